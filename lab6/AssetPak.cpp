@@ -0,0 +1,387 @@
+#include "framework.h"
+
+#include "AssetPak.h"
+#include "ContentHash.h"
+#include "MappedFile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+
+    const uint32_t AssetPakSignature = 0x4B415041;     ///< "APAK"
+    const uint32_t AssetPakVersion = 1;
+    const uint64_t AssetPakAlignment = 4096;
+
+#pragma pack(push)
+#pragma pack(1)
+
+    /** Start of the archive, the table of contents and the names blob follow right after it */
+    struct AssetPakHeader
+    {
+        uint32_t signature;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t namesSize;
+    };
+
+    /** Table of contents record, records are sorted by nameHash and then by name */
+    struct AssetPakEntry
+    {
+        uint64_t nameHash;
+        uint64_t offset;        ///< From the start of the archive, multiple of AssetPakAlignment
+        uint64_t size;
+        uint32_t nameOffset;    ///< From the start of the names blob
+        uint32_t nameLength;
+    };
+
+#pragma pack(pop)
+
+    std::mutex g_mountMutex;
+    std::shared_ptr<AssetPak> g_pMountedPak;
+
+    uint64_t HashName(const std::string& name)
+    {
+        return ComputeContentHash(name.data(), name.size());
+    }
+
+    bool ReadWholeFile(const std::wstring& filepath, std::vector<uint8_t>& data)
+    {
+        FILE* pFile = nullptr;
+        _wfopen_s(&pFile, filepath.c_str(), L"rb");
+        if (pFile == nullptr)
+        {
+            return false;
+        }
+
+        fseek(pFile, 0, SEEK_END);
+        long long fileSize = _ftelli64(pFile);
+        fseek(pFile, 0, SEEK_SET);
+
+        if (fileSize < 0)
+        {
+            fclose(pFile);
+            return false;
+        }
+
+        data.resize((size_t)fileSize);
+        size_t readSize = fileSize != 0 ? fread(data.data(), 1, (size_t)fileSize, pFile) : 0;
+        fclose(pFile);
+
+        return readSize == (size_t)fileSize;
+    }
+
+    bool WritePadding(FILE* pFile, uint64_t& offset)
+    {
+        static const uint8_t Zeros[AssetPakAlignment] = {};
+
+        size_t padding = (size_t)(DivUp(offset, AssetPakAlignment) * AssetPakAlignment - offset);
+        offset += padding;
+
+        return padding == 0 || fwrite(Zeros, 1, padding, pFile) == padding;
+    }
+
+}
+
+std::shared_ptr<AssetPak> AssetPak::Open(const std::wstring& filepath)
+{
+    std::shared_ptr<MappedFile> pFile = MappedFile::Open(filepath);
+    if (pFile == nullptr || pFile->GetSize() < sizeof(AssetPakHeader))
+    {
+        return nullptr;
+    }
+
+    const uint8_t* pBytes = pFile->GetData();
+    const size_t fileSize = pFile->GetSize();
+
+    AssetPakHeader header;
+    memcpy(&header, pBytes, sizeof(AssetPakHeader));
+
+    if (header.signature != AssetPakSignature || header.version != AssetPakVersion)
+    {
+        return nullptr;
+    }
+
+    const uint64_t tocSize = (uint64_t)header.entryCount * sizeof(AssetPakEntry);
+    if (fileSize - sizeof(AssetPakHeader) < tocSize + header.namesSize)
+    {
+        return nullptr;
+    }
+
+    // Every record is checked once here, lookups then trust the table
+    const uint8_t* pEntries = pBytes + sizeof(AssetPakHeader);
+    for (uint32_t i = 0; i < header.entryCount; i++)
+    {
+        AssetPakEntry entry;
+        memcpy(&entry, pEntries + (size_t)i * sizeof(AssetPakEntry), sizeof(AssetPakEntry));
+
+        if ((uint64_t)entry.nameOffset + entry.nameLength > header.namesSize
+            || entry.offset > fileSize || fileSize - entry.offset < entry.size
+            || entry.offset % AssetPakAlignment != 0)
+        {
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<AssetPak> pPak(new AssetPak());
+    pPak->m_pFile = pFile;
+    pPak->m_pEntries = pEntries;
+    pPak->m_entryCount = header.entryCount;
+
+    return pPak;
+}
+
+void AssetPak::Mount(const std::shared_ptr<AssetPak>& pPak)
+{
+    std::lock_guard<std::mutex> lock(g_mountMutex);
+    g_pMountedPak = pPak;
+}
+
+std::shared_ptr<AssetPak> AssetPak::GetMounted()
+{
+    std::lock_guard<std::mutex> lock(g_mountMutex);
+    return g_pMountedPak;
+}
+
+bool AssetPak::Find(const std::wstring& path, AssetView& view) const
+{
+    const std::string name = NormalizePath(path);
+    const uint64_t hash = HashName(name);
+
+    const char* pNames = reinterpret_cast<const char*>(m_pEntries + (size_t)m_entryCount * sizeof(AssetPakEntry));
+
+    auto readEntry = [this](uint32_t index)
+    {
+        AssetPakEntry entry;
+        memcpy(&entry, m_pEntries + (size_t)index * sizeof(AssetPakEntry), sizeof(AssetPakEntry));
+        return entry;
+    };
+
+    // Lower bound of the hash, equal hashes are told apart by the stored name
+    uint32_t first = 0;
+    uint32_t count = m_entryCount;
+    while (count > 0)
+    {
+        uint32_t step = count / 2;
+        if (readEntry(first + step).nameHash < hash)
+        {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    for (uint32_t i = first; i < m_entryCount; i++)
+    {
+        AssetPakEntry entry = readEntry(i);
+        if (entry.nameHash != hash)
+        {
+            break;
+        }
+
+        if (entry.nameLength == name.size() && memcmp(pNames + entry.nameOffset, name.data(), name.size()) == 0)
+        {
+            view.pData = m_pFile->GetData() + entry.offset;
+            view.size = (size_t)entry.size;
+            view.pStorage = m_pFile;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::string AssetPak::NormalizePath(const std::wstring& path)
+{
+    std::string result;
+    result.reserve(path.size());
+
+    size_t start = 0;
+    while (start <= path.size())
+    {
+        size_t end = path.find_first_of(L"/\\", start);
+        if (end == std::wstring::npos)
+        {
+            end = path.size();
+        }
+
+        std::wstring segment = path.substr(start, end - start);
+        if (!segment.empty() && segment != L"." && segment != L"..")
+        {
+            if (!result.empty())
+            {
+                result += '/';
+            }
+
+            // Names are ASCII in practice, other characters are kept as UTF-8
+            for (wchar_t ch : segment)
+            {
+                uint32_t c = (uint32_t)ch;
+                if (c < 0x80)
+                {
+                    result += (char)(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+                }
+                else if (c < 0x800)
+                {
+                    result += (char)(0xC0 | (c >> 6));
+                    result += (char)(0x80 | (c & 0x3F));
+                }
+                else
+                {
+                    result += (char)(0xE0 | ((c >> 12) & 0x0F));
+                    result += (char)(0x80 | ((c >> 6) & 0x3F));
+                    result += (char)(0x80 | (c & 0x3F));
+                }
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return result;
+}
+
+bool WriteAssetPak(const std::wstring& filepath, const std::vector<AssetPakSource>& sources)
+{
+    struct Record
+    {
+        std::string name;
+        uint64_t hash;
+        size_t sourceIndex;
+    };
+
+    std::vector<Record> records;
+    records.reserve(sources.size());
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        Record record;
+        record.name = AssetPak::NormalizePath(sources[i].name);
+        record.hash = HashName(record.name);
+        record.sourceIndex = i;
+        records.push_back(std::move(record));
+    }
+
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b)
+    {
+        return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+    });
+
+    std::string names;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i].name.empty() || (i > 0 && records[i].name == records[i - 1].name))
+        {
+            return false;
+        }
+        names += records[i].name;
+    }
+
+    // Sizes are known only after reading, so the table is written last
+    std::vector<AssetPakEntry> entries(records.size());
+
+    FILE* pFile = nullptr;
+    _wfopen_s(&pFile, filepath.c_str(), L"wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    uint64_t offset = sizeof(AssetPakHeader) + entries.size() * sizeof(AssetPakEntry) + names.size();
+    bool success = fseek(pFile, (long)offset, SEEK_SET) == 0;
+
+    uint32_t nameOffset = 0;
+    std::vector<uint8_t> data;
+    for (size_t i = 0; i < records.size() && success; i++)
+    {
+        success = WritePadding(pFile, offset)
+            && ReadWholeFile(sources[records[i].sourceIndex].filepath, data)
+            && (data.empty() || fwrite(data.data(), 1, data.size(), pFile) == data.size());
+
+        AssetPakEntry& entry = entries[i];
+        entry.nameHash = records[i].hash;
+        entry.offset = offset;
+        entry.size = data.size();
+        entry.nameOffset = nameOffset;
+        entry.nameLength = (uint32_t)records[i].name.size();
+
+        offset += data.size();
+        nameOffset += entry.nameLength;
+    }
+
+    AssetPakHeader header;
+    header.signature = AssetPakSignature;
+    header.version = AssetPakVersion;
+    header.entryCount = (uint32_t)entries.size();
+    header.namesSize = (uint32_t)names.size();
+
+    success = success
+        && fseek(pFile, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(AssetPakHeader), 1, pFile) == 1
+        && (entries.empty() || fwrite(entries.data(), sizeof(AssetPakEntry), entries.size(), pFile) == entries.size())
+        && (names.empty() || fwrite(names.data(), 1, names.size(), pFile) == names.size());
+
+    success = fclose(pFile) == 0 && success;
+    if (!success)
+    {
+        _wremove(filepath.c_str());
+    }
+
+    return success;
+}
+
+bool WriteFileReplacing(const std::wstring& filepath, const std::function<bool(FILE* pFile)>& write)
+{
+    // Unique per process and call, writers of the same file never share a temporary one
+    static std::atomic<uint32_t> s_tempIndex(0);
+
+    wchar_t suffix[48];
+    swprintf(suffix, sizeof(suffix) / sizeof(suffix[0]), L".%lu.%u.tmp", (unsigned long)GetCurrentProcessId(),
+        (unsigned)s_tempIndex++);
+    const std::wstring tempPath = filepath + suffix;
+
+    FILE* pFile = nullptr;
+    _wfopen_s(&pFile, tempPath.c_str(), L"wb");
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    bool success = write(pFile);
+    success = fclose(pFile) == 0 && success;
+
+    success = success && MoveFileExW(tempPath.c_str(), filepath.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if (!success)
+    {
+        _wremove(tempPath.c_str());
+    }
+
+    return success;
+}
+
+bool OpenAsset(const std::wstring& filepath, AssetView& view)
+{
+    std::shared_ptr<AssetPak> pPak = AssetPak::GetMounted();
+    if (pPak != nullptr && pPak->Find(filepath, view))
+    {
+        return true;
+    }
+
+    std::shared_ptr<MappedFile> pFile = MappedFile::Open(filepath);
+    if (pFile == nullptr)
+    {
+        return false;
+    }
+
+    view.pData = pFile->GetData();
+    view.size = pFile->GetSize();
+    view.pStorage = pFile;
+
+    return true;
+}
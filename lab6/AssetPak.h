@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class MappedFile;
+
+/** Bytes of one file, kept alive by pStorage */
+struct AssetView
+{
+    const uint8_t* pData = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> pStorage;
+};
+
+/**
+ * Read-only archive of many files served from a single memory mapping. The table of
+ * contents is sorted by the hash of the normalized name and is searched in place, file
+ * data starts at 4K aligned offsets. Names are matched case-insensitively with "." and
+ * ".." segments dropped, so "../textures/bricks.dds" finds "textures/bricks.dds".
+ */
+class AssetPak
+{
+public:
+    /** Maps and validates the archive, returns nullptr if it is missing or broken */
+    static std::shared_ptr<AssetPak> Open(const std::wstring& filepath);
+
+    /** Makes the archive the one OpenAsset consults first, nullptr unmounts */
+    static void Mount(const std::shared_ptr<AssetPak>& pPak);
+    static std::shared_ptr<AssetPak> GetMounted();
+
+    bool Find(const std::wstring& path, AssetView& view) const;
+
+    uint32_t GetEntryCount() const { return m_entryCount; }
+
+    /** Lower case name with '/' separators and no "." or ".." segments */
+    static std::string NormalizePath(const std::wstring& path);
+
+private:
+    AssetPak() = default;
+
+    std::shared_ptr<MappedFile> m_pFile;
+    const uint8_t* m_pEntries = nullptr;
+    uint32_t m_entryCount = 0;
+};
+
+/** One file going into an archive */
+struct AssetPakSource
+{
+    std::wstring filepath;      ///< File on disk
+    std::wstring name;          ///< Name to find it by, normalized on write
+};
+
+/** Writes the files into a new archive, fails on unreadable files and duplicate names */
+bool WriteAssetPak(const std::wstring& filepath, const std::vector<AssetPakSource>& sources);
+
+/**
+ * Writes the file through a uniquely named temporary one in the same directory that is
+ * renamed over it once write returned true, so a reader never maps a partial file. The
+ * temporary one is deleted if writing or the rename fails.
+ */
+bool WriteFileReplacing(const std::wstring& filepath, const std::function<bool(FILE* pFile)>& write);
+
+/** Maps the file from the mounted archive if it is packed there, from disk otherwise */
+bool OpenAsset(const std::wstring& filepath, AssetView& view);
@@ -0,0 +1,1030 @@
+#include "framework.h"
+
+#include "BCDecoder.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+#include <string.h>
+
+// Define BC_NO_SIMD to build only the scalar decoders
+#if !defined(BC_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define BC_DECODER_SSE 1
+#include <smmintrin.h>
+#endif
+
+// MSVC emits SSE4.1 intrinsics without extra switches, GCC and Clang need them enabled per function
+#if defined(BC_DECODER_SSE) && !defined(_MSC_VER)
+#define BC_SSE_TARGET __attribute__((target("sse4.1")))
+#else
+#define BC_SSE_TARGET
+#endif
+
+namespace
+{
+
+    /** Decodes a 4x4 block into 4 rows of 16 bytes starting at pDst */
+    typedef void (*BlockDecoder)(const UINT8* pBlock, UINT8* pDst, size_t dstPitch);
+
+    inline UINT16 ReadUInt16(const UINT8* pData)
+    {
+        return (UINT16)(pData[0] | (pData[1] << 8));
+    }
+
+    inline UINT32 ReadUInt32(const UINT8* pData)
+    {
+        return (UINT32)pData[0] | ((UINT32)pData[1] << 8) | ((UINT32)pData[2] << 16) | ((UINT32)pData[3] << 24);
+    }
+
+    inline UINT64 ReadUInt64(const UINT8* pData)
+    {
+        return (UINT64)ReadUInt32(pData) | ((UINT64)ReadUInt32(pData + 4) << 32);
+    }
+
+    inline UINT32 PackRGBA(UINT32 r, UINT32 g, UINT32 b, UINT32 a)
+    {
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    inline void StorePixel(UINT8* pDst, UINT32 rgba)
+    {
+        memcpy(pDst, &rgba, 4);
+    }
+
+    /** Builds the 4 entry color palette of a BC1-BC3 color block */
+    void BuildColorPalette(const UINT8* pBlock, bool allowPunchThrough, UINT32 palette[4])
+    {
+        UINT16 c0 = ReadUInt16(pBlock);
+        UINT16 c1 = ReadUInt16(pBlock + 2);
+
+        UINT32 r0 = (c0 >> 11) & 0x1F, g0 = (c0 >> 5) & 0x3F, b0 = c0 & 0x1F;
+        UINT32 r1 = (c1 >> 11) & 0x1F, g1 = (c1 >> 5) & 0x3F, b1 = c1 & 0x1F;
+
+        r0 = (r0 << 3) | (r0 >> 2); g0 = (g0 << 2) | (g0 >> 4); b0 = (b0 << 3) | (b0 >> 2);
+        r1 = (r1 << 3) | (r1 >> 2); g1 = (g1 << 2) | (g1 >> 4); b1 = (b1 << 3) | (b1 >> 2);
+
+        palette[0] = PackRGBA(r0, g0, b0, 255);
+        palette[1] = PackRGBA(r1, g1, b1, 255);
+
+        // BC2 and BC3 always use four colors, BC1 switches to 1-bit alpha mode on c0 <= c1
+        if (!allowPunchThrough || c0 > c1)
+        {
+            palette[2] = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 255);
+            palette[3] = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 255);
+        }
+        else
+        {
+            palette[2] = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+            palette[3] = 0;
+        }
+    }
+
+    /** Builds the 8 entry palette of a BC3/BC4/BC5 UNORM channel block */
+    void BuildUnormPalette(const UINT8* pBlock, UINT8 palette[8])
+    {
+        UINT32 a0 = pBlock[0];
+        UINT32 a1 = pBlock[1];
+
+        palette[0] = (UINT8)a0;
+        palette[1] = (UINT8)a1;
+
+        if (a0 > a1)
+        {
+            for (UINT32 i = 1; i < 7; i++)
+            {
+                palette[i + 1] = (UINT8)(((7 - i) * a0 + i * a1) / 7);
+            }
+        }
+        else
+        {
+            for (UINT32 i = 1; i < 5; i++)
+            {
+                palette[i + 1] = (UINT8)(((5 - i) * a0 + i * a1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    /** Builds the palette of a BC4/BC5 SNORM channel block remapped to [0, 255] */
+    void BuildSnormPalette(const UINT8* pBlock, UINT8 palette[8])
+    {
+        int a0 = std::max((int)(INT8)pBlock[0], -127);
+        int a1 = std::max((int)(INT8)pBlock[1], -127);
+
+        int values[8] = { a0, a1 };
+
+        if (a0 > a1)
+        {
+            for (int i = 1; i < 7; i++)
+            {
+                values[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+            }
+        }
+        else
+        {
+            for (int i = 1; i < 5; i++)
+            {
+                values[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+            }
+            values[6] = -127;
+            values[7] = 127;
+        }
+
+        for (int i = 0; i < 8; i++)
+        {
+            palette[i] = (UINT8)(((values[i] + 127) * 255 + 127) / 254);
+        }
+    }
+
+    /** Unpacks 16 3-bit palette indices stored after the two endpoints */
+    void UnpackChannelIndices(const UINT8* pBlock, UINT8 indices[16])
+    {
+        UINT64 bits = ReadUInt64(pBlock) >> 16;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            indices[i] = (UINT8)((bits >> (3 * i)) & 7);
+        }
+    }
+
+    //
+    // Scalar decoders
+    //
+
+    void DecodeColorBlock(const UINT8* pBlock, bool allowPunchThrough, UINT8* pDst, size_t dstPitch)
+    {
+        UINT32 palette[4];
+        BuildColorPalette(pBlock, allowPunchThrough, palette);
+
+        UINT32 indices = ReadUInt32(pBlock + 4);
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            for (UINT32 x = 0; x < 4; x++)
+            {
+                StorePixel(pDst + y * dstPitch + x * 4, palette[(indices >> (2 * (y * 4 + x))) & 3]);
+            }
+        }
+    }
+
+    /** Writes 16 channel values into byte `channel` of every pixel */
+    void StoreChannel(const UINT8 values[16], UINT32 channel, UINT8* pDst, size_t dstPitch)
+    {
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            for (UINT32 x = 0; x < 4; x++)
+            {
+                pDst[y * dstPitch + x * 4 + channel] = values[y * 4 + x];
+            }
+        }
+    }
+
+    void DecodeChannelBlock(const UINT8* pBlock, bool isSigned, UINT32 channel, UINT8* pDst, size_t dstPitch)
+    {
+        UINT8 palette[8];
+        if (isSigned)
+        {
+            BuildSnormPalette(pBlock, palette);
+        }
+        else
+        {
+            BuildUnormPalette(pBlock, palette);
+        }
+
+        UINT8 indices[16];
+        UnpackChannelIndices(pBlock, indices);
+
+        UINT8 values[16];
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            values[i] = palette[indices[i]];
+        }
+
+        StoreChannel(values, channel, pDst, dstPitch);
+    }
+
+    void FillBlock(UINT32 rgba, UINT8* pDst, size_t dstPitch)
+    {
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            for (UINT32 x = 0; x < 4; x++)
+            {
+                StorePixel(pDst + y * dstPitch + x * 4, rgba);
+            }
+        }
+    }
+
+    void DecodeBC1Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        DecodeColorBlock(pBlock, true, pDst, dstPitch);
+    }
+
+    void DecodeBC2Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        DecodeColorBlock(pBlock + 8, false, pDst, dstPitch);
+
+        UINT64 bits = ReadUInt64(pBlock);
+        UINT8 values[16];
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            values[i] = (UINT8)(((bits >> (4 * i)) & 0xF) * 17);
+        }
+
+        StoreChannel(values, 3, pDst, dstPitch);
+    }
+
+    void DecodeBC3Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        DecodeColorBlock(pBlock + 8, false, pDst, dstPitch);
+        DecodeChannelBlock(pBlock, false, 3, pDst, dstPitch);
+    }
+
+    template <bool IsSigned>
+    void DecodeBC4Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        FillBlock(PackRGBA(0, 0, 0, 255), pDst, dstPitch);
+        DecodeChannelBlock(pBlock, IsSigned, 0, pDst, dstPitch);
+    }
+
+    template <bool IsSigned>
+    void DecodeBC5Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        FillBlock(PackRGBA(0, 0, 0, 255), pDst, dstPitch);
+        DecodeChannelBlock(pBlock, IsSigned, 0, pDst, dstPitch);
+        DecodeChannelBlock(pBlock + 8, IsSigned, 1, pDst, dstPitch);
+    }
+
+#ifdef BC_DECODER_SSE
+
+    //
+    // SSE4.1 decoders, palette lookups are done with byte shuffles
+    //
+
+    /** pshufb masks picking 4 palette entries by a byte of four 2-bit indices */
+    struct ColorShuffleTable
+    {
+        alignas(16) UINT8 masks[256][16];
+
+        ColorShuffleTable()
+        {
+            for (UINT32 code = 0; code < 256; code++)
+            {
+                for (UINT32 x = 0; x < 4; x++)
+                {
+                    UINT32 index = (code >> (2 * x)) & 3;
+                    for (UINT32 c = 0; c < 4; c++)
+                    {
+                        masks[code][x * 4 + c] = (UINT8)(index * 4 + c);
+                    }
+                }
+            }
+        }
+    };
+
+    const ColorShuffleTable ColorShuffles;
+
+    BC_SSE_TARGET inline void StoreColorRowsSSE(const UINT32 palette[4], UINT32 indices, UINT8* pDst, size_t dstPitch)
+    {
+        __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette));
+
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(ColorShuffles.masks[(indices >> (8 * y)) & 0xFF]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + y * dstPitch), _mm_shuffle_epi8(colors, mask));
+        }
+    }
+
+    /** Moves 16 channel bytes into byte `Channel` of each pixel, rows are merged into pDst */
+    template <UINT32 Channel>
+    BC_SSE_TARGET inline void MergeChannelSSE(__m128i values, UINT8* pDst, size_t dstPitch)
+    {
+        const __m128i keepMask = _mm_set1_epi32((int)~(0xFFu << (8 * Channel)));
+
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            const char b = (char)(4 * y);
+            const char z = (char)0x80;
+            __m128i spread = _mm_setr_epi8(
+                Channel == 0 ? b : z, Channel == 1 ? b : z, Channel == 2 ? b : z, Channel == 3 ? b : z,
+                Channel == 0 ? b + 1 : z, Channel == 1 ? b + 1 : z, Channel == 2 ? b + 1 : z, Channel == 3 ? b + 1 : z,
+                Channel == 0 ? b + 2 : z, Channel == 1 ? b + 2 : z, Channel == 2 ? b + 2 : z, Channel == 3 ? b + 2 : z,
+                Channel == 0 ? b + 3 : z, Channel == 1 ? b + 3 : z, Channel == 2 ? b + 3 : z, Channel == 3 ? b + 3 : z);
+
+            __m128i* pRow = reinterpret_cast<__m128i*>(pDst + y * dstPitch);
+            __m128i row = _mm_and_si128(_mm_loadu_si128(pRow), keepMask);
+            _mm_storeu_si128(pRow, _mm_or_si128(row, _mm_shuffle_epi8(values, spread)));
+        }
+    }
+
+    BC_SSE_TARGET inline __m128i LookupChannelSSE(const UINT8* pBlock, bool isSigned)
+    {
+        alignas(16) UINT8 palette[16] = {};
+        if (isSigned)
+        {
+            BuildSnormPalette(pBlock, palette);
+        }
+        else
+        {
+            BuildUnormPalette(pBlock, palette);
+        }
+
+        alignas(16) UINT8 indices[16];
+        UnpackChannelIndices(pBlock, indices);
+
+        return _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(palette)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(indices)));
+    }
+
+    BC_SSE_TARGET void DecodeBC1SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        UINT32 palette[4];
+        BuildColorPalette(pBlock, true, palette);
+        StoreColorRowsSSE(palette, ReadUInt32(pBlock + 4), pDst, dstPitch);
+    }
+
+    BC_SSE_TARGET void DecodeBC2SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        UINT32 palette[4];
+        BuildColorPalette(pBlock + 8, false, palette);
+        StoreColorRowsSSE(palette, ReadUInt32(pBlock + 12), pDst, dstPitch);
+
+        // Low nibble of each byte is the first of two pixels
+        __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pBlock));
+        __m128i low = _mm_and_si128(packed, _mm_set1_epi8(0x0F));
+        __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), _mm_set1_epi8(0x0F));
+        __m128i nibbles = _mm_unpacklo_epi8(low, high);
+        __m128i alpha = _mm_or_si128(nibbles, _mm_slli_epi16(nibbles, 4));
+
+        MergeChannelSSE<3>(alpha, pDst, dstPitch);
+    }
+
+    BC_SSE_TARGET void DecodeBC3SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        UINT32 palette[4];
+        BuildColorPalette(pBlock + 8, false, palette);
+        StoreColorRowsSSE(palette, ReadUInt32(pBlock + 12), pDst, dstPitch);
+
+        MergeChannelSSE<3>(LookupChannelSSE(pBlock, false), pDst, dstPitch);
+    }
+
+    template <bool IsSigned>
+    BC_SSE_TARGET void DecodeBC4SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        __m128i opaque = _mm_set1_epi32((int)0xFF000000);
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + y * dstPitch), opaque);
+        }
+
+        MergeChannelSSE<0>(LookupChannelSSE(pBlock, IsSigned), pDst, dstPitch);
+    }
+
+    template <bool IsSigned>
+    BC_SSE_TARGET void DecodeBC5SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        __m128i red = LookupChannelSSE(pBlock, IsSigned);
+        __m128i green = LookupChannelSSE(pBlock + 8, IsSigned);
+
+        // Interleaving R and G bytes gives RG pairs, widening them with 0x00FF gives RGBA
+        __m128i rg01 = _mm_unpacklo_epi8(red, green);
+        __m128i rg23 = _mm_unpackhi_epi8(red, green);
+        __m128i ba = _mm_set1_epi16((short)0xFF00);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), _mm_unpacklo_epi16(rg01, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + dstPitch), _mm_unpackhi_epi16(rg01, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 2 * dstPitch), _mm_unpacklo_epi16(rg23, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 3 * dstPitch), _mm_unpackhi_epi16(rg23, ba));
+    }
+
+#endif
+
+    //
+    // BC7
+    //
+
+    struct BC7ModeInfo
+    {
+        UINT8 subsets;
+        UINT8 partitionBits;
+        UINT8 rotationBits;
+        UINT8 indexSelectionBits;
+        UINT8 colorBits;
+        UINT8 alphaBits;
+        UINT8 endpointPBits;
+        UINT8 sharedPBits;
+        UINT8 indexBits;
+        UINT8 indexBits2;
+    };
+
+    constexpr BC7ModeInfo BC7Modes[8] =
+    {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+        { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+        { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+        { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+        { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 }
+    };
+
+    /** Subset of each pixel for the 2-subset partitions */
+    const UINT8 BC7Partitions2[64][16] =
+    {
+        { 0,0,1,1,0,0,1,1,0,0,1,1,0,0,1,1 }, { 0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1 },
+        { 0,1,1,1,0,1,1,1,0,1,1,1,0,1,1,1 }, { 0,0,0,1,0,0,1,1,0,0,1,1,0,1,1,1 },
+        { 0,0,0,0,0,0,0,1,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,0,1,1,1,1,1,1,1 },
+        { 0,0,0,1,0,0,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,0,1,1,0,1,1,1 },
+        { 0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,1,1,1,1,1,1,1,1 },
+        { 0,0,0,0,0,0,0,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,1,0,1,1,1 },
+        { 0,0,0,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1 },
+        { 0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1 },
+        { 0,0,0,0,1,0,0,0,1,1,1,0,1,1,1,1 }, { 0,1,1,1,0,0,0,1,0,0,0,0,0,0,0,0 },
+        { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,1,0 }, { 0,1,1,1,0,0,1,1,0,0,0,1,0,0,0,0 },
+        { 0,0,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,1,0,0,1,1,1,0 },
+        { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,1,0,0,1,1,0,0,1,1,0,0,0,1 },
+        { 0,0,1,1,0,0,0,1,0,0,0,1,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,0,0,0,1,1,0,0 },
+        { 0,1,1,0,0,1,1,0,0,1,1,0,0,1,1,0 }, { 0,0,1,1,0,1,1,0,0,1,1,0,1,1,0,0 },
+        { 0,0,0,1,0,1,1,1,1,1,1,0,1,0,0,0 }, { 0,0,0,0,1,1,1,1,1,1,1,1,0,0,0,0 },
+        { 0,1,1,1,0,0,0,1,1,0,0,0,1,1,1,0 }, { 0,0,1,1,1,0,0,1,1,0,0,1,1,1,0,0 },
+        { 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 }, { 0,0,0,0,1,1,1,1,0,0,0,0,1,1,1,1 },
+        { 0,1,0,1,1,0,1,0,0,1,0,1,1,0,1,0 }, { 0,0,1,1,0,0,1,1,1,1,0,0,1,1,0,0 },
+        { 0,0,1,1,1,1,0,0,0,0,1,1,1,1,0,0 }, { 0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0 },
+        { 0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1 }, { 0,1,0,1,1,0,1,0,1,0,1,0,0,1,0,1 },
+        { 0,1,1,1,0,0,1,1,1,1,0,0,1,1,1,0 }, { 0,0,0,1,0,0,1,1,1,1,0,0,1,0,0,0 },
+        { 0,0,1,1,0,0,1,0,0,1,0,0,1,1,0,0 }, { 0,0,1,1,1,0,1,1,1,1,0,1,1,1,0,0 },
+        { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0 }, { 0,0,1,1,1,1,0,0,1,1,0,0,0,0,1,1 },
+        { 0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1 }, { 0,0,0,0,0,1,1,0,0,1,1,0,0,0,0,0 },
+        { 0,1,0,0,1,1,1,0,0,1,0,0,0,0,0,0 }, { 0,0,1,0,0,1,1,1,0,0,1,0,0,0,0,0 },
+        { 0,0,0,0,0,0,1,0,0,1,1,1,0,0,1,0 }, { 0,0,0,0,0,1,0,0,1,1,1,0,0,1,0,0 },
+        { 0,1,1,0,1,1,0,0,1,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,0,1,1,0,0,1,0,0,1 },
+        { 0,1,1,0,0,0,1,1,1,0,0,1,1,1,0,0 }, { 0,0,1,1,1,0,0,1,1,1,0,0,0,1,1,0 },
+        { 0,1,1,0,1,1,0,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,0,0,1,1,1,0,0,1 },
+        { 0,1,1,1,1,1,1,0,1,0,0,0,0,0,0,1 }, { 0,0,0,1,1,0,0,0,1,1,1,0,0,1,1,1 },
+        { 0,0,0,0,1,1,1,1,0,0,1,1,0,0,1,1 }, { 0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0 },
+        { 0,0,1,0,0,0,1,0,1,1,1,0,1,1,1,0 }, { 0,1,0,0,0,1,0,0,0,1,1,1,0,1,1,1 }
+    };
+
+    /** Subset of each pixel for the 3-subset partitions */
+    const UINT8 BC7Partitions3[64][16] =
+    {
+        { 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 },
+        { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+        { 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 },
+        { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+        { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 },
+        { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+        { 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 },
+        { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+        { 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 },
+        { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+        { 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 },
+        { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+        { 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 },
+        { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+        { 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 },
+        { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+        { 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 },
+        { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+        { 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+        { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+        { 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 },
+        { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+        { 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 },
+        { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+        { 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 },
+        { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+        { 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 },
+        { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+        { 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 },
+        { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+        { 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 },
+        { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 }
+    };
+
+    /** Anchor pixel of the second subset of 2-subset partitions */
+    const UINT8 BC7Anchors2[64] =
+    {
+        15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+        15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+        15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+         6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15
+    };
+
+    /** Anchor pixel of the second subset of 3-subset partitions */
+    const UINT8 BC7Anchors3Second[64] =
+    {
+         3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+         3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+         8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+         3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3
+    };
+
+    /** Anchor pixel of the third subset of 3-subset partitions */
+    const UINT8 BC7Anchors3Third[64] =
+    {
+        15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+        15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+        15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+        15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8
+    };
+
+    /** Weights are padded to 16 entries so that they can be used as a shuffle source */
+    alignas(16) const UINT8 BC7Weights2[16] = { 0, 21, 43, 64 };
+    alignas(16) const UINT8 BC7Weights3[16] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    alignas(16) const UINT8 BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    alignas(16) const UINT8 BC7SingleSubset[16] = {};
+
+    const UINT8* GetBC7Weights(UINT32 indexBits)
+    {
+        return indexBits == 2 ? BC7Weights2 : indexBits == 3 ? BC7Weights3 : BC7Weights4;
+    }
+
+    inline UINT32 CountTrailingZeros(UINT32 value)
+    {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, value);
+        return index;
+#else
+        return (UINT32)__builtin_ctz(value);
+#endif
+    }
+
+    /** Reads little-endian bit fields of a 128-bit block, fields are at most 8 bits wide */
+    class BlockBitReader
+    {
+    public:
+        explicit BlockBitReader(const UINT8* pBlock)
+            : m_low(ReadUInt64(pBlock))
+            , m_high(ReadUInt64(pBlock + 8))
+        {
+        }
+
+        UINT32 Read(UINT32 count)
+        {
+            UINT32 value = Peek(m_position, count);
+            m_position += count;
+            return value;
+        }
+
+        /** Field at an absolute position, independent peeks let the CPU extract indices in parallel */
+        UINT32 Peek(UINT32 position, UINT32 count) const
+        {
+            // Splitting the shift keeps it defined for position == 0
+            UINT64 bits = position >= 64 ? m_high >> (position - 64)
+                : (m_low >> position) | ((m_high << 1) << (63 - position));
+            return (UINT32)bits & ((1u << count) - 1);
+        }
+
+        UINT32 GetPosition() const { return m_position; }
+        void Skip(UINT32 count) { m_position += count; }
+
+    private:
+        UINT64 m_low;
+        UINT64 m_high;
+        UINT32 m_position = 0;
+    };
+
+    /** BC7 block unpacked to endpoints and per pixel weights */
+    struct BC7Block
+    {
+        alignas(16) UINT8 endpoints[2][4][16];  ///< [endpoint][channel][subset], padded for shuffles
+        alignas(16) UINT8 colorIndices[16];
+        alignas(16) UINT8 alphaIndices[16];
+
+        const UINT8* pSubsets;
+        const UINT8* pColorWeights;
+        const UINT8* pAlphaWeights;
+        UINT32 rotation;
+    };
+
+    /** Instantiated per mode so that all field widths and loop counts are constants */
+    template <UINT32 Mode>
+    void ParseBC7Block(const UINT8* pBlock, BC7Block& block)
+    {
+        constexpr BC7ModeInfo info = BC7Modes[Mode];
+
+        BlockBitReader reader(pBlock);
+        reader.Skip(Mode + 1);
+
+        UINT32 partition = reader.Read(info.partitionBits);
+        block.rotation = reader.Read(info.rotationBits);
+        UINT32 indexSelection = reader.Read(info.indexSelectionBits);
+
+        const UINT32 endpointCount = info.subsets * 2u;
+
+        UINT32 endpoints[6][4] = {};
+        for (UINT32 c = 0; c < 3; c++)
+        {
+            for (UINT32 e = 0; e < endpointCount; e++)
+            {
+                endpoints[e][c] = reader.Read(info.colorBits);
+            }
+        }
+
+        for (UINT32 e = 0; e < endpointCount && info.alphaBits != 0; e++)
+        {
+            endpoints[e][3] = reader.Read(info.alphaBits);
+        }
+
+        UINT32 pBits[6] = {};
+        if (info.endpointPBits)
+        {
+            for (UINT32 e = 0; e < endpointCount; e++)
+            {
+                pBits[e] = reader.Read(1);
+            }
+        }
+        else if (info.sharedPBits)
+        {
+            for (UINT32 s = 0; s < info.subsets; s++)
+            {
+                pBits[2 * s] = pBits[2 * s + 1] = reader.Read(1);
+            }
+        }
+
+        const UINT32 pBitCount = (info.endpointPBits || info.sharedPBits) ? 1 : 0;
+
+        // Endpoints are expanded to 8 bits by replicating their top bits
+        memset(block.endpoints, 0, sizeof(block.endpoints));
+        for (UINT32 e = 0; e < endpointCount; e++)
+        {
+            for (UINT32 c = 0; c < 4; c++)
+            {
+                UINT32 bits = c < 3 ? info.colorBits : info.alphaBits;
+                UINT32 value = 255;
+
+                if (bits != 0)
+                {
+                    value = (endpoints[e][c] << pBitCount) | (pBits[e] & pBitCount);
+                    bits += pBitCount;
+                    value = (value << (8 - bits)) | (value >> (2 * bits - 8));
+                }
+
+                block.endpoints[e & 1][c][e / 2] = (UINT8)value;
+            }
+        }
+
+        block.pSubsets = info.subsets == 2 ? BC7Partitions2[partition]
+            : info.subsets == 3 ? BC7Partitions3[partition] : BC7SingleSubset;
+
+        UINT32 anchor1 = info.subsets == 2 ? BC7Anchors2[partition]
+            : info.subsets == 3 ? BC7Anchors3Second[partition] : 0;
+        UINT32 anchor2 = info.subsets == 3 ? BC7Anchors3Third[partition] : 0;
+
+        UINT32 anchorMask = 1u | (1u << anchor1) | (1u << anchor2);
+
+        // Anchor indices have their implicit top bit dropped
+        UINT32 position = reader.GetPosition();
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            UINT32 bits = info.indexBits - ((anchorMask >> i) & 1);
+            block.colorIndices[i] = (UINT8)reader.Peek(position, bits);
+            position += bits;
+        }
+
+        UINT32 colorIndexBits = info.indexBits;
+        UINT32 alphaIndexBits = info.indexBits;
+
+        if (info.indexBits2 == 0)
+        {
+            memcpy(block.alphaIndices, block.colorIndices, 16);
+        }
+        else
+        {
+            for (UINT32 i = 0; i < 16; i++)
+            {
+                UINT32 bits = info.indexBits2 - (i == 0 ? 1 : 0);
+                block.alphaIndices[i] = (UINT8)reader.Peek(position, bits);
+                position += bits;
+            }
+
+            alphaIndexBits = info.indexBits2;
+
+            if (indexSelection)
+            {
+                std::swap(block.colorIndices, block.alphaIndices);
+                std::swap(colorIndexBits, alphaIndexBits);
+            }
+        }
+
+        block.pColorWeights = GetBC7Weights(colorIndexBits);
+        block.pAlphaWeights = GetBC7Weights(alphaIndexBits);
+    }
+
+    /** Returns false for the reserved mode */
+    bool ParseBC7Block(const UINT8* pBlock, BC7Block& block)
+    {
+        if (pBlock[0] == 0)
+        {
+            return false;
+        }
+
+        // Mode is the number of zero bits before the first set one
+        switch (CountTrailingZeros(pBlock[0]))
+        {
+        case 0: ParseBC7Block<0>(pBlock, block); break;
+        case 1: ParseBC7Block<1>(pBlock, block); break;
+        case 2: ParseBC7Block<2>(pBlock, block); break;
+        case 3: ParseBC7Block<3>(pBlock, block); break;
+        case 4: ParseBC7Block<4>(pBlock, block); break;
+        case 5: ParseBC7Block<5>(pBlock, block); break;
+        case 6: ParseBC7Block<6>(pBlock, block); break;
+        default: ParseBC7Block<7>(pBlock, block); break;
+        }
+
+        return true;
+    }
+
+    inline UINT8 InterpolateBC7(UINT32 e0, UINT32 e1, UINT32 weight)
+    {
+        return (UINT8)(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+    }
+
+    void DecodeBC7Scalar(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        BC7Block block;
+        if (!ParseBC7Block(pBlock, block))
+        {
+            // Reserved mode decodes to transparent black
+            FillBlock(0, pDst, dstPitch);
+            return;
+        }
+
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            UINT32 subset = block.pSubsets[i];
+            UINT32 colorWeight = block.pColorWeights[block.colorIndices[i]];
+            UINT32 alphaWeight = block.pAlphaWeights[block.alphaIndices[i]];
+
+            UINT8 pixel[4];
+            for (UINT32 c = 0; c < 4; c++)
+            {
+                pixel[c] = InterpolateBC7(block.endpoints[0][c][subset], block.endpoints[1][c][subset],
+                    c < 3 ? colorWeight : alphaWeight);
+            }
+
+            if (block.rotation != 0)
+            {
+                std::swap(pixel[3], pixel[block.rotation - 1]);
+            }
+
+            memcpy(pDst + (i / 4) * dstPitch + (i % 4) * 4, pixel, 4);
+        }
+    }
+
+#ifdef BC_DECODER_SSE
+
+    /** Interpolates all 16 pixels of one channel at once in 16-bit lanes */
+    BC_SSE_TARGET inline __m128i InterpolateBC7ChannelSSE(const BC7Block& block, UINT32 channel,
+        __m128i subsets, __m128i weights)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rounding = _mm_set1_epi16(32);
+
+        __m128i e0 = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block.endpoints[0][channel])), subsets);
+        __m128i e1 = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block.endpoints[1][channel])), subsets);
+
+        // (64 - w) * e0 + w * e1 + 32 >> 6 is computed as e0 + (w * (e1 - e0) + 32 >> 6)
+        __m128i e0Low = _mm_unpacklo_epi8(e0, zero);
+        __m128i e0High = _mm_unpackhi_epi8(e0, zero);
+
+        __m128i deltaLow = _mm_sub_epi16(_mm_unpacklo_epi8(e1, zero), e0Low);
+        __m128i deltaHigh = _mm_sub_epi16(_mm_unpackhi_epi8(e1, zero), e0High);
+
+        __m128i low = _mm_add_epi16(e0Low, _mm_srai_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(deltaLow, _mm_unpacklo_epi8(weights, zero)), rounding), 6));
+        __m128i high = _mm_add_epi16(e0High, _mm_srai_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(deltaHigh, _mm_unpackhi_epi8(weights, zero)), rounding), 6));
+
+        return _mm_packus_epi16(low, high);
+    }
+
+    BC_SSE_TARGET void DecodeBC7SSE(const UINT8* pBlock, UINT8* pDst, size_t dstPitch)
+    {
+        BC7Block block;
+        if (!ParseBC7Block(pBlock, block))
+        {
+            FillBlock(0, pDst, dstPitch);
+            return;
+        }
+
+        __m128i subsets = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.pSubsets));
+
+        __m128i colorWeights = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block.pColorWeights)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(block.colorIndices)));
+        __m128i alphaWeights = _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i*>(block.pAlphaWeights)),
+            _mm_load_si128(reinterpret_cast<const __m128i*>(block.alphaIndices)));
+
+        __m128i channels[4] =
+        {
+            InterpolateBC7ChannelSSE(block, 0, subsets, colorWeights),
+            InterpolateBC7ChannelSSE(block, 1, subsets, colorWeights),
+            InterpolateBC7ChannelSSE(block, 2, subsets, colorWeights),
+            InterpolateBC7ChannelSSE(block, 3, subsets, alphaWeights)
+        };
+
+        if (block.rotation != 0)
+        {
+            std::swap(channels[3], channels[block.rotation - 1]);
+        }
+
+        // Planar channels are interleaved back into RGBA rows
+        __m128i rgLow = _mm_unpacklo_epi8(channels[0], channels[1]);
+        __m128i rgHigh = _mm_unpackhi_epi8(channels[0], channels[1]);
+        __m128i baLow = _mm_unpacklo_epi8(channels[2], channels[3]);
+        __m128i baHigh = _mm_unpackhi_epi8(channels[2], channels[3]);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst), _mm_unpacklo_epi16(rgLow, baLow));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + dstPitch), _mm_unpackhi_epi16(rgLow, baLow));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 2 * dstPitch), _mm_unpacklo_epi16(rgHigh, baHigh));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + 3 * dstPitch), _mm_unpackhi_epi16(rgHigh, baHigh));
+    }
+
+#endif
+
+    /** Picks the decoder of the format, SSE4.1 variants when the CPU has them */
+    BlockDecoder GetBlockDecoder(DXGI_FORMAT fmt)
+    {
+#ifdef BC_DECODER_SSE
+        const bool useSSE = GetCpuFeatures().sse41;
+#else
+        const bool useSSE = false;
+#endif
+
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC1SSE;
+#endif
+            return DecodeBC1Scalar;
+
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC2SSE;
+#endif
+            return DecodeBC2Scalar;
+
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC3SSE;
+#endif
+            return DecodeBC3Scalar;
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC4SSE<false>;
+#endif
+            return DecodeBC4Scalar<false>;
+
+        case DXGI_FORMAT_BC4_SNORM:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC4SSE<true>;
+#endif
+            return DecodeBC4Scalar<true>;
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC5SSE<false>;
+#endif
+            return DecodeBC5Scalar<false>;
+
+        case DXGI_FORMAT_BC5_SNORM:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC5SSE<true>;
+#endif
+            return DecodeBC5Scalar<true>;
+
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+#ifdef BC_DECODER_SSE
+            if (useSSE) return DecodeBC7SSE;
+#endif
+            return DecodeBC7Scalar;
+
+        default:
+            break;
+        }
+
+        (void)useSSE;
+        return nullptr;
+    }
+
+    void DecodeBlockRow(BlockDecoder decoder, UINT32 blockSize, const UINT8* pSrc, UINT32 width, UINT32 rows,
+        UINT8* pDst, UINT32 dstRowPitch)
+    {
+        UINT32 blocksWide = DivUp(width, 4u);
+        UINT32 fullBlocks = width / 4;
+
+        for (UINT32 bx = 0; bx < fullBlocks && rows == 4; bx++)
+        {
+            decoder(pSrc + bx * blockSize, pDst + bx * 16, dstRowPitch);
+        }
+
+        // Blocks hanging over the right or bottom edge go through a scratch block
+        for (UINT32 bx = rows == 4 ? fullBlocks : 0; bx < blocksWide; bx++)
+        {
+            UINT8 scratch[64];
+            decoder(pSrc + bx * blockSize, scratch, 16);
+
+            UINT32 columns = std::min(4u, width - bx * 4);
+            for (UINT32 y = 0; y < rows; y++)
+            {
+                memcpy(pDst + y * dstRowPitch + bx * 16, scratch + y * 16, columns * 4);
+            }
+        }
+    }
+
+}
+
+bool IsBCDecodeSupported(DXGI_FORMAT fmt)
+{
+    return GetBlockDecoder(fmt) != nullptr;
+}
+
+bool DecodeBC(DXGI_FORMAT fmt, const void* pBlocks, UINT32 rowPitch, UINT32 width, UINT32 height,
+    UINT8* pRGBA, UINT32 dstRowPitch, ThreadPool* pPool)
+{
+    BlockDecoder decoder = GetBlockDecoder(fmt);
+    if (decoder == nullptr || pBlocks == nullptr || pRGBA == nullptr || dstRowPitch < width * 4)
+    {
+        return false;
+    }
+
+    const UINT32 blockSize = GetBytesPerBlock(fmt);
+    const UINT32 blocksHigh = DivUp(height, 4u);
+    const UINT8* pSrc = reinterpret_cast<const UINT8*>(pBlocks);
+
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    pPool->ParallelFor(blocksHigh, [&](uint32_t by)
+    {
+        DecodeBlockRow(decoder, blockSize, pSrc + (size_t)by * rowPitch, width, std::min(4u, height - by * 4),
+            pRGBA + (size_t)by * 4 * dstRowPitch, dstRowPitch);
+    });
+
+    return true;
+}
+
+bool DecodeSubresource(const TextureDesc& desc, UINT32 index, std::vector<UINT8>& rgba, ThreadPool* pPool)
+{
+    const bool isRGBA = desc.fmt == DXGI_FORMAT_R8G8B8A8_UNORM || desc.fmt == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+    const bool isBGRA = desc.fmt == DXGI_FORMAT_B8G8R8A8_UNORM || desc.fmt == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+    const bool isBGRX = desc.fmt == DXGI_FORMAT_B8G8R8X8_UNORM || desc.fmt == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+
+    if (index >= desc.subresources.size() || !(isRGBA || isBGRA || isBGRX || IsBCDecodeSupported(desc.fmt)))
+    {
+        return false;
+    }
+
+    const SubresourceLayout& layout = desc.subresources[index];
+    const UINT8* pSrc = reinterpret_cast<const UINT8*>(desc.GetSubresourceData(index));
+
+    const size_t sliceSize = (size_t)layout.width * layout.height * 4;
+    rgba.resize(sliceSize * layout.depth);
+
+    if (!IsBlockCompressed(desc.fmt))
+    {
+        for (UINT32 row = 0; row < layout.height * layout.depth; row++)
+        {
+            const UINT8* pSrcRow = pSrc + (size_t)(row / layout.height) * layout.slicePitch
+                + (size_t)(row % layout.height) * layout.rowPitch;
+            UINT8* pDstRow = rgba.data() + (size_t)row * layout.width * 4;
+
+            memcpy(pDstRow, pSrcRow, (size_t)layout.width * 4);
+            if (isBGRA || isBGRX)
+            {
+                for (UINT32 x = 0; x < layout.width; x++)
+                {
+                    std::swap(pDstRow[x * 4], pDstRow[x * 4 + 2]);
+                    pDstRow[x * 4 + 3] = isBGRX ? 255 : pDstRow[x * 4 + 3];
+                }
+            }
+        }
+        return true;
+    }
+
+    for (UINT32 z = 0; z < layout.depth; z++)
+    {
+        if (!DecodeBC(desc.fmt, pSrc + (size_t)z * layout.slicePitch, layout.rowPitch, layout.width, layout.height,
+            rgba.data() + z * sliceSize, layout.width * 4, pPool))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
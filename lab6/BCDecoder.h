@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+
+#include "DDS.h"
+
+class ThreadPool;
+
+/** True for BC1-BC5 and BC7 formats the CPU decoder can expand */
+bool IsBCDecodeSupported(DXGI_FORMAT fmt);
+
+/**
+ * Expands a block compressed image to RGBA8. Rows of blocks are decoded in parallel
+ * on the thread pool (the default one if pPool is nullptr). Single channel formats
+ * are written as (R, 0, 0, 255) and two channel ones as (R, G, 0, 255), the way the
+ * GPU samples them, SNORM values are remapped to [0, 255]. sRGB formats are not
+ * converted to linear.
+ */
+bool DecodeBC(DXGI_FORMAT fmt, const void* pBlocks, UINT32 rowPitch, UINT32 width, UINT32 height,
+    UINT8* pRGBA, UINT32 dstRowPitch, ThreadPool* pPool = nullptr);
+
+/**
+ * Decodes one loaded subresource of the texture to tightly packed RGBA8. Uncompressed
+ * RGBA8 and BGRA8 subresources are copied in RGBA order.
+ */
+bool DecodeSubresource(const TextureDesc& desc, UINT32 index, std::vector<UINT8>& rgba,
+    ThreadPool* pPool = nullptr);
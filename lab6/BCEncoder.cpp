@@ -0,0 +1,905 @@
+#include "framework.h"
+
+#include "BCEncoder.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+// BC_NO_SIMD leaves out the SSE4.1 encoders, as it does the decoders
+#if !defined(BC_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define BC_ENCODER_SSE 1
+#include <smmintrin.h>
+#endif
+
+#if defined(BC_ENCODER_SSE) && !defined(_MSC_VER)
+#define BC_SSE_TARGET __attribute__((target("sse4.1")))
+#else
+#define BC_SSE_TARGET
+#endif
+
+namespace
+{
+
+    /** Encodes 4x4 RGBA8 pixels (64 bytes, row by row) into one block */
+    typedef void (*BlockEncoder)(const UINT8* pPixels, BCQuality quality, UINT8* pBlock);
+
+    inline void WriteUInt16(UINT8* pData, UINT32 value)
+    {
+        pData[0] = (UINT8)value;
+        pData[1] = (UINT8)(value >> 8);
+    }
+
+    inline void WriteUInt32(UINT8* pData, UINT32 value)
+    {
+        WriteUInt16(pData, value);
+        WriteUInt16(pData + 2, value >> 16);
+    }
+
+    inline int Clamp(int value, int low, int high)
+    {
+        return std::min(std::max(value, low), high);
+    }
+
+    //
+    // Color blocks (BC1, color part of BC3)
+    //
+
+    struct Color565
+    {
+        int r;
+        int g;
+        int b;
+
+        UINT32 Pack() const
+        {
+            return (UINT32)((r << 11) | (g << 5) | b);
+        }
+
+        /** Rounds an 8-bit color to the nearest representable one */
+        static Color565 FromRGB(float r, float g, float b)
+        {
+            Color565 color;
+            color.r = Clamp((int)(r * 31.0f / 255.0f + 0.5f), 0, 31);
+            color.g = Clamp((int)(g * 63.0f / 255.0f + 0.5f), 0, 63);
+            color.b = Clamp((int)(b * 31.0f / 255.0f + 0.5f), 0, 31);
+            return color;
+        }
+    };
+
+    inline bool operator==(const Color565& a, const Color565& b)
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b;
+    }
+
+    /** Palette exactly as BCDecoder and the GPU reconstruct it */
+    void BuildColorPalette(const Color565& c0, const Color565& c1, bool isThreeColor, UINT32 palette[4])
+    {
+        int r0 = (c0.r << 3) | (c0.r >> 2), g0 = (c0.g << 2) | (c0.g >> 4), b0 = (c0.b << 3) | (c0.b >> 2);
+        int r1 = (c1.r << 3) | (c1.r >> 2), g1 = (c1.g << 2) | (c1.g >> 4), b1 = (c1.b << 3) | (c1.b >> 2);
+
+        palette[0] = (UINT32)(r0 | (g0 << 8) | (b0 << 16));
+        palette[1] = (UINT32)(r1 | (g1 << 8) | (b1 << 16));
+
+        if (isThreeColor)
+        {
+            palette[2] = (UINT32)(((r0 + r1) / 2) | (((g0 + g1) / 2) << 8) | (((b0 + b1) / 2) << 16));
+            palette[3] = 0;
+        }
+        else
+        {
+            palette[2] = (UINT32)(((2 * r0 + r1) / 3) | (((2 * g0 + g1) / 3) << 8) | (((2 * b0 + b1) / 3) << 16));
+            palette[3] = (UINT32)(((r0 + 2 * r1) / 3) | (((g0 + 2 * g1) / 3) << 8) | (((b0 + 2 * b1) / 3) << 16));
+        }
+    }
+
+    inline int ColorDistance(const UINT8* pPixel, UINT32 color)
+    {
+        int dr = pPixel[0] - (int)(color & 0xFF);
+        int dg = pPixel[1] - (int)((color >> 8) & 0xFF);
+        int db = pPixel[2] - (int)((color >> 16) & 0xFF);
+        return dr * dr + dg * dg + db * db;
+    }
+
+    /**
+     * Picks the closest of the first paletteSize colors for every pixel flagged in
+     * pixelMask, returns the summed squared error. Alpha is ignored.
+     */
+    UINT32 SelectColorIndicesScalar(const UINT8* pPixels, const UINT32 palette[4], UINT32 paletteSize,
+        UINT32 pixelMask, UINT8 indices[16])
+    {
+        UINT32 error = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            if ((pixelMask & (1u << i)) == 0)
+            {
+                continue;
+            }
+
+            int bestDistance = ColorDistance(pPixels + i * 4, palette[0]);
+            UINT8 bestIndex = 0;
+            for (UINT32 k = 1; k < paletteSize; k++)
+            {
+                int distance = ColorDistance(pPixels + i * 4, palette[k]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = (UINT8)k;
+                }
+            }
+
+            indices[i] = bestIndex;
+            error += (UINT32)bestDistance;
+        }
+        return error;
+    }
+
+#ifdef BC_ENCODER_SSE
+
+    /** Same as the scalar version, four pixels are matched against a palette entry at once */
+    BC_SSE_TARGET UINT32 SelectColorIndicesSSE(const UINT8* pPixels, const UINT32 palette[4], UINT32 paletteSize,
+        UINT32 pixelMask, UINT8 indices[16])
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+
+        UINT32 error = 0;
+
+        for (UINT32 group = 0; group < 4; group++)
+        {
+            __m128i pixels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pPixels + group * 16)), rgbMask);
+            __m128i pixelsLow = _mm_unpacklo_epi8(pixels, zero);
+            __m128i pixelsHigh = _mm_unpackhi_epi8(pixels, zero);
+
+            __m128i bestDistance = _mm_set1_epi32(0x7FFFFFFF);
+            __m128i bestIndex = zero;
+
+            for (UINT32 k = 0; k < paletteSize; k++)
+            {
+                __m128i color = _mm_unpacklo_epi8(_mm_set1_epi32((int)palette[k]), zero);
+
+                // madd sums r*r + g*g and b*b + 0 per pixel, hadd finishes the sum
+                __m128i diffLow = _mm_sub_epi16(pixelsLow, color);
+                __m128i diffHigh = _mm_sub_epi16(pixelsHigh, color);
+                __m128i distance = _mm_hadd_epi32(_mm_madd_epi16(diffLow, diffLow), _mm_madd_epi16(diffHigh, diffHigh));
+
+                __m128i isCloser = _mm_cmplt_epi32(distance, bestDistance);
+                bestDistance = _mm_min_epi32(bestDistance, distance);
+                bestIndex = _mm_blendv_epi8(bestIndex, _mm_set1_epi32((int)k), isCloser);
+            }
+
+            alignas(16) UINT32 distances[4];
+            alignas(16) UINT32 groupIndices[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(distances), bestDistance);
+            _mm_store_si128(reinterpret_cast<__m128i*>(groupIndices), bestIndex);
+
+            for (UINT32 j = 0; j < 4; j++)
+            {
+                UINT32 i = group * 4 + j;
+                if (pixelMask & (1u << i))
+                {
+                    indices[i] = (UINT8)groupIndices[j];
+                    error += distances[j];
+                }
+            }
+        }
+
+        return error;
+    }
+
+    /** Component-wise bounds of the 16 pixels */
+    BC_SSE_TARGET void ComputeBoundsSSE(const UINT8* pPixels, UINT8 minColor[4], UINT8 maxColor[4])
+    {
+        const __m128i* pRows = reinterpret_cast<const __m128i*>(pPixels);
+
+        __m128i low = _mm_min_epu8(_mm_min_epu8(_mm_loadu_si128(pRows), _mm_loadu_si128(pRows + 1)),
+            _mm_min_epu8(_mm_loadu_si128(pRows + 2), _mm_loadu_si128(pRows + 3)));
+        __m128i high = _mm_max_epu8(_mm_max_epu8(_mm_loadu_si128(pRows), _mm_loadu_si128(pRows + 1)),
+            _mm_max_epu8(_mm_loadu_si128(pRows + 2), _mm_loadu_si128(pRows + 3)));
+
+        // Fold the four pixels of a row down to one
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+        low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+        high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+
+        UINT32 lowBits = (UINT32)_mm_cvtsi128_si32(low);
+        UINT32 highBits = (UINT32)_mm_cvtsi128_si32(high);
+        memcpy(minColor, &lowBits, 4);
+        memcpy(maxColor, &highBits, 4);
+    }
+
+#endif
+
+    void ComputeBoundsScalar(const UINT8* pPixels, UINT8 minColor[4], UINT8 maxColor[4])
+    {
+        memcpy(minColor, pPixels, 4);
+        memcpy(maxColor, pPixels, 4);
+
+        for (UINT32 i = 1; i < 16; i++)
+        {
+            for (UINT32 c = 0; c < 4; c++)
+            {
+                minColor[c] = std::min(minColor[c], pPixels[i * 4 + c]);
+                maxColor[c] = std::max(maxColor[c], pPixels[i * 4 + c]);
+            }
+        }
+    }
+
+    UINT32 SelectColorIndices(const UINT8* pPixels, const UINT32 palette[4], UINT32 paletteSize,
+        UINT32 pixelMask, UINT8 indices[16])
+    {
+#ifdef BC_ENCODER_SSE
+        if (GetCpuFeatures().sse41)
+        {
+            return SelectColorIndicesSSE(pPixels, palette, paletteSize, pixelMask, indices);
+        }
+#endif
+        return SelectColorIndicesScalar(pPixels, palette, paletteSize, pixelMask, indices);
+    }
+
+    void ComputeBounds(const UINT8* pPixels, UINT8 minColor[4], UINT8 maxColor[4])
+    {
+#ifdef BC_ENCODER_SSE
+        if (GetCpuFeatures().sse41)
+        {
+            ComputeBoundsSSE(pPixels, minColor, maxColor);
+            return;
+        }
+#endif
+        ComputeBoundsScalar(pPixels, minColor, maxColor);
+    }
+
+    /** Endpoints with the indices and error they produce */
+    struct ColorCandidate
+    {
+        Color565 c0;
+        Color565 c1;
+        UINT8 indices[16];
+        UINT32 error;
+    };
+
+    void EvaluateCandidate(const UINT8* pPixels, UINT32 opaqueMask, bool isThreeColor, ColorCandidate& candidate)
+    {
+        UINT32 palette[4];
+        BuildColorPalette(candidate.c0, candidate.c1, isThreeColor, palette);
+        candidate.error = SelectColorIndices(pPixels, palette, isThreeColor ? 3 : 4, opaqueMask, candidate.indices);
+    }
+
+    /** Endpoints along the principal axis of the opaque pixels */
+    void ComputePrincipalEndpoints(const UINT8* pPixels, UINT32 opaqueMask, float e0[3], float e1[3])
+    {
+        float mean[3] = {};
+        UINT32 count = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            if (opaqueMask & (1u << i))
+            {
+                for (UINT32 c = 0; c < 3; c++)
+                {
+                    mean[c] += pPixels[i * 4 + c];
+                }
+                count++;
+            }
+        }
+        for (UINT32 c = 0; c < 3; c++)
+        {
+            mean[c] /= (float)count;
+        }
+
+        float cov[6] = {};  // rr rg rb gg gb bb
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            if (opaqueMask & (1u << i))
+            {
+                float r = pPixels[i * 4 + 0] - mean[0];
+                float g = pPixels[i * 4 + 1] - mean[1];
+                float b = pPixels[i * 4 + 2] - mean[2];
+                cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+                cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+            }
+        }
+
+        // Power iteration converges to the dominant eigenvector in a few steps
+        float axis[3] = { 1.0f, 1.0f, 1.0f };
+        for (UINT32 iteration = 0; iteration < 4; iteration++)
+        {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+            float length = std::max(std::max(fabsf(x), fabsf(y)), fabsf(z));
+            if (length < 1e-6f)
+            {
+                break;
+            }
+
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+
+        float minProjection = 1e30f;
+        float maxProjection = -1e30f;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            if (opaqueMask & (1u << i))
+            {
+                float projection = (pPixels[i * 4 + 0] - mean[0]) * axis[0]
+                    + (pPixels[i * 4 + 1] - mean[1]) * axis[1]
+                    + (pPixels[i * 4 + 2] - mean[2]) * axis[2];
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+        }
+
+        float axisLengthSq = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axisLengthSq < 1e-6f)
+        {
+            axisLengthSq = 1.0f;
+        }
+
+        for (UINT32 c = 0; c < 3; c++)
+        {
+            e0[c] = mean[c] + axis[c] * maxProjection / axisLengthSq;
+            e1[c] = mean[c] + axis[c] * minProjection / axisLengthSq;
+        }
+    }
+
+    /**
+     * Solves for the endpoints minimizing the squared error of the current indices.
+     * Returns false when all pixels map to one point of the line.
+     */
+    bool RefineEndpoints(const UINT8* pPixels, UINT32 opaqueMask, bool isThreeColor, ColorCandidate& candidate)
+    {
+        static const float Weights4[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        static const float Weights3[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+        const float* pWeights = isThreeColor ? Weights3 : Weights4;
+
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[3] = {}, bx[3] = {};
+
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            if ((opaqueMask & (1u << i)) == 0)
+            {
+                continue;
+            }
+
+            float t = pWeights[candidate.indices[i]];
+            float a = 1.0f - t;
+            float b = t;
+
+            aa += a * a; ab += a * b; bb += b * b;
+            for (UINT32 c = 0; c < 3; c++)
+            {
+                ax[c] += a * pPixels[i * 4 + c];
+                bx[c] += b * pPixels[i * 4 + c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (fabsf(determinant) < 1e-6f)
+        {
+            return false;
+        }
+
+        float e0[3], e1[3];
+        for (UINT32 c = 0; c < 3; c++)
+        {
+            e0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+            e1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+        }
+
+        candidate.c0 = Color565::FromRGB(e0[0], e0[1], e0[2]);
+        candidate.c1 = Color565::FromRGB(e1[0], e1[1], e1[2]);
+        return true;
+    }
+
+    /** Tries moving every endpoint component by one step and keeps improvements */
+    void SearchEndpoints(const UINT8* pPixels, UINT32 opaqueMask, bool isThreeColor, ColorCandidate& best)
+    {
+        static const int Limits[3] = { 31, 63, 31 };
+
+        for (bool isImproved = true; isImproved;)
+        {
+            isImproved = false;
+
+            for (UINT32 component = 0; component < 6; component++)
+            {
+                for (int delta = -1; delta <= 1; delta += 2)
+                {
+                    ColorCandidate candidate = best;
+                    Color565& endpoint = component < 3 ? candidate.c0 : candidate.c1;
+                    int* pValue = component % 3 == 0 ? &endpoint.r : component % 3 == 1 ? &endpoint.g : &endpoint.b;
+
+                    int value = *pValue + delta;
+                    if (value < 0 || value > Limits[component % 3])
+                    {
+                        continue;
+                    }
+                    *pValue = value;
+
+                    EvaluateCandidate(pPixels, opaqueMask, isThreeColor, candidate);
+                    if (candidate.error < best.error)
+                    {
+                        best = candidate;
+                        isImproved = true;
+                    }
+                }
+            }
+        }
+    }
+
+    /** Writes c0, c1 and indices, ordering the endpoints for the requested mode */
+    void EmitColorBlock(const ColorCandidate& candidate, bool isThreeColor, UINT32 transparentMask, UINT8* pBlock)
+    {
+        UINT32 c0 = candidate.c0.Pack();
+        UINT32 c1 = candidate.c1.Pack();
+
+        UINT8 indices[16];
+        memcpy(indices, candidate.indices, 16);
+
+        // Four color mode needs c0 > c1, three color mode c0 <= c1, swapping endpoints swaps index pairs
+        bool needsSwap = isThreeColor ? c0 > c1 : c0 < c1;
+        if (needsSwap)
+        {
+            std::swap(c0, c1);
+            for (UINT32 i = 0; i < 16; i++)
+            {
+                static const UINT8 Swapped4[4] = { 1, 0, 3, 2 };
+                static const UINT8 Swapped3[4] = { 1, 0, 2, 3 };
+                indices[i] = isThreeColor ? Swapped3[indices[i]] : Swapped4[indices[i]];
+            }
+        }
+        else if (!isThreeColor && c0 == c1)
+        {
+            // Equal endpoints decode as three color mode, index 0 is the only safe choice
+            memset(indices, 0, sizeof(indices));
+        }
+
+        UINT32 bits = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            UINT32 index = (transparentMask & (1u << i)) ? 3 : indices[i];
+            bits |= index << (2 * i);
+        }
+
+        WriteUInt16(pBlock, c0);
+        WriteUInt16(pBlock + 2, c1);
+        WriteUInt32(pBlock + 4, bits);
+    }
+
+    void EncodeColorBlock(const UINT8* pPixels, bool allowPunchThrough, BCQuality quality, UINT8* pBlock)
+    {
+        UINT32 transparentMask = 0;
+        if (allowPunchThrough)
+        {
+            for (UINT32 i = 0; i < 16; i++)
+            {
+                if (pPixels[i * 4 + 3] < 128)
+                {
+                    transparentMask |= 1u << i;
+                }
+            }
+        }
+
+        const UINT32 opaqueMask = ~transparentMask & 0xFFFF;
+        const bool isThreeColor = transparentMask != 0;
+
+        ColorCandidate best = {};
+
+        if (opaqueMask == 0)
+        {
+            EmitColorBlock(best, true, transparentMask, pBlock);
+            return;
+        }
+
+        UINT8 minColor[4], maxColor[4];
+        ComputeBounds(pPixels, minColor, maxColor);
+
+        if (quality == BCQuality::Fast || isThreeColor)
+        {
+            // Insetting the box by 1/16 of its size moves endpoints toward the bulk of pixels
+            float e0[3], e1[3];
+            for (UINT32 c = 0; c < 3; c++)
+            {
+                float inset = (maxColor[c] - minColor[c]) / 16.0f;
+                e0[c] = maxColor[c] - inset;
+                e1[c] = minColor[c] + inset;
+            }
+
+            // Bounds span all pixels, transparent ones included, so refine from the opaque ones
+            if (isThreeColor)
+            {
+                ComputePrincipalEndpoints(pPixels, opaqueMask, e0, e1);
+            }
+
+            best.c0 = Color565::FromRGB(e0[0], e0[1], e0[2]);
+            best.c1 = Color565::FromRGB(e1[0], e1[1], e1[2]);
+            EvaluateCandidate(pPixels, opaqueMask, isThreeColor, best);
+
+            if (quality == BCQuality::Fast)
+            {
+                EmitColorBlock(best, isThreeColor, transparentMask, pBlock);
+                return;
+            }
+        }
+        else
+        {
+            float e0[3], e1[3];
+            ComputePrincipalEndpoints(pPixels, opaqueMask, e0, e1);
+
+            best.c0 = Color565::FromRGB(e0[0], e0[1], e0[2]);
+            best.c1 = Color565::FromRGB(e1[0], e1[1], e1[2]);
+            EvaluateCandidate(pPixels, opaqueMask, isThreeColor, best);
+        }
+
+        const UINT32 refineIterations = quality == BCQuality::High ? 4 : 1;
+        for (UINT32 iteration = 0; iteration < refineIterations && best.error != 0; iteration++)
+        {
+            ColorCandidate candidate = best;
+            if (!RefineEndpoints(pPixels, opaqueMask, isThreeColor, candidate))
+            {
+                break;
+            }
+
+            EvaluateCandidate(pPixels, opaqueMask, isThreeColor, candidate);
+            if (candidate.error >= best.error)
+            {
+                break;
+            }
+            best = candidate;
+        }
+
+        if (quality == BCQuality::High && best.error != 0)
+        {
+            SearchEndpoints(pPixels, opaqueMask, isThreeColor, best);
+        }
+
+        EmitColorBlock(best, isThreeColor, transparentMask, pBlock);
+    }
+
+    //
+    // Single channel blocks (BC3 alpha, BC4, BC5)
+    //
+
+    void BuildChannelPalette(UINT32 a0, UINT32 a1, UINT8 palette[8])
+    {
+        palette[0] = (UINT8)a0;
+        palette[1] = (UINT8)a1;
+
+        if (a0 > a1)
+        {
+            for (UINT32 i = 1; i < 7; i++)
+            {
+                palette[i + 1] = (UINT8)(((7 - i) * a0 + i * a1) / 7);
+            }
+        }
+        else
+        {
+            for (UINT32 i = 1; i < 5; i++)
+            {
+                palette[i + 1] = (UINT8)(((5 - i) * a0 + i * a1) / 5);
+            }
+            palette[6] = 0;
+            palette[7] = 255;
+        }
+    }
+
+    UINT32 SelectChannelIndicesScalar(const UINT8 values[16], const UINT8 palette[8], UINT8 indices[16])
+    {
+        UINT32 error = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            int bestDistance = abs(values[i] - palette[0]);
+            UINT8 bestIndex = 0;
+            for (UINT32 k = 1; k < 8; k++)
+            {
+                int distance = abs(values[i] - palette[k]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestIndex = (UINT8)k;
+                }
+            }
+
+            indices[i] = bestIndex;
+            error += (UINT32)(bestDistance * bestDistance);
+        }
+        return error;
+    }
+
+#ifdef BC_ENCODER_SSE
+
+    /** All 16 values are matched against a palette entry at once in 16-bit lanes */
+    BC_SSE_TARGET UINT32 SelectChannelIndicesSSE(const UINT8 values[16], const UINT8 palette[8], UINT8 indices[16])
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i low = _mm_unpacklo_epi8(packed, zero);
+        __m128i high = _mm_unpackhi_epi8(packed, zero);
+
+        __m128i bestLow = _mm_set1_epi16(0x7FFF);
+        __m128i bestHigh = bestLow;
+        __m128i indexLow = zero;
+        __m128i indexHigh = zero;
+
+        for (UINT32 k = 0; k < 8; k++)
+        {
+            __m128i entry = _mm_set1_epi16(palette[k]);
+            __m128i index = _mm_set1_epi16((short)k);
+
+            __m128i distanceLow = _mm_abs_epi16(_mm_sub_epi16(low, entry));
+            __m128i distanceHigh = _mm_abs_epi16(_mm_sub_epi16(high, entry));
+
+            indexLow = _mm_blendv_epi8(indexLow, index, _mm_cmplt_epi16(distanceLow, bestLow));
+            indexHigh = _mm_blendv_epi8(indexHigh, index, _mm_cmplt_epi16(distanceHigh, bestHigh));
+
+            bestLow = _mm_min_epi16(bestLow, distanceLow);
+            bestHigh = _mm_min_epi16(bestHigh, distanceHigh);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(indices), _mm_packus_epi16(indexLow, indexHigh));
+
+        __m128i errors = _mm_add_epi32(_mm_madd_epi16(bestLow, bestLow), _mm_madd_epi16(bestHigh, bestHigh));
+        errors = _mm_add_epi32(errors, _mm_srli_si128(errors, 8));
+        errors = _mm_add_epi32(errors, _mm_srli_si128(errors, 4));
+        return (UINT32)_mm_cvtsi128_si32(errors);
+    }
+
+#endif
+
+    UINT32 SelectChannelIndices(const UINT8 values[16], const UINT8 palette[8], UINT8 indices[16])
+    {
+#ifdef BC_ENCODER_SSE
+        if (GetCpuFeatures().sse41)
+        {
+            return SelectChannelIndicesSSE(values, palette, indices);
+        }
+#endif
+        return SelectChannelIndicesScalar(values, palette, indices);
+    }
+
+    struct ChannelCandidate
+    {
+        UINT32 a0;
+        UINT32 a1;
+        UINT8 indices[16];
+        UINT32 error;
+    };
+
+    void EvaluateChannelCandidate(const UINT8 values[16], ChannelCandidate& candidate)
+    {
+        UINT8 palette[8];
+        BuildChannelPalette(candidate.a0, candidate.a1, palette);
+        candidate.error = SelectChannelIndices(values, palette, candidate.indices);
+    }
+
+    void EncodeChannelBlock(const UINT8 values[16], BCQuality quality, UINT8* pBlock)
+    {
+        UINT32 minValue = 255, maxValue = 0;
+        UINT32 minInner = 255, maxInner = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            minValue = std::min<UINT32>(minValue, values[i]);
+            maxValue = std::max<UINT32>(maxValue, values[i]);
+
+            if (values[i] != 0 && values[i] != 255)
+            {
+                minInner = std::min<UINT32>(minInner, values[i]);
+                maxInner = std::max<UINT32>(maxInner, values[i]);
+            }
+        }
+
+        // Eight value mode spanning the whole range
+        ChannelCandidate best = {};
+        best.a0 = maxValue;
+        best.a1 = minValue;
+        EvaluateChannelCandidate(values, best);
+
+        if (quality != BCQuality::Fast && best.error != 0)
+        {
+            // Six value mode leaves 0 and 255 to the explicit entries
+            if (minInner <= maxInner && (minValue == 0 || maxValue == 255))
+            {
+                ChannelCandidate candidate = {};
+                candidate.a0 = minInner;
+                candidate.a1 = maxInner;
+                EvaluateChannelCandidate(values, candidate);
+
+                if (candidate.error < best.error)
+                {
+                    best = candidate;
+                }
+            }
+
+            // Pulling the endpoints inward trades extremes for finer steps in the middle
+            const int searchRadius = quality == BCQuality::High ? 2 : 1;
+            const ChannelCandidate start = best;
+            for (int d0 = -searchRadius; d0 <= searchRadius; d0++)
+            {
+                for (int d1 = -searchRadius; d1 <= searchRadius; d1++)
+                {
+                    ChannelCandidate candidate = {};
+                    candidate.a0 = (UINT32)Clamp((int)start.a0 + d0, 0, 255);
+                    candidate.a1 = (UINT32)Clamp((int)start.a1 + d1, 0, 255);
+
+                    // Keep the mode of the starting point
+                    if ((candidate.a0 > candidate.a1) != (start.a0 > start.a1))
+                    {
+                        continue;
+                    }
+
+                    EvaluateChannelCandidate(values, candidate);
+                    if (candidate.error < best.error)
+                    {
+                        best = candidate;
+                    }
+                }
+            }
+        }
+
+        pBlock[0] = (UINT8)best.a0;
+        pBlock[1] = (UINT8)best.a1;
+
+        UINT64 bits = 0;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            bits |= (UINT64)best.indices[i] << (3 * i);
+        }
+
+        for (UINT32 i = 0; i < 6; i++)
+        {
+            pBlock[2 + i] = (UINT8)(bits >> (8 * i));
+        }
+    }
+
+    void GatherChannel(const UINT8* pPixels, UINT32 channel, UINT8 values[16])
+    {
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            values[i] = pPixels[i * 4 + channel];
+        }
+    }
+
+    //
+    // Formats
+    //
+
+    void EncodeBC1Block(const UINT8* pPixels, BCQuality quality, UINT8* pBlock)
+    {
+        EncodeColorBlock(pPixels, true, quality, pBlock);
+    }
+
+    void EncodeBC2Block(const UINT8* pPixels, BCQuality quality, UINT8* pBlock)
+    {
+        // Explicit 4-bit alpha, the decoder expands it as value * 17
+        for (UINT32 i = 0; i < 16; i += 2)
+        {
+            UINT32 a0 = (pPixels[i * 4 + 3] + 8) / 17;
+            UINT32 a1 = (pPixels[i * 4 + 7] + 8) / 17;
+            pBlock[i / 2] = (UINT8)(a0 | (a1 << 4));
+        }
+
+        EncodeColorBlock(pPixels, false, quality, pBlock + 8);
+    }
+
+    void EncodeBC3Block(const UINT8* pPixels, BCQuality quality, UINT8* pBlock)
+    {
+        UINT8 alpha[16];
+        GatherChannel(pPixels, 3, alpha);
+
+        EncodeChannelBlock(alpha, quality, pBlock);
+        EncodeColorBlock(pPixels, false, quality, pBlock + 8);
+    }
+
+    void EncodeBC4Block(const UINT8* pPixels, BCQuality quality, UINT8* pBlock)
+    {
+        UINT8 red[16];
+        GatherChannel(pPixels, 0, red);
+
+        EncodeChannelBlock(red, quality, pBlock);
+    }
+
+    void EncodeBC5Block(const UINT8* pPixels, BCQuality quality, UINT8* pBlock)
+    {
+        UINT8 red[16], green[16];
+        GatherChannel(pPixels, 0, red);
+        GatherChannel(pPixels, 1, green);
+
+        EncodeChannelBlock(red, quality, pBlock);
+        EncodeChannelBlock(green, quality, pBlock + 8);
+    }
+
+    BlockEncoder GetBlockEncoder(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            return EncodeBC1Block;
+
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            return EncodeBC2Block;
+
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return EncodeBC3Block;
+
+        case DXGI_FORMAT_BC4_UNORM:
+            return EncodeBC4Block;
+
+        case DXGI_FORMAT_BC5_UNORM:
+            return EncodeBC5Block;
+
+        default:
+            break;
+        }
+
+        return nullptr;
+    }
+
+    /** Copies a 4x4 tile, coordinates past the edges are clamped */
+    void LoadBlock(const UINT8* pRGBA, UINT32 srcRowPitch, UINT32 width, UINT32 height,
+        UINT32 x0, UINT32 y0, UINT8 pixels[64])
+    {
+        for (UINT32 y = 0; y < 4; y++)
+        {
+            const UINT8* pRow = pRGBA + (size_t)std::min(y0 + y, height - 1) * srcRowPitch;
+
+            if (x0 + 4 <= width)
+            {
+                memcpy(pixels + y * 16, pRow + x0 * 4, 16);
+                continue;
+            }
+
+            for (UINT32 x = 0; x < 4; x++)
+            {
+                memcpy(pixels + y * 16 + x * 4, pRow + std::min(x0 + x, width - 1) * 4, 4);
+            }
+        }
+    }
+
+}
+
+bool IsBCEncodeSupported(DXGI_FORMAT fmt)
+{
+    return GetBlockEncoder(fmt) != nullptr;
+}
+
+bool EncodeBC(DXGI_FORMAT fmt, const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 srcRowPitch,
+    UINT8* pBlocks, UINT32 dstRowPitch, BCQuality quality, ThreadPool* pPool)
+{
+    BlockEncoder encoder = GetBlockEncoder(fmt);
+    if (encoder == nullptr || pRGBA == nullptr || pBlocks == nullptr || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    const UINT32 blockSize = GetBytesPerBlock(fmt);
+    const UINT32 blocksWide = DivUp(width, 4u);
+    const UINT32 blocksHigh = DivUp(height, 4u);
+
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    pPool->ParallelFor(blocksHigh, [&](uint32_t by)
+    {
+        UINT8* pRow = pBlocks + (size_t)by * dstRowPitch;
+
+        alignas(16) UINT8 pixels[64];
+        for (UINT32 bx = 0; bx < blocksWide; bx++)
+        {
+            LoadBlock(pRGBA, srcRowPitch, width, height, bx * 4, by * 4, pixels);
+            encoder(pixels, quality, pRow + bx * blockSize);
+        }
+    });
+
+    return true;
+}
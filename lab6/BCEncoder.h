@@ -0,0 +1,26 @@
+#pragma once
+
+#include "DDS.h"
+
+class ThreadPool;
+
+/** Trade-off between encoding speed and endpoint search effort */
+enum class BCQuality
+{
+    Fast,       ///< Inset bounding box endpoints, single pass
+    Normal,     ///< Principal axis endpoints refined once by least squares
+    High        ///< Iterated least squares followed by a greedy endpoint search
+};
+
+/** True for the BC1-BC5 UNORM formats the encoder can produce */
+bool IsBCEncodeSupported(DXGI_FORMAT fmt);
+
+/**
+ * Compresses an RGBA8 image. Rows of blocks are encoded in parallel on the thread
+ * pool (the default one if pPool is nullptr). Partial blocks at the right and bottom
+ * edges replicate the last column and row. BC1 switches a block to 1-bit alpha when
+ * one of its pixels has alpha below 128, BC4 takes the red channel and BC5 the red
+ * and green ones.
+ */
+bool EncodeBC(DXGI_FORMAT fmt, const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 srcRowPitch,
+    UINT8* pBlocks, UINT32 dstRowPitch, BCQuality quality = BCQuality::Normal, ThreadPool* pPool = nullptr);
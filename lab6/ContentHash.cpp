@@ -0,0 +1,112 @@
+#include "ContentHash.h"
+
+#include <string.h>
+
+namespace
+{
+
+    const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+    const uint64_t Prime3 = 0x165667B19E3779F9ull;
+    const uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+    const uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+    inline uint64_t RotateLeft(uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    inline uint64_t Read64(const uint8_t* pData)
+    {
+        uint64_t value;
+        memcpy(&value, pData, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t Read32(const uint8_t* pData)
+    {
+        uint32_t value;
+        memcpy(&value, pData, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t Round(uint64_t accumulator, uint64_t input)
+    {
+        accumulator += input * Prime2;
+        accumulator = RotateLeft(accumulator, 31);
+        return accumulator * Prime1;
+    }
+
+    inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator)
+    {
+        hash ^= Round(0, accumulator);
+        return hash * Prime1 + Prime4;
+    }
+
+}
+
+uint64_t ComputeContentHash(const void* pData, size_t size, uint64_t seed)
+{
+    const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+    const uint8_t* pEnd = pBytes + size;
+
+    uint64_t hash;
+
+    if (size >= 32)
+    {
+        // Four independent lanes keep the multipliers busy
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+
+        const uint8_t* pLimit = pEnd - 32;
+        do
+        {
+            v1 = Round(v1, Read64(pBytes));
+            v2 = Round(v2, Read64(pBytes + 8));
+            v3 = Round(v3, Read64(pBytes + 16));
+            v4 = Round(v4, Read64(pBytes + 24));
+            pBytes += 32;
+        } while (pBytes <= pLimit);
+
+        hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+        hash = MergeRound(hash, v1);
+        hash = MergeRound(hash, v2);
+        hash = MergeRound(hash, v3);
+        hash = MergeRound(hash, v4);
+    }
+    else
+    {
+        hash = seed + Prime5;
+    }
+
+    hash += (uint64_t)size;
+
+    for (; pBytes + 8 <= pEnd; pBytes += 8)
+    {
+        hash ^= Round(0, Read64(pBytes));
+        hash = RotateLeft(hash, 27) * Prime1 + Prime4;
+    }
+
+    if (pBytes + 4 <= pEnd)
+    {
+        hash ^= (uint64_t)Read32(pBytes) * Prime1;
+        hash = RotateLeft(hash, 23) * Prime2 + Prime3;
+        pBytes += 4;
+    }
+
+    for (; pBytes < pEnd; pBytes++)
+    {
+        hash ^= (*pBytes) * Prime5;
+        hash = RotateLeft(hash, 11) * Prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= Prime2;
+    hash ^= hash >> 29;
+    hash *= Prime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
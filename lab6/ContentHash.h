@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 64-bit hash of a byte range (the XXH64 algorithm). The value does not depend on
+ * the platform or the process, so it can key data stored on disk.
+ */
+uint64_t ComputeContentHash(const void* pData, size_t size, uint64_t seed = 0);
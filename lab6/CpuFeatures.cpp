@@ -0,0 +1,54 @@
+#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_FEATURES_X86 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace
+{
+
+    CpuFeatures DetectCpuFeatures()
+    {
+        CpuFeatures features;
+
+#if defined(CPU_FEATURES_X86) && defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        features.sse41 = (info[2] & (1 << 19)) != 0;
+
+        // AVX registers are usable only if the OS saves them on context switches
+        const bool hasOSXSave = (info[2] & (1 << 27)) != 0;
+        const unsigned long long xcr0 = hasOSXSave ? _xgetbv(0) : 0;
+        const bool hasAVXState = (xcr0 & 0x6) == 0x6;
+        const bool hasAVX512State = (xcr0 & 0xE6) == 0xE6;
+
+        if (maxLeaf >= 7)
+        {
+            __cpuidex(info, 7, 0);
+            features.avx2 = hasAVXState && (info[1] & (1 << 5)) != 0;
+            features.avx512f = hasAVX512State && (info[1] & (1 << 16)) != 0;
+        }
+#elif defined(CPU_FEATURES_X86)
+        __builtin_cpu_init();
+        features.sse41 = __builtin_cpu_supports("sse4.1") != 0;
+        features.avx2 = __builtin_cpu_supports("avx2") != 0;
+        features.avx512f = __builtin_cpu_supports("avx512f") != 0;
+#endif
+
+        return features;
+    }
+
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+    static const CpuFeatures features = DetectCpuFeatures();
+    return features;
+}
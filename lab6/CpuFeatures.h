@@ -0,0 +1,12 @@
+#pragma once
+
+/** Instruction set extensions usable on this CPU with the current OS */
+struct CpuFeatures
+{
+    bool sse41 = false;
+    bool avx2 = false;
+    bool avx512f = false;
+};
+
+/** Detected once on the first call */
+const CpuFeatures& GetCpuFeatures();
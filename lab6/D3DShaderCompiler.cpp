@@ -0,0 +1,98 @@
+#include "framework.h"
+
+#include "D3DShaderCompiler.h"
+#include "ShaderSourceCache.h"
+
+#include <d3dcompiler.h>
+
+namespace
+{
+
+    class CustomShaderIncludeHandler : public ID3DInclude
+    {
+    public:
+        HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* dataOutput, UINT* dataSize) override
+        {
+            int length = MultiByteToWideChar(CP_ACP, 0, fileName, -1, nullptr, 0);
+            if (length <= 0)
+            {
+                return E_FAIL;
+            }
+
+            std::wstring path(length, L'\0');
+            MultiByteToWideChar(CP_ACP, 0, fileName, -1, &path[0], length);
+            path.resize(length - 1);
+
+            // A header shared by many shaders is read once, the view keeps it alive until Close
+            AssetView file;
+            if (!ShaderSourceCache::GetDefault().Open(path, file))
+            {
+                return E_FAIL;
+            }
+
+            *dataOutput = file.pData;
+            *dataSize = static_cast<UINT>(file.size);
+
+            m_openFiles.push_back(std::move(file));
+
+            return S_OK;
+        }
+
+        HRESULT __stdcall Close(LPCVOID dataToRelease) override
+        {
+            auto it = std::find_if(m_openFiles.begin(), m_openFiles.end(),
+                [dataToRelease](const AssetView& file) { return file.pData == dataToRelease; });
+
+            if (it != m_openFiles.end())
+            {
+                m_openFiles.erase(it);
+            }
+            return S_OK;
+        }
+
+    private:
+        std::vector<AssetView> m_openFiles;
+    };
+
+}
+
+HRESULT D3DShaderCompiler::Compile(const void* pSource, size_t size, const ShaderCompileArgs& args,
+    std::vector<UINT8>& bytecode, std::string& messages)
+{
+    // The name shows up in compiler messages
+    std::string name(args.path.begin(), args.path.end());
+
+    CustomShaderIncludeHandler includeHandler;
+
+    ID3DBlob* pCode     = nullptr;
+    ID3DBlob* pErrMsg   = nullptr;
+    HRESULT result      = D3DCompile(pSource, size, name.c_str(),
+                                     args.pDefines, &includeHandler, args.entryPoint.c_str(), args.profile.c_str(),
+                                     args.flags, 0, &pCode, &pErrMsg);
+
+    if (pErrMsg != nullptr)
+    {
+        messages = (const char*)pErrMsg->GetBufferPointer();
+        pErrMsg->Release();
+    }
+
+    bytecode.clear();
+
+    if (SUCCEEDED(result))
+    {
+        const UINT8* pBytes = (const UINT8*)pCode->GetBufferPointer();
+        bytecode.assign(pBytes, pBytes + pCode->GetBufferSize());
+    }
+
+    if (pCode != nullptr)
+    {
+        pCode->Release();
+    }
+
+    return result;
+}
+
+UINT64 D3DShaderCompiler::GetVersion() const
+{
+    return D3D_COMPILER_VERSION;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "ShaderCache.h"
+
+/** IShaderCompiler over D3DCompile, includes are served by ShaderSourceCache */
+class D3DShaderCompiler : public IShaderCompiler
+{
+public:
+    HRESULT Compile(const void* pSource, size_t size, const ShaderCompileArgs& args,
+        std::vector<UINT8>& bytecode, std::string& messages) override;
+
+    UINT64 GetVersion() const override;
+};
@@ -1,11 +1,23 @@
 #include "framework.h"
 
 #include "DDS.h"
+#include "AssetPak.h"
+#include "ContentHash.h"
+#include "LZCodec.h"
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 namespace
 {
 
     const UINT32 DDSSignature = 0x20534444;     ///< DDS file signature
+    const UINT32 SupercompressedSignature = 0x5A534444;     ///< "DDSZ", DDS headers followed by an LZ chunked payload
+    const UINT32 SupercompressedChunkSize = 64 * 1024;
+    const UINT32 MaxArraySize = 2048;       ///< D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION, cube faces included
 
 #pragma pack(push)
 #pragma pack(1)
@@ -46,10 +58,23 @@ namespace
         UINT32 miscFlags2;
     };
 
+    /**
+     * Follows the DDS headers of a supercompressed file, then come the stored size of
+     * every chunk and the chunks. A chunk stored at its raw size is not compressed.
+     */
+    struct SupercompressedHeader
+    {
+        UINT32 chunkSize;
+        UINT32 chunkCount;
+        UINT64 payloadSize;
+    };
+
 #pragma pack(pop)
 
-    const UINT32 DDPF_FOURCC = 0x4;
     const UINT32 DDPF_ALPHAPIXELS = 0x1;
+    const UINT32 DDPF_FOURCC = 0x4;
+    const UINT32 DDPF_RGB = 0x40;
+    const UINT32 DDPF_LUMINANCE = 0x20000;
 
     const UINT32 DDSD_CAPS = 0x1;
     const UINT32 DDSD_HEIGHT = 0x2;
@@ -60,17 +85,32 @@ namespace
     const UINT32 DDSD_LINEARSIZE = 0x80000;
     const UINT32 DDSD_DEPTH = 0x800000;
 
-    bool HaveDXT10Header(const DDSHeader& header)
+    const UINT32 DDSCAPS_COMPLEX = 0x8;
+    const UINT32 DDSCAPS_TEXTURE = 0x1000;
+    const UINT32 DDSCAPS_MIPMAP = 0x400000;
+
+    const UINT32 DDSCAPS2_CUBEMAP = 0x200;
+    const UINT32 DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00;
+    const UINT32 DDSCAPS2_VOLUME = 0x200000;
+
+    const UINT32 DDS_DIMENSION_TEXTURE1D = 2;
+    const UINT32 DDS_DIMENSION_TEXTURE2D = 3;
+    const UINT32 DDS_DIMENSION_TEXTURE3D = 4;
+
+    const UINT32 DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+    constexpr UINT32 MakeFourCC(char a, char b, char c, char d)
     {
-        if ((header.pixelFormat.flags & DDPF_FOURCC) != 0)
-        {
-            char fourCC[5] = { 0 };
-            memcpy(fourCC, &header.pixelFormat.fourCC, 4);
+        return (UINT32)(UINT8)a | ((UINT32)(UINT8)b << 8) | ((UINT32)(UINT8)c << 16) | ((UINT32)(UINT8)d << 24);
+    }
 
-            return strcmp(fourCC, "DX10") == 0;
-        }
+    /** Marks reserved[1..2] of the header as TextureDesc::sourceKey */
+    const UINT32 SourceKeyTag = MakeFourCC('S', 'K', 'E', 'Y');
 
-        return false;
+    bool HaveDXT10Header(const DDSHeader& header)
+    {
+        return (header.pixelFormat.flags & DDPF_FOURCC) != 0
+            && header.pixelFormat.fourCC == MakeFourCC('D', 'X', '1', '0');
     }
 
     bool ValidateFlags(const DDSHeader& header)
@@ -81,134 +121,1180 @@ namespace
             && (header.flags & DDSD_PIXELFORMAT) != 0;
     }
 
+    bool IsMask(const PixelFormat& pf, UINT32 r, UINT32 g, UINT32 b, UINT32 a)
+    {
+        return pf.RMask == r && pf.GMask == g && pf.BMask == b && pf.AMask == a;
+    }
+
+    /** Maps legacy (non DX10) pixel format description to DXGI format */
     DXGI_FORMAT GetTextureFormat(const DDSHeader& header)
     {
-        char fourCC[5] = { 0 };
-        memcpy(fourCC, &header.pixelFormat.fourCC, 4);
+        const PixelFormat& pf = header.pixelFormat;
 
-        if (strcmp(fourCC, "DXT1") == 0)
+        if ((pf.flags & DDPF_FOURCC) != 0)
         {
-            return DXGI_FORMAT_BC1_UNORM;
+            switch (pf.fourCC)
+            {
+            case MakeFourCC('D', 'X', 'T', '1'):
+                return DXGI_FORMAT_BC1_UNORM;
+
+            case MakeFourCC('D', 'X', 'T', '2'):
+            case MakeFourCC('D', 'X', 'T', '3'):
+                return DXGI_FORMAT_BC2_UNORM;
+
+            case MakeFourCC('D', 'X', 'T', '4'):
+            case MakeFourCC('D', 'X', 'T', '5'):
+                return DXGI_FORMAT_BC3_UNORM;
+
+            case MakeFourCC('A', 'T', 'I', '1'):
+            case MakeFourCC('B', 'C', '4', 'U'):
+                return DXGI_FORMAT_BC4_UNORM;
+            case MakeFourCC('B', 'C', '4', 'S'):
+                return DXGI_FORMAT_BC4_SNORM;
+
+            case MakeFourCC('A', 'T', 'I', '2'):
+            case MakeFourCC('B', 'C', '5', 'U'):
+                return DXGI_FORMAT_BC5_UNORM;
+            case MakeFourCC('B', 'C', '5', 'S'):
+                return DXGI_FORMAT_BC5_SNORM;
+
+            // D3DFORMAT codes stored in place of four CC
+            case 36:
+                return DXGI_FORMAT_R16G16B16A16_UNORM;
+            case 110:
+                return DXGI_FORMAT_R16G16B16A16_SNORM;
+            case 111:
+                return DXGI_FORMAT_R16_FLOAT;
+            case 112:
+                return DXGI_FORMAT_R16G16_FLOAT;
+            case 113:
+                return DXGI_FORMAT_R16G16B16A16_FLOAT;
+            case 114:
+                return DXGI_FORMAT_R32_FLOAT;
+            case 115:
+                return DXGI_FORMAT_R32G32_FLOAT;
+            case 116:
+                return DXGI_FORMAT_R32G32B32A32_FLOAT;
+            }
+
+            return DXGI_FORMAT_UNKNOWN;
+        }
+
+        if ((pf.flags & DDPF_RGB) != 0 && pf.bitCount == 32)
+        {
+            if (IsMask(pf, 0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000))
+            {
+                return DXGI_FORMAT_R8G8B8A8_UNORM;
+            }
+            if (IsMask(pf, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000))
+            {
+                return DXGI_FORMAT_B8G8R8A8_UNORM;
+            }
+            if (IsMask(pf, 0x00FF0000, 0x0000FF00, 0x000000FF, 0))
+            {
+                return DXGI_FORMAT_B8G8R8X8_UNORM;
+            }
+            if (IsMask(pf, 0xFFFFFFFF, 0, 0, 0))
+            {
+                return DXGI_FORMAT_R32_FLOAT;
+            }
         }
-        if (strcmp(fourCC, "DXT1") == 0 && (header.pixelFormat.flags & DDPF_ALPHAPIXELS) != 0)
+
+        if ((pf.flags & DDPF_LUMINANCE) != 0 && pf.bitCount == 8)
         {
-            return DXGI_FORMAT_BC1_UNORM;
+            return DXGI_FORMAT_R8_UNORM;
         }
-        if (strcmp(fourCC, "DXT3") == 0)
+
+        return DXGI_FORMAT_UNKNOWN;
+    }
+
+    /** Size of one mip level surface, false if its pitches do not fit in 32 bits */
+    bool GetSurfaceInfo(DXGI_FORMAT fmt, UINT32 width, UINT32 height, UINT32& rowPitch, UINT32& rowCount,
+        UINT32& slicePitch)
+    {
+        UINT64 pitch = 0;
+        if (IsBlockCompressed(fmt))
         {
-            return DXGI_FORMAT_BC2_UNORM;
+            pitch = std::max<UINT64>(1, DivUp<UINT64>(width, 4)) * GetBytesPerBlock(fmt);
+            rowCount = (UINT32)std::max<UINT64>(1, DivUp<UINT64>(height, 4));
         }
-        if (strcmp(fourCC, "DXT5") == 0)
+        else
         {
-            return DXGI_FORMAT_BC3_UNORM;
+            pitch = DivUp<UINT64>((UINT64)width * GetBitsPerPixel(fmt), 8);
+            rowCount = height;
         }
-        return DXGI_FORMAT_UNKNOWN;
+
+        // A 64K x 64K RGBA8 surface already wraps a 32-bit slice pitch to 0
+        if (pitch > UINT32_MAX || pitch * rowCount > UINT32_MAX)
+        {
+            return false;
+        }
+
+        rowPitch = (UINT32)pitch;
+        slicePitch = (UINT32)(pitch * rowCount);
+
+        return true;
+    }
+
+    /** Fills the pre-DX10 description of the format, returns false if it has none GetTextureFormat maps back */
+    bool GetLegacyPixelFormat(DXGI_FORMAT fmt, PixelFormat& pf)
+    {
+        memset(&pf, 0, sizeof(PixelFormat));
+        pf.size = sizeof(PixelFormat);
+        pf.flags = DDPF_FOURCC;
+
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM: pf.fourCC = MakeFourCC('D', 'X', 'T', '1'); return true;
+        case DXGI_FORMAT_BC2_UNORM: pf.fourCC = MakeFourCC('D', 'X', 'T', '3'); return true;
+        case DXGI_FORMAT_BC3_UNORM: pf.fourCC = MakeFourCC('D', 'X', 'T', '5'); return true;
+        case DXGI_FORMAT_BC4_UNORM: pf.fourCC = MakeFourCC('A', 'T', 'I', '1'); return true;
+        case DXGI_FORMAT_BC4_SNORM: pf.fourCC = MakeFourCC('B', 'C', '4', 'S'); return true;
+        case DXGI_FORMAT_BC5_UNORM: pf.fourCC = MakeFourCC('A', 'T', 'I', '2'); return true;
+        case DXGI_FORMAT_BC5_SNORM: pf.fourCC = MakeFourCC('B', 'C', '5', 'S'); return true;
+
+        case DXGI_FORMAT_R16G16B16A16_UNORM: pf.fourCC = 36; return true;
+        case DXGI_FORMAT_R16G16B16A16_SNORM: pf.fourCC = 110; return true;
+        case DXGI_FORMAT_R16_FLOAT:          pf.fourCC = 111; return true;
+        case DXGI_FORMAT_R16G16_FLOAT:       pf.fourCC = 112; return true;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT: pf.fourCC = 113; return true;
+        case DXGI_FORMAT_R32_FLOAT:          pf.fourCC = 114; return true;
+        case DXGI_FORMAT_R32G32_FLOAT:       pf.fourCC = 115; return true;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT: pf.fourCC = 116; return true;
+
+        default:
+            break;
+        }
+
+        pf.flags = DDPF_RGB;
+        pf.bitCount = 32;
+
+        switch (fmt)
+        {
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+            pf.flags |= DDPF_ALPHAPIXELS;
+            pf.RMask = 0x000000FF; pf.GMask = 0x0000FF00; pf.BMask = 0x00FF0000; pf.AMask = 0xFF000000;
+            return true;
+
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+            pf.flags |= DDPF_ALPHAPIXELS;
+            pf.RMask = 0x00FF0000; pf.GMask = 0x0000FF00; pf.BMask = 0x000000FF; pf.AMask = 0xFF000000;
+            return true;
+
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+            pf.RMask = 0x00FF0000; pf.GMask = 0x0000FF00; pf.BMask = 0x000000FF;
+            return true;
+
+        case DXGI_FORMAT_R8_UNORM:
+            pf.flags = DDPF_LUMINANCE;
+            pf.bitCount = 8;
+            pf.RMask = 0xFF;
+            return true;
+
+        default:
+            break;
+        }
+
+        return false;
+    }
+
+    /**
+     * Collects small pieces and writes them in chunks of ChunkSize bytes, so every
+     * write but the last starts at a chunk aligned file offset. Large pieces are
+     * written straight from the caller memory once the buffer has been flushed.
+     */
+    class ChunkWriter
+    {
+    public:
+        static const size_t ChunkSize = 1 << 20;
+
+        explicit ChunkWriter(FILE* pFile)
+            : m_pFile(pFile)
+            , m_buffer(ChunkSize)
+            , m_used(0)
+            , m_isFailed(false)
+        {
+            // Data is already gathered in large blocks, the CRT buffer would only add a copy
+            setvbuf(m_pFile, nullptr, _IONBF, 0);
+        }
+
+        void Write(const void* pData, size_t size)
+        {
+            const UINT8* pBytes = reinterpret_cast<const UINT8*>(pData);
+
+            while (size != 0 && !m_isFailed)
+            {
+                if (m_used == 0 && size >= ChunkSize)
+                {
+                    size_t directSize = size - size % ChunkSize;
+                    m_isFailed = fwrite(pBytes, 1, directSize, m_pFile) != directSize;
+                    pBytes += directSize;
+                    size -= directSize;
+                    continue;
+                }
+
+                size_t copySize = std::min(size, ChunkSize - m_used);
+                memcpy(m_buffer.data() + m_used, pBytes, copySize);
+                m_used += copySize;
+                pBytes += copySize;
+                size -= copySize;
+
+                if (m_used == ChunkSize)
+                {
+                    Flush();
+                }
+            }
+        }
+
+        /** Writes out the buffered tail, returns false if any write failed */
+        bool Flush()
+        {
+            if (m_used != 0 && !m_isFailed)
+            {
+                m_isFailed = fwrite(m_buffer.data(), 1, m_used, m_pFile) != m_used;
+            }
+            m_used = 0;
+
+            return !m_isFailed;
+        }
+
+    private:
+        FILE* m_pFile;
+        std::vector<UINT8> m_buffer;
+        size_t m_used;
+        bool m_isFailed;
+    };
+
+    /**
+     * Reads one byte of every page of the payload so that the mapping is paged in
+     * by the loader thread rather than on first access from the render thread.
+     */
+    void TouchPages(const TextureDesc& desc)
+    {
+        const size_t PageSize = 4096;
+
+        const volatile UINT8* pBytes = reinterpret_cast<const volatile UINT8*>(desc.pData);
+        UINT8 sum = 0;
+        for (UINT64 offset = 0; offset < desc.dataSize; offset += PageSize)
+        {
+            sum += pBytes[offset];
+        }
+        if (desc.dataSize != 0)
+        {
+            sum += pBytes[desc.dataSize - 1];
+        }
+        (void)sum;
+    }
+
+    /**
+     * Replaces a supercompressed file image with the plain DDS image it decodes to,
+     * chunks are decoded in parallel on the default pool. Plain images are left as is.
+     */
+    bool ExpandSupercompressed(const UINT8*& pFile, size_t& fileSize, std::shared_ptr<const void>& pStorage)
+    {
+        UINT32 signature = 0;
+        if (fileSize < sizeof(UINT32) + sizeof(DDSHeader))
+        {
+            return true;
+        }
+        memcpy(&signature, pFile, sizeof(UINT32));
+        if (signature != SupercompressedSignature)
+        {
+            return true;
+        }
+
+        DDSHeader header;
+        memcpy(&header, pFile + sizeof(UINT32), sizeof(DDSHeader));
+
+        size_t headersSize = sizeof(UINT32) + sizeof(DDSHeader) + (HaveDXT10Header(header) ? sizeof(DDS10Header) : 0);
+        if (fileSize < headersSize || fileSize - headersSize < sizeof(SupercompressedHeader))
+        {
+            return false;
+        }
+
+        SupercompressedHeader chunksHeader;
+        memcpy(&chunksHeader, pFile + headersSize, sizeof(SupercompressedHeader));
+
+        if (chunksHeader.chunkSize == 0 || chunksHeader.payloadSize > SIZE_MAX - headersSize
+            || chunksHeader.chunkCount != DivUp<UINT64>(chunksHeader.payloadSize, chunksHeader.chunkSize))
+        {
+            return false;
+        }
+
+        const size_t tableOffset = headersSize + sizeof(SupercompressedHeader);
+        if ((fileSize - tableOffset) / sizeof(UINT32) < chunksHeader.chunkCount)
+        {
+            return false;
+        }
+
+        // Stored chunks follow the table back to back, each one is raw or smaller than raw
+        std::vector<UINT32> storedSizes(chunksHeader.chunkCount);
+        std::vector<size_t> chunkOffsets(chunksHeader.chunkCount);
+        memcpy(storedSizes.data(), pFile + tableOffset, storedSizes.size() * sizeof(UINT32));
+
+        size_t offset = tableOffset + storedSizes.size() * sizeof(UINT32);
+        for (UINT32 i = 0; i < chunksHeader.chunkCount; i++)
+        {
+            UINT64 chunkStart = (UINT64)i * chunksHeader.chunkSize;
+            UINT64 rawSize = std::min<UINT64>(chunksHeader.chunkSize, chunksHeader.payloadSize - chunkStart);
+            if (storedSizes[i] == 0 || storedSizes[i] > rawSize || fileSize - offset < storedSizes[i])
+            {
+                return false;
+            }
+            chunkOffsets[i] = offset;
+            offset += storedSizes[i];
+        }
+
+        const size_t imageSize = headersSize + (size_t)chunksHeader.payloadSize;
+        std::shared_ptr<UINT8> pImage((UINT8*)malloc(imageSize), free);
+        if (pImage == nullptr)
+        {
+            return false;
+        }
+
+        memcpy(pImage.get(), &DDSSignature, sizeof(UINT32));
+        memcpy(pImage.get() + sizeof(UINT32), pFile + sizeof(UINT32), headersSize - sizeof(UINT32));
+
+        std::atomic<bool> isFailed(false);
+        const UINT8* pChunks = pFile;
+        ThreadPool::GetDefault().ParallelFor(chunksHeader.chunkCount, [&](uint32_t i)
+        {
+            UINT64 chunkStart = (UINT64)i * chunksHeader.chunkSize;
+            size_t rawSize = (size_t)std::min<UINT64>(chunksHeader.chunkSize, chunksHeader.payloadSize - chunkStart);
+            UINT8* pDst = pImage.get() + headersSize + (size_t)chunkStart;
+
+            if (storedSizes[i] == rawSize)
+            {
+                memcpy(pDst, pChunks + chunkOffsets[i], rawSize);
+            }
+            else if (!LZDecompress(pChunks + chunkOffsets[i], storedSizes[i], pDst, rawSize))
+            {
+                isFailed = true;
+            }
+        });
+
+        if (isFailed)
+        {
+            return false;
+        }
+
+        pFile = pImage.get();
+        fileSize = imageSize;
+        pStorage = pImage;
+
+        return true;
+    }
+
+    /** Compresses the payload in independent chunks on the default pool and writes it after the headers */
+    void WriteSupercompressedPayload(ChunkWriter& writer, const UINT8* pPayload, size_t payloadSize)
+    {
+        SupercompressedHeader header;
+        header.chunkSize = SupercompressedChunkSize;
+        header.chunkCount = (UINT32)DivUp<UINT64>(payloadSize, SupercompressedChunkSize);
+        header.payloadSize = payloadSize;
+
+        std::vector<std::vector<UINT8>> chunks(header.chunkCount);
+        std::vector<UINT32> storedSizes(header.chunkCount);
+
+        ThreadPool::GetDefault().ParallelFor(header.chunkCount, [&](uint32_t i)
+        {
+            size_t chunkStart = (size_t)i * SupercompressedChunkSize;
+            size_t rawSize = std::min<size_t>(SupercompressedChunkSize, payloadSize - chunkStart);
+
+            // Chunks that do not shrink are kept raw
+            std::vector<UINT8>& chunk = chunks[i];
+            chunk.resize(rawSize - 1);
+            size_t size = rawSize > 1 ? LZCompress(pPayload + chunkStart, rawSize, chunk.data(), chunk.size()) : 0;
+            if (size == 0)
+            {
+                chunk.assign(pPayload + chunkStart, pPayload + chunkStart + rawSize);
+            }
+            else
+            {
+                chunk.resize(size);
+            }
+            storedSizes[i] = (UINT32)chunk.size();
+        });
+
+        writer.Write(&header, sizeof(SupercompressedHeader));
+        writer.Write(storedSizes.data(), storedSizes.size() * sizeof(UINT32));
+        for (const std::vector<UINT8>& chunk : chunks)
+        {
+            writer.Write(chunk.data(), chunk.size());
+        }
+    }
+
+    /**
+     * Parses DDS headers of a file image in memory, texels are referenced in place.
+     * Only mips [firstMip, firstMip + mipCount) are described, mipCount == 0 takes
+     * all mips starting from firstMip.
+     */
+    bool ParseDDS(const UINT8* pFile, size_t fileSize, TextureDesc& desc, UINT32 firstMip, UINT32 mipCount)
+    {
+        size_t offset = 0;
+
+        // Try to read signature
+        UINT32 signature = 0;
+        if (fileSize < sizeof(UINT32))
+        {
+            return false;
+        }
+        memcpy(&signature, pFile, sizeof(UINT32));
+        if (signature != DDSSignature)
+        {
+            return false;
+        }
+        offset += sizeof(UINT32);
+
+        // Read DDS header
+        DDSHeader header;
+        memset(&header, 0, sizeof(DDSHeader));
+        if (fileSize - offset < sizeof(DDSHeader))
+        {
+            return false;
+        }
+        memcpy(&header, pFile + offset, sizeof(DDSHeader));
+        if (header.size != sizeof(DDSHeader))
+        {
+            return false;
+        }
+        offset += sizeof(DDSHeader);
+
+        // Validate header
+        if (!ValidateFlags(header))
+        {
+            return false;
+        }
+
+        // Read pitch
+        desc.pitch = (header.flags & DDSD_PITCH) != 0 ? (UINT32)header.pitchOrLinearSize : 0;
+
+        // Setup image size
+        desc.width = header.width;
+        desc.height = header.height;
+        desc.depth = 1;
+        desc.arraySize = 1;
+        desc.isCubemap = false;
+
+        // Key of generated textures, other writers leave the words zero or use them differently
+        desc.sourceKey = header.reserved[0] == SourceKeyTag
+            ? (UINT64)header.reserved[1] | ((UINT64)header.reserved[2] << 32) : 0;
+        desc.dimension = TextureDimension::Texture2D;
+
+        if (HaveDXT10Header(header))
+        {
+            DDS10Header header10;
+            memset(&header10, 0, sizeof(DDS10Header));
+            if (fileSize - offset < sizeof(DDS10Header))
+            {
+                return false;
+            }
+            memcpy(&header10, pFile + offset, sizeof(DDS10Header));
+            offset += sizeof(DDS10Header);
+
+            desc.fmt = (DXGI_FORMAT)header10.dxgiFormat;
+            desc.arraySize = header10.arraySize;
+            if (desc.arraySize == 0 || desc.arraySize > MaxArraySize)
+            {
+                return false;
+            }
+
+            switch (header10.resourceDimension)
+            {
+            case DDS_DIMENSION_TEXTURE1D:
+                desc.dimension = TextureDimension::Texture1D;
+                desc.height = 1;
+                break;
+
+            case DDS_DIMENSION_TEXTURE2D:
+                desc.dimension = TextureDimension::Texture2D;
+                if ((header10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0)
+                {
+                    if (desc.arraySize > MaxArraySize / 6)
+                    {
+                        return false;
+                    }
+                    desc.isCubemap = true;
+                    desc.arraySize *= 6;
+                }
+                break;
+
+            case DDS_DIMENSION_TEXTURE3D:
+                if ((header.flags & DDSD_DEPTH) == 0 || desc.arraySize != 1)
+                {
+                    return false;
+                }
+                desc.dimension = TextureDimension::Texture3D;
+                desc.depth = std::max(1u, header.depth);
+                break;
+
+            default:
+                return false;
+            }
+        }
+        else
+        {
+            desc.fmt = GetTextureFormat(header);
+
+            if ((header.caps2 & DDSCAPS2_CUBEMAP) != 0)
+            {
+                // Partial cubemaps are not supported by D3D11
+                if ((header.caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+                {
+                    return false;
+                }
+                desc.isCubemap = true;
+                desc.arraySize = 6;
+            }
+            else if ((header.caps2 & DDSCAPS2_VOLUME) != 0 && (header.flags & DDSD_DEPTH) != 0)
+            {
+                desc.dimension = TextureDimension::Texture3D;
+                desc.depth = std::max(1u, header.depth);
+            }
+        }
+
+        // Read texture format
+        if (desc.fmt == DXGI_FORMAT_UNKNOWN || GetBitsPerPixel(desc.fmt) == 0)
+        {
+            return false;
+        }
+
+        // Read mipmap count, a chain can not go on past 1x1x1
+        UINT32 fileMipCount = (header.flags & DDSD_MIPMAPCOUNT) != 0 ? std::max(1u, (UINT32)header.mipMapCount) : 1;
+        fileMipCount = std::min(fileMipCount,
+            std::max(GetFullMipCount(desc.width, desc.height), GetFullMipCount(desc.depth, 1)));
+
+        if (firstMip >= fileMipCount)
+        {
+            return false;
+        }
+        desc.mipmapsCount = mipCount == 0 ? fileMipCount - firstMip : std::min(mipCount, fileMipCount - firstMip);
+
+        desc.pData = pFile + offset;
+        desc.dataOffset = offset;
+        desc.dataSize = ComputeSubresourceLayout(desc.fmt, desc.width, desc.height, desc.depth,
+            desc.arraySize, fileMipCount, desc.mipmapsCount, desc.subresources, firstMip, fileSize - offset);
+
+        // Every subresource has to fit in 32-bit pitches and in the rest of the file
+        if (desc.dataSize == 0)
+        {
+            return false;
+        }
+
+        // Texture starts at the first loaded mip
+        desc.width = desc.subresources[0].width;
+        desc.height = desc.subresources[0].height;
+        desc.depth = desc.subresources[0].depth;
+
+        return true;
     }
 
 }
 
-bool LoadDDS(const std::wstring& filepath, TextureDesc& desc, bool singleMip)
+UINT64 ComputeSubresourceLayout(DXGI_FORMAT fmt, UINT32 width, UINT32 height, UINT32 depth,
+    UINT32 arraySize, UINT32 fileMipCount, UINT32 mipCount, std::vector<SubresourceLayout>& layout, UINT32 firstMip,
+    UINT64 maxSize)
 {
-    FILE* pFile = nullptr;
-    _wfopen_s(&pFile, filepath.c_str(), L"rb");
-    if (pFile == nullptr)
+    layout.clear();
+    layout.reserve((size_t)arraySize * mipCount);
+
+    UINT64 offset = 0;
+
+    // File stores all mips of a slice before the next slice
+    for (UINT32 slice = 0; slice < arraySize; slice++)
+    {
+        UINT32 mipWidth = width;
+        UINT32 mipHeight = height;
+        UINT32 mipDepth = depth;
+
+        for (UINT32 mip = 0; mip < fileMipCount; mip++)
+        {
+            SubresourceLayout subresource;
+            subresource.offset = offset;
+            subresource.width = mipWidth;
+            subresource.height = mipHeight;
+            subresource.depth = mipDepth;
+            if (!GetSurfaceInfo(fmt, mipWidth, mipHeight, subresource.rowPitch, subresource.blockRows,
+                subresource.slicePitch))
+            {
+                layout.clear();
+                return 0;
+            }
+
+            // Checked against what is left, so the offset can not wrap either
+            const UINT64 size = (UINT64)subresource.slicePitch * mipDepth;
+            if (size > maxSize - offset)
+            {
+                layout.clear();
+                return 0;
+            }
+
+            if (mip >= firstMip && mip - firstMip < mipCount)
+            {
+                layout.push_back(subresource);
+            }
+
+            offset += size;
+
+            mipWidth = std::max(1u, mipWidth / 2);
+            mipHeight = std::max(1u, mipHeight / 2);
+            mipDepth = std::max(1u, mipDepth / 2);
+        }
+    }
+
+    return offset;
+}
+
+UINT32 GetBitsPerPixel(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32A32_UINT:
+    case DXGI_FORMAT_R32G32B32A32_SINT:
+        return 128;
+
+    case DXGI_FORMAT_R32G32B32_TYPELESS:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_UINT:
+    case DXGI_FORMAT_R32G32B32_SINT:
+        return 96;
+
+    case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R16G16B16A16_UINT:
+    case DXGI_FORMAT_R16G16B16A16_SNORM:
+    case DXGI_FORMAT_R16G16B16A16_SINT:
+    case DXGI_FORMAT_R32G32_TYPELESS:
+    case DXGI_FORMAT_R32G32_FLOAT:
+    case DXGI_FORMAT_R32G32_UINT:
+    case DXGI_FORMAT_R32G32_SINT:
+        return 64;
+
+    case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UINT:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_R8G8B8A8_UINT:
+    case DXGI_FORMAT_R8G8B8A8_SNORM:
+    case DXGI_FORMAT_R8G8B8A8_SINT:
+    case DXGI_FORMAT_R16G16_TYPELESS:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R16G16_UINT:
+    case DXGI_FORMAT_R16G16_SNORM:
+    case DXGI_FORMAT_R16G16_SINT:
+    case DXGI_FORMAT_R32_TYPELESS:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_R32_UINT:
+    case DXGI_FORMAT_R32_SINT:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        return 32;
+
+    case DXGI_FORMAT_R8G8_TYPELESS:
+    case DXGI_FORMAT_R8G8_UNORM:
+    case DXGI_FORMAT_R8G8_UINT:
+    case DXGI_FORMAT_R8G8_SNORM:
+    case DXGI_FORMAT_R8G8_SINT:
+    case DXGI_FORMAT_R16_TYPELESS:
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R16_UNORM:
+    case DXGI_FORMAT_R16_UINT:
+    case DXGI_FORMAT_R16_SNORM:
+    case DXGI_FORMAT_R16_SINT:
+    case DXGI_FORMAT_B5G6R5_UNORM:
+    case DXGI_FORMAT_B5G5R5A1_UNORM:
+    case DXGI_FORMAT_B4G4R4A4_UNORM:
+        return 16;
+
+    case DXGI_FORMAT_R8_TYPELESS:
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_R8_UINT:
+    case DXGI_FORMAT_R8_SNORM:
+    case DXGI_FORMAT_R8_SINT:
+    case DXGI_FORMAT_A8_UNORM:
+    case DXGI_FORMAT_BC2_TYPELESS:
+    case DXGI_FORMAT_BC2_UNORM:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_TYPELESS:
+    case DXGI_FORMAT_BC3_UNORM:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC5_TYPELESS:
+    case DXGI_FORMAT_BC5_UNORM:
+    case DXGI_FORMAT_BC5_SNORM:
+    case DXGI_FORMAT_BC6H_TYPELESS:
+    case DXGI_FORMAT_BC6H_UF16:
+    case DXGI_FORMAT_BC6H_SF16:
+    case DXGI_FORMAT_BC7_TYPELESS:
+    case DXGI_FORMAT_BC7_UNORM:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return 8;
+
+    case DXGI_FORMAT_BC1_TYPELESS:
+    case DXGI_FORMAT_BC1_UNORM:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC4_TYPELESS:
+    case DXGI_FORMAT_BC4_UNORM:
+    case DXGI_FORMAT_BC4_SNORM:
+        return 4;
+
+    default:
+        return 0;
+    }
+}
+
+bool IsBlockCompressed(DXGI_FORMAT fmt)
+{
+    return (fmt >= DXGI_FORMAT_BC1_TYPELESS && fmt <= DXGI_FORMAT_BC5_SNORM)
+        || (fmt >= DXGI_FORMAT_BC6H_TYPELESS && fmt <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+bool IsSRGB(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+    case DXGI_FORMAT_BC1_UNORM_SRGB:
+    case DXGI_FORMAT_BC2_UNORM_SRGB:
+    case DXGI_FORMAT_BC3_UNORM_SRGB:
+    case DXGI_FORMAT_BC7_UNORM_SRGB:
+        return true;
+
+    default:
+        break;
+    }
+
+    return false;
+}
+
+UINT64 ComputeTextureDescKey(const TextureDesc& desc)
+{
+    const UINT32 Header[] =
+    {
+        (UINT32)desc.fmt, (UINT32)desc.dimension, desc.width, desc.height, desc.depth, desc.mipmapsCount,
+        desc.arraySize, desc.isCubemap ? 1u : 0u, desc.isArray ? 1u : 0u
+    };
+
+    return ComputeContentHash(Header, sizeof(Header));
+}
+
+UINT64 ComputeTextureKey(const TextureDesc& desc, const SubresourceRowsGetter& getRows)
+{
+    UINT64 hash = ComputeTextureDescKey(desc);
+
+    // All array slices share the layout of the first one
+    UINT32 count = desc.arraySize * desc.mipmapsCount;
+    for (UINT32 i = 0; i < count; i++)
+    {
+        const SubresourceLayout& subresource = desc.subresources[i % desc.mipmapsCount];
+
+        UINT32 pitch = subresource.rowPitch;
+        UINT32 slicePitch = subresource.slicePitch;
+        const UINT8* pRows = reinterpret_cast<const UINT8*>(getRows ? getRows(i, pitch, slicePitch)
+            : desc.GetSubresourceData(i));
+
+        for (UINT32 slice = 0; slice < subresource.depth; slice++)
+        {
+            const UINT8* pSlice = pRows + (size_t)slice * slicePitch;
+            for (UINT32 row = 0; row < subresource.blockRows; row++)
+            {
+                hash = ComputeContentHash(pSlice + (size_t)row * pitch, subresource.rowPitch, hash);
+            }
+        }
+    }
+
+    return hash;
+}
+
+bool LoadDDS(const std::wstring& filepath, TextureDesc& desc, bool singleMip, DDSLoadMode mode)
+{
+    const UINT8* pFile = nullptr;
+    size_t fileSize = 0;
+    std::shared_ptr<const void> pStorage;
+
+    AssetView file;
+    std::shared_ptr<AssetPak> pPak = AssetPak::GetMounted();
+
+    if (mode == DDSLoadMode::Mapped)
+    {
+        if (!OpenAsset(filepath, file))
+        {
+            return false;
+        }
+
+        pFile = file.pData;
+        fileSize = file.size;
+        pStorage = file.pStorage;
+    }
+    else if (pPak != nullptr && pPak->Find(filepath, file))
+    {
+        // Packed files are copied out of the archive mapping, no file is opened
+        std::shared_ptr<UINT8> pBuffer((UINT8*)malloc(std::max<size_t>(file.size, 1)), free);
+        if (pBuffer == nullptr)
+        {
+            return false;
+        }
+        memcpy(pBuffer.get(), file.pData, file.size);
+
+        pFile = pBuffer.get();
+        fileSize = file.size;
+        pStorage = pBuffer;
+    }
+    else
+    {
+        FILE* pStream = nullptr;
+        _wfopen_s(&pStream, filepath.c_str(), L"rb");
+        if (pStream == nullptr)
+        {
+            return false;
+        }
+
+        fseek(pStream, 0, SEEK_END);
+        long long streamSize = _ftelli64(pStream);
+        fseek(pStream, 0, SEEK_SET);
+
+        if (streamSize <= 0)
+        {
+            fclose(pStream);
+            return false;
+        }
+
+        std::shared_ptr<UINT8> pBuffer((UINT8*)malloc((size_t)streamSize), free);
+        if (pBuffer == nullptr)
+        {
+            fclose(pStream);
+            return false;
+        }
+
+        size_t readSize = fread(pBuffer.get(), 1, (size_t)streamSize, pStream);
+        fclose(pStream);
+
+        if (readSize != (size_t)streamSize)
+        {
+            return false;
+        }
+
+        pFile = pBuffer.get();
+        fileSize = (size_t)streamSize;
+        pStorage = pBuffer;
+    }
+
+    // Supercompressed files always end up decoded into a heap buffer
+    if (!ExpandSupercompressed(pFile, fileSize, pStorage)
+        || !ParseDDS(pFile, fileSize, desc, 0, singleMip ? 1 : 0))
     {
         return false;
     }
 
-    // Try to read signature
-    UINT32 signature = 0;
-    if (fread(&signature, 1, sizeof(UINT32), pFile) != sizeof(UINT32)
-        || signature != DDSSignature)
+    desc.pStorage = pStorage;
+
+    return true;
+}
+
+bool LoadDDSMips(const std::wstring& filepath, TextureDesc& desc, UINT32 firstMip, UINT32 mipCount, DDSLoadMode mode)
+{
+    AssetView file;
+    if (!OpenAsset(filepath, file))
+    {
+        return false;
+    }
+
+    const UINT8* pFile = file.pData;
+    size_t fileSize = file.size;
+    std::shared_ptr<const void> pStorage = file.pStorage;
+
+    if (!ExpandSupercompressed(pFile, fileSize, pStorage)
+        || !ParseDDS(pFile, fileSize, desc, firstMip, mipCount))
+    {
+        return false;
+    }
+
+    if (mode == DDSLoadMode::Mapped)
+    {
+        desc.pStorage = pStorage;
+        return true;
+    }
+
+    // Requested mips of a slice are stored back to back, so each slice is a single copy
+    UINT64 bufferSize = 0;
+    for (UINT32 slice = 0; slice < desc.arraySize; slice++)
+    {
+        const SubresourceLayout& last = desc.subresources[slice * desc.mipmapsCount + desc.mipmapsCount - 1];
+        bufferSize += last.offset + (UINT64)last.slicePitch * last.depth - desc.subresources[slice * desc.mipmapsCount].offset;
+    }
+
+    std::shared_ptr<UINT8> pBuffer((UINT8*)malloc((size_t)bufferSize), free);
+    if (pBuffer == nullptr)
+    {
+        return false;
+    }
+
+    const UINT8* pPayload = reinterpret_cast<const UINT8*>(desc.pData);
+    UINT64 dstOffset = 0;
+    for (UINT32 slice = 0; slice < desc.arraySize; slice++)
+    {
+        SubresourceLayout* pSlice = desc.subresources.data() + slice * desc.mipmapsCount;
+        const SubresourceLayout& last = pSlice[desc.mipmapsCount - 1];
+
+        UINT64 srcOffset = pSlice[0].offset;
+        UINT64 size = last.offset + (UINT64)last.slicePitch * last.depth - srcOffset;
+        memcpy(pBuffer.get() + dstOffset, pPayload + srcOffset, (size_t)size);
+
+        for (UINT32 mip = 0; mip < desc.mipmapsCount; mip++)
+        {
+            pSlice[mip].offset = pSlice[mip].offset - srcOffset + dstOffset;
+        }
+        dstOffset += size;
+    }
+
+    desc.pData = pBuffer.get();
+    desc.pStorage = pBuffer;
+
+    return true;
+}
+
+bool SaveDDS(const TextureDesc& desc, const std::wstring& filepath, bool supercompress)
+{
+    if (desc.pData == nullptr || desc.mipmapsCount == 0 || desc.arraySize == 0
+        || desc.subresources.size() != (size_t)desc.arraySize * desc.mipmapsCount
+        || GetBitsPerPixel(desc.fmt) == 0)
     {
-        fclose(pFile);
         return false;
     }
 
-    // Read DDS header
+    const bool isVolume = desc.dimension == TextureDimension::Texture3D;
+    const bool isBlockCompressed = IsBlockCompressed(desc.fmt);
+    const SubresourceLayout& top = desc.subresources[0];
+
     DDSHeader header;
     memset(&header, 0, sizeof(DDSHeader));
-    size_t readSize = fread(&header, 1, sizeof(header), pFile);
-    if (readSize != sizeof(DDSHeader) || readSize != header.size)
+    header.size = sizeof(DDSHeader);
+    header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT
+        | (isBlockCompressed ? DDSD_LINEARSIZE : DDSD_PITCH) | (isVolume ? DDSD_DEPTH : 0);
+    header.height = desc.height;
+    header.width = desc.width;
+    header.pitchOrLinearSize = isBlockCompressed ? top.slicePitch : top.rowPitch;
+    header.depth = isVolume ? desc.depth : 0;
+    header.mipMapCount = desc.mipmapsCount;
+    header.caps = DDSCAPS_TEXTURE | (desc.mipmapsCount > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0)
+        | (desc.isCubemap || isVolume ? DDSCAPS_COMPLEX : 0);
+    header.caps2 = (desc.isCubemap ? DDSCAPS2_CUBEMAP | DDSCAPS2_CUBEMAP_ALLFACES : 0) | (isVolume ? DDSCAPS2_VOLUME : 0);
+
+    if (desc.sourceKey != 0)
     {
-        fclose(pFile);
-        return false;
+        header.reserved[0] = SourceKeyTag;
+        header.reserved[1] = (UINT32)desc.sourceKey;
+        header.reserved[2] = (UINT32)(desc.sourceKey >> 32);
     }
 
-    // Check for DXT10 header presence
+    // Legacy header can describe one texture or one cube only, in a fixed set of formats
+    const bool isSingle = desc.isCubemap ? desc.arraySize == 6 : desc.arraySize == 1;
+    const bool isLegacy = isSingle && desc.dimension != TextureDimension::Texture1D
+        && GetLegacyPixelFormat(desc.fmt, header.pixelFormat);
+
     DDS10Header header10;
     memset(&header10, 0, sizeof(DDS10Header));
-    if (HaveDXT10Header(header))
+
+    if (!isLegacy)
     {
-        readSize = fread(&header10, 1, sizeof(DDS10Header), pFile);
-        if (readSize != sizeof(DDS10Header))
+        memset(&header.pixelFormat, 0, sizeof(PixelFormat));
+        header.pixelFormat.size = sizeof(PixelFormat);
+        header.pixelFormat.flags = DDPF_FOURCC;
+        header.pixelFormat.fourCC = MakeFourCC('D', 'X', '1', '0');
+
+        header10.dxgiFormat = (UINT32)desc.fmt;
+        header10.arraySize = desc.isCubemap ? desc.arraySize / 6 : desc.arraySize;
+
+        switch (desc.dimension)
         {
-            fclose(pFile);
-            return false;
+        case TextureDimension::Texture1D:
+            header10.resourceDimension = DDS_DIMENSION_TEXTURE1D;
+            break;
+
+        case TextureDimension::Texture2D:
+            header10.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+            header10.miscFlag = desc.isCubemap ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+            break;
+
+        case TextureDimension::Texture3D:
+            header10.resourceDimension = DDS_DIMENSION_TEXTURE3D;
+            break;
         }
     }
 
-    // Validate header
-    if (!ValidateFlags(header))
+    FILE* pFile = nullptr;
+    _wfopen_s(&pFile, filepath.c_str(), L"wb");
+    if (pFile == nullptr)
     {
-        fclose(pFile);
         return false;
     }
 
-    // Read pitch
-    desc.pitch = (header.flags & DDSD_PITCH) != 0 ? (UINT32)header.pitchOrLinearSize : 0;
+    ChunkWriter writer(pFile);
+    writer.Write(supercompress ? &SupercompressedSignature : &DDSSignature, sizeof(UINT32));
+    writer.Write(&header, sizeof(DDSHeader));
+    if (!isLegacy)
+    {
+        writer.Write(&header10, sizeof(DDS10Header));
+    }
 
-    // Read mipmap count
-    desc.mipmapsCount = (header.flags & DDSD_MIPMAPCOUNT) != 0 ? (UINT32)header.mipMapCount : 1;
+    // Payload loaded as a whole goes out in one piece, partially loaded textures are gathered
+    std::vector<SubresourceLayout> layout;
+    UINT64 dataSize = ComputeSubresourceLayout(desc.fmt, desc.width, desc.height, desc.depth, desc.arraySize,
+        desc.mipmapsCount, desc.mipmapsCount, layout);
 
-    if (singleMip)
+    bool isContiguous = desc.dataSize == dataSize;
+    for (size_t i = 0; i < layout.size() && isContiguous; i++)
     {
-        desc.mipmapsCount = 1;
+        isContiguous = desc.subresources[i].offset == layout[i].offset
+            && desc.subresources[i].rowPitch == layout[i].rowPitch
+            && desc.subresources[i].slicePitch == layout[i].slicePitch;
     }
 
-    // Read texture format
-    desc.fmt = GetTextureFormat(header);
-    if (desc.fmt == DXGI_FORMAT_UNKNOWN)
+    auto forEachRow = [&](const std::function<void(const UINT8*, size_t)>& func)
     {
-        fclose(pFile);
-        return false;
-    }
+        for (UINT32 i = 0; i < (UINT32)layout.size(); i++)
+        {
+            const SubresourceLayout& source = desc.subresources[i];
+            const UINT8* pSrc = reinterpret_cast<const UINT8*>(desc.GetSubresourceData(i));
 
-    // Setup image size
-    desc.width = header.width;
-    desc.height = header.height;
+            for (UINT32 z = 0; z < layout[i].depth; z++)
+            {
+                for (UINT32 row = 0; row < layout[i].blockRows; row++)
+                {
+                    func(pSrc + (size_t)z * source.slicePitch + (size_t)row * source.rowPitch, layout[i].rowPitch);
+                }
+            }
+        }
+    };
 
-    // Get data size
-    UINT32 dataSize = (header.flags & DDSD_LINEARSIZE) != 0 ? (UINT32)header.pitchOrLinearSize : 0;
-    if (dataSize == 0)
+    if (supercompress)
     {
-        long long curPos = _ftelli64(pFile);
-        fseek(pFile, 0, SEEK_END);
-        dataSize = (UINT32)(_ftelli64(pFile) - curPos);
-        fseek(pFile, (int)curPos, SEEK_SET);
+        // Chunks are cut from one contiguous copy of the payload
+        std::vector<UINT8> gathered;
+        const UINT8* pPayload = reinterpret_cast<const UINT8*>(desc.pData);
+        if (!isContiguous)
+        {
+            gathered.reserve((size_t)dataSize);
+            forEachRow([&](const UINT8* pRow, size_t size) { gathered.insert(gathered.end(), pRow, pRow + size); });
+            pPayload = gathered.data();
+        }
+
+        WriteSupercompressedPayload(writer, pPayload, (size_t)dataSize);
+    }
+    else if (isContiguous)
+    {
+        writer.Write(desc.pData, (size_t)dataSize);
     }
     else
     {
-        UINT32 levelSize = dataSize / 4;
-        // We have top level size - let's calculate the whole size
-        for (UINT32 i = 1; i < desc.mipmapsCount; i++)
+        forEachRow([&](const UINT8* pRow, size_t size) { writer.Write(pRow, size); });
+    }
+
+    bool isWritten = writer.Flush();
+    isWritten = fclose(pFile) == 0 && isWritten;
+
+    if (!isWritten)
+    {
+        _wremove(filepath.c_str());
+    }
+
+    return isWritten;
+}
+
+size_t LoadDDSBatch(const std::vector<DDSBatchItem>& items, const DDSBatchCallback& callback,
+    DDSLoadMode mode, ThreadPool* pPool)
+{
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    struct Result
+    {
+        size_t index;
+        bool success;
+        TextureDesc desc;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<Result> finished;
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(items.size());
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        futures.push_back(pPool->Submit([&, i]()
         {
-            dataSize += levelSize;
-            levelSize = std::max(16u, levelSize / 4); //   UINT32
-        }
+            Result result = { i, false, {} };
+
+            // Every item has to report back, the caller waits for all of them
+            try
+            {
+                result.success = items[i].generateMips
+                    ? LoadDDSWithMips(items[i].filepath, result.desc, mode, MipFilter::Kaiser, pPool)
+                    : LoadDDS(items[i].filepath, result.desc, items[i].singleMip, mode);
+
+                if (result.success && mode == DDSLoadMode::Mapped)
+                {
+                    TouchPages(result.desc);
+                }
+            }
+            catch (...)
+            {
+                result.success = false;
+                result.desc = TextureDesc();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.push_back(std::move(result));
+            }
+            condition.notify_one();
+        }));
     }
 
-    desc.pData = malloc(dataSize);
-    readSize = fread(desc.pData, 1, dataSize, pFile);
-    if (readSize != dataSize)
+    size_t loadedCount = 0;
+
+    for (size_t delivered = 0; delivered < items.size();)
     {
-        free(desc.pData);
-        desc.pData = nullptr;
-        fclose(pFile);
-        return false;
+        std::vector<Result> ready;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&]() { return !finished.empty(); });
+            ready.swap(finished);
+        }
+
+        for (Result& result : ready)
+        {
+            if (result.success)
+            {
+                loadedCount++;
+            }
+
+            callback(result.index, result.success, result.desc);
+            delivered++;
+        }
     }
 
-    fclose(pFile);
+    // Workers may still be leaving their jobs while touching the local state
+    for (std::future<void>& future : futures)
+    {
+        future.wait();
+    }
 
-    return true;
+    return loadedCount;
 }
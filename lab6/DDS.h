@@ -1,8 +1,44 @@
 #pragma once
 
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
+#ifdef _WIN32
 #include <dxgiformat.h>
+#else
+#include "PortablePlatform.h"
+#endif
+
+/** Where texel data of a loaded texture lives */
+enum class DDSLoadMode
+{
+    Copy,       ///< File is read into a heap buffer
+    Mapped      ///< Texels are referenced straight from a read-only file mapping
+};
+
+enum class TextureDimension
+{
+    Texture1D,
+    Texture2D,
+    Texture3D
+};
+
+/** Placement of one mip of one array slice inside the DDS payload */
+struct SubresourceLayout
+{
+    UINT64 offset = 0;          ///< Byte offset from the start of the payload
+    UINT32 rowPitch = 0;        ///< Bytes between rows (rows of 4x4 blocks for BC formats)
+    UINT32 slicePitch = 0;      ///< Bytes between depth slices of a 3D texture
+    UINT32 blockRows = 0;       ///< Number of rows (rows of 4x4 blocks for BC formats)
+
+    UINT32 width = 0;
+    UINT32 height = 0;
+    UINT32 depth = 0;
+};
 
 struct TextureDesc
 {
@@ -13,8 +49,104 @@ struct TextureDesc
 
     UINT32 width = 0;
     UINT32 height = 0;
+    UINT32 depth = 1;           ///< Depth of a 3D texture, 1 otherwise
+    UINT32 arraySize = 1;       ///< Number of 2D slices, 6 per cube for cubemaps
+
+    TextureDimension dimension = TextureDimension::Texture2D;
+    bool isCubemap = false;
+    bool isArray = false;       ///< Viewed as an array also with a single slice, as built texture arrays are
+
+    const void* pData = nullptr;    ///< Start of the payload
+    UINT64 dataOffset = 0;          ///< Payload offset in the file
+    UINT64 dataSize = 0;            ///< Exact payload size of all mips of all slices in the file
+    UINT64 sourceKey = 0;           ///< What a generated texture was built from, kept in reserved header words, 0 if unknown
+
+    /** One entry per loaded subresource, indexed as slice * mipmapsCount + mip */
+    std::vector<SubresourceLayout> subresources;
 
-    void* pData = nullptr;
+    const void* GetSubresourceData(UINT32 index) const
+    {
+        return reinterpret_cast<const UINT8*>(pData) + subresources[index].offset;
+    }
+
+    std::shared_ptr<const void> pStorage;   ///< Keeps pData alive, released with the last copy of the desc
+};
+
+bool LoadDDS(const std::wstring& filepath, TextureDesc& desc, bool singleMip = false, DDSLoadMode mode = DDSLoadMode::Copy);
+
+/**
+ * Loads mips [firstMip, firstMip + mipCount) of every slice, mipCount == 0 takes the
+ * rest of the chain. The desc describes a texture whose top level is firstMip. In
+ * Copy mode only the requested mips are read into a packed heap buffer.
+ */
+bool LoadDDSMips(const std::wstring& filepath, TextureDesc& desc, UINT32 firstMip, UINT32 mipCount = 0,
+    DDSLoadMode mode = DDSLoadMode::Copy);
+
+/**
+ * Writes the loaded subresources of the texture as a DDS file that LoadDDS reads back
+ * bit exact. Formats with a pre-DX10 description get the legacy header, the rest and
+ * texture arrays get the DX10 one. Data goes out in large chunks at aligned offsets.
+ * With supercompress the payload is stored as independently LZ compressed 64KB chunks
+ * under a "DDSZ" signature, which only LoadDDS understands; it decodes them in parallel.
+ */
+bool SaveDDS(const TextureDesc& desc, const std::wstring& filepath, bool supercompress = false);
+
+class ThreadPool;
+
+/** One file of a batched load */
+struct DDSBatchItem
+{
+    std::wstring filepath;
+    bool singleMip = false;
+    bool generateMips = false;      ///< Complete missing mips through LoadDDSWithMips, singleMip is ignored
 };
 
-bool LoadDDS(const std::wstring& filepath, TextureDesc& desc, bool singleMip = false);
+/** Receives the index of the finished item in the batch, desc is valid only if success is true */
+using DDSBatchCallback = std::function<void(size_t index, bool success, TextureDesc& desc)>;
+
+/**
+ * Reads and validates all files concurrently on the thread pool (the default one if
+ * pPool is nullptr). The callback is invoked on the calling thread in completion
+ * order, so it may safely create GPU resources. An item whose load throws, out of
+ * memory for one, is reported as failed. Returns the number of loaded files.
+ * Must not be called from a worker of the same pool.
+ */
+size_t LoadDDSBatch(const std::vector<DDSBatchItem>& items, const DDSBatchCallback& callback,
+    DDSLoadMode mode = DDSLoadMode::Copy, ThreadPool* pPool = nullptr);
+
+/**
+ * Computes placement of every mip of every slice as stored in a DDS payload.
+ * Only mipCount mips of each slice starting from firstMip are emitted, offsets
+ * still account for all fileMipCount mips. Returns the whole payload size, or 0 with
+ * an empty layout if a pitch does not fit in 32 bits or the payload is larger than
+ * maxSize, the bytes a file holds after its headers.
+ */
+UINT64 ComputeSubresourceLayout(DXGI_FORMAT fmt, UINT32 width, UINT32 height, UINT32 depth,
+    UINT32 arraySize, UINT32 fileMipCount, UINT32 mipCount, std::vector<SubresourceLayout>& layout,
+    UINT32 firstMip = 0, UINT64 maxSize = UINT64_MAX);
+
+/** Bits per texel of the format, 0 for unsupported formats */
+UINT32 GetBitsPerPixel(DXGI_FORMAT fmt);
+
+bool IsBlockCompressed(DXGI_FORMAT fmt);
+
+/** True for the _SRGB formats, their color channels are stored gamma encoded */
+bool IsSRGB(DXGI_FORMAT fmt);
+
+/**
+ * Returns the first row of subresource index, the bytes between its rows and between
+ * its depth slices
+ */
+using SubresourceRowsGetter = std::function<const void*(UINT32 index, UINT32& pitch, UINT32& slicePitch)>;
+
+/** Hash of the description ComputeTextureKey starts from, the texels left out */
+UINT64 ComputeTextureDescKey(const TextureDesc& desc);
+
+/**
+ * Content key TextureCache shares textures by: a hash of the description and of the
+ * rows of every depth slice of every subresource, padding between rows and slices
+ * skipped. Rows are read from the payload of the desc unless getRows points elsewhere.
+ * Costs a pass over all texels, so streamed data is keyed where it is loaded rather
+ * than where it is uploaded.
+ */
+UINT64 ComputeTextureKey(const TextureDesc& desc, const SubresourceRowsGetter& getRows = nullptr);
@@ -0,0 +1,78 @@
+#include "framework.h"
+
+#include "EmbeddedShaders.h"
+
+#include <string.h>
+
+// The table is generated into the intermediate directory by the ShaderEmbedder build
+// step, a build without it still works and compiles every shader at run time
+#if defined(__has_include)
+#if __has_include("EmbeddedShaderData.h")
+#include "EmbeddedShaderData.h"
+#define HAS_EMBEDDED_SHADERS
+#endif
+#endif
+
+namespace
+{
+
+#ifdef HAS_EMBEDDED_SHADERS
+    const EmbeddedShader* const Shaders = EmbeddedShaderTable;
+    const size_t ShaderCount = sizeof(EmbeddedShaderTable) / sizeof(EmbeddedShaderTable[0]);
+#else
+    const EmbeddedShader* const Shaders = nullptr;
+    const size_t ShaderCount = 0;
+#endif
+
+    bool IsSameDefines(const char* const* pEmbedded, const D3D_SHADER_MACRO* pDefines)
+    {
+        for (; pDefines != nullptr && pDefines->Name != nullptr; pDefines++, pEmbedded += 2)
+        {
+            const char* definition = pDefines->Definition != nullptr ? pDefines->Definition : "";
+            if (*pEmbedded == nullptr || strcmp(pEmbedded[0], pDefines->Name) != 0 || strcmp(pEmbedded[1], definition) != 0)
+            {
+                return false;
+            }
+        }
+
+        return *pEmbedded == nullptr;
+    }
+
+}
+
+bool FindEmbeddedShader(const ShaderCompileArgs& args, AssetView& bytecode, std::vector<std::wstring>* pDependencies)
+{
+    // A few dozen variants, a linear search costs less than building an index
+    for (size_t i = 0; i < ShaderCount; i++)
+    {
+        const EmbeddedShader& shader = Shaders[i];
+
+        if (shader.flags != args.flags || args.path != shader.path || args.entryPoint != shader.entryPoint
+            || args.profile != shader.profile || !IsSameDefines(shader.pDefines, args.pDefines))
+        {
+            continue;
+        }
+
+        bytecode.pData = shader.pBytecode;
+        bytecode.size = shader.size;
+        bytecode.pStorage = nullptr;
+
+        if (pDependencies != nullptr)
+        {
+            pDependencies->clear();
+            for (const wchar_t* const* pName = shader.pDependencies; *pName != nullptr; pName++)
+            {
+                pDependencies->push_back(*pName);
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+size_t GetEmbeddedShaderCount()
+{
+    return ShaderCount;
+}
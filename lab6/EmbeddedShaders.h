@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+
+/** Bytecode compiled at build time, entries of the table ShaderEmbedder generates */
+struct EmbeddedShader
+{
+    const wchar_t* path;
+    const char* entryPoint;
+    const char* profile;
+    UINT flags;
+    const char* const* pDefines;        ///< Name and definition pairs in the order they were passed, nullptr terminated
+    const UINT8* pBytecode;
+    size_t size;
+    const wchar_t* const* pDependencies;    ///< Source and included files, nullptr terminated
+};
+
+/**
+ * Finds the bytecode built for exactly these args (path, entry point, profile, flags
+ * and defines in the same order). No file is read, the data lives in the executable.
+ * pDependencies, if given, gets the files the shader was compiled from. Returns false
+ * if the build did not embed such a shader.
+ */
+bool FindEmbeddedShader(const ShaderCompileArgs& args, AssetView& bytecode,
+    std::vector<std::wstring>* pDependencies = nullptr);
+
+/** Number of shaders in the table, 0 if the executable was built without it */
+size_t GetEmbeddedShaderCount();
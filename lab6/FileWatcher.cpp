@@ -0,0 +1,206 @@
+#ifdef _WIN32
+#include "framework.h"
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <limits.h>
+#include <stdlib.h>
+#endif
+
+#include "FileWatcher.h"
+
+std::unique_ptr<FileWatcher> FileWatcher::Create(const std::wstring& directory)
+{
+    std::unique_ptr<FileWatcher> pWatcher(new FileWatcher());
+
+#ifdef _WIN32
+    HANDLE hDirectory = CreateFileW(directory.c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (hDirectory == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+    pWatcher->m_hDirectory = hDirectory;
+
+    pWatcher->m_hStopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (pWatcher->m_hStopEvent == nullptr)
+    {
+        return nullptr;
+    }
+#else
+    std::string path(directory.size() * MB_LEN_MAX + 1, '\0');
+    size_t length = wcstombs(&path[0], directory.c_str(), path.size());
+    if (length == (size_t)-1)
+    {
+        return nullptr;
+    }
+    path.resize(length);
+
+    pWatcher->m_notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (pWatcher->m_notifyFd < 0 || pipe(pWatcher->m_stopPipe) != 0)
+    {
+        return nullptr;
+    }
+
+    if (inotify_add_watch(pWatcher->m_notifyFd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0)
+    {
+        return nullptr;
+    }
+#endif
+
+    pWatcher->m_thread = std::thread(&FileWatcher::WatchLoop, pWatcher.get());
+
+    return pWatcher;
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef _WIN32
+    if (m_hStopEvent)
+    {
+        SetEvent((HANDLE)m_hStopEvent);
+    }
+#else
+    if (m_stopPipe[1] >= 0)
+    {
+        char stop = 0;
+        (void)write(m_stopPipe[1], &stop, 1);
+    }
+#endif
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+#ifdef _WIN32
+    if (m_hDirectory)
+    {
+        CloseHandle((HANDLE)m_hDirectory);
+    }
+
+    if (m_hStopEvent)
+    {
+        CloseHandle((HANDLE)m_hStopEvent);
+    }
+#else
+    for (int fd : { m_notifyFd, m_stopPipe[0], m_stopPipe[1] })
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+#endif
+}
+
+std::vector<std::wstring> FileWatcher::PollChanges()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<std::wstring> changes(m_changes.begin(), m_changes.end());
+    m_changes.clear();
+
+    return changes;
+}
+
+void FileWatcher::AddChange(const std::wstring& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changes.insert(name);
+}
+
+void FileWatcher::WatchLoop()
+{
+#ifdef _WIN32
+    // DWORD aligned as FILE_NOTIFY_INFORMATION requires
+    DWORD buffer[16 * 1024];
+
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (overlapped.hEvent == nullptr)
+    {
+        return;
+    }
+
+    HANDLE events[] = { overlapped.hEvent, (HANDLE)m_hStopEvent };
+
+    for (;;)
+    {
+        ResetEvent(overlapped.hEvent);
+
+        if (!ReadDirectoryChangesW((HANDLE)m_hDirectory, buffer, sizeof(buffer), TRUE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr))
+        {
+            break;
+        }
+
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            CancelIo((HANDLE)m_hDirectory);
+            WaitForSingleObject(overlapped.hEvent, INFINITE);
+            break;
+        }
+
+        DWORD size = 0;
+        if (!GetOverlappedResult((HANDLE)m_hDirectory, &overlapped, &size, FALSE))
+        {
+            break;
+        }
+
+        // Zero bytes means the buffer overflowed and the changes are lost, the next save reports again
+        const BYTE* pEntry = (const BYTE*)buffer;
+        while (size != 0)
+        {
+            const FILE_NOTIFY_INFORMATION* pInfo = (const FILE_NOTIFY_INFORMATION*)pEntry;
+
+            if (pInfo->Action == FILE_ACTION_MODIFIED || pInfo->Action == FILE_ACTION_ADDED
+                || pInfo->Action == FILE_ACTION_RENAMED_NEW_NAME)
+            {
+                AddChange(std::wstring(pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR)));
+            }
+
+            if (pInfo->NextEntryOffset == 0)
+            {
+                break;
+            }
+            pEntry += pInfo->NextEntryOffset;
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+#else
+    alignas(struct inotify_event) char buffer[16 * 1024];
+
+    for (;;)
+    {
+        pollfd fds[] = { { m_notifyFd, POLLIN, 0 }, { m_stopPipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN) != 0)
+        {
+            break;
+        }
+
+        ssize_t size = read(m_notifyFd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < size;)
+        {
+            const inotify_event* pEvent = reinterpret_cast<const inotify_event*>(buffer + offset);
+
+            if (pEvent->len != 0)
+            {
+                std::wstring name(pEvent->len, L'\0');
+                size_t length = mbstowcs(&name[0], pEvent->name, name.size());
+                if (length != (size_t)-1)
+                {
+                    name.resize(length);
+                    AddChange(name);
+                }
+            }
+
+            offset += sizeof(inotify_event) + pEvent->len;
+        }
+    }
+#endif
+}
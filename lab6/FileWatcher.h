@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Collects the names of files written, created or renamed into a directory on a
+ * background thread (ReadDirectoryChangesW on Windows, inotify elsewhere). Windows
+ * also reports subdirectories, inotify watches the directory itself only.
+ */
+class FileWatcher
+{
+public:
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /** Starts watching, returns nullptr if the directory can not be watched */
+    static std::unique_ptr<FileWatcher> Create(const std::wstring& directory);
+
+    /** Paths relative to the directory changed since the last call, each one once */
+    std::vector<std::wstring> PollChanges();
+
+private:
+    FileWatcher() = default;
+
+    void WatchLoop();
+    void AddChange(const std::wstring& name);
+
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+    std::set<std::wstring> m_changes;
+
+#ifdef _WIN32
+    void* m_hDirectory = nullptr;   ///< Directory HANDLE opened for overlapped reads
+    void* m_hStopEvent = nullptr;   ///< Event HANDLE set to end the watch thread
+#else
+    int m_notifyFd = -1;
+    int m_stopPipe[2] = { -1, -1 }; ///< Written to end the watch thread
+#endif
+};
@@ -0,0 +1,246 @@
+#include "LZCodec.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+    const size_t MinMatch = 4;
+    const size_t LastLiterals = 5;      ///< Block always ends with this many literals
+    const size_t MatchSearchLimit = 12; ///< No match starts this close to the end
+    const size_t MaxOffset = 65535;
+    const int HashBits = 14;
+
+    inline uint32_t Read32(const uint8_t* pData)
+    {
+        uint32_t value;
+        memcpy(&value, pData, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t HashSequence(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HashBits);
+    }
+
+    /** Writes the 255-run continuation of a length that did not fit into its nibble */
+    inline uint8_t* WriteLength(uint8_t* pDst, size_t length)
+    {
+        for (; length >= 255; length -= 255)
+        {
+            *pDst++ = 255;
+        }
+        *pDst++ = (uint8_t)length;
+        return pDst;
+    }
+
+    inline bool ReadLength(const uint8_t*& pSrc, const uint8_t* pSrcEnd, size_t& length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (pSrc == pSrcEnd)
+            {
+                return false;
+            }
+            byte = *pSrc++;
+            length += byte;
+        } while (byte == 255);
+
+        return true;
+    }
+
+    /** Emits literals [pLiterals, pLiterals + literalCount) and a match, matchLength 0 ends the block */
+    bool WriteSequence(uint8_t*& pDst, const uint8_t* pDstEnd, const uint8_t* pLiterals, size_t literalCount,
+        size_t offset, size_t matchLength)
+    {
+        // Token, literal run, worst case length bytes and the offset
+        size_t worstSize = 1 + literalCount + literalCount / 255 + 1 + 2 + matchLength / 255 + 1;
+        if ((size_t)(pDstEnd - pDst) < worstSize)
+        {
+            return false;
+        }
+
+        uint8_t* pToken = pDst++;
+        *pToken = (uint8_t)(std::min<size_t>(literalCount, 15) << 4);
+        if (literalCount >= 15)
+        {
+            pDst = WriteLength(pDst, literalCount - 15);
+        }
+
+        if (literalCount != 0)
+        {
+            memcpy(pDst, pLiterals, literalCount);
+            pDst += literalCount;
+        }
+
+        if (matchLength == 0)
+        {
+            return true;
+        }
+
+        *pDst++ = (uint8_t)(offset & 0xFF);
+        *pDst++ = (uint8_t)(offset >> 8);
+
+        size_t code = matchLength - MinMatch;
+        *pToken |= (uint8_t)std::min<size_t>(code, 15);
+        if (code >= 15)
+        {
+            pDst = WriteLength(pDst, code - 15);
+        }
+
+        return true;
+    }
+
+}
+
+size_t LZCompressBound(size_t srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t LZCompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity)
+{
+    const uint8_t* pBase = reinterpret_cast<const uint8_t*>(pSrc);
+    uint8_t* pOut = reinterpret_cast<uint8_t*>(pDst);
+    const uint8_t* pOutEnd = pOut + dstCapacity;
+
+    size_t anchor = 0;
+
+    if (srcSize > MatchSearchLimit)
+    {
+        // Positions are stored + 1 so that zero marks an empty slot
+        std::vector<uint32_t> table((size_t)1 << HashBits, 0);
+
+        const size_t searchEnd = srcSize - MatchSearchLimit;
+        const size_t matchEnd = srcSize - LastLiterals;
+
+        size_t pos = 0;
+        while (pos < searchEnd)
+        {
+            uint32_t sequence = Read32(pBase + pos);
+            uint32_t& slot = table[HashSequence(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)(pos + 1);
+
+            if (candidate == 0 || pos - (candidate - 1) > MaxOffset || Read32(pBase + candidate - 1) != sequence)
+            {
+                // Skip faster through data that keeps failing to match
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+            candidate--;
+
+            size_t length = MinMatch;
+            while (pos + length < matchEnd && pBase[candidate + length] == pBase[pos + length])
+            {
+                length++;
+            }
+
+            if (!WriteSequence(pOut, pOutEnd, pBase + anchor, pos - anchor, pos - candidate, length))
+            {
+                return 0;
+            }
+
+            pos += length;
+            anchor = pos;
+        }
+    }
+
+    if (!WriteSequence(pOut, pOutEnd, pBase + anchor, srcSize - anchor, 0, 0))
+    {
+        return 0;
+    }
+
+    return (size_t)(pOut - reinterpret_cast<uint8_t*>(pDst));
+}
+
+bool LZDecompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize)
+{
+    const uint8_t* pIn = reinterpret_cast<const uint8_t*>(pSrc);
+    const uint8_t* pInEnd = pIn + srcSize;
+    uint8_t* pBase = reinterpret_cast<uint8_t*>(pDst);
+    uint8_t* pOut = pBase;
+    uint8_t* pOutEnd = pBase + dstSize;
+
+    while (pIn < pInEnd)
+    {
+        uint8_t token = *pIn++;
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !ReadLength(pIn, pInEnd, literalCount))
+        {
+            return false;
+        }
+
+        if ((size_t)(pInEnd - pIn) < literalCount || (size_t)(pOutEnd - pOut) < literalCount)
+        {
+            return false;
+        }
+        if (literalCount != 0)
+        {
+            memcpy(pOut, pIn, literalCount);
+            pIn += literalCount;
+            pOut += literalCount;
+        }
+
+        // Only the last sequence has no match
+        if (pIn == pInEnd)
+        {
+            break;
+        }
+
+        if (pInEnd - pIn < 2)
+        {
+            return false;
+        }
+        size_t offset = (size_t)pIn[0] | ((size_t)pIn[1] << 8);
+        pIn += 2;
+
+        size_t matchLength = token & 0x0F;
+        if (matchLength == 15 && !ReadLength(pIn, pInEnd, matchLength))
+        {
+            return false;
+        }
+        matchLength += MinMatch;
+
+        if (offset == 0 || offset > (size_t)(pOut - pBase) || (size_t)(pOutEnd - pOut) < matchLength)
+        {
+            return false;
+        }
+
+        const uint8_t* pMatch = pOut - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(pOut, pMatch, matchLength);
+            pOut += matchLength;
+        }
+        else if (offset >= 8)
+        {
+            // Overlapping copy in steps that never read bytes not yet written
+            uint8_t* pEnd = pOut + matchLength;
+            while (pOut + 8 <= pEnd)
+            {
+                memcpy(pOut, pMatch, 8);
+                pOut += 8;
+                pMatch += 8;
+            }
+            while (pOut < pEnd)
+            {
+                *pOut++ = *pMatch++;
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; i++)
+            {
+                *pOut++ = *pMatch++;
+            }
+        }
+    }
+
+    return pOut == pOutEnd;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Byte-level LZ77 codec with an LZ4-like sequence layout: a token with literal and
+ * match lengths, the literals, then a 16-bit match offset. Blocks are independent,
+ * so large data is meant to be split into chunks that can be decoded in parallel.
+ */
+
+/** Largest compressed size of srcSize bytes, incompressible data grows slightly */
+size_t LZCompressBound(size_t srcSize);
+
+/** Returns the compressed size, 0 if the result does not fit into dstCapacity */
+size_t LZCompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity);
+
+/** Decodes a block that must expand to exactly dstSize bytes, false on malformed input */
+bool LZDecompress(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize);
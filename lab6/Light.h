@@ -10,15 +10,37 @@ cbuffer SceneBuffer : register (b0)
     float4 cameraPos;
     float4 lightCount;
     Light lights[10];
-    float4 ambientColor;
+    float4 ambientSH[9];
 };
 
+// Irradiance of the environment over pi for a unit normal, see SHIrradiance
+float3 EvaluateAmbient(in float3 n)
+{
+    return ambientSH[0].xyz
+        + ambientSH[1].xyz * n.y + ambientSH[2].xyz * n.z + ambientSH[3].xyz * n.x
+        + ambientSH[4].xyz * (n.x * n.y) + ambientSH[5].xyz * (n.y * n.z)
+        + ambientSH[6].xyz * (3.0 * n.z * n.z - 1.0)
+        + ambientSH[7].xyz * (n.x * n.z) + ambientSH[8].xyz * (n.x * n.x - n.y * n.y);
+}
+
+
+// Variants are compiled per ShaderPermutation: NUM_LIGHTS unrolls the loop for a fixed
+// light count, SPECULAR adds the highlight and TRANSLUCENT lights the back side
+#ifdef NUM_LIGHTS
+#define LIGHT_LOOP [unroll] for (int i = 0; i < NUM_LIGHTS; i++)
+#else
+#define LIGHT_LOOP [loop] for (int i = 0; i < lightCount.x; i++)
+#endif
 
-float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in float shine, in bool trans)
+float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in float shine)
 {
-    float3 finalColor = float3(0, 0, 0);
+    float3 finalColor = objColor * max(EvaluateAmbient(normalize(objNormal)), 0.0);
 
-    for (int i = 0; i < lightCount.x; i++)
+#ifdef SPECULAR
+    float3 viewDir = normalize(cameraPos.xyz - pos);
+#endif
+
+    LIGHT_LOOP
     {
         float3 normal = objNormal;
 
@@ -28,19 +50,18 @@ float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in
 
         float atten = clamp(1.0 / (lightDist * lightDist), 0, 1);
 
-        if (trans && dot(lightDir, objNormal) < 0.0)
-        {
-            normal = -normal;
-        }
+#ifdef TRANSLUCENT
+        normal = dot(lightDir, objNormal) < 0.0 ? -normal : normal;
+#endif
 
         finalColor += objColor * max(dot(lightDir, normal), 0) * atten * lights[i].color.xyz;
 
-        float3 viewDir = normalize(cameraPos.xyz - pos);
+#ifdef SPECULAR
         float3 reflectDir = reflect(-lightDir, normal);
-
-        float spec = shine > 0 ? pow(max(dot(viewDir, reflectDir), 0.0), shine) : 0.0;
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), shine);
 
         finalColor += objColor * 0.5 * spec * lights[i].color.xyz;
+#endif
     }
 
     return finalColor;
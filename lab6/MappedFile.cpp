@@ -0,0 +1,123 @@
+#include "framework.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.h"
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::wstring& filepath)
+{
+    std::shared_ptr<MappedFile> pFile(new MappedFile());
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return nullptr;
+    }
+    pFile->m_hFile = hFile;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+    {
+        return nullptr;
+    }
+
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (hMapping == nullptr)
+    {
+        return nullptr;
+    }
+    pFile->m_hMapping = hMapping;
+
+    const void* pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (pView == nullptr)
+    {
+        return nullptr;
+    }
+
+    pFile->m_pData = reinterpret_cast<const uint8_t*>(pView);
+    pFile->m_size = (size_t)size.QuadPart;
+#else
+    int fd = open(ToNarrowPath(filepath).c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    void* pView = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (pView == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    pFile->m_pData = reinterpret_cast<const uint8_t*>(pView);
+    pFile->m_size = (size_t)st.st_size;
+#endif
+
+    return pFile;
+}
+
+bool MappedFile::GetStamp(const std::wstring& filepath, FileStamp& stamp)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data = {};
+    if (!GetFileAttributesExW(filepath.c_str(), GetFileExInfoStandard, &data))
+    {
+        return false;
+    }
+
+    stamp.writeTime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+    stamp.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+    struct stat st = {};
+    if (stat(ToNarrowPath(filepath).c_str(), &st) != 0)
+    {
+        return false;
+    }
+
+    stamp.writeTime = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+    stamp.size = (uint64_t)st.st_size;
+#endif
+
+    return true;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+
+    if (m_hMapping)
+    {
+        CloseHandle((HANDLE)m_hMapping);
+    }
+
+    if (m_hFile)
+    {
+        CloseHandle((HANDLE)m_hFile);
+    }
+#else
+    if (m_pData)
+    {
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+    }
+#endif
+}
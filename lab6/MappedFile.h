@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+/** Last write time and size of a file, a different stamp means the file was changed */
+struct FileStamp
+{
+    uint64_t writeTime = 0;     ///< FILETIME on Windows, nanoseconds since the epoch elsewhere
+    uint64_t size = 0;
+
+    bool operator==(const FileStamp& other) const { return writeTime == other.writeTime && size == other.size; }
+    bool operator!=(const FileStamp& other) const { return !(*this == other); }
+};
+
+/** Read-only view of a whole file mapped into the address space */
+class MappedFile
+{
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** Maps the file, returns nullptr if it can not be opened or is empty */
+    static std::shared_ptr<MappedFile> Open(const std::wstring& filepath);
+
+    /** Reads the stamp without opening the file, false if there is no such file */
+    static bool GetStamp(const std::wstring& filepath, FileStamp& stamp);
+
+    const uint8_t* GetData() const { return m_pData; }
+    size_t GetSize() const { return m_size; }
+
+private:
+    MappedFile() = default;
+
+    const uint8_t* m_pData = nullptr;
+    size_t m_size = 0;
+
+#ifdef _WIN32
+    void* m_hFile = nullptr;        ///< File HANDLE
+    void* m_hMapping = nullptr;     ///< File mapping HANDLE
+#endif
+};
@@ -0,0 +1,702 @@
+#include "framework.h"
+
+#include "MipGenerator.h"
+#include "BCDecoder.h"
+#include "BCEncoder.h"
+#include "ContentHash.h"
+#include "AssetPak.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <functional>
+
+// SSE2 is the baseline of every x86 target, so no runtime dispatch is needed here
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MIP_GENERATOR_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+    const float Pi = 3.14159265358979f;
+
+    const float KaiserWidth = 3.0f;     ///< Filter radius in destination texels
+    const float KaiserAlpha = 4.0f;     ///< Window shape, higher values trade sharpness for less ringing
+
+    const UINT32 LinearToSRGBTableSize = 8192;
+
+    const UINT32 MipCacheSignature = 0x4350494D;    ///< "MIPC"
+    const UINT32 MipCacheVersion = 1;
+
+#pragma pack(push)
+#pragma pack(1)
+
+    /** Header of a <file>.mips cache entry, the payload follows in DDS layout */
+    struct MipCacheHeader
+    {
+        UINT32 signature;
+        UINT32 version;
+        UINT64 sourceHash;      ///< Hash of the source payload the chain was built from
+        UINT32 filter;
+        UINT32 fmt;
+        UINT32 width;
+        UINT32 height;
+        UINT32 arraySize;
+        UINT32 mipCount;
+        UINT64 dataSize;
+    };
+
+#pragma pack(pop)
+
+    /** Receives every generated level as tightly packed RGBA8, returns false to stop */
+    typedef std::function<bool(UINT32 level, const UINT8* pRGBA, UINT32 width, UINT32 height)> MipSink;
+
+    /** Linear RGBA image with one float4 per texel */
+    struct FloatImage
+    {
+        UINT32 width = 0;
+        UINT32 height = 0;
+        std::vector<float> texels;
+
+        void Resize(UINT32 newWidth, UINT32 newHeight)
+        {
+            width = newWidth;
+            height = newHeight;
+            texels.resize((size_t)width * height * 4);
+        }
+
+        float* GetRow(UINT32 y) { return texels.data() + (size_t)y * width * 4; }
+        const float* GetRow(UINT32 y) const { return texels.data() + (size_t)y * width * 4; }
+    };
+
+    /** Source texels and weights of every destination texel along one axis */
+    struct FilterKernel
+    {
+        std::vector<UINT32> firstTap;   ///< First tap of each destination texel, one extra entry marks the end
+        std::vector<UINT32> indices;    ///< Source texel of each tap, clamped to the image
+        std::vector<float> weights;     ///< Weight of each tap, taps of a texel sum up to 1
+    };
+
+#ifdef MIP_GENERATOR_SSE
+    typedef __m128 Texel;
+
+    inline Texel LoadTexel(const float* pTexel) { return _mm_loadu_ps(pTexel); }
+    inline void StoreTexel(float* pTexel, Texel value) { _mm_storeu_ps(pTexel, value); }
+    inline Texel ZeroTexel() { return _mm_setzero_ps(); }
+
+    inline Texel MulAdd(Texel sum, Texel value, float weight)
+    {
+        return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight)));
+    }
+
+    /** Saturates, scales to [0, 255] and rounds one texel */
+    inline __m128i QuantizeTexel(const float* pTexel)
+    {
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(pTexel), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    }
+#else
+    struct Texel
+    {
+        float c[4];
+    };
+
+    inline Texel LoadTexel(const float* pTexel) { return { { pTexel[0], pTexel[1], pTexel[2], pTexel[3] } }; }
+    inline void StoreTexel(float* pTexel, Texel value) { memcpy(pTexel, value.c, sizeof(value.c)); }
+    inline Texel ZeroTexel() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+
+    inline Texel MulAdd(Texel sum, Texel value, float weight)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            sum.c[i] += value.c[i] * weight;
+        }
+        return sum;
+    }
+#endif
+
+    inline float Saturate(float value)
+    {
+        return std::min(std::max(value, 0.0f), 1.0f);
+    }
+
+    inline UINT8 QuantizeUNorm(float value)
+    {
+        return (UINT8)(Saturate(value) * 255.0f + 0.5f);
+    }
+
+    const float* GetUNormToFloatTable()
+    {
+        static const std::vector<float> Table = []()
+        {
+            std::vector<float> table(256);
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                table[i] = (float)i / 255.0f;
+            }
+            return table;
+        }();
+
+        return Table.data();
+    }
+
+    const float* GetSRGBToLinearTable()
+    {
+        static const std::vector<float> Table = []()
+        {
+            std::vector<float> table(256);
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                float value = (float)i / 255.0f;
+                table[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+
+        return Table.data();
+    }
+
+    /** Maps linear values quantized to LinearToSRGBTableSize steps to 8-bit sRGB */
+    const UINT8* GetLinearToSRGBTable()
+    {
+        static const std::vector<UINT8> Table = []()
+        {
+            std::vector<UINT8> table(LinearToSRGBTableSize);
+            for (UINT32 i = 0; i < LinearToSRGBTableSize; i++)
+            {
+                float value = (float)i / (float)(LinearToSRGBTableSize - 1);
+                value = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+                table[i] = QuantizeUNorm(value);
+            }
+            return table;
+        }();
+
+        return Table.data();
+    }
+
+    float BesselI0(float x)
+    {
+        // Power series, converges in a few terms for the arguments of the window
+        const float quarterSquare = x * x * 0.25f;
+
+        float sum = 1.0f;
+        float term = 1.0f;
+        for (int k = 1; k < 32 && term > sum * 1e-7f; k++)
+        {
+            term *= quarterSquare / (float)(k * k);
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    float Sinc(float x)
+    {
+        x *= Pi;
+        return fabsf(x) < 1e-4f ? 1.0f : sinf(x) / x;
+    }
+
+    /** t is the distance from the destination texel center in destination texels */
+    float KaiserWindowedSinc(float t)
+    {
+        if (fabsf(t) >= KaiserWidth)
+        {
+            return 0.0f;
+        }
+
+        const float r = t / KaiserWidth;
+        return Sinc(t) * BesselI0(KaiserAlpha * sqrtf(1.0f - r * r)) / BesselI0(KaiserAlpha);
+    }
+
+    FilterKernel BuildKernel(UINT32 srcSize, UINT32 dstSize, MipFilter filter)
+    {
+        FilterKernel kernel;
+        kernel.firstTap.reserve(dstSize + 1);
+
+        const float scale = (float)srcSize / (float)dstSize;
+        const float radius = filter == MipFilter::Box ? scale * 0.5f : KaiserWidth * scale;
+
+        for (UINT32 x = 0; x < dstSize; x++)
+        {
+            kernel.firstTap.push_back((UINT32)kernel.indices.size());
+
+            // Axis that is already 1 texel wide is passed through
+            if (srcSize == dstSize)
+            {
+                kernel.indices.push_back(x);
+                kernel.weights.push_back(1.0f);
+                continue;
+            }
+
+            const float center = ((float)x + 0.5f) * scale;
+            const int first = (int)floorf(center - radius);
+            const int last = (int)ceilf(center + radius);
+
+            const size_t start = kernel.weights.size();
+            float sum = 0.0f;
+
+            for (int i = first; i <= last; i++)
+            {
+                float weight;
+                if (filter == MipFilter::Box)
+                {
+                    // Part of the texel covered by the footprint, negative outside of it
+                    weight = std::min(center + radius, (float)(i + 1)) - std::max(center - radius, (float)i);
+                    if (weight <= 0.0f)
+                    {
+                        continue;
+                    }
+                }
+                else
+                {
+                    // Sinc lobes are negative, only exact zeros are dropped
+                    weight = KaiserWindowedSinc(((float)i + 0.5f - center) / scale);
+                    if (weight == 0.0f)
+                    {
+                        continue;
+                    }
+                }
+
+                kernel.indices.push_back((UINT32)std::min(std::max(i, 0), (int)srcSize - 1));
+                kernel.weights.push_back(weight);
+                sum += weight;
+            }
+
+            for (size_t i = start; i < kernel.weights.size(); i++)
+            {
+                kernel.weights[i] /= sum;
+            }
+        }
+
+        kernel.firstTap.push_back((UINT32)kernel.indices.size());
+
+        return kernel;
+    }
+
+    /** Resamples every row of the source to the destination width */
+    void FilterRows(const FloatImage& src, const FilterKernel& kernel, FloatImage& dst, ThreadPool& pool)
+    {
+        pool.ParallelFor(src.height, [&](uint32_t y)
+        {
+            const float* pSrc = src.GetRow(y);
+            float* pDst = dst.GetRow(y);
+
+            for (UINT32 x = 0; x < dst.width; x++)
+            {
+                Texel sum = ZeroTexel();
+                for (UINT32 tap = kernel.firstTap[x]; tap < kernel.firstTap[x + 1]; tap++)
+                {
+                    sum = MulAdd(sum, LoadTexel(pSrc + (size_t)kernel.indices[tap] * 4), kernel.weights[tap]);
+                }
+                StoreTexel(pDst + (size_t)x * 4, sum);
+            }
+        });
+    }
+
+    /** Resamples every column of the source to the destination height */
+    void FilterColumns(const FloatImage& src, const FilterKernel& kernel, FloatImage& dst, ThreadPool& pool)
+    {
+        pool.ParallelFor(dst.height, [&](uint32_t y)
+        {
+            float* pDst = dst.GetRow(y);
+
+            // Whole source rows are accumulated tap by tap, so the inner loop streams through memory
+            for (UINT32 tap = kernel.firstTap[y]; tap < kernel.firstTap[y + 1]; tap++)
+            {
+                const float* pSrc = src.GetRow(kernel.indices[tap]);
+                const float weight = kernel.weights[tap];
+                const bool isFirst = tap == kernel.firstTap[y];
+
+                for (UINT32 x = 0; x < dst.width; x++)
+                {
+                    Texel sum = isFirst ? ZeroTexel() : LoadTexel(pDst + (size_t)x * 4);
+                    StoreTexel(pDst + (size_t)x * 4, MulAdd(sum, LoadTexel(pSrc + (size_t)x * 4), weight));
+                }
+            }
+        });
+    }
+
+    void ConvertToFloat(const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 rowPitch, bool isSRGB,
+        FloatImage& image, ThreadPool& pool)
+    {
+        image.Resize(width, height);
+
+        const float* pAlphaTable = GetUNormToFloatTable();
+        const float* pColorTable = isSRGB ? GetSRGBToLinearTable() : pAlphaTable;
+
+        pool.ParallelFor(height, [&](uint32_t y)
+        {
+            const UINT8* pSrc = pRGBA + (size_t)y * rowPitch;
+            float* pDst = image.GetRow(y);
+
+            for (UINT32 i = 0; i < width * 4; i += 4)
+            {
+                pDst[i + 0] = pColorTable[pSrc[i + 0]];
+                pDst[i + 1] = pColorTable[pSrc[i + 1]];
+                pDst[i + 2] = pColorTable[pSrc[i + 2]];
+                pDst[i + 3] = pAlphaTable[pSrc[i + 3]];
+            }
+        });
+    }
+
+    void ConvertToRGBA8(const FloatImage& image, bool isSRGB, std::vector<UINT8>& rgba, ThreadPool& pool)
+    {
+        rgba.resize((size_t)image.width * image.height * 4);
+
+        pool.ParallelFor(image.height, [&](uint32_t y)
+        {
+            const float* pSrc = image.GetRow(y);
+            UINT8* pDst = rgba.data() + (size_t)y * image.width * 4;
+
+            if (isSRGB)
+            {
+                const UINT8* pTable = GetLinearToSRGBTable();
+                for (UINT32 i = 0; i < image.width * 4; i += 4)
+                {
+                    for (UINT32 c = 0; c < 3; c++)
+                    {
+                        pDst[i + c] = pTable[(UINT32)(Saturate(pSrc[i + c]) * (float)(LinearToSRGBTableSize - 1) + 0.5f)];
+                    }
+                    pDst[i + 3] = QuantizeUNorm(pSrc[i + 3]);
+                }
+                return;
+            }
+
+            UINT32 x = 0;
+
+#ifdef MIP_GENERATOR_SSE
+            for (; x + 4 <= image.width; x += 4)
+            {
+                const float* pTexels = pSrc + (size_t)x * 4;
+                __m128i low = _mm_packs_epi32(QuantizeTexel(pTexels), QuantizeTexel(pTexels + 4));
+                __m128i high = _mm_packs_epi32(QuantizeTexel(pTexels + 8), QuantizeTexel(pTexels + 12));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + (size_t)x * 4), _mm_packus_epi16(low, high));
+            }
+#endif
+
+            for (UINT32 i = x * 4; i < image.width * 4; i++)
+            {
+                pDst[i] = QuantizeUNorm(pSrc[i]);
+            }
+        });
+    }
+
+    /** Filters levels 1..levelCount-1 from the RGBA8 top level and passes each of them to the sink */
+    bool BuildMips(const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 rowPitch, bool isSRGB,
+        MipFilter filter, UINT32 levelCount, ThreadPool& pool, const MipSink& sink)
+    {
+        FloatImage current, rows, next;
+        ConvertToFloat(pRGBA, width, height, rowPitch, isSRGB, current, pool);
+
+        std::vector<UINT8> rgba;
+
+        for (UINT32 level = 1; level < levelCount; level++)
+        {
+            const UINT32 nextWidth = std::max(1u, current.width / 2);
+            const UINT32 nextHeight = std::max(1u, current.height / 2);
+
+            // Separable filter, rows first and then columns of the narrowed image
+            rows.Resize(nextWidth, current.height);
+            FilterRows(current, BuildKernel(current.width, nextWidth, filter), rows, pool);
+
+            next.Resize(nextWidth, nextHeight);
+            FilterColumns(rows, BuildKernel(current.height, nextHeight, filter), next, pool);
+
+            ConvertToRGBA8(next, isSRGB, rgba, pool);
+            if (!sink(level, rgba.data(), nextWidth, nextHeight))
+            {
+                return false;
+            }
+
+            std::swap(current, next);
+        }
+
+        return true;
+    }
+
+    bool CanGenerateMips(const TextureDesc& desc)
+    {
+        return desc.dimension == TextureDimension::Texture2D && desc.depth == 1 && desc.mipmapsCount != 0
+            && desc.pData != nullptr && IsMipGenerationSupported(desc.fmt);
+    }
+
+    bool LoadMipCache(const std::wstring& cachePath, const TextureDesc& source, UINT64 sourceHash, MipFilter filter,
+        TextureDesc& desc)
+    {
+        // Packed caches ship in the archive next to their textures
+        AssetView file;
+        if (!OpenAsset(cachePath, file) || file.size < sizeof(MipCacheHeader))
+        {
+            return false;
+        }
+
+        MipCacheHeader header;
+        memcpy(&header, file.pData, sizeof(MipCacheHeader));
+
+        const UINT32 mipCount = GetFullMipCount(source.width, source.height);
+
+        // Any mismatch means the source or the generator changed since the entry was written
+        if (header.signature != MipCacheSignature || header.version != MipCacheVersion
+            || header.sourceHash != sourceHash || header.filter != (UINT32)filter
+            || header.fmt != (UINT32)source.fmt || header.width != source.width || header.height != source.height
+            || header.arraySize != source.arraySize || header.mipCount != mipCount)
+        {
+            return false;
+        }
+
+        std::vector<SubresourceLayout> layout;
+        UINT64 dataSize = ComputeSubresourceLayout(source.fmt, source.width, source.height, 1, source.arraySize,
+            mipCount, mipCount, layout);
+
+        if (header.dataSize != dataSize || file.size - sizeof(MipCacheHeader) < dataSize)
+        {
+            return false;
+        }
+
+        desc = source;
+        desc.mipmapsCount = mipCount;
+        desc.subresources = std::move(layout);
+        desc.pData = file.pData + sizeof(MipCacheHeader);
+        desc.dataOffset = sizeof(MipCacheHeader);
+        desc.dataSize = dataSize;
+        desc.pStorage = file.pStorage;
+
+        return true;
+    }
+
+    bool SaveMipCache(const std::wstring& cachePath, const TextureDesc& desc, UINT64 sourceHash, MipFilter filter)
+    {
+        MipCacheHeader header = {};
+        header.signature = MipCacheSignature;
+        header.version = MipCacheVersion;
+        header.sourceHash = sourceHash;
+        header.filter = (UINT32)filter;
+        header.fmt = (UINT32)desc.fmt;
+        header.width = desc.width;
+        header.height = desc.height;
+        header.arraySize = desc.arraySize;
+        header.mipCount = desc.mipmapsCount;
+        header.dataSize = desc.dataSize;
+
+        return WriteFileReplacing(cachePath, [&](FILE* pFile)
+        {
+            return fwrite(&header, sizeof(MipCacheHeader), 1, pFile) == 1
+                && fwrite(desc.pData, 1, (size_t)desc.dataSize, pFile) == desc.dataSize;
+        });
+    }
+
+}
+
+UINT32 GetFullMipCount(UINT32 width, UINT32 height)
+{
+    UINT32 count = 1;
+    while (width > 1 || height > 1)
+    {
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        count++;
+    }
+
+    return count;
+}
+
+bool IsMipGenerationSupported(DXGI_FORMAT fmt)
+{
+    switch (fmt)
+    {
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+        return true;
+
+    default:
+        break;
+    }
+
+    return IsBCDecodeSupported(fmt) && IsBCEncodeSupported(fmt);
+}
+
+bool GenerateMipChain(const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 rowPitch, bool isSRGB,
+    MipFilter filter, std::vector<std::vector<UINT8>>& levels, ThreadPool* pPool)
+{
+    if (pRGBA == nullptr || width == 0 || height == 0)
+    {
+        return false;
+    }
+
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    const UINT32 levelCount = GetFullMipCount(width, height);
+
+    levels.clear();
+    levels.resize(levelCount - 1);
+
+    return BuildMips(pRGBA, width, height, rowPitch, isSRGB, filter, levelCount, *pPool,
+        [&](UINT32 level, const UINT8* pLevel, UINT32 levelWidth, UINT32 levelHeight)
+        {
+            levels[level - 1].assign(pLevel, pLevel + (size_t)levelWidth * levelHeight * 4);
+            return true;
+        });
+}
+
+bool GenerateMips(const TextureDesc& source, TextureDesc& result, MipFilter filter, ThreadPool* pPool)
+{
+    if (!CanGenerateMips(source))
+    {
+        return false;
+    }
+
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    const UINT32 sourceMips = source.mipmapsCount;
+    const UINT32 mipCount = GetFullMipCount(source.width, source.height);
+    if (sourceMips >= mipCount)
+    {
+        result = source;
+        return true;
+    }
+
+    std::vector<SubresourceLayout> layout;
+    const UINT64 dataSize = ComputeSubresourceLayout(source.fmt, source.width, source.height, 1, source.arraySize,
+        mipCount, mipCount, layout);
+
+    std::shared_ptr<UINT8> pBuffer((UINT8*)malloc((size_t)dataSize), free);
+    if (pBuffer == nullptr)
+    {
+        return false;
+    }
+
+    const bool isCompressed = IsBlockCompressed(source.fmt);
+    const bool isSRGB = IsSRGB(source.fmt);
+
+    std::atomic<bool> isFailed(false);
+
+    // Slices are independent, each of them also spreads its rows and blocks over the pool
+    pPool->ParallelFor(source.arraySize, [&](uint32_t slice)
+    {
+        // Mips present in the source are kept bit exact
+        for (UINT32 mip = 0; mip < sourceMips; mip++)
+        {
+            const UINT32 sourceIndex = slice * sourceMips + mip;
+            const SubresourceLayout& sourceLayout = source.subresources[sourceIndex];
+            const SubresourceLayout& targetLayout = layout[slice * mipCount + mip];
+
+            const UINT8* pSrc = reinterpret_cast<const UINT8*>(source.GetSubresourceData(sourceIndex));
+            UINT8* pDst = pBuffer.get() + targetLayout.offset;
+
+            for (UINT32 row = 0; row < targetLayout.blockRows; row++)
+            {
+                memcpy(pDst + (size_t)row * targetLayout.rowPitch, pSrc + (size_t)row * sourceLayout.rowPitch,
+                    targetLayout.rowPitch);
+            }
+        }
+
+        const UINT32 topIndex = slice * sourceMips + sourceMips - 1;
+        const SubresourceLayout& top = source.subresources[topIndex];
+
+        const UINT8* pTop = reinterpret_cast<const UINT8*>(source.GetSubresourceData(topIndex));
+        UINT32 topPitch = top.rowPitch;
+
+        std::vector<UINT8> decoded;
+        if (isCompressed)
+        {
+            if (!DecodeSubresource(source, topIndex, decoded, pPool))
+            {
+                isFailed = true;
+                return;
+            }
+
+            pTop = decoded.data();
+            topPitch = top.width * 4;
+        }
+
+        bool isBuilt = BuildMips(pTop, top.width, top.height, topPitch, isSRGB, filter, mipCount - sourceMips + 1,
+            *pPool, [&](UINT32 level, const UINT8* pRGBA, UINT32 width, UINT32 height)
+            {
+                const SubresourceLayout& targetLayout = layout[slice * mipCount + sourceMips - 1 + level];
+                UINT8* pDst = pBuffer.get() + targetLayout.offset;
+
+                if (isCompressed)
+                {
+                    return EncodeBC(source.fmt, pRGBA, width, height, width * 4, pDst, targetLayout.rowPitch,
+                        BCQuality::Normal, pPool);
+                }
+
+                for (UINT32 y = 0; y < height; y++)
+                {
+                    memcpy(pDst + (size_t)y * targetLayout.rowPitch, pRGBA + (size_t)y * width * 4, width * 4);
+                }
+                return true;
+            });
+
+        if (!isBuilt)
+        {
+            isFailed = true;
+        }
+    });
+
+    if (isFailed)
+    {
+        return false;
+    }
+
+    result = source;
+    result.mipmapsCount = mipCount;
+    result.subresources = std::move(layout);
+    result.pData = pBuffer.get();
+    result.dataOffset = 0;
+    result.dataSize = dataSize;
+    result.pStorage = pBuffer;
+
+    return true;
+}
+
+bool LoadDDSWithMips(const std::wstring& filepath, TextureDesc& desc, DDSLoadMode mode, MipFilter filter,
+    ThreadPool* pPool)
+{
+    TextureDesc source;
+    if (!LoadDDS(filepath, source, false, mode))
+    {
+        return false;
+    }
+
+    if (!CanGenerateMips(source) || source.mipmapsCount >= GetFullMipCount(source.width, source.height))
+    {
+        desc = std::move(source);
+        return true;
+    }
+
+    const std::wstring cachePath = filepath + L".mips";
+    const UINT64 sourceHash = ComputeContentHash(source.pData, (size_t)source.dataSize);
+
+    // Cached chains are always mapped, the texels are only read once for upload
+    if (LoadMipCache(cachePath, source, sourceHash, filter, desc))
+    {
+        return true;
+    }
+
+    if (!GenerateMips(source, desc, filter, pPool))
+    {
+        desc = std::move(source);
+        return true;
+    }
+
+    // Failing to store the entry only costs another generation on the next load
+    SaveMipCache(cachePath, desc, sourceHash, filter);
+
+    return true;
+}
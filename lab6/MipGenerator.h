@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "DDS.h"
+
+class ThreadPool;
+
+/** Downsampling filter of the mip generator */
+enum class MipFilter
+{
+    Box,        ///< Average of the covered texels, cheap and soft
+    Kaiser      ///< Kaiser windowed sinc, keeps detail at the cost of slight ringing
+};
+
+/** Number of levels of a full chain down to 1x1 */
+UINT32 GetFullMipCount(UINT32 width, UINT32 height);
+
+/** True for the RGBA8/BGRA8 formats and the BC1-BC5 UNORM ones mips can be generated for */
+bool IsMipGenerationSupported(DXGI_FORMAT fmt);
+
+/**
+ * Builds levels 1..N-1 of an RGBA8 image down to 1x1, each tightly packed. Every
+ * level is filtered from the previous one kept in float, in linear space when
+ * isSRGB is set. Rows are filtered in parallel on the thread pool (the default
+ * one if pPool is nullptr).
+ */
+bool GenerateMipChain(const UINT8* pRGBA, UINT32 width, UINT32 height, UINT32 rowPitch, bool isSRGB,
+    MipFilter filter, std::vector<std::vector<UINT8>>& levels, ThreadPool* pPool = nullptr);
+
+/**
+ * Makes a copy of a 2D texture with a full mip chain. Mips present in the source are
+ * copied verbatim, the missing ones are filtered from the smallest present level and
+ * encoded back to the source format. Slices are processed in parallel.
+ */
+bool GenerateMips(const TextureDesc& source, TextureDesc& result, MipFilter filter = MipFilter::Kaiser,
+    ThreadPool* pPool = nullptr);
+
+/**
+ * LoadDDS that completes missing mips. A generated chain is stored next to the file
+ * as <file>.mips, keyed by a hash of the source payload, and is mapped on later
+ * loads instead of being computed again. Textures that already have all mips or
+ * can not be processed are returned as loaded.
+ */
+bool LoadDDSWithMips(const std::wstring& filepath, TextureDesc& desc, DDSLoadMode mode = DDSLoadMode::Copy,
+    MipFilter filter = MipFilter::Kaiser, ThreadPool* pPool = nullptr);
@@ -15,5 +15,5 @@ cbuffer GeomBuffer : register(b1)
 
 float4 PS(VSOutput pixel) : SV_Target0
 {
-    return float4(CalculateColor(color.xyz, float3(1, 0, 0), pixel.worldPos.xyz, 0.0, true), color.w);
+    return float4(CalculateColor(color.xyz, float3(1, 0, 0), pixel.worldPos.xyz, 0.0), color.w);
 }
@@ -5,10 +5,12 @@ cbuffer MaterialProperties : register(b1)
     float4x4 worldTransform;
     float4x4 normalMatrix;
     float4 glossiness;
+    uint4 material;     // Diffuse array and slice, normal array and slice
 };
 
-Texture2D diffuseMap : register(t0);
-Texture2D normalMap : register(t1);
+// Layers of all materials that share a format, the draw picks its slice
+Texture2DArray diffuseMaps : register(t0);
+Texture2DArray normalMaps : register(t1);
 SamplerState textureSampler : register(s0);
 
 struct PixelInput
@@ -22,19 +24,32 @@ struct PixelInput
 
 float4 PS(PixelInput input) : SV_Target0
 {
-    float3 baseColor = diffuseMap.Sample(textureSampler, input.texCoords).rgb;
-
-    float3 computedNormal = float3(0.0, 0.0, 0.0);
+    float3 baseColor = diffuseMaps.Sample(textureSampler, float3(input.texCoords, material.y)).rgb;
 
+#ifdef NORMAL_MAP
     float3 biNormal = normalize(cross(input.normalVector, input.tangentVector));
 
-    float3 sampledNormal = normalMap.Sample(textureSampler, input.texCoords).rgb;
+#ifdef NORMAL_MAP_BC5
+    // Two channel map stores X and Y only, Z of a tangent space normal is never negative
+    float2 sampledNormal = normalMaps.Sample(textureSampler, float3(input.texCoords, material.w)).rg;
+#ifdef NORMAL_MAP_SNORM
+    float3 adjustedNormal = float3(sampledNormal, 0.0);
+#else
+    float3 adjustedNormal = float3(sampledNormal * 2.0 - 1.0, 0.0);
+#endif
+    adjustedNormal.z = sqrt(saturate(1.0 - dot(adjustedNormal.xy, adjustedNormal.xy)));
+#else
+    float3 sampledNormal = normalMaps.Sample(textureSampler, float3(input.texCoords, material.w)).rgb;
     float3 adjustedNormal = sampledNormal * 2.0 - 1.0;
+#endif
 
-    computedNormal = adjustedNormal.x * normalize(input.tangentVector) +
-                     adjustedNormal.y * biNormal +
-                     adjustedNormal.z * normalize(input.normalVector);
+    float3 computedNormal = adjustedNormal.x * normalize(input.tangentVector) +
+                            adjustedNormal.y * biNormal +
+                            adjustedNormal.z * normalize(input.normalVector);
+#else
+    float3 computedNormal = normalize(input.normalVector);
+#endif
 
-    float3 finalColor = CalculateColor(baseColor, computedNormal, input.globalPos.xyz, glossiness.x, false);
+    float3 finalColor = CalculateColor(baseColor, computedNormal, input.globalPos.xyz, glossiness.x);
     return float4(finalColor, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,659 @@
+#pragma once
+
+// DirectXMath on Windows. Elsewhere, or with USE_PORTABLE_MATH defined, the subset of it the
+// CPU code uses, under the same names. The functions repeat the operations of the SSE2 code
+// DirectXMath runs in our x64 build (no /arch:AVX, so no SSE4 or FMA) in the same order,
+// with SSE2, NEON or plain floats, and give the same bits on each. GCC and Clang fuse
+// multiplies and adds on ARM64 unless built with -ffp-contract=off.
+// Define PORTABLE_MATH_NO_SIMD to build the plain float code on any CPU.
+#if !defined(USE_PORTABLE_MATH) && defined(_WIN32)
+
+#include <DirectXMath.h>
+
+#else
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(PORTABLE_MATH_NO_SIMD)
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PORTABLE_MATH_SSE 1
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PORTABLE_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace DirectX
+{
+
+    constexpr float XM_PI = 3.141592654f;
+    constexpr float XM_2PI = 6.283185307f;
+    constexpr float XM_1DIVPI = 0.318309886f;
+    constexpr float XM_1DIV2PI = 0.159154943f;
+    constexpr float XM_PIDIV2 = 1.570796327f;
+    constexpr float XM_PIDIV4 = 0.785398163f;
+
+#if defined(PORTABLE_MATH_SSE)
+    using XMVECTOR = __m128;
+#elif defined(PORTABLE_MATH_NEON)
+    using XMVECTOR = float32x4_t;
+#else
+    struct alignas(16) XMVECTOR
+    {
+        float f[4];
+    };
+#endif
+
+    using FXMVECTOR = const XMVECTOR;
+    using GXMVECTOR = const XMVECTOR;
+    using CXMVECTOR = const XMVECTOR&;
+
+    struct alignas(16) XMMATRIX
+    {
+        XMVECTOR r[4];
+
+        XMMATRIX() = default;
+        XMMATRIX(FXMVECTOR R0, FXMVECTOR R1, FXMVECTOR R2, CXMVECTOR R3) : r{ R0, R1, R2, R3 } {}
+    };
+
+    using FXMMATRIX = const XMMATRIX&;
+    using CXMMATRIX = const XMMATRIX&;
+
+    struct XMFLOAT4X4
+    {
+        union
+        {
+            struct
+            {
+                float _11, _12, _13, _14;
+                float _21, _22, _23, _24;
+                float _31, _32, _33, _34;
+                float _41, _42, _43, _44;
+            };
+            float m[4][4];
+        };
+
+        XMFLOAT4X4() = default;
+    };
+
+    /** Lane operations the functions below are written in, one set per instruction set */
+    namespace PortableMath
+    {
+
+#if defined(PORTABLE_MATH_SSE)
+
+        inline XMVECTOR Set(float x, float y, float z, float w) { return _mm_set_ps(w, z, y, x); }
+        inline XMVECTOR SetBits(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+        {
+            return _mm_castsi128_ps(_mm_set_epi32((int)w, (int)z, (int)y, (int)x));
+        }
+        inline XMVECTOR Splat(float value) { return _mm_set1_ps(value); }
+        inline XMVECTOR Zero() { return _mm_setzero_ps(); }
+
+        inline XMVECTOR Add(XMVECTOR a, XMVECTOR b) { return _mm_add_ps(a, b); }
+        inline XMVECTOR Subtract(XMVECTOR a, XMVECTOR b) { return _mm_sub_ps(a, b); }
+        inline XMVECTOR Multiply(XMVECTOR a, XMVECTOR b) { return _mm_mul_ps(a, b); }
+        inline XMVECTOR Divide(XMVECTOR a, XMVECTOR b) { return _mm_div_ps(a, b); }
+        inline XMVECTOR Sqrt(XMVECTOR v) { return _mm_sqrt_ps(v); }
+
+        /** Lane x of a + b, the other lanes of a */
+        inline XMVECTOR AddX(XMVECTOR a, XMVECTOR b) { return _mm_add_ss(a, b); }
+
+        /** All bits set in the lanes where a != b, NaN compares unequal */
+        inline XMVECTOR NotEqual(XMVECTOR a, XMVECTOR b) { return _mm_cmpneq_ps(a, b); }
+        inline XMVECTOR And(XMVECTOR a, XMVECTOR b) { return _mm_and_ps(a, b); }
+        /** ~a & b */
+        inline XMVECTOR AndNot(XMVECTOR a, XMVECTOR b) { return _mm_andnot_ps(a, b); }
+        inline XMVECTOR Or(XMVECTOR a, XMVECTOR b) { return _mm_or_ps(a, b); }
+
+        /** Lanes x and y from a, z and w from b, indices in _MM_SHUFFLE order (w first) */
+        template <int W, int Z, int Y, int X>
+        inline XMVECTOR Shuffle(XMVECTOR a, XMVECTOR b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(W, Z, Y, X)); }
+
+        inline float GetX(XMVECTOR v) { return _mm_cvtss_f32(v); }
+
+#elif defined(PORTABLE_MATH_NEON)
+
+        inline XMVECTOR Set(float x, float y, float z, float w)
+        {
+            const float values[4] = { x, y, z, w };
+            return vld1q_f32(values);
+        }
+        inline XMVECTOR SetBits(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+        {
+            const uint32_t values[4] = { x, y, z, w };
+            return vreinterpretq_f32_u32(vld1q_u32(values));
+        }
+        inline XMVECTOR Splat(float value) { return vdupq_n_f32(value); }
+        inline XMVECTOR Zero() { return vdupq_n_f32(0.0f); }
+
+        inline XMVECTOR Add(XMVECTOR a, XMVECTOR b) { return vaddq_f32(a, b); }
+        inline XMVECTOR Subtract(XMVECTOR a, XMVECTOR b) { return vsubq_f32(a, b); }
+        inline XMVECTOR Multiply(XMVECTOR a, XMVECTOR b) { return vmulq_f32(a, b); }
+        inline XMVECTOR Divide(XMVECTOR a, XMVECTOR b) { return vdivq_f32(a, b); }
+        inline XMVECTOR Sqrt(XMVECTOR v) { return vsqrtq_f32(v); }
+
+        inline XMVECTOR AddX(XMVECTOR a, XMVECTOR b)
+        {
+            return vsetq_lane_f32(vgetq_lane_f32(a, 0) + vgetq_lane_f32(b, 0), a, 0);
+        }
+
+        inline XMVECTOR NotEqual(XMVECTOR a, XMVECTOR b) { return vreinterpretq_f32_u32(vmvnq_u32(vceqq_f32(a, b))); }
+        inline XMVECTOR And(XMVECTOR a, XMVECTOR b)
+        {
+            return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+        }
+        inline XMVECTOR AndNot(XMVECTOR a, XMVECTOR b)
+        {
+            return vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(b), vreinterpretq_u32_f32(a)));
+        }
+        inline XMVECTOR Or(XMVECTOR a, XMVECTOR b)
+        {
+            return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+        }
+
+        template <int W, int Z, int Y, int X>
+        inline XMVECTOR Shuffle(XMVECTOR a, XMVECTOR b)
+        {
+            XMVECTOR result = vdupq_n_f32(vgetq_lane_f32(a, X));
+            result = vsetq_lane_f32(vgetq_lane_f32(a, Y), result, 1);
+            result = vsetq_lane_f32(vgetq_lane_f32(b, Z), result, 2);
+            return vsetq_lane_f32(vgetq_lane_f32(b, W), result, 3);
+        }
+
+        inline float GetX(XMVECTOR v) { return vgetq_lane_f32(v, 0); }
+
+#else
+
+        inline XMVECTOR Set(float x, float y, float z, float w) { return XMVECTOR{ { x, y, z, w } }; }
+        inline XMVECTOR SetBits(uint32_t x, uint32_t y, uint32_t z, uint32_t w)
+        {
+            const uint32_t bits[4] = { x, y, z, w };
+            XMVECTOR result;
+            memcpy(result.f, bits, sizeof(bits));
+            return result;
+        }
+        inline XMVECTOR Splat(float value) { return Set(value, value, value, value); }
+        inline XMVECTOR Zero() { return Splat(0.0f); }
+
+        inline XMVECTOR Add(XMVECTOR a, XMVECTOR b) { return Set(a.f[0] + b.f[0], a.f[1] + b.f[1], a.f[2] + b.f[2], a.f[3] + b.f[3]); }
+        inline XMVECTOR Subtract(XMVECTOR a, XMVECTOR b) { return Set(a.f[0] - b.f[0], a.f[1] - b.f[1], a.f[2] - b.f[2], a.f[3] - b.f[3]); }
+        inline XMVECTOR Multiply(XMVECTOR a, XMVECTOR b) { return Set(a.f[0] * b.f[0], a.f[1] * b.f[1], a.f[2] * b.f[2], a.f[3] * b.f[3]); }
+        inline XMVECTOR Divide(XMVECTOR a, XMVECTOR b) { return Set(a.f[0] / b.f[0], a.f[1] / b.f[1], a.f[2] / b.f[2], a.f[3] / b.f[3]); }
+        inline XMVECTOR Sqrt(XMVECTOR v) { return Set(sqrtf(v.f[0]), sqrtf(v.f[1]), sqrtf(v.f[2]), sqrtf(v.f[3])); }
+
+        inline XMVECTOR AddX(XMVECTOR a, XMVECTOR b) { return Set(a.f[0] + b.f[0], a.f[1], a.f[2], a.f[3]); }
+
+        inline XMVECTOR NotEqual(XMVECTOR a, XMVECTOR b)
+        {
+            return SetBits(a.f[0] != b.f[0] ? ~0u : 0u, a.f[1] != b.f[1] ? ~0u : 0u,
+                a.f[2] != b.f[2] ? ~0u : 0u, a.f[3] != b.f[3] ? ~0u : 0u);
+        }
+
+        /** Lanes as bits, the masks above are whole lanes of ones or zeros */
+        inline void GetBits(XMVECTOR v, uint32_t bits[4]) { memcpy(bits, v.f, sizeof(v.f)); }
+
+        inline XMVECTOR And(XMVECTOR a, XMVECTOR b)
+        {
+            uint32_t x[4], y[4];
+            GetBits(a, x);
+            GetBits(b, y);
+            return SetBits(x[0] & y[0], x[1] & y[1], x[2] & y[2], x[3] & y[3]);
+        }
+        inline XMVECTOR AndNot(XMVECTOR a, XMVECTOR b)
+        {
+            uint32_t x[4], y[4];
+            GetBits(a, x);
+            GetBits(b, y);
+            return SetBits(~x[0] & y[0], ~x[1] & y[1], ~x[2] & y[2], ~x[3] & y[3]);
+        }
+        inline XMVECTOR Or(XMVECTOR a, XMVECTOR b)
+        {
+            uint32_t x[4], y[4];
+            GetBits(a, x);
+            GetBits(b, y);
+            return SetBits(x[0] | y[0], x[1] | y[1], x[2] | y[2], x[3] | y[3]);
+        }
+
+        template <int W, int Z, int Y, int X>
+        inline XMVECTOR Shuffle(XMVECTOR a, XMVECTOR b) { return Set(a.f[X], a.f[Y], b.f[Z], b.f[W]); }
+
+        inline float GetX(XMVECTOR v) { return v.f[0]; }
+
+#endif
+
+        template <int W, int Z, int Y, int X>
+        inline XMVECTOR Permute(XMVECTOR v) { return Shuffle<W, Z, Y, X>(v, v); }
+
+        /** Bits of lane x, y, z kept and w cleared */
+        inline XMVECTOR Mask3() { return SetBits(~0u, ~0u, ~0u, 0u); }
+
+        inline XMVECTOR IdentityR0() { return Set(1.0f, 0.0f, 0.0f, 0.0f); }
+        inline XMVECTOR IdentityR1() { return Set(0.0f, 1.0f, 0.0f, 0.0f); }
+        inline XMVECTOR IdentityR2() { return Set(0.0f, 0.0f, 1.0f, 0.0f); }
+        inline XMVECTOR IdentityR3() { return Set(0.0f, 0.0f, 0.0f, 1.0f); }
+
+        /** c - a * b, as XM_FNMADD_PS without FMA */
+        inline XMVECTOR NegativeMultiplySubtract(XMVECTOR a, XMVECTOR b, XMVECTOR c) { return Subtract(c, Multiply(a, b)); }
+
+    }
+
+    inline XMVECTOR XMVectorSet(float x, float y, float z, float w) { return PortableMath::Set(x, y, z, w); }
+    inline XMVECTOR XMVectorZero() { return PortableMath::Zero(); }
+    inline XMVECTOR XMVectorReplicate(float value) { return PortableMath::Splat(value); }
+
+    inline float XMVectorGetX(FXMVECTOR V) { return PortableMath::GetX(V); }
+    inline float XMVectorGetY(FXMVECTOR V) { return PortableMath::GetX(PortableMath::Permute<1, 1, 1, 1>(V)); }
+    inline float XMVectorGetZ(FXMVECTOR V) { return PortableMath::GetX(PortableMath::Permute<2, 2, 2, 2>(V)); }
+    inline float XMVectorGetW(FXMVECTOR V) { return PortableMath::GetX(PortableMath::Permute<3, 3, 3, 3>(V)); }
+
+    inline XMVECTOR XMVectorAdd(FXMVECTOR V1, FXMVECTOR V2) { return PortableMath::Add(V1, V2); }
+    inline XMVECTOR XMVectorSubtract(FXMVECTOR V1, FXMVECTOR V2) { return PortableMath::Subtract(V1, V2); }
+    inline XMVECTOR XMVectorMultiply(FXMVECTOR V1, FXMVECTOR V2) { return PortableMath::Multiply(V1, V2); }
+
+    /** 0 - V as DirectXMath computes it, so a zero lane becomes +0 */
+    inline XMVECTOR XMVectorNegate(FXMVECTOR V) { return PortableMath::Subtract(PortableMath::Zero(), V); }
+
+    /** Bits of V2 where Control is set, of V1 elsewhere */
+    inline XMVECTOR XMVectorSelect(FXMVECTOR V1, FXMVECTOR V2, FXMVECTOR Control)
+    {
+        return PortableMath::Or(PortableMath::AndNot(Control, V1), PortableMath::And(V2, Control));
+    }
+
+    /** (x + y) + z in every lane */
+    inline XMVECTOR XMVector3Dot(FXMVECTOR V1, FXMVECTOR V2)
+    {
+        using namespace PortableMath;
+
+        XMVECTOR dot = Multiply(V1, V2);
+        XMVECTOR temp = Permute<2, 1, 2, 1>(dot);
+        dot = AddX(dot, temp);
+        temp = Permute<1, 1, 1, 1>(temp);
+        dot = AddX(dot, temp);
+        return Permute<0, 0, 0, 0>(dot);
+    }
+
+    /** (x + z) + (y + w) in every lane */
+    inline XMVECTOR XMVector4Dot(FXMVECTOR V1, FXMVECTOR V2)
+    {
+        using namespace PortableMath;
+
+        XMVECTOR temp2 = V2;
+        XMVECTOR temp = Multiply(V1, temp2);
+        temp2 = Shuffle<1, 0, 0, 0>(temp2, temp);
+        temp2 = Add(temp2, temp);
+        temp = Shuffle<0, 3, 0, 0>(temp, temp2);
+        temp = Add(temp, temp2);
+        return Permute<2, 2, 2, 2>(temp);
+    }
+
+    /** w of the result is 0 */
+    inline XMVECTOR XMVector3Cross(FXMVECTOR V1, FXMVECTOR V2)
+    {
+        using namespace PortableMath;
+
+        XMVECTOR temp1 = Permute<3, 0, 2, 1>(V1);
+        XMVECTOR temp2 = Permute<3, 1, 0, 2>(V2);
+        XMVECTOR result = Multiply(temp1, temp2);
+        temp1 = Permute<3, 0, 2, 1>(temp1);
+        temp2 = Permute<3, 1, 0, 2>(temp2);
+        result = NegativeMultiplySubtract(temp1, temp2, result);
+        return And(result, Mask3());
+    }
+
+    /** Divides all four lanes by the length of x, y, z. Zero length gives zero, infinite length NaN. */
+    inline XMVECTOR XMVector3Normalize(FXMVECTOR V)
+    {
+        using namespace PortableMath;
+
+        XMVECTOR lengthSq = Multiply(V, V);
+        XMVECTOR temp = Permute<2, 1, 2, 1>(lengthSq);
+        lengthSq = AddX(lengthSq, temp);
+        temp = Permute<1, 1, 1, 1>(temp);
+        lengthSq = AddX(lengthSq, temp);
+        lengthSq = Permute<0, 0, 0, 0>(lengthSq);
+
+        XMVECTOR result = Sqrt(lengthSq);
+        XMVECTOR zeroMask = NotEqual(Zero(), result);
+        lengthSq = NotEqual(lengthSq, SetBits(0x7F800000, 0x7F800000, 0x7F800000, 0x7F800000));
+        result = Divide(V, result);
+        result = And(result, zeroMask);
+
+        XMVECTOR temp1 = AndNot(lengthSq, SetBits(0x7FC00000, 0x7FC00000, 0x7FC00000, 0x7FC00000));
+        XMVECTOR temp2 = And(result, lengthSq);
+        return Or(temp1, temp2);
+    }
+
+    /** Sine and cosine by the minimax polynomials of DirectXMath, not by sinf and cosf */
+    inline void XMScalarSinCos(float* pSin, float* pCos, float Value)
+    {
+        // Map Value to y in [-pi, pi], x = 2 * pi * quotient + remainder
+        float quotient = XM_1DIV2PI * Value;
+        if (Value >= 0.0f)
+        {
+            quotient = static_cast<float>(static_cast<int>(quotient + 0.5f));
+        }
+        else
+        {
+            quotient = static_cast<float>(static_cast<int>(quotient - 0.5f));
+        }
+        float y = Value - XM_2PI * quotient;
+
+        // Map y to [-pi / 2, pi / 2] with sin(y) = sin(Value)
+        float sign;
+        if (y > XM_PIDIV2)
+        {
+            y = XM_PI - y;
+            sign = -1.0f;
+        }
+        else if (y < -XM_PIDIV2)
+        {
+            y = -XM_PI - y;
+            sign = -1.0f;
+        }
+        else
+        {
+            sign = +1.0f;
+        }
+
+        float y2 = y * y;
+
+        *pSin = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2 - 0.16666667f) * y2 + 1.0f) * y;
+
+        float p = ((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2 - 0.5f) * y2 + 1.0f;
+        *pCos = sign * p;
+    }
+
+    inline XMMATRIX XMMatrixIdentity()
+    {
+        using namespace PortableMath;
+        return XMMATRIX(IdentityR0(), IdentityR1(), IdentityR2(), IdentityR3());
+    }
+
+    inline XMMATRIX XMMatrixTranslation(float OffsetX, float OffsetY, float OffsetZ)
+    {
+        using namespace PortableMath;
+        return XMMATRIX(IdentityR0(), IdentityR1(), IdentityR2(), XMVectorSet(OffsetX, OffsetY, OffsetZ, 1.0f));
+    }
+
+    inline XMMATRIX XMMatrixTranspose(FXMMATRIX M)
+    {
+        using namespace PortableMath;
+
+        XMVECTOR temp1 = Shuffle<1, 0, 1, 0>(M.r[0], M.r[1]);
+        XMVECTOR temp3 = Shuffle<3, 2, 3, 2>(M.r[0], M.r[1]);
+        XMVECTOR temp2 = Shuffle<1, 0, 1, 0>(M.r[2], M.r[3]);
+        XMVECTOR temp4 = Shuffle<3, 2, 3, 2>(M.r[2], M.r[3]);
+
+        XMMATRIX result;
+        result.r[0] = Shuffle<2, 0, 2, 0>(temp1, temp2);
+        result.r[1] = Shuffle<3, 1, 3, 1>(temp1, temp2);
+        result.r[2] = Shuffle<2, 0, 2, 0>(temp3, temp4);
+        result.r[3] = Shuffle<3, 1, 3, 1>(temp3, temp4);
+        return result;
+    }
+
+    /** M1 * M2, each row summed as (x + z) + (y + w) */
+    inline XMMATRIX XMMatrixMultiply(CXMMATRIX M1, CXMMATRIX M2)
+    {
+        using namespace PortableMath;
+
+        XMMATRIX result;
+        for (int i = 0; i < 4; i++)
+        {
+            XMVECTOR w = M1.r[i];
+            XMVECTOR x = Permute<0, 0, 0, 0>(w);
+            XMVECTOR y = Permute<1, 1, 1, 1>(w);
+            XMVECTOR z = Permute<2, 2, 2, 2>(w);
+            w = Permute<3, 3, 3, 3>(w);
+
+            x = Multiply(x, M2.r[0]);
+            y = Multiply(y, M2.r[1]);
+            z = Multiply(z, M2.r[2]);
+            w = Multiply(w, M2.r[3]);
+
+            x = Add(x, z);
+            y = Add(y, w);
+            result.r[i] = Add(x, y);
+        }
+        return result;
+    }
+
+    /** Cofactors over the determinant, the determinant goes to all lanes of *pDeterminant */
+    inline XMMATRIX XMMatrixInverse(XMVECTOR* pDeterminant, FXMMATRIX M)
+    {
+        using namespace PortableMath;
+
+        XMMATRIX MT = XMMatrixTranspose(M);
+
+        XMVECTOR V00 = Permute<1, 1, 0, 0>(MT.r[2]);
+        XMVECTOR V10 = Permute<3, 2, 3, 2>(MT.r[3]);
+        XMVECTOR V01 = Permute<1, 1, 0, 0>(MT.r[0]);
+        XMVECTOR V11 = Permute<3, 2, 3, 2>(MT.r[1]);
+        XMVECTOR V02 = Shuffle<2, 0, 2, 0>(MT.r[2], MT.r[0]);
+        XMVECTOR V12 = Shuffle<3, 1, 3, 1>(MT.r[3], MT.r[1]);
+
+        XMVECTOR D0 = Multiply(V00, V10);
+        XMVECTOR D1 = Multiply(V01, V11);
+        XMVECTOR D2 = Multiply(V02, V12);
+
+        V00 = Permute<3, 2, 3, 2>(MT.r[2]);
+        V10 = Permute<1, 1, 0, 0>(MT.r[3]);
+        V01 = Permute<3, 2, 3, 2>(MT.r[0]);
+        V11 = Permute<1, 1, 0, 0>(MT.r[1]);
+        V02 = Shuffle<3, 1, 3, 1>(MT.r[2], MT.r[0]);
+        V12 = Shuffle<2, 0, 2, 0>(MT.r[3], MT.r[1]);
+
+        D0 = NegativeMultiplySubtract(V00, V10, D0);
+        D1 = NegativeMultiplySubtract(V01, V11, D1);
+        D2 = NegativeMultiplySubtract(V02, V12, D2);
+
+        // V11 = D0Y, D0W, D2Y, D2Y
+        V11 = Shuffle<1, 1, 3, 1>(D0, D2);
+        V00 = Permute<1, 0, 2, 1>(MT.r[1]);
+        V10 = Shuffle<0, 3, 0, 2>(V11, D0);
+        V01 = Permute<0, 1, 0, 2>(MT.r[0]);
+        V11 = Shuffle<2, 1, 2, 1>(V11, D0);
+        // V13 = D1Y, D1W, D2W, D2W
+        XMVECTOR V13 = Shuffle<3, 3, 3, 1>(D1, D2);
+        V02 = Permute<1, 0, 2, 1>(MT.r[3]);
+        V12 = Shuffle<0, 3, 0, 2>(V13, D1);
+        XMVECTOR V03 = Permute<0, 1, 0, 2>(MT.r[2]);
+        V13 = Shuffle<2, 1, 2, 1>(V13, D1);
+
+        XMVECTOR C0 = Multiply(V00, V10);
+        XMVECTOR C2 = Multiply(V01, V11);
+        XMVECTOR C4 = Multiply(V02, V12);
+        XMVECTOR C6 = Multiply(V03, V13);
+
+        // V11 = D0X, D0Y, D2X, D2X
+        V11 = Shuffle<0, 0, 1, 0>(D0, D2);
+        V00 = Permute<2, 1, 3, 2>(MT.r[1]);
+        V10 = Shuffle<2, 1, 0, 3>(D0, V11);
+        V01 = Permute<1, 3, 2, 3>(MT.r[0]);
+        V11 = Shuffle<0, 2, 1, 2>(D0, V11);
+        // V13 = D1X, D1Y, D2Z, D2Z
+        V13 = Shuffle<2, 2, 1, 0>(D1, D2);
+        V02 = Permute<2, 1, 3, 2>(MT.r[3]);
+        V12 = Shuffle<2, 1, 0, 3>(D1, V13);
+        V03 = Permute<1, 3, 2, 3>(MT.r[2]);
+        V13 = Shuffle<0, 2, 1, 2>(D1, V13);
+
+        C0 = NegativeMultiplySubtract(V00, V10, C0);
+        C2 = NegativeMultiplySubtract(V01, V11, C2);
+        C4 = NegativeMultiplySubtract(V02, V12, C4);
+        C6 = NegativeMultiplySubtract(V03, V13, C6);
+
+        V00 = Permute<0, 3, 0, 3>(MT.r[1]);
+        // V10 = D0Z, D0Z, D2X, D2Y
+        V10 = Shuffle<1, 0, 2, 2>(D0, D2);
+        V10 = Permute<0, 2, 3, 0>(V10);
+        V01 = Permute<2, 0, 3, 1>(MT.r[0]);
+        // V11 = D0X, D0W, D2X, D2Y
+        V11 = Shuffle<1, 0, 3, 0>(D0, D2);
+        V11 = Permute<2, 1, 0, 3>(V11);
+        V02 = Permute<0, 3, 0, 3>(MT.r[3]);
+        // V12 = D1Z, D1Z, D2Z, D2W
+        V12 = Shuffle<3, 2, 2, 2>(D1, D2);
+        V12 = Permute<0, 2, 3, 0>(V12);
+        V03 = Permute<2, 0, 3, 1>(MT.r[2]);
+        // V13 = D1X, D1W, D2Z, D2W
+        V13 = Shuffle<3, 2, 3, 0>(D1, D2);
+        V13 = Permute<2, 1, 0, 3>(V13);
+
+        V00 = Multiply(V00, V10);
+        V01 = Multiply(V01, V11);
+        V02 = Multiply(V02, V12);
+        V03 = Multiply(V03, V13);
+        XMVECTOR C1 = Subtract(C0, V00);
+        C0 = Add(C0, V00);
+        XMVECTOR C3 = Add(C2, V01);
+        C2 = Subtract(C2, V01);
+        XMVECTOR C5 = Subtract(C4, V02);
+        C4 = Add(C4, V02);
+        XMVECTOR C7 = Add(C6, V03);
+        C6 = Subtract(C6, V03);
+
+        C0 = Shuffle<3, 1, 2, 0>(C0, C1);
+        C2 = Shuffle<3, 1, 2, 0>(C2, C3);
+        C4 = Shuffle<3, 1, 2, 0>(C4, C5);
+        C6 = Shuffle<3, 1, 2, 0>(C6, C7);
+        C0 = Permute<3, 1, 2, 0>(C0);
+        C2 = Permute<3, 1, 2, 0>(C2);
+        C4 = Permute<3, 1, 2, 0>(C4);
+        C6 = Permute<3, 1, 2, 0>(C6);
+
+        XMVECTOR determinant = XMVector4Dot(C0, MT.r[0]);
+        if (pDeterminant != nullptr)
+        {
+            *pDeterminant = determinant;
+        }
+
+        XMVECTOR reciprocal = Divide(Splat(1.0f), determinant);
+
+        XMMATRIX result;
+        result.r[0] = Multiply(C0, reciprocal);
+        result.r[1] = Multiply(C2, reciprocal);
+        result.r[2] = Multiply(C4, reciprocal);
+        result.r[3] = Multiply(C6, reciprocal);
+        return result;
+    }
+
+    /** NormalAxis must be unit length */
+    inline XMMATRIX XMMatrixRotationNormal(FXMVECTOR NormalAxis, float Angle)
+    {
+        using namespace PortableMath;
+
+        float sinAngle;
+        float cosAngle;
+        XMScalarSinCos(&sinAngle, &cosAngle, Angle);
+
+        XMVECTOR C2 = Splat(1.0f - cosAngle);
+        XMVECTOR C1 = Splat(cosAngle);
+        XMVECTOR C0 = Splat(sinAngle);
+
+        XMVECTOR N0 = Permute<3, 0, 2, 1>(NormalAxis);
+        XMVECTOR N1 = Permute<3, 1, 0, 2>(NormalAxis);
+
+        XMVECTOR V0 = Multiply(C2, N0);
+        V0 = Multiply(V0, N1);
+
+        XMVECTOR R0 = Multiply(C2, NormalAxis);
+        R0 = Add(Multiply(R0, NormalAxis), C1);
+
+        XMVECTOR R1 = Add(Multiply(C0, NormalAxis), V0);
+        XMVECTOR R2 = NegativeMultiplySubtract(C0, NormalAxis, V0);
+
+        V0 = And(R0, Mask3());
+        XMVECTOR V1 = Shuffle<2, 1, 2, 0>(R1, R2);
+        V1 = Permute<0, 3, 2, 1>(V1);
+        XMVECTOR V2 = Shuffle<0, 0, 1, 1>(R1, R2);
+        V2 = Permute<2, 0, 2, 0>(V2);
+
+        XMMATRIX result;
+        R2 = Shuffle<1, 0, 3, 0>(V0, V1);
+        result.r[0] = Permute<1, 3, 2, 0>(R2);
+
+        R2 = Shuffle<3, 2, 3, 1>(V0, V1);
+        result.r[1] = Permute<1, 3, 0, 2>(R2);
+
+        result.r[2] = Shuffle<3, 2, 1, 0>(V2, V0);
+        result.r[3] = IdentityR3();
+        return result;
+    }
+
+    inline XMMATRIX XMMatrixRotationAxis(FXMVECTOR Axis, float Angle)
+    {
+        return XMMatrixRotationNormal(XMVector3Normalize(Axis), Angle);
+    }
+
+    inline XMMATRIX XMMatrixLookToLH(FXMVECTOR EyePosition, FXMVECTOR EyeDirection, FXMVECTOR UpDirection)
+    {
+        XMVECTOR R2 = XMVector3Normalize(EyeDirection);
+
+        XMVECTOR R0 = XMVector3Cross(UpDirection, R2);
+        R0 = XMVector3Normalize(R0);
+
+        XMVECTOR R1 = XMVector3Cross(R2, R0);
+
+        XMVECTOR negEyePosition = XMVectorNegate(EyePosition);
+
+        XMVECTOR D0 = XMVector3Dot(R0, negEyePosition);
+        XMVECTOR D1 = XMVector3Dot(R1, negEyePosition);
+        XMVECTOR D2 = XMVector3Dot(R2, negEyePosition);
+
+        // x, y, z from the axes and w from the dot products
+        const XMVECTOR select1110 = PortableMath::Mask3();
+
+        XMMATRIX M;
+        M.r[0] = XMVectorSelect(D0, R0, select1110);
+        M.r[1] = XMVectorSelect(D1, R1, select1110);
+        M.r[2] = XMVectorSelect(D2, R2, select1110);
+        M.r[3] = PortableMath::IdentityR3();
+
+        return XMMatrixTranspose(M);
+    }
+
+    inline XMMATRIX XMMatrixLookAtLH(FXMVECTOR EyePosition, FXMVECTOR FocusPosition, FXMVECTOR UpDirection)
+    {
+        return XMMatrixLookToLH(EyePosition, XMVectorSubtract(FocusPosition, EyePosition), UpDirection);
+    }
+
+    inline XMMATRIX XMMatrixPerspectiveLH(float ViewWidth, float ViewHeight, float NearZ, float FarZ)
+    {
+        float twoNearZ = NearZ + NearZ;
+        float range = FarZ / (FarZ - NearZ);
+
+        return XMMATRIX(
+            XMVectorSet(twoNearZ / ViewWidth, 0.0f, 0.0f, 0.0f),
+            XMVectorSet(0.0f, twoNearZ / ViewHeight, 0.0f, 0.0f),
+            XMVectorSet(0.0f, 0.0f, range, 1.0f),
+            XMVectorSet(0.0f, 0.0f, -range * NearZ, 0.0f));
+    }
+
+    inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* pSource)
+    {
+        return XMMATRIX(
+            XMVectorSet(pSource->m[0][0], pSource->m[0][1], pSource->m[0][2], pSource->m[0][3]),
+            XMVectorSet(pSource->m[1][0], pSource->m[1][1], pSource->m[1][2], pSource->m[1][3]),
+            XMVectorSet(pSource->m[2][0], pSource->m[2][1], pSource->m[2][2], pSource->m[2][3]),
+            XMVectorSet(pSource->m[3][0], pSource->m[3][1], pSource->m[3][2], pSource->m[3][3]));
+    }
+
+    inline void XMStoreFloat4x4(XMFLOAT4X4* pDestination, FXMMATRIX M)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            pDestination->m[i][0] = XMVectorGetX(M.r[i]);
+            pDestination->m[i][1] = XMVectorGetY(M.r[i]);
+            pDestination->m[i][2] = XMVectorGetZ(M.r[i]);
+            pDestination->m[i][3] = XMVectorGetW(M.r[i]);
+        }
+    }
+
+}
+
+#endif
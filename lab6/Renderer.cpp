@@ -2,10 +2,19 @@
 #include "framework.h"
 #include "Renderer.h"
 #include "DDS.h"
+#include "AssetPak.h"
+#include "TextureCache.h"
+#include "TextureArrayBuilder.h"
+#include "D3DShaderCompiler.h"
+#include "EmbeddedShaders.h"
+#include "ShaderSourceCache.h"
 
 const float Renderer::CameraRotationSpeed   = (float)M_PI * 2.0f;
 const float Renderer::CameraMovingSpeed     = (float)10.0f;
 const float Renderer::ModelRotationSpeed    = (float)M_PI / 2.0f;
+const float Renderer::AmbientIntensity      = 0.3f;
+const UINT32 Renderer::AmbientFaceSize      = 256;
+const float Renderer::CubeShininess[2]      = { 30.0f, 10.0f };
 
 
 bool Renderer::InitDevice(HWND hWnd)
@@ -116,7 +125,18 @@ bool Renderer::InitDevice(HWND hWnd)
         m_pScene->lightCount.x = 1;
         m_pScene->lights[0].pos = XMFLOAT4{ 2.0, 1.0f, 0, 1 };
         m_pScene->lights[0].color = XMFLOAT4{ 1, 1, 0, 0};
-        m_pScene->ambientColor = XMFLOAT4(0, 0, 0.1f, 0);
+        // Constant ambient until the environment is projected
+        m_pScene->ambientSH[0] = XMFLOAT4(0, 0, 0.1f, 0);
+    }
+
+    if (SUCCEEDED(result))
+    {
+        // Bytecode of unchanged shaders is reused across launches
+        m_pShaderCompiler = new D3DShaderCompiler();
+        m_pShaderCache = new ShaderCache(m_pShaderCompiler, L"ShaderCache");
+        m_pShaderQueue = new ShaderCompileQueue(m_pShaderCache);
+        // Edited shaders and includes are recompiled while running
+        m_pShaderHotReload = new ShaderHotReload(m_pShaderCache, L".");
     }
 
     if (SUCCEEDED(result))
@@ -213,11 +233,14 @@ void Renderer::CleanupDevice()
         m_pVertexShader = nullptr;
     }
 
-    if (m_pPixelShader)
+    for (auto& variant : m_pixelShaders)
     {
-        m_pPixelShader->Release();
-        m_pPixelShader = nullptr;
+        if (variant.second)
+        {
+            variant.second->Release();
+        }
     }
+    m_pixelShaders.clear();
 
     if (m_pInputLayout)
     {
@@ -243,16 +266,14 @@ void Renderer::CleanupDevice()
         m_pSceneBuffer = nullptr;
     }
 
-    if (m_pTexture)
+    // Textures are shared through the cache, only the reference of this renderer goes
+    for (ID3D11ShaderResourceView*& pView : m_arrayViews)
     {
-        m_pTexture->Release();
-        m_pTexture = nullptr;
-    }
-
-    if (m_pTextureView)
-    {
-        m_pTextureView->Release();
-        m_pTextureView = nullptr;
+        if (pView)
+        {
+            TextureCache::GetDefault().Release(pView);
+            pView = nullptr;
+        }
     }
 
     if (m_pSampler)
@@ -279,16 +300,11 @@ void Renderer::CleanupDevice()
         m_pSphereInputLayout = nullptr;
     }
 
-    if (m_pCubemapTexture)
-    {
-        m_pCubemapTexture->Release();
-        m_pCubemapTexture = nullptr;
-    }
-
     if (m_pCubemapView)
     {
-        m_pCubemapView->Release();
+        TextureCache::GetDefault().Release(m_pCubemapView);
         m_pCubemapView = nullptr;
+        m_pCubemapTexture = nullptr;
     }
 
     if (m_pDepthBuffer)
@@ -321,12 +337,6 @@ void Renderer::CleanupDevice()
         m_pTransBlendState = nullptr;
     }
 
-    if (m_pRectPixelShader)
-    {
-        m_pRectPixelShader->Release();
-        m_pRectPixelShader = nullptr;
-    }
-
     if (m_pRectVertexShader)
     {
         m_pRectVertexShader->Release();
@@ -370,18 +380,6 @@ void Renderer::CleanupDevice()
         m_pNoTransBlendState = nullptr;
     }
 
-    if (m_pNormalTextureView)
-    {
-        m_pNormalTextureView->Release();
-        m_pNormalTextureView = nullptr;
-    }
-
-    if (m_pNormalTexture)
-    {
-        m_pNormalTexture->Release();
-        m_pNormalTexture = nullptr;
-    }
-
     if (m_pSphere != nullptr)
     {
         m_pSphere->CleanupSphere();
@@ -418,7 +416,49 @@ void Renderer::CleanupDevice()
         delete m_pScene;
     }
 
+    delete m_pTextureStreamer;
+    m_pTextureStreamer = nullptr;
+
 #ifdef _DEBUG
+    if (m_pShaderCache != nullptr)
+    {
+        ShaderCacheStats shaderStats = m_pShaderCache->GetStats();
+
+        char shaderMessage[256];
+        sprintf_s(shaderMessage, "Shader cache: %u hits, %u misses, %.1f ms compiling\n",
+            shaderStats.hits, shaderStats.misses, shaderStats.compileSeconds * 1000.0);
+        OutputDebugStringA(shaderMessage);
+    }
+
+    for (const auto& source : ShaderSourceCache::GetDefault().GetStats())
+    {
+        char sourceMessage[512];
+        sprintf_s(sourceMessage, "Shader source %s: %llu hits, %llu reads\n",
+            source.first.c_str(), source.second.hits, source.second.misses);
+        OutputDebugStringA(sourceMessage);
+    }
+#endif
+
+    delete m_pShaderHotReload;
+    m_pShaderHotReload = nullptr;
+
+    delete m_pShaderQueue;
+    m_pShaderQueue = nullptr;
+
+    delete m_pShaderCache;
+    m_pShaderCache = nullptr;
+
+    delete m_pShaderCompiler;
+    m_pShaderCompiler = nullptr;
+
+#ifdef _DEBUG
+    TextureCacheStats stats = TextureCache::GetDefault().GetStats();
+
+    char statsMessage[256];
+    sprintf_s(statsMessage, "Texture cache: %llu hits, %llu misses, %llu KB saved, %u textures alive\n",
+        stats.hits, stats.misses, stats.bytesSaved / 1024, stats.textureCount);
+    OutputDebugStringA(statsMessage);
+
     if (m_pDevice != nullptr)
     {
         ID3D11Debug* pDebug = nullptr;
@@ -488,7 +528,10 @@ bool Renderer::Render()
     ID3D11SamplerState* samplers[] = { m_pSampler };
     m_pDeviceContext->PSSetSamplers(0, 1, samplers);
 
-    ID3D11ShaderResourceView* resources[] = { m_pTextureView, m_pNormalTextureView };
+    // Every material keeps its diffuse layers in one array and its normal layers in another,
+    // draws pick their slices from the geometry buffer
+    const MaterialSlices& material = m_materialArrays.GetMaterial(m_bricksMaterial);
+    ID3D11ShaderResourceView* resources[] = { m_arrayViews[material.diffuse.arrayIndex], m_arrayViews[material.normal.arrayIndex] };
     m_pDeviceContext->PSSetShaderResources(0, 2, resources);
 
     m_pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
@@ -504,12 +547,13 @@ bool Renderer::Render()
     m_pDeviceContext->IASetInputLayout(m_pInputLayout);
     m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     m_pDeviceContext->VSSetShader(m_pVertexShader, nullptr, 0);
-    m_pDeviceContext->PSSetShader(m_pPixelShader, nullptr, 0);
+    m_pDeviceContext->PSSetShader(GetPixelShader(L"PixelShader.hlsl", GetCubeFeatures(CubeShininess[0])), nullptr, 0);
     m_pDeviceContext->VSSetConstantBuffers(0, 2, cbuffers);
     m_pDeviceContext->PSSetConstantBuffers(0, 2, cbuffers);
     m_pDeviceContext->DrawIndexed(36, 0, 0);
 
     ID3D11Buffer* cbuffers2[] = { m_pGeomBuffer2 };
+    m_pDeviceContext->PSSetShader(GetPixelShader(L"PixelShader.hlsl", GetCubeFeatures(CubeShininess[1])), nullptr, 0);
     m_pDeviceContext->VSSetConstantBuffers(1, 1, cbuffers2);
     m_pDeviceContext->PSSetConstantBuffers(1, 1, cbuffers2);
     m_pDeviceContext->DrawIndexed(36, 0, 0);
@@ -542,29 +586,27 @@ bool Renderer::Update()
 
     double deltaSec = (usec - m_prevUSec) / 1000000.0;
 
+    // Shaders are swapped before anything of the frame is drawn with them
+    m_pShaderHotReload->Update();
+
     m_angle = m_angle + deltaSec * ModelRotationSpeed;
 
     GeomBuffer geomBuffer;
 
-    DirectX::XMMATRIX m = DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), -(float)m_angle);
-
-    geomBuffer.m = m;
+    // Both cubes are made of bricks
+    std::vector<UINT32> materialTable;
+    m_materialArrays.GetMaterialTable(materialTable);
+    std::copy_n(materialTable.begin() + m_bricksMaterial * 4, 4, geomBuffer.material);
 
-    m = DirectX::XMMatrixInverse(nullptr, m);
-    m = DirectX::XMMatrixTranspose(m);
-    geomBuffer.normalMatrix = m;
-    geomBuffer.shine.x = 30.0f;
+    geomBuffer.m = ComputeModelMatrix(-(float)m_angle);
+    geomBuffer.normalMatrix = ComputeNormalMatrix(geomBuffer.m);
+    geomBuffer.shine.x = CubeShininess[0];
 
     m_pDeviceContext->UpdateSubresource(m_pGeomBuffer, 0, nullptr, &geomBuffer, 0, 0);
 
-    m = DirectX::XMMatrixTranslation(2.0f, 0.0f, 0.0f);
-
-    geomBuffer.m = m;
-
-    m = DirectX::XMMatrixInverse(nullptr, m);
-    m = DirectX::XMMatrixTranspose(m);
-    geomBuffer.normalMatrix = m;
-    geomBuffer.shine.x = 10.0f;
+    geomBuffer.m = DirectX::XMMatrixTranslation(2.0f, 0.0f, 0.0f);
+    geomBuffer.normalMatrix = ComputeNormalMatrix(geomBuffer.m);
+    geomBuffer.shine.x = CubeShininess[1];
 
     m_pDeviceContext->UpdateSubresource(m_pGeomBuffer2, 0, nullptr, &geomBuffer, 0, 0);
 
@@ -582,35 +624,9 @@ bool Renderer::Update()
 
     m_prevUSec = usec;
 
-    DirectX::XMMATRIX v;
-    XMFLOAT4 cameraPos;
-    {
-        float posX = m_camera.poi.x + cosf(m_camera.theta) * cosf(m_camera.phi) * m_camera.r;
-        float posY = m_camera.poi.y + sinf(m_camera.theta) * m_camera.r;
-        float posZ = m_camera.poi.z + cosf(m_camera.theta) * sinf(m_camera.phi) * m_camera.r;
-
-        float upTheta = m_camera.theta + (float)M_PI / 2;
-
-        float upX = cosf(upTheta) * cosf(m_camera.phi);
-        float upY = sinf(upTheta);
-        float upZ = cosf(upTheta) * sinf(m_camera.phi);
-
-        v = DirectX::XMMatrixLookAtLH(
-            DirectX::XMVectorSet(posX, posY, posZ, 0.0f),
-            DirectX::XMVectorSet(m_camera.poi.x, m_camera.poi.y, m_camera.poi.z, 0.0f),
-            DirectX::XMVectorSet(upX, upY, upZ, 0.0f)
-        );
-
+    CameraMatrices camera = ComputeCameraMatrices(m_camera, m_width, m_height);
 
-        cameraPos = { posX, posY, posZ };
-    }
-
-    float f = 100.0f;
-    float n = 0.1f;
-    float fov = (float)M_PI / 3;
-    float c = 1.0f / tanf(fov / 2);
-    float aspectRatio = (float)m_height / m_width;
-    DirectX::XMMATRIX p = DirectX::XMMatrixPerspectiveLH(tanf(fov / 2) * 2 * n, tanf(fov / 2) * 2 * n * aspectRatio, n, f);
+    UpdateStreamedTextures(camera.position, camera.projectionScale);
 
 
     D3D11_MAPPED_SUBRESOURCE subresource;
@@ -620,10 +636,10 @@ bool Renderer::Update()
     if (SUCCEEDED(result))
     {
         SceneBuffer& sceneBuffer = *reinterpret_cast<SceneBuffer*>(subresource.pData);
-        sceneBuffer.vp = DirectX::XMMatrixMultiply(v, p);
-        sceneBuffer.cameraPos = cameraPos;
+        sceneBuffer.vp = DirectX::XMMatrixMultiply(camera.view, camera.projection);
+        sceneBuffer.cameraPos = camera.position;
         sceneBuffer.lightCount = m_pScene->lightCount;
-        sceneBuffer.ambientColor = m_pScene->ambientColor;
+        std::copy(m_pScene->ambientSH, m_pScene->ambientSH + SHCoefficientCount, sceneBuffer.ambientSH);
         for (int i = 0; i < m_pScene->lightCount.x; i++)
         {
             sceneBuffer.lights[i].pos = m_pScene->lights[i].pos;
@@ -747,6 +763,15 @@ HRESULT Renderer::InitScene()
         result = CreateIndexBuffer();
     }
 
+    // Compiles run on the worker threads while buffers and textures are set up,
+    // the Init* functions below pick up the same jobs
+    QueueShader(L"VertexShader.hlsl", ShaderType::Vertex);
+    QueueShader(L"VertexSphereShader.hlsl", ShaderType::Vertex);
+    QueueShader(L"PixelSphereShader.hlsl", ShaderType::Pixel);
+    QueueShader(L"VertexLightShader.hlsl", ShaderType::Vertex);
+    QueueShader(L"PixelLightShader.hlsl", ShaderType::Pixel);
+    QueueShader(L"VertexRectangleShader.hlsl", ShaderType::Vertex);
+
     static const D3D11_INPUT_ELEMENT_DESC InputDesc[] = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
         {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
@@ -761,11 +786,6 @@ HRESULT Renderer::InitScene()
         result = CreateShader(L"VertexShader.hlsl", ShaderType::Vertex, (ID3D11DeviceChild**)&m_pVertexShader, &pVertexShaderCode);
     }
 
-    if (SUCCEEDED(result))
-    {
-        result = CreateShader(L"PixelShader.hlsl", ShaderType::Pixel, (ID3D11DeviceChild**)&m_pPixelShader);
-    }
-
     if (SUCCEEDED(result))
     {
         result = m_pDevice->CreateInputLayout(InputDesc, 4, pVertexShaderCode->GetBufferPointer(), pVertexShaderCode->GetBufferSize(), &m_pInputLayout);
@@ -813,12 +833,30 @@ HRESULT Renderer::InitScene()
 
     if (SUCCEEDED(result))
     {
-        result = LoadTexture();
+        result = LoadTextures();
     }
 
     if (SUCCEEDED(result))
     {
-        result = LoadNormalTexture();
+        // Variants of the lit shaders depend on how the normal maps are stored
+        DXGI_FORMAT normalFormat = m_materialArrays.GetFormat(m_materialArrays.GetMaterial(m_bricksMaterial).normal.arrayIndex);
+
+        m_normalMapFeatures = ShaderFeatureNormalMap;
+        if (normalFormat == DXGI_FORMAT_BC5_UNORM || normalFormat == DXGI_FORMAT_BC5_TYPELESS)
+        {
+            m_normalMapFeatures |= ShaderFeatureNormalMapBC5;
+        }
+        else if (normalFormat == DXGI_FORMAT_BC5_SNORM)
+        {
+            m_normalMapFeatures |= ShaderFeatureNormalMapBC5 | ShaderFeatureNormalMapSnorm;
+        }
+
+        // The first frame draws with these, they compile next to the rest of the init
+        for (float shine : CubeShininess)
+        {
+            QueuePixelShader(L"PixelShader.hlsl", GetCubeFeatures(shine));
+        }
+        QueuePixelShader(L"PixelRectangleShader.hlsl", ShaderFeatureTranslucent);
     }
 
 
@@ -839,11 +877,9 @@ HRESULT Renderer::InitScene()
         assert(SUCCEEDED(result));
     }
 
-
     if (SUCCEEDED(result))
     {
-        result = InitCubemap();
-        assert(SUCCEEDED(result));
+        result = InitLightShaders();
     }
 
     for (int i = 0; i < m_pScene->lightCount.x; ++i)
@@ -854,91 +890,26 @@ HRESULT Renderer::InitScene()
         }
     }
 
-    return result;
-}
-
-class CustomShaderIncludeHandler : public ID3DInclude
-{
-public:
-    HRESULT __stdcall Open(D3D_INCLUDE_TYPE includeType, LPCSTR fileName, LPCVOID parentData, LPCVOID* dataOutput, UINT* dataSize) override
+    // Creates the variants queued above, later light counts or materials add their own on first use
+    if (SUCCEEDED(result))
     {
-        FILE* fileHandle = nullptr;
-        errno_t errorCode = fopen_s(&fileHandle, fileName, "rb");
-
-        if (errorCode != 0 || fileHandle == nullptr)
-        {
-            return E_FAIL;
-        }
-
-        if (fseek(fileHandle, 0, SEEK_END) != 0)
-        {
-            fclose(fileHandle);
-            return E_FAIL;
-        }
-
-        long long fileLength = _ftelli64(fileHandle);
-        if (fseek(fileHandle, 0, SEEK_SET) != 0)
-        {
-            fclose(fileHandle);
-            return E_FAIL;
-        }
-
-        void* allocatedMemory = malloc(fileLength);
-        if (!allocatedMemory)
-        {
-            fclose(fileHandle);
-            return E_FAIL;
-        }
-
-        size_t bytesRead = fread(allocatedMemory, 1, fileLength, fileHandle);
-        fclose(fileHandle);
-
-        if (bytesRead != static_cast<size_t>(fileLength))
-        {
-            free(allocatedMemory);
-            return E_FAIL;
-        }
+        bool isCreated = GetPixelShader(L"PixelShader.hlsl", GetCubeFeatures(CubeShininess[0])) != nullptr
+            && GetPixelShader(L"PixelShader.hlsl", GetCubeFeatures(CubeShininess[1])) != nullptr
+            && GetPixelShader(L"PixelRectangleShader.hlsl", ShaderFeatureTranslucent) != nullptr;
 
-        *dataOutput = allocatedMemory;
-        *dataSize = static_cast<UINT>(fileLength);
-
-        return S_OK;
+        result = isCreated ? S_OK : E_FAIL;
     }
 
-    HRESULT __stdcall Close(LPCVOID dataToRelease) override
-    {
-        if (dataToRelease)
-        {
-            free(const_cast<void*>(dataToRelease));
-        }
-        return S_OK;
-    }
-};
+    // Bytecode is not needed once the shaders exist
+    m_pShaderQueue->Clear();
 
+    return result;
+}
 
-HRESULT Renderer::CreateShader(const std::wstring& path, ShaderType shaderType, ID3D11DeviceChild** ppShader, ID3DBlob** ppCode)
+bool Renderer::MakeShaderArgs(const std::wstring& path, ShaderType shaderType, const D3D_SHADER_MACRO* pDefines,
+    ShaderCompileArgs& args) const
 {
 
-    FILE* pFile = nullptr;
-    _wfopen_s(&pFile, path.c_str(), L"rb");
-
-    if (pFile == nullptr)
-    {
-        return E_FAIL;
-    }
-
-
-    fseek(pFile, 0, SEEK_END);
-    long long size = _ftelli64(pFile);
-    fseek(pFile, 0, SEEK_SET);
-
-
-    std::vector<char> data(size + 1);
-    size_t rd = fread(data.data(), 1, size, pFile);
-    assert(rd == (size_t)size);
-    fclose(pFile);
-
-
     std::string entryPoint;
     std::string platform;
 
@@ -961,7 +932,7 @@ HRESULT Renderer::CreateShader(const std::wstring& path, ShaderType shaderType,
     default:
     {
         assert(false && "Unknown shader type");
-        return E_INVALIDARG;
+        return false;
     }
     }
 
@@ -972,64 +943,186 @@ HRESULT Renderer::CreateShader(const std::wstring& path, ShaderType shaderType,
 #endif
 
 
-    CustomShaderIncludeHandler includeHandler;
+    args.path       = path;
+    args.pDefines   = pDefines;
+    args.entryPoint = entryPoint;
+    args.profile    = platform;
+    args.flags      = flags1;
 
-    ID3DBlob* pCode     = nullptr;
-    ID3DBlob* pErrMsg   = nullptr;
-    HRESULT result      = D3DCompile(data.data(), data.size(), nullptr,
-                                     nullptr, &includeHandler, entryPoint.c_str(), platform.c_str(),
-                                     flags1, 0, &pCode, &pErrMsg);
+    return true;
+}
 
+std::shared_future<ShaderCompileResult> Renderer::QueueShader(const std::wstring& path, ShaderType shaderType,
+    const D3D_SHADER_MACRO* pDefines)
+{
+    ShaderCompileArgs args;
+    if (!MakeShaderArgs(path, shaderType, pDefines, args))
+    {
+        ShaderCompileResult invalidResult;
+        invalidResult.result = E_INVALIDARG;
 
-    if (!SUCCEEDED(result) && pErrMsg != nullptr)
+        std::promise<ShaderCompileResult> invalid;
+        invalid.set_value(invalidResult);
+        return invalid.get_future().share();
+    }
+
+    // Shaders built into the executable need neither the source files nor the compiler
+    ShaderCompileResult embedded;
+    if (FindEmbeddedShader(args, embedded.bytecode, &embedded.dependencies))
     {
-        OutputDebugStringA((const char*)pErrMsg->GetBufferPointer());
+        embedded.result = S_OK;
+
+        std::promise<ShaderCompileResult> ready;
+        ready.set_value(embedded);
+        return ready.get_future().share();
     }
 
-    assert(SUCCEEDED(result));
+    if (GetEmbeddedShaderCount() != 0)
+    {
+        std::wstring message = L"Shader " + path + L" is not embedded, compiling it\n";
+        OutputDebugStringW(message.c_str());
+    }
+
+    return m_pShaderQueue->Enqueue(args);
+}
+
+HRESULT Renderer::CreateShader(const std::wstring& path, ShaderType shaderType, ID3D11DeviceChild** ppShader, ID3DBlob** ppCode,
+    const D3D_SHADER_MACRO* pDefines)
+{
+    std::shared_future<ShaderCompileResult> job = QueueShader(path, shaderType, pDefines);
+
+    const ShaderCompileResult& compiled = job.get();
+    const AssetView& code = compiled.bytecode;
+    const std::string& messages = compiled.messages;
+    HRESULT result = compiled.result;
 
-    if (pErrMsg != nullptr)
+
+    if (!SUCCEEDED(result) && !messages.empty())
     {
-        pErrMsg->Release();
+        OutputDebugStringA(messages.c_str());
     }
 
+    assert(SUCCEEDED(result));
+
 
     if (SUCCEEDED(result))
     {
-        if (shaderType == ShaderType::Vertex)
-        {
-            ID3D11VertexShader* pVertexShader = nullptr;
+        result = CreateShaderFromBytecode(shaderType, code, ppShader);
+    }
 
-            result = m_pDevice->CreateVertexShader(pCode->GetBufferPointer(), pCode->GetBufferSize(), nullptr, &pVertexShader);
+    // A shader that failed to compile is tracked as well, fixing the source brings it in
+    ShaderCompileArgs args;
+    if (!compiled.dependencies.empty() && MakeShaderArgs(path, shaderType, pDefines, args))
+    {
+        m_pShaderHotReload->Track(args, compiled.dependencies, [this, shaderType, ppShader](const AssetView& bytecode)
+        {
+            ID3D11DeviceChild* pShader = nullptr;
+            if (FAILED(CreateShaderFromBytecode(shaderType, bytecode, &pShader)))
+            {
+                return false;
+            }
 
-            if (SUCCEEDED(result))
+            // The context keeps its own reference to a shader still bound
+            if (*ppShader != nullptr)
             {
-                *ppShader = pVertexShader;
+                (*ppShader)->Release();
             }
+            *ppShader = pShader;
+
+            return true;
+        });
+    }
+
+    // Input layouts are validated against the vertex shader signature, so callers get a copy
+    if (SUCCEEDED(result) && ppCode)
+    {
+        result = D3DCreateBlob(code.size, ppCode);
+
+        if (SUCCEEDED(result))
+        {
+            memcpy((*ppCode)->GetBufferPointer(), code.pData, code.size);
         }
-        else if (shaderType == ShaderType::Pixel)
+    }
+
+    return result;
+}
+
+HRESULT Renderer::CreateShaderFromBytecode(ShaderType shaderType, const AssetView& code, ID3D11DeviceChild** ppShader)
+{
+    HRESULT result = E_INVALIDARG;
+
+    if (shaderType == ShaderType::Vertex)
+    {
+        ID3D11VertexShader* pVertexShader = nullptr;
+
+        result = m_pDevice->CreateVertexShader(code.pData, code.size, nullptr, &pVertexShader);
+
+        if (SUCCEEDED(result))
         {
-            ID3D11PixelShader* pPixelShader = nullptr;
+            *ppShader = pVertexShader;
+        }
+    }
+    else if (shaderType == ShaderType::Pixel)
+    {
+        ID3D11PixelShader* pPixelShader = nullptr;
 
-            result = m_pDevice->CreatePixelShader(pCode->GetBufferPointer(), pCode->GetBufferSize(), nullptr, &pPixelShader);
+        result = m_pDevice->CreatePixelShader(code.pData, code.size, nullptr, &pPixelShader);
 
-            if (SUCCEEDED(result))
-            {
-                *ppShader = pPixelShader;
-            }
+        if (SUCCEEDED(result))
+        {
+            *ppShader = pPixelShader;
         }
     }
 
-    if (ppCode)
+    return result;
+}
+
+ShaderPermutation Renderer::MakePermutation(UINT32 features) const
+{
+    return ShaderPermutation::Make(features, (UINT32)m_pScene->lightCount.x);
+}
+
+UINT32 Renderer::GetCubeFeatures(float shine) const
+{
+    return m_normalMapFeatures | (shine > 0.0f ? ShaderFeatureSpecular : 0);
+}
+
+void Renderer::QueuePixelShader(const std::wstring& path, UINT32 features)
+{
+    ShaderPermutationDefines defines(MakePermutation(features));
+    QueueShader(path, ShaderType::Pixel, defines.Get());
+}
+
+ID3D11PixelShader* Renderer::GetPixelShader(const std::wstring& path, UINT32 features)
+{
+    PixelShaderVariant variant(path, MakePermutation(features));
+
+    auto it = m_pixelShaders.find(variant);
+    if (it != m_pixelShaders.end())
     {
-        *ppCode = pCode;
+        return it->second;
     }
-    else
+
+    ShaderPermutationDefines defines(variant.second);
+
+    // A failed variant is not compiled again every frame, the entry also gives hot reload a stable slot
+    it = m_pixelShaders.emplace(variant, nullptr).first;
+
+    HRESULT result = CreateShader(path, ShaderType::Pixel, (ID3D11DeviceChild**)&it->second, nullptr, defines.Get());
+    ID3D11PixelShader* pShader = it->second;
+
+    if (SUCCEEDED(result))
     {
-        pCode->Release();
+        std::string name = "PixelShader";
+        for (const D3D_SHADER_MACRO* pDefine = defines.Get(); pDefine->Name != nullptr; pDefine++)
+        {
+            name = name + " " + pDefine->Name + "=" + pDefine->Definition;
+        }
+
+        pShader->SetPrivateData(WKPDID_D3DDebugObjectName, (UINT)name.length(), name.c_str());
     }
 
-    return result;
+    return pShader;
 }
 
 
@@ -1444,150 +1537,187 @@ HRESULT Renderer::CreateRasterizerState()
 }
 
 
-HRESULT Renderer::LoadTexture()
+HRESULT Renderer::CreateTexture(const TextureDesc& textureDesc, const std::string& name,
+    ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView, UINT64 contentKey)
 {
-    DXGI_FORMAT textureFmt;
-    HRESULT result;
+    std::vector<D3D11_SUBRESOURCE_DATA> data;
+    data.resize(textureDesc.subresources.size());
 
-    const std::wstring TextureName = L"../textures/bricks2.dds";
+    for (UINT32 i = 0; i < (UINT32)data.size(); i++)
+    {
+        data[i].pSysMem = textureDesc.GetSubresourceData(i);
+        data[i].SysMemPitch = textureDesc.subresources[i].rowPitch;
+        data[i].SysMemSlicePitch = textureDesc.subresources[i].slicePitch;
+    }
 
-    TextureDesc textureDesc;
-    bool ddsRes = LoadDDS(TextureName.c_str(), textureDesc);
+    return CreateTexture(textureDesc, data.data(), name, ppTexture, ppView, contentKey);
+}
 
-    textureFmt = textureDesc.fmt;
 
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Format = textureDesc.fmt;
-    desc.ArraySize = 1;
-    desc.MipLevels = textureDesc.mipmapsCount;
-    desc.Usage = D3D11_USAGE_IMMUTABLE;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-    desc.Height = textureDesc.height;
-    desc.Width = textureDesc.width;
-
-    UINT32 blockWidth = DivUp(desc.Width, 4u);
-    UINT32 blockHeight = DivUp(desc.Height, 4u);
-    UINT32 pitch = blockWidth * GetBytesPerBlock(desc.Format);
+HRESULT Renderer::CreateTexture(const TextureDesc& textureDesc, const D3D11_SUBRESOURCE_DATA* pData,
+    const std::string& name, ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView, UINT64 contentKey)
+{
+    // Identical texels are shared with every other renderer on the same device
+    return TextureCache::GetDefault().Acquire(m_pDevice, textureDesc, pData, name, ppTexture, ppView, contentKey);
+}
 
-    const char* pSrcData = reinterpret_cast<const char*>(textureDesc.pData);
 
-    std::vector<D3D11_SUBRESOURCE_DATA> data;
-    data.resize(desc.MipLevels);
+HRESULT Renderer::LoadTextures()
+{
+    enum TextureIndex
+    {
+        SkyboxTexture,
+        FirstFaceTexture,
+        TextureCount = FirstFaceTexture + 6
+    };
 
-    for (UINT32 i = 0; i < desc.MipLevels; i++)
+    const std::vector<DDSBatchItem> Items =
     {
-        data[i].pSysMem = pSrcData;
-        data[i].SysMemPitch = pitch;
-        data[i].SysMemSlicePitch = 0;
+        // Sky files ship without mips, generated chains are cached next to them
+        { L"../textures/skybox.dds", false, true },
+        { L"../textures/px.dds", false, true }, { L"../textures/nx.dds", false, true },
+        { L"../textures/py.dds", false, true }, { L"../textures/ny.dds", false, true },
+        { L"../textures/pz.dds", false, true }, { L"../textures/nz.dds", false, true }
+    };
 
-        pSrcData += pitch * blockHeight;
-        blockHeight = std::max(1u, blockHeight / 2);
-        blockWidth = std::max(1u, blockWidth / 2);
-        pitch = blockWidth * GetBytesPerBlock(desc.Format);
-    }
+    HRESULT result = S_OK;
 
-    result = m_pDevice->CreateTexture2D(&desc, data.data(), &m_pTexture);
-    assert(SUCCEEDED(result));
+    // Bricks start with their mip tail only, finer mips are streamed in on demand
+    m_pTextureStreamer = new TextureStreamer();
 
-    if (SUCCEEDED(result))
+    TextureDesc tailDesc;
+    TextureDesc normalTailDesc;
+    if (!m_pTextureStreamer->Register(L"../textures/bricks2.dds", m_textureId, tailDesc)
+        || !m_pTextureStreamer->Register(L"../textures/bricks_normal.dds", m_normalTextureId, normalTailDesc))
     {
+        return E_FAIL;
+    }
 
-        result = m_pTexture->SetPrivateData(WKPDID_D3DDebugObjectName,
-            (UINT)TextureName.length(), TextureName.c_str());
+    // The layers go into the arrays of their format, whatever material they belong to
+    m_bricksMaterial = m_materialArrays.AddMaterial(tailDesc, &normalTailDesc);
+    if (m_bricksMaterial == TextureArrayBuilder::InvalidMaterial)
+    {
+        return E_FAIL;
     }
+    result = UpdateMaterialArrays();
 
-    free(textureDesc.pData);
-    
+    TextureDesc cubeDescs[7];
+    bool isLoaded[TextureCount] = {};
 
-    if (SUCCEEDED(result))
+    // Files are read concurrently, textures are created here as soon as each one is ready
+    LoadDDSBatch(Items, [&](size_t index, bool success, TextureDesc& desc)
     {
-        D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
+        isLoaded[index] = success;
+        if (!success || FAILED(result))
+        {
+            return;
+        }
 
-        desc.Format = textureFmt;
-        desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-        desc.Texture2D.MipLevels = textureDesc.mipmapsCount;
-        desc.Texture2D.MostDetailedMip = 0;
+        cubeDescs[index - SkyboxTexture] = std::move(desc);
+    }, DDSLoadMode::Mapped);
 
-        result = m_pDevice->CreateShaderResourceView(m_pTexture, &desc, &m_pTextureView);
+    if (SUCCEEDED(result))
+    {
+        if (isLoaded[SkyboxTexture] && cubeDescs[0].isCubemap)
+        {
+            result = InitCubemap(cubeDescs[0], nullptr);
+        }
+        else if (std::all_of(isLoaded + FirstFaceTexture, isLoaded + TextureCount, [](bool loaded) { return loaded; }))
+        {
+            result = InitCubemap(cubeDescs[0], cubeDescs + 1);
+        }
+        else
+        {
+            result = E_FAIL;
+        }
         assert(SUCCEEDED(result));
     }
 
     return result;
 }
 
-HRESULT Renderer::LoadNormalTexture()
-{
-    DXGI_FORMAT textureFmt;
-    HRESULT result = S_OK;
 
-    const std::wstring TextureName = L"../textures/bricks_normal.dds";
+void Renderer::UpdateStreamedTextures(const XMFLOAT4& cameraPos, float c)
+{
+    // Both bricks cubes are unit sized and show the whole texture on every face
+    static const XMFLOAT3 CubeCenters[] = { XMFLOAT3{ 0.0f, 0.0f, 0.0f }, XMFLOAT3{ 2.0f, 0.0f, 0.0f } };
 
-    TextureDesc textureDesc;
-    bool ddsRes = LoadDDS(TextureName.c_str(), textureDesc);
+    float screenSize = 0.0f;
+    for (const XMFLOAT3& center : CubeCenters)
+    {
+        float dx = cameraPos.x - center.x;
+        float dy = cameraPos.y - center.y;
+        float dz = cameraPos.z - center.z;
+        float distance = std::max(sqrtf(dx * dx + dy * dy + dz * dz), 0.1f);
 
-    textureFmt = textureDesc.fmt;
+        screenSize = std::max(screenSize, c * m_width / (2.0f * distance));
+    }
 
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Format = textureDesc.fmt;
-    desc.ArraySize = 1;
-    desc.MipLevels = textureDesc.mipmapsCount;
-    desc.Usage = D3D11_USAGE_IMMUTABLE;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-    desc.Height = textureDesc.height;
-    desc.Width = textureDesc.width;
+    m_pTextureStreamer->RequestScreenSize(m_textureId, screenSize);
+    m_pTextureStreamer->RequestScreenSize(m_normalTextureId, screenSize);
 
-    UINT32 blockWidth = DivUp(desc.Width, 4u);
-    UINT32 blockHeight = DivUp(desc.Height, 4u);
-    UINT32 pitch = blockWidth * GetBytesPerBlock(desc.Format);
-    const char* pSrcData = reinterpret_cast<const char*>(textureDesc.pData);
+    std::vector<TextureStreamerUpdate> updates;
+    m_pTextureStreamer->Update(updates);
 
-    std::vector<D3D11_SUBRESOURCE_DATA> data;
-    data.resize(desc.MipLevels);
-    for (UINT32 i = 0; i < desc.MipLevels; i++)
+    if (updates.empty())
     {
-        data[i].pSysMem = pSrcData;
-        data[i].SysMemPitch = pitch;
-        data[i].SysMemSlicePitch = 0;
-
-        pSrcData += pitch * blockHeight;
-        blockHeight = std::max(1u, blockHeight / 2);
-        blockWidth = std::max(1u, blockWidth / 2);
-        pitch = blockWidth * GetBytesPerBlock(desc.Format);
+        return;
     }
-    result = m_pDevice->CreateTexture2D(&desc, data.data(), &m_pNormalTexture);
-    assert(SUCCEEDED(result));
 
-    if (SUCCEEDED(result))
+    // Streamed mips arrive already keyed, the render thread does not touch every texel
+    for (const TextureStreamerUpdate& update : updates)
     {
-        result = m_pNormalTexture->SetPrivateData(WKPDID_D3DDebugObjectName,
-            (UINT)TextureName.length(), TextureName.c_str());
+        bool isNormal = update.id == m_normalTextureId;
+
+        bool isReplaced = m_materialArrays.ReplaceLayer(m_bricksMaterial, isNormal, update.desc, update.contentKey);
+        assert(isReplaced);
     }
 
-    free(textureDesc.pData);
+    HRESULT result = UpdateMaterialArrays();
+    assert(SUCCEEDED(result));
+}
 
 
-    if (SUCCEEDED(result))
+HRESULT Renderer::UpdateMaterialArrays()
+{
+    m_arrayViews.resize(m_materialArrays.GetArrayCount(), nullptr);
+
+    // Arrays are immutable, one whose slices changed is created again and replaces the old one
+    for (UINT32 i = 0; i < m_materialArrays.GetArrayCount(); i++)
     {
-        D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
+        if (!m_materialArrays.IsDirty(i))
+        {
+            continue;
+        }
 
-        desc.Format = textureFmt;
-        desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-        desc.Texture2D.MipLevels = textureDesc.mipmapsCount;
-        desc.Texture2D.MostDetailedMip = 0;
+        ID3D11ShaderResourceView* pView = nullptr;
+        if (m_materialArrays.GetLiveSliceCount(i) != 0)
+        {
+            TextureDesc arrayDesc;
+            std::vector<D3D11_SUBRESOURCE_DATA> data;
+            UINT64 contentKey = 0;
+            if (!m_materialArrays.Build(i, arrayDesc, data, false, &contentKey))
+            {
+                return E_FAIL;
+            }
 
-        result = m_pDevice->CreateShaderResourceView(m_pNormalTexture, &desc, &m_pNormalTextureView);
-        assert(SUCCEEDED(result));
+            ID3D11Texture2D* pTexture = nullptr;
+            HRESULT result = CreateTexture(arrayDesc, data.data(), "MaterialArray" + std::to_string(i),
+                &pTexture, &pView, contentKey);
+            if (FAILED(result))
+            {
+                return result;
+            }
+        }
+
+        if (m_arrayViews[i] != nullptr)
+        {
+            TextureCache::GetDefault().Release(m_arrayViews[i]);
+        }
+        m_arrayViews[i] = pView;
     }
 
-    return result;
+    return S_OK;
 }
 
 
@@ -1656,30 +1786,13 @@ HRESULT Renderer::InitSphere()
 
 
 
-HRESULT Renderer::InitLights(int i)
+HRESULT Renderer::InitLightShaders()
 {
     static const D3D11_INPUT_ELEMENT_DESC InputDesc[] = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0}
     };
 
     HRESULT result = S_OK;
-    static const size_t SphereSteps = 128;
-
-    m_pLights[i] = new Sphere();
-
-    m_pLights[i]->GetSphereDataSize(SphereSteps);
-    m_pLights[i]->CreateSphere();
-    m_pLights[i]->Scale();
-
-    if (SUCCEEDED(result))
-    {
-        m_pLights[i]->CreateVertexBuffer(m_pDevice);
-    }
-
-    if (SUCCEEDED(result))
-    {
-        m_pLights[i]->CreateIndexBuffer(m_pDevice);
-    }
 
     ID3DBlob* pLightVertexShaderCode = nullptr;
 
@@ -1712,6 +1825,31 @@ HRESULT Renderer::InitLights(int i)
         pLightVertexShaderCode = nullptr;
     }
 
+    return result;
+}
+
+
+HRESULT Renderer::InitLights(int i)
+{
+    HRESULT result = S_OK;
+    static const size_t SphereSteps = 128;
+
+    m_pLights[i] = new Sphere();
+
+    m_pLights[i]->GetSphereDataSize(SphereSteps);
+    m_pLights[i]->CreateSphere();
+    m_pLights[i]->Scale();
+
+    if (SUCCEEDED(result))
+    {
+        m_pLights[i]->CreateVertexBuffer(m_pDevice);
+    }
+
+    if (SUCCEEDED(result))
+    {
+        m_pLights[i]->CreateIndexBuffer(m_pDevice);
+    }
+
     if (SUCCEEDED(result))
     {
         m_pLights[i]->CreateGeometryBuffer(m_pDevice, m_pScene->lights[i].color);
@@ -1746,11 +1884,6 @@ HRESULT Renderer::InitRect()
         result = CreateShader(L"VertexRectangleShader.hlsl", ShaderType::Vertex, (ID3D11DeviceChild**)&m_pRectVertexShader, &pRectangleVertexShaderCode);
     }
 
-    if (SUCCEEDED(result))
-    {
-        result = CreateShader(L"PixelRectangleShader.hlsl", ShaderType::Pixel, (ID3D11DeviceChild**)&m_pRectPixelShader);
-    }
-
     if (SUCCEEDED(result))
     {
         result = m_pDevice->CreateInputLayout(m_pRect->InputDesc, 2, pRectangleVertexShaderCode->GetBufferPointer(), 
@@ -1789,98 +1922,59 @@ HRESULT Renderer::InitRect()
 }
 
 
-HRESULT Renderer::InitCubemap()
+HRESULT Renderer::InitCubemap(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs)
 {
-    HRESULT result = S_OK;
-
-    DXGI_FORMAT textureFmt;
-
-    if (SUCCEEDED(result))
+    // Single-file cubemap is preferred, separate faces are a fallback
+    if (pFaceDescs == nullptr)
     {
-        const std::wstring TextureNames[6] =
-        {
-            L"../textures/px.dds", L"../textures/nx.dds",
-            L"../textures/py.dds", L"../textures/ny.dds",
-            L"../textures/pz.dds", L"../textures/nz.dds"
-        };
+        UpdateAmbient(cubeDesc, nullptr);
+        return CreateTexture(cubeDesc, "CubemapTexture", &m_pCubemapTexture, &m_pCubemapView);
+    }
 
-        TextureDesc texDescs[6];
-        bool ddsRes = true;
+    UpdateAmbient(cubeDesc, pFaceDescs);
 
-        for (int i = 0; i < 6 && ddsRes; i++)
+    // A face left without generated mips limits the whole cube
+    TextureArrayBuilder builder;
+    for (UINT32 i = 0; i < 6; i++)
+    {
+        TextureArraySlice slice;
+        if (!builder.Add(pFaceDescs[i], slice) || slice.arrayIndex != 0 || slice.slice != i)
         {
-            ddsRes = LoadDDS(TextureNames[i].c_str(), texDescs[i], true);
+            return E_FAIL;
         }
+    }
 
-        textureFmt = texDescs[0].fmt;
-
-        D3D11_TEXTURE2D_DESC desc = {};
-        desc.Format = textureFmt;
-        desc.ArraySize = 6;
-        desc.MipLevels = 1;
-        desc.Usage = D3D11_USAGE_IMMUTABLE;
-        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.CPUAccessFlags = 0;
-        desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
-        desc.SampleDesc.Count = 1;
-        desc.SampleDesc.Quality = 0;
-        desc.Height = texDescs[0].height;
-        desc.Width = texDescs[0].width;
-
-        UINT32 blockWidth = DivUp(desc.Width, 4u);
-        UINT32 blockHeight = DivUp(desc.Height, 4u);
-        UINT32 pitch = blockWidth * GetBytesPerBlock(desc.Format);
-
-        D3D11_SUBRESOURCE_DATA data[6];
+    TextureDesc facesDesc;
+    std::vector<D3D11_SUBRESOURCE_DATA> data;
+    UINT64 contentKey = 0;
+    if (!builder.Build(0, facesDesc, data, true, &contentKey))
+    {
+        return E_FAIL;
+    }
 
-        for (int i = 0; i < 6; i++)
-        {
-            data[i].pSysMem = texDescs[i].pData;
-            data[i].SysMemPitch = pitch;
-            data[i].SysMemSlicePitch = 0;
-        }
+    return CreateTexture(facesDesc, data.data(), "CubemapTexture", &m_pCubemapTexture, &m_pCubemapView, contentKey);
+}
 
-        result = m_pDevice->CreateTexture2D(&desc, data, &m_pCubemapTexture);
-        assert(SUCCEEDED(result));
-      
-        if (SUCCEEDED(result))
-        {
-            std::string name = "CubemapTexture";
 
-            result = m_pCubemapTexture->SetPrivateData(WKPDID_D3DDebugObjectName,
-                (UINT)name.length(), name.c_str());
-        }
+void Renderer::UpdateAmbient(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs)
+{
+    SHIrradiance irradiance;
+    bool isProjected = pFaceDescs == nullptr
+        ? ProjectCubemapToSH(cubeDesc, irradiance, AmbientFaceSize)
+        : ProjectCubemapFacesToSH(pFaceDescs, irradiance, AmbientFaceSize);
 
-        for (int i = 0; i < 6; i++)
-        {
-            if (texDescs[i].pData)
-            {
-                free(texDescs[i].pData);
-            }
-        }
+    // Formats the CPU can not decode keep the constant ambient
+    if (!isProjected)
+    {
+        return;
     }
 
-
-    if (SUCCEEDED(result))
+    for (UINT32 i = 0; i < SHCoefficientCount; i++)
     {
-        D3D11_SHADER_RESOURCE_VIEW_DESC desc;
-        desc.Format = textureFmt;
-        desc.ViewDimension = D3D_SRV_DIMENSION_TEXTURECUBE;
-        desc.TextureCube.MipLevels = 1;
-        desc.TextureCube.MostDetailedMip = 0;
-
-        result = m_pDevice->CreateShaderResourceView(m_pCubemapTexture, &desc, &m_pCubemapView);
-     
-        if (SUCCEEDED(result))
-        {
-            std::string name = "CubemapView";
-
-            result = m_pCubemapView->SetPrivateData(WKPDID_D3DDebugObjectName,
-                (UINT)name.length(), name.c_str());
-        }
+        const XMFLOAT4& coefficient = irradiance.coefficients[i];
+        m_pScene->ambientSH[i] = XMFLOAT4(coefficient.x * AmbientIntensity, coefficient.y * AmbientIntensity,
+            coefficient.z * AmbientIntensity, 0.0f);
     }
-
-    return result;
 }
 
 
@@ -1949,7 +2043,7 @@ void Renderer::RenderRectangles()
     m_pDeviceContext->IASetInputLayout(m_pRectInputLayout);
     m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     m_pDeviceContext->VSSetShader(m_pRectVertexShader, nullptr, 0);
-    m_pDeviceContext->PSSetShader(m_pRectPixelShader, nullptr, 0);
+    m_pDeviceContext->PSSetShader(GetPixelShader(L"PixelRectangleShader.hlsl", ShaderFeatureTranslucent), nullptr, 0);
 
     XMFLOAT3 cameraPos;
     XMFLOAT3 rectPos;
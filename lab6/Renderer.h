@@ -8,6 +8,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <map>
 
 #include <corecrt_math_defines.h>
 
@@ -17,6 +18,14 @@
 
 #include "framework.h"
 
+#include "DDS.h"
+#include "TextureStreamer.h"
+#include "TextureArrayBuilder.h"
+#include "SphericalHarmonics.h"
+#include "ShaderCompileQueue.h"
+#include "ShaderHotReload.h"
+#include "SceneMath.h"
+#include "ShaderPermutation.h"
 #include "Sphere.h"
 #include "Rectangle.h"
 
@@ -31,14 +40,7 @@ struct GeomBuffer
     DirectX::XMMATRIX m;
     DirectX::XMMATRIX normalMatrix;
     XMFLOAT4 shine;
-};
-
-struct Camera
-{
-    XMFLOAT3 poi;
-    float r;
-    float phi;
-    float theta;
+    UINT32 material[4];     ///< Row of the material table: diffuse array and slice, normal array and slice
 };
 
 struct TextureNormalVertex
@@ -61,7 +63,7 @@ struct SceneBuffer
     XMFLOAT4 cameraPos;
     XMFLOAT4 lightCount;
     Light lights[10];
-    XMFLOAT4 ambientColor;
+    XMFLOAT4 ambientSH[SHCoefficientCount];     ///< SHIrradiance of the environment
 };
 
 class Renderer
@@ -75,7 +77,6 @@ public:
         , m_pBackBufferRTV(nullptr)
         , m_width(16)
         , m_height(16)
-        , m_pPixelShader(nullptr)
         , m_pVertexShader(nullptr)
         , m_pInputLayout(nullptr)
         , m_pVertexBuffer(nullptr)
@@ -86,8 +87,6 @@ public:
         , m_prevUSec(0)
         , m_angle(0.0)
         , PressedKeys{ false }
-        , m_pTexture(nullptr)
-        , m_pTextureView(nullptr)
         , m_pSampler(nullptr)
         , m_pSpherePixelShader(nullptr)
         , m_pSphereVertexShader(nullptr)
@@ -101,7 +100,6 @@ public:
         , m_pDepthState(nullptr)
         , m_pTransDepthState(nullptr)
         , m_pTransBlendState(nullptr)
-        , m_pRectPixelShader(nullptr)
         , m_pRectVertexShader(nullptr)
         , m_pRectInputLayout(nullptr)
         , m_pRasterState(nullptr)
@@ -112,8 +110,15 @@ public:
         , m_pLightPixelShader(nullptr)
         , m_pScene(nullptr)
         , m_pNoTransBlendState(nullptr)
-        , m_pNormalTextureView(nullptr)
-        , m_pNormalTexture(nullptr)
+        , m_pTextureStreamer(nullptr)
+        , m_textureId(0)
+        , m_normalTextureId(0)
+        , m_bricksMaterial(TextureArrayBuilder::InvalidMaterial)
+        , m_pShaderCompiler(nullptr)
+        , m_pShaderCache(nullptr)
+        , m_pShaderQueue(nullptr)
+        , m_pShaderHotReload(nullptr)
+        , m_normalMapFeatures(0)
     {
     }
 
@@ -136,8 +141,23 @@ private:
     HRESULT SetupBackBuffer();
     HRESULT InitScene();
 
+    bool MakeShaderArgs(const std::wstring& path, ShaderType shaderType, const D3D_SHADER_MACRO* pDefines,
+        ShaderCompileArgs& args) const;
+    /** Starts compiling on the worker threads, CreateShader with the same arguments waits for this job */
+    std::shared_future<ShaderCompileResult> QueueShader(const std::wstring& path, ShaderType shaderType,
+        const D3D_SHADER_MACRO* pDefines = nullptr);
+    /** The shader at *ppShader is replaced when its sources change, so ppShader has to stay valid */
     HRESULT CreateShader(const std::wstring& path, ShaderType shaderType,
-        ID3D11DeviceChild** ppShader, ID3DBlob** ppCode = nullptr);
+        ID3D11DeviceChild** ppShader, ID3DBlob** ppCode = nullptr, const D3D_SHADER_MACRO* pDefines = nullptr);
+    HRESULT CreateShaderFromBytecode(ShaderType shaderType, const AssetView& code, ID3D11DeviceChild** ppShader);
+
+    /** Variant of a lit pixel shader with the features for the current light count, compiled on first use */
+    ID3D11PixelShader* GetPixelShader(const std::wstring& path, UINT32 features);
+    /** Starts compiling the variant GetPixelShader will ask for */
+    void QueuePixelShader(const std::wstring& path, UINT32 features);
+    ShaderPermutation MakePermutation(UINT32 features) const;
+    /** Features of the textured cubes, specular only if the material has a highlight */
+    UINT32 GetCubeFeatures(float shine) const;
 
     void UpdateCamera(double deltaSec);
 
@@ -151,12 +171,22 @@ private:
     HRESULT CreateBlendState();
     HRESULT CreateRasterizerState();
 
-    HRESULT LoadTexture();
-    HRESULT LoadNormalTexture();
+    HRESULT CreateTexture(const TextureDesc& textureDesc, const std::string& name,
+        ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView, UINT64 contentKey = 0);
+    HRESULT CreateTexture(const TextureDesc& textureDesc, const D3D11_SUBRESOURCE_DATA* pData, const std::string& name,
+        ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView, UINT64 contentKey = 0);
+
+    HRESULT LoadTextures();
+    HRESULT UpdateMaterialArrays();
+    void UpdateStreamedTextures(const XMFLOAT4& cameraPos, float c);
 
     HRESULT InitSphere();
     HRESULT InitRect();
-    HRESULT InitCubemap();
+    HRESULT InitCubemap(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs);
+    /** Projects the environment to the ambient SH, to be called again whenever it changes */
+    void UpdateAmbient(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs);
+    /** Shaders and input layout shared by all light spheres */
+    HRESULT InitLightShaders();
     HRESULT InitLights(int idx);
 
     void RenderLights(int idx);
@@ -187,6 +217,9 @@ private:
     static const float CameraRotationSpeed;
     static const float CameraMovingSpeed;
     static const float ModelRotationSpeed;
+    static const float AmbientIntensity;        ///< Share of the sky irradiance lighting the scene
+    static const UINT32 AmbientFaceSize;        ///< Largest cubemap face projected to the ambient SH
+    static const float CubeShininess[2];        ///< Specular power of the two cubes, 0 for none
 
     bool PressedKeys[1024];
 
@@ -208,17 +241,29 @@ private:
     ID3D11BlendState* m_pNoTransBlendState;
 
 
-    ID3D11PixelShader*  m_pPixelShader;
     ID3D11VertexShader* m_pVertexShader;
 
     ID3D11InputLayout* m_pInputLayout;
 
-    ID3D11Texture2D* m_pTexture;
-    ID3D11Texture2D* m_pNormalTexture;
-    ID3D11ShaderResourceView*   m_pTextureView;
-    ID3D11ShaderResourceView*   m_pNormalTextureView;
     ID3D11SamplerState*         m_pSampler;
 
+    TextureArrayBuilder m_materialArrays;                   ///< Layers of the materials, one array per format and size
+    std::vector<ID3D11ShaderResourceView*> m_arrayViews;    ///< Indexed like the arrays, nullptr for empty ones
+    UINT32 m_bricksMaterial;
+
+    TextureStreamer* m_pTextureStreamer;
+    UINT32 m_textureId;             ///< Streamer id of the diffuse layer of the bricks material
+    UINT32 m_normalTextureId;       ///< Streamer id of its normal layer
+
+    IShaderCompiler* m_pShaderCompiler;
+    ShaderCache* m_pShaderCache;
+    ShaderCompileQueue* m_pShaderQueue;
+    ShaderHotReload* m_pShaderHotReload;
+
+    using PixelShaderVariant = std::pair<std::wstring, ShaderPermutation>;
+    std::map<PixelShaderVariant, ID3D11PixelShader*> m_pixelShaders;    ///< Failed variants are kept as nullptr
+    UINT32 m_normalMapFeatures;     ///< ShaderFeature bits matching the format of the normal layers
+
 
     ID3D11PixelShader*  m_pSpherePixelShader;
     ID3D11VertexShader* m_pSphereVertexShader;
@@ -228,7 +273,6 @@ private:
     ID3D11VertexShader* m_pLightVertexShader;
     ID3D11InputLayout* m_pLightInputLayout;
 
-    ID3D11PixelShader* m_pRectPixelShader;
     ID3D11VertexShader* m_pRectVertexShader;
     ID3D11InputLayout* m_pRectInputLayout;
 
@@ -0,0 +1,44 @@
+#include "framework.h"
+
+#include "SceneMath.h"
+
+#include <math.h>
+
+DirectX::XMMATRIX ComputeModelMatrix(float angle)
+{
+    return DirectX::XMMatrixRotationAxis(DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 1.0f), angle);
+}
+
+DirectX::XMMATRIX ComputeNormalMatrix(const DirectX::XMMATRIX& model)
+{
+    return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, model));
+}
+
+CameraMatrices ComputeCameraMatrices(const Camera& camera, UINT32 width, UINT32 height)
+{
+    CameraMatrices result;
+
+    float posX = camera.poi.x + cosf(camera.theta) * cosf(camera.phi) * camera.r;
+    float posY = camera.poi.y + sinf(camera.theta) * camera.r;
+    float posZ = camera.poi.z + cosf(camera.theta) * sinf(camera.phi) * camera.r;
+
+    float upTheta = camera.theta + 3.14159265f / 2;
+
+    float upX = cosf(upTheta) * cosf(camera.phi);
+    float upY = sinf(upTheta);
+    float upZ = cosf(upTheta) * sinf(camera.phi);
+
+    result.view = DirectX::XMMatrixLookAtLH(
+        DirectX::XMVectorSet(posX, posY, posZ, 0.0f),
+        DirectX::XMVectorSet(camera.poi.x, camera.poi.y, camera.poi.z, 0.0f),
+        DirectX::XMVectorSet(upX, upY, upZ, 0.0f)
+    );
+    result.position = { posX, posY, posZ };
+
+    float n = CameraNearZ;
+    float aspectRatio = (float)height / width;
+    result.projection = DirectX::XMMatrixPerspectiveLH(tanf(CameraFov / 2) * 2 * n, tanf(CameraFov / 2) * 2 * n * aspectRatio, n, CameraFarZ);
+    result.projectionScale = 1.0f / tanf(CameraFov / 2);
+
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "framework.h"
+
+#include "XMFLOAT3.h"
+#include "XMFLOAT4.h"
+
+// The matrices Renderer::Update builds each frame, kept apart from the D3D code so they
+// build with PortableMath and can be tested and timed without a device.
+
+struct Camera
+{
+    XMFLOAT3 poi;
+    float r;
+    float phi;
+    float theta;
+};
+
+/** Vertical field of view of the scene camera, in radians */
+const float CameraFov = 3.14159265f / 3;
+const float CameraNearZ = 0.1f;
+const float CameraFarZ = 100.0f;
+
+struct CameraMatrices
+{
+    DirectX::XMMATRIX view;
+    DirectX::XMMATRIX projection;
+    XMFLOAT4 position;              ///< w is 0
+    float projectionScale = 0.0f;   ///< 1 / tan(fov / 2), screen size of a unit at unit distance
+};
+
+/** The cube spun about the Y axis by angle radians */
+DirectX::XMMATRIX ComputeModelMatrix(float angle);
+
+/** Transposed inverse of model, it takes normals to world space in the vertex shader */
+DirectX::XMMATRIX ComputeNormalMatrix(const DirectX::XMMATRIX& model);
+
+/** View from the orbit camera and perspective projection for a width x height viewport */
+CameraMatrices ComputeCameraMatrices(const Camera& camera, UINT32 width, UINT32 height);
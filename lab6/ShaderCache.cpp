@@ -0,0 +1,289 @@
+#include "framework.h"
+
+#include "ShaderCache.h"
+#include "ContentHash.h"
+#include "ShaderSourceCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <set>
+
+namespace
+{
+
+    const UINT32 ShaderCacheSignature = 0x43444853;     ///< "SHDC"
+    const UINT32 ShaderCacheVersion = 1;
+
+#pragma pack(push)
+#pragma pack(1)
+
+    /** Header of a <key>.cso cache entry, the bytecode follows */
+    struct ShaderCacheHeader
+    {
+        UINT32 signature;
+        UINT32 version;
+        UINT64 key;
+        UINT64 size;
+    };
+
+#pragma pack(pop)
+
+    /** Names of the files the source includes, conditional includes are taken as well */
+    void FindIncludes(const char* pText, size_t size, std::vector<std::string>& names)
+    {
+        const char* pEnd = pText + size;
+        const char* pLine = pText;
+
+        while (pLine < pEnd)
+        {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', pEnd - pLine));
+            if (pLineEnd == nullptr)
+            {
+                pLineEnd = pEnd;
+            }
+
+            const char* p = pLine;
+            while (p < pLineEnd && (*p == ' ' || *p == '\t'))
+            {
+                p++;
+            }
+
+            if (p < pLineEnd && *p == '#')
+            {
+                p++;
+                while (p < pLineEnd && (*p == ' ' || *p == '\t'))
+                {
+                    p++;
+                }
+
+                const size_t KeywordLength = 7;
+                if (pLineEnd - p > (ptrdiff_t)KeywordLength && memcmp(p, "include", KeywordLength) == 0)
+                {
+                    p += KeywordLength;
+                    while (p < pLineEnd && (*p == ' ' || *p == '\t'))
+                    {
+                        p++;
+                    }
+
+                    char close = p < pLineEnd && *p == '<' ? '>' : '"';
+                    if (p < pLineEnd && (*p == '"' || *p == '<'))
+                    {
+                        const char* pName = ++p;
+                        while (p < pLineEnd && *p != close)
+                        {
+                            p++;
+                        }
+
+                        if (p < pLineEnd)
+                        {
+                            names.push_back(std::string(pName, p));
+                        }
+                    }
+                }
+            }
+
+            pLine = pLineEnd + 1;
+        }
+    }
+
+    inline UINT64 HashString(const std::string& text, UINT64 seed)
+    {
+        // The length keeps "ab" + "c" apart from "a" + "bc"
+        UINT64 length = text.size();
+        seed = ComputeContentHash(&length, sizeof(length), seed);
+        return ComputeContentHash(text.data(), text.size(), seed);
+    }
+
+    /**
+     * Hashes the source and, depth first, every file it includes once. The compiler
+     * resolves includes by name through the source cache, so the same names are opened here.
+     * A missing include only adds its name, the compile fails on it anyway.
+     */
+    UINT64 HashIncludes(const AssetView& file, std::set<std::string>& visited, UINT64 seed)
+    {
+        seed = ComputeContentHash(file.pData, file.size, seed);
+
+        std::vector<std::string> names;
+        FindIncludes(reinterpret_cast<const char*>(file.pData), file.size, names);
+
+        for (const std::string& name : names)
+        {
+            if (!visited.insert(name).second)
+            {
+                continue;
+            }
+
+            seed = HashString(name, seed);
+
+            AssetView include;
+            if (ShaderSourceCache::GetDefault().Open(std::wstring(name.begin(), name.end()), include))
+            {
+                seed = HashIncludes(include, visited, seed);
+            }
+        }
+
+        return seed;
+    }
+
+    UINT64 ComputeKey(const ShaderCompileArgs& args, const AssetView& source, UINT64 compilerVersion,
+        std::set<std::string>& includes)
+    {
+        const UINT64 Header[] = { ShaderCacheVersion, compilerVersion, args.flags };
+
+        UINT64 key = ComputeContentHash(Header, sizeof(Header));
+        key = HashString(args.entryPoint, key);
+        key = HashString(args.profile, key);
+
+        for (const D3D_SHADER_MACRO* pDefine = args.pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+        {
+            key = HashString(pDefine->Name, key);
+            key = HashString(pDefine->Definition != nullptr ? pDefine->Definition : "", key);
+        }
+
+        key = HashIncludes(source, includes, key);
+
+        // Zero is kept for "no key"
+        return key != 0 ? key : 1;
+    }
+
+}
+
+ShaderCache::ShaderCache(IShaderCompiler* pCompiler, const std::wstring& directory)
+    : m_pCompiler(pCompiler)
+    , m_directory(directory)
+{
+    assert(pCompiler != nullptr);
+}
+
+HRESULT ShaderCache::GetBytecode(const ShaderCompileArgs& args, AssetView& bytecode, std::string& messages,
+    std::vector<std::wstring>* pDependencies)
+{
+    AssetView source;
+    if (!ShaderSourceCache::GetDefault().Open(args.path, source))
+    {
+        return E_FAIL;
+    }
+
+    std::set<std::string> includes;
+    const UINT64 key = ::ComputeKey(args, source, m_pCompiler->GetVersion(), includes);
+
+    if (pDependencies != nullptr)
+    {
+        pDependencies->assign(1, args.path);
+        for (const std::string& name : includes)
+        {
+            pDependencies->push_back(std::wstring(name.begin(), name.end()));
+        }
+    }
+
+    if (LoadEntry(key, bytecode))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.hits++;
+
+        return S_OK;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<UINT8> code;
+    HRESULT result = m_pCompiler->Compile(source.pData, source.size, args, code, messages);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.misses++;
+        m_stats.compileSeconds += seconds;
+    }
+
+    if (FAILED(result))
+    {
+        return result;
+    }
+
+    // An unwritable cache only costs the next start another compile
+    SaveEntry(key, code);
+
+    std::shared_ptr<std::vector<UINT8>> pCode = std::make_shared<std::vector<UINT8>>(std::move(code));
+
+    bytecode.pData = pCode->data();
+    bytecode.size = pCode->size();
+    bytecode.pStorage = pCode;
+
+    return S_OK;
+}
+
+UINT64 ShaderCache::ComputeKey(const ShaderCompileArgs& args) const
+{
+    AssetView source;
+    if (!ShaderSourceCache::GetDefault().Open(args.path, source))
+    {
+        return 0;
+    }
+
+    std::set<std::string> includes;
+    return ::ComputeKey(args, source, m_pCompiler->GetVersion(), includes);
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+std::wstring ShaderCache::GetEntryPath(UINT64 key) const
+{
+    wchar_t name[32];
+    swprintf(name, sizeof(name) / sizeof(name[0]), L"%016llx.cso", (unsigned long long)key);
+
+    return m_directory.empty() ? std::wstring(name) : m_directory + L"/" + name;
+}
+
+bool ShaderCache::LoadEntry(UINT64 key, AssetView& bytecode) const
+{
+    AssetView file;
+    if (!OpenAsset(GetEntryPath(key), file) || file.size < sizeof(ShaderCacheHeader))
+    {
+        return false;
+    }
+
+    ShaderCacheHeader header;
+    memcpy(&header, file.pData, sizeof(ShaderCacheHeader));
+
+    // A truncated or foreign entry is compiled again and overwritten
+    if (header.signature != ShaderCacheSignature || header.version != ShaderCacheVersion || header.key != key
+        || header.size == 0 || header.size != file.size - sizeof(ShaderCacheHeader))
+    {
+        return false;
+    }
+
+    bytecode.pData = file.pData + sizeof(ShaderCacheHeader);
+    bytecode.size = (size_t)header.size;
+    bytecode.pStorage = file.pStorage;
+
+    return true;
+}
+
+bool ShaderCache::SaveEntry(UINT64 key, const std::vector<UINT8>& bytecode) const
+{
+    if (!m_directory.empty())
+    {
+        CreateDirectoryW(m_directory.c_str(), nullptr);
+    }
+
+    ShaderCacheHeader header = {};
+    header.signature = ShaderCacheSignature;
+    header.version = ShaderCacheVersion;
+    header.key = key;
+    header.size = bytecode.size();
+
+    // Another instance may be mapping the entry right now, it keeps the old file until it is done
+    return WriteFileReplacing(GetEntryPath(key), [&](FILE* pFile)
+    {
+        return fwrite(&header, sizeof(ShaderCacheHeader), 1, pFile) == 1
+            && fwrite(bytecode.data(), 1, bytecode.size(), pFile) == bytecode.size();
+    });
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <d3d11.h>
+#else
+#include "PortablePlatform.h"
+#endif
+
+#include "AssetPak.h"
+
+/** Everything that selects the bytecode of a shader */
+struct ShaderCompileArgs
+{
+    std::wstring path;                          ///< Source asset, read with its includes through ShaderSourceCache
+    const D3D_SHADER_MACRO* pDefines = nullptr; ///< Terminated by an entry with a null Name, may be nullptr
+    std::string entryPoint;
+    std::string profile;
+    UINT flags = 0;                             ///< D3DCOMPILE_* flags
+};
+
+/** Compiles HLSL to bytecode, D3DShaderCompiler on Windows, a stub stands in for it in tests/ShaderCacheTests */
+class IShaderCompiler
+{
+public:
+    virtual ~IShaderCompiler() = default;
+
+    /**
+     * Compiles the source text of args.path. Warnings and errors go to messages,
+     * bytecode is left empty on failure.
+     */
+    virtual HRESULT Compile(const void* pSource, size_t size, const ShaderCompileArgs& args,
+        std::vector<UINT8>& bytecode, std::string& messages) = 0;
+
+    /** Identifies the compiler build, bytecode cached by another one is not reused */
+    virtual UINT64 GetVersion() const = 0;
+};
+
+struct ShaderCacheStats
+{
+    UINT32 hits = 0;                ///< Shaders loaded from the cache without compiling
+    UINT32 misses = 0;              ///< Shaders compiled
+    double compileSeconds = 0.0;    ///< Time spent in the compiler on misses
+};
+
+/**
+ * Persistent bytecode cache in front of an IShaderCompiler. Entries are keyed by a
+ * hash of the source, the contents of every file it includes (transitively), the
+ * defines, entry point, profile, flags and compiler version, so an entry can only be
+ * reused for an identical compile. A hit maps the stored bytecode and does not touch
+ * the compiler at all. Entries are files <key>.cso in the cache directory, they are
+ * looked up with OpenAsset and can ship in the mounted archive. Safe to use from
+ * several threads.
+ */
+class ShaderCache
+{
+public:
+    ShaderCache(IShaderCompiler* pCompiler, const std::wstring& directory);
+
+    /**
+     * Returns the bytecode for args from the cache or the compiler, compiler output goes
+     * to messages. pDependencies, if given, gets args.path and the names of the files it
+     * includes, everything the key was computed from.
+     */
+    HRESULT GetBytecode(const ShaderCompileArgs& args, AssetView& bytecode, std::string& messages,
+        std::vector<std::wstring>* pDependencies = nullptr);
+
+    /** Hash the entry for args is stored under, 0 if the source can not be read */
+    UINT64 ComputeKey(const ShaderCompileArgs& args) const;
+
+    ShaderCacheStats GetStats() const;
+
+private:
+    std::wstring GetEntryPath(UINT64 key) const;
+
+    bool LoadEntry(UINT64 key, AssetView& bytecode) const;
+    bool SaveEntry(UINT64 key, const std::vector<UINT8>& bytecode) const;
+
+    IShaderCompiler* m_pCompiler;
+    std::wstring m_directory;
+
+    mutable std::mutex m_mutex;
+    ShaderCacheStats m_stats;
+};
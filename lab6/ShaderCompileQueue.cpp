@@ -0,0 +1,100 @@
+#include "framework.h"
+
+#include "ShaderCompileQueue.h"
+#include "ThreadPool.h"
+
+ShaderCompileQueue::ShaderCompileQueue(ShaderCache* pCache, ThreadPool* pPool)
+    : m_pCache(pCache)
+    , m_pPool(pPool != nullptr ? pPool : &ThreadPool::GetDefault())
+{
+    assert(pCache != nullptr);
+}
+
+ShaderCompileQueue::~ShaderCompileQueue()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& job : m_jobs)
+    {
+        job.second.wait();
+    }
+}
+
+std::shared_future<ShaderCompileResult> ShaderCompileQueue::Enqueue(const ShaderCompileArgs& args)
+{
+    const JobKey key = MakeJobKey(args);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_jobs.find(key);
+    if (it != m_jobs.end())
+    {
+        return it->second;
+    }
+
+    // The caller's define array may be gone by the time the job runs
+    std::vector<std::string> defineStrings;
+    for (const D3D_SHADER_MACRO* pDefine = args.pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+    {
+        defineStrings.push_back(pDefine->Name);
+        defineStrings.push_back(pDefine->Definition != nullptr ? pDefine->Definition : "");
+    }
+
+    ShaderCache* pCache = m_pCache;
+    ShaderCompileArgs jobArgs = args;
+
+    std::shared_future<ShaderCompileResult> job = m_pPool->Submit([pCache, jobArgs, defineStrings]() mutable
+    {
+        std::vector<D3D_SHADER_MACRO> defines;
+        for (size_t i = 0; i < defineStrings.size(); i += 2)
+        {
+            defines.push_back({ defineStrings[i].c_str(), defineStrings[i + 1].c_str() });
+        }
+        defines.push_back({ nullptr, nullptr });
+
+        jobArgs.pDefines = defines.data();
+
+        ShaderCompileResult compiled;
+        compiled.result = pCache->GetBytecode(jobArgs, compiled.bytecode, compiled.messages,
+            &compiled.dependencies);
+
+        return compiled;
+    }).share();
+
+    m_jobs.emplace(key, job);
+
+    return job;
+}
+
+void ShaderCompileQueue::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto it = m_jobs.begin(); it != m_jobs.end();)
+    {
+        if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            it = m_jobs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+ShaderCompileQueue::JobKey ShaderCompileQueue::MakeJobKey(const ShaderCompileArgs& args)
+{
+    // Fields are separated by a byte that can not occur in any of them
+    std::string fields = args.entryPoint + '\n' + args.profile + '\n' + std::to_string(args.flags);
+
+    for (const D3D_SHADER_MACRO* pDefine = args.pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+    {
+        fields += '\n';
+        fields += pDefine->Name;
+        fields += '=';
+        fields += pDefine->Definition != nullptr ? pDefine->Definition : "";
+    }
+
+    return JobKey(args.path, fields);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "ShaderCache.h"
+
+class ThreadPool;
+
+/** Outcome of one queued compile */
+struct ShaderCompileResult
+{
+    HRESULT result = E_FAIL;
+    AssetView bytecode;
+    std::string messages;       ///< Compiler warnings and errors
+    std::vector<std::wstring> dependencies;    ///< Source and included files, see ShaderCache::GetBytecode
+};
+
+/**
+ * Runs shader compiles through a ShaderCache on worker threads (the default pool if
+ * pPool is nullptr). Requests with the same path, entry point, profile, flags and
+ * defines share one job, so a shader asked for by several objects is compiled once.
+ * Finished jobs are kept until Clear, later requests get their result at once.
+ */
+class ShaderCompileQueue
+{
+public:
+    explicit ShaderCompileQueue(ShaderCache* pCache, ThreadPool* pPool = nullptr);
+    /** Waits for the running jobs, they use the cache */
+    ~ShaderCompileQueue();
+
+    ShaderCompileQueue(const ShaderCompileQueue&) = delete;
+    ShaderCompileQueue& operator=(const ShaderCompileQueue&) = delete;
+
+    /** Queues the compile unless an equal one is known, args.pDefines is copied */
+    std::shared_future<ShaderCompileResult> Enqueue(const ShaderCompileArgs& args);
+
+    /** Drops the finished jobs and their bytecode, so the next request compiles (or loads) again */
+    void Clear();
+
+private:
+    /** Path and the other fields of the args joined into one string */
+    using JobKey = std::pair<std::wstring, std::string>;
+
+    static JobKey MakeJobKey(const ShaderCompileArgs& args);
+
+    ShaderCache* m_pCache;
+    ThreadPool* m_pPool;
+
+    std::mutex m_mutex;
+    std::map<JobKey, std::shared_future<ShaderCompileResult>> m_jobs;
+};
@@ -0,0 +1,148 @@
+#include "framework.h"
+
+#include "ShaderHotReload.h"
+#include "AssetPak.h"
+#include "FileWatcher.h"
+
+ShaderHotReload::ShaderHotReload(ShaderCache* pCache, const std::wstring& directory, ThreadPool* pPool)
+    : m_pWatcher(FileWatcher::Create(directory))
+    , m_queue(pCache, pPool)
+    , m_directory(directory)
+{
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+}
+
+void ShaderHotReload::Track(const ShaderCompileArgs& args, const std::vector<std::wstring>& dependencies,
+    const ShaderReloadCallback& onReload)
+{
+    TrackedShader shader;
+    shader.args = args;
+    shader.args.pDefines = nullptr;
+    shader.onReload = onReload;
+
+    for (const D3D_SHADER_MACRO* pDefine = args.pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+    {
+        shader.defines.emplace_back(pDefine->Name, pDefine->Definition != nullptr ? pDefine->Definition : "");
+    }
+
+    const size_t index = m_shaders.size();
+    for (const std::wstring& dependency : dependencies)
+    {
+        shader.dependencies.push_back(AssetPak::NormalizePath(dependency));
+        m_dependents[shader.dependencies.back()].insert(index);
+    }
+
+    m_shaders.push_back(std::move(shader));
+}
+
+void ShaderHotReload::MarkChanged(const std::wstring& path)
+{
+    auto it = m_dependents.find(AssetPak::NormalizePath(path));
+    if (it == m_dependents.end())
+    {
+        return;
+    }
+
+    for (size_t index : it->second)
+    {
+        TrackedShader& shader = m_shaders[index];
+
+        // A running compile may have read the file before the change, it is repeated once done
+        if (shader.job.valid())
+        {
+            shader.isPending = true;
+        }
+        else
+        {
+            StartCompile(shader);
+        }
+    }
+}
+
+UINT32 ShaderHotReload::Update()
+{
+    if (m_pWatcher != nullptr)
+    {
+        for (const std::wstring& name : m_pWatcher->PollChanges())
+        {
+            MarkChanged(m_directory + L"/" + name);
+        }
+    }
+
+    UINT32 reloadCount = 0;
+    std::vector<size_t> restarts;
+
+    for (size_t index = 0; index < m_shaders.size(); index++)
+    {
+        TrackedShader& shader = m_shaders[index];
+
+        if (!shader.job.valid() || shader.job.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            continue;
+        }
+
+        const ShaderCompileResult& compiled = shader.job.get();
+
+        if (SUCCEEDED(compiled.result))
+        {
+            if (shader.onReload(compiled.bytecode))
+            {
+                reloadCount++;
+            }
+
+            // Includes may have been added or removed by the edit
+            for (const std::string& dependency : shader.dependencies)
+            {
+                m_dependents[dependency].erase(index);
+            }
+
+            shader.dependencies.clear();
+            for (const std::wstring& dependency : compiled.dependencies)
+            {
+                shader.dependencies.push_back(AssetPak::NormalizePath(dependency));
+                m_dependents[shader.dependencies.back()].insert(index);
+            }
+        }
+        else
+        {
+            std::string message = "Shader reload failed, the old shader is kept\n" + compiled.messages;
+            OutputDebugStringA(message.c_str());
+        }
+
+        shader.job = std::shared_future<ShaderCompileResult>();
+
+        if (shader.isPending)
+        {
+            shader.isPending = false;
+            restarts.push_back(index);
+        }
+    }
+
+    // Finished jobs would be handed out again for the next change of the same shader
+    m_queue.Clear();
+
+    for (size_t index : restarts)
+    {
+        StartCompile(m_shaders[index]);
+    }
+
+    return reloadCount;
+}
+
+void ShaderHotReload::StartCompile(TrackedShader& shader)
+{
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const auto& define : shader.defines)
+    {
+        defines.push_back({ define.first.c_str(), define.second.c_str() });
+    }
+    defines.push_back({ nullptr, nullptr });
+
+    ShaderCompileArgs args = shader.args;
+    args.pDefines = defines.data();
+
+    shader.job = m_queue.Enqueue(args);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ShaderCompileQueue.h"
+
+class FileWatcher;
+class ThreadPool;
+
+/** Takes new bytecode of a tracked shader, returns false to keep the old shader */
+using ShaderReloadCallback = std::function<bool(const AssetView& bytecode)>;
+
+/**
+ * Recompiles shaders when their source or any file they include changes on disk.
+ * Shaders are tracked with the files their cache key was computed from, a change
+ * recompiles only the shaders depending on the file. Compiles run on the thread pool
+ * (the default one if pPool is nullptr), Update hands finished bytecode to the
+ * callbacks on the calling thread, so the renderer swaps shaders between frames. A
+ * failed compile keeps the old shader and reports the compiler output. Files served
+ * from a mounted archive do not change and are never reloaded.
+ */
+class ShaderHotReload
+{
+public:
+    ShaderHotReload(ShaderCache* pCache, const std::wstring& directory, ThreadPool* pPool = nullptr);
+    /** Waits for the running compiles, they use the cache */
+    ~ShaderHotReload();
+
+    ShaderHotReload(const ShaderHotReload&) = delete;
+    ShaderHotReload& operator=(const ShaderHotReload&) = delete;
+
+    /** False if the directory can not be watched, Update then does nothing */
+    bool IsWatching() const { return m_pWatcher != nullptr; }
+
+    /**
+     * Recompiles the shader built from args whenever one of the dependencies changes
+     * and passes the result to onReload. args.pDefines is copied.
+     */
+    void Track(const ShaderCompileArgs& args, const std::vector<std::wstring>& dependencies,
+        const ShaderReloadCallback& onReload);
+
+    /** Starts compiles for files changed since the last call and applies finished ones, returns their count */
+    UINT32 Update();
+
+    /** Queues recompiles of the shaders depending on the file as if it changed */
+    void MarkChanged(const std::wstring& path);
+
+private:
+    struct TrackedShader
+    {
+        ShaderCompileArgs args;
+        std::vector<std::pair<std::string, std::string>> defines;
+        std::vector<std::string> dependencies;      ///< Normalized names
+        ShaderReloadCallback onReload;
+
+        std::shared_future<ShaderCompileResult> job;    ///< Running or finished compile, invalid if none
+        bool isPending = false;                         ///< Changed again after the job was started
+    };
+
+    void StartCompile(TrackedShader& shader);
+
+    std::unique_ptr<FileWatcher> m_pWatcher;
+    ShaderCompileQueue m_queue;
+    std::wstring m_directory;
+
+    std::vector<TrackedShader> m_shaders;
+    std::map<std::string, std::set<size_t>> m_dependents;     ///< Normalized file name to indices of m_shaders
+};
@@ -0,0 +1,53 @@
+#include "framework.h"
+
+#include "ShaderPermutation.h"
+
+namespace
+{
+
+    struct FeatureDefine
+    {
+        UINT32 feature;
+        const char* name;
+    };
+
+    const FeatureDefine FeatureDefines[] =
+    {
+        { ShaderFeatureNormalMap,       "NORMAL_MAP" },
+        { ShaderFeatureNormalMapBC5,    "NORMAL_MAP_BC5" },
+        { ShaderFeatureNormalMapSnorm,  "NORMAL_MAP_SNORM" },
+        { ShaderFeatureSpecular,        "SPECULAR" },
+        { ShaderFeatureTranslucent,     "TRANSLUCENT" },
+    };
+
+}
+
+ShaderPermutation ShaderPermutation::Make(UINT32 features, UINT32 lightCount)
+{
+    ShaderPermutation permutation;
+    permutation.features = features;
+    permutation.lightCount = lightCount <= MaxSpecializedLights ? lightCount : 0;
+
+    return permutation;
+}
+
+ShaderPermutationDefines::ShaderPermutationDefines(const ShaderPermutation& permutation)
+{
+    for (const FeatureDefine& define : FeatureDefines)
+    {
+        if ((permutation.features & define.feature) != 0)
+        {
+            m_macros.push_back({ define.name, "1" });
+        }
+    }
+
+    // Without NUM_LIGHTS the shader loops over the count in the scene buffer,
+    // so a scene without lights gets the generic variant as well
+    if (permutation.lightCount != 0)
+    {
+        m_lightCount = std::to_string(permutation.lightCount);
+        m_macros.push_back({ "NUM_LIGHTS", m_lightCount.c_str() });
+    }
+
+    m_macros.push_back({ nullptr, nullptr });
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+
+/** Optional parts of the lit shaders, each one maps to a define */
+enum ShaderFeature : UINT32
+{
+    ShaderFeatureNormalMap      = 1 << 0,   ///< NORMAL_MAP, tangent space normal map bound to t1
+    ShaderFeatureNormalMapBC5   = 1 << 1,   ///< NORMAL_MAP_BC5, the map stores X and Y only
+    ShaderFeatureNormalMapSnorm = 1 << 2,   ///< NORMAL_MAP_SNORM, the BC5 map is signed
+    ShaderFeatureSpecular       = 1 << 3,   ///< SPECULAR, Phong highlight of every light
+    ShaderFeatureTranslucent    = 1 << 4,   ///< TRANSLUCENT, both sides are lit
+};
+
+/** One compiled variant of a shader */
+struct ShaderPermutation
+{
+    /** Largest light count with a variant of its own, more lights use the loop of the generic one */
+    static const UINT32 MaxSpecializedLights = 4;
+
+    UINT32 features = 0;        ///< ShaderFeature bits
+    UINT32 lightCount = 0;      ///< NUM_LIGHTS, 0 loops over lightCount.x of the scene buffer
+
+    /** Variant for lightCount scene lights, falls back to the generic loop above MaxSpecializedLights */
+    static ShaderPermutation Make(UINT32 features, UINT32 lightCount);
+
+    bool operator<(const ShaderPermutation& other) const
+    {
+        return features != other.features ? features < other.features : lightCount < other.lightCount;
+    }
+};
+
+/** D3D_SHADER_MACRO list of a permutation, owns the strings it points to */
+class ShaderPermutationDefines
+{
+public:
+    explicit ShaderPermutationDefines(const ShaderPermutation& permutation);
+
+    ShaderPermutationDefines(const ShaderPermutationDefines&) = delete;
+    ShaderPermutationDefines& operator=(const ShaderPermutationDefines&) = delete;
+
+    /** Terminated by an entry with a null Name */
+    const D3D_SHADER_MACRO* Get() const { return m_macros.data(); }
+
+private:
+    std::string m_lightCount;
+    std::vector<D3D_SHADER_MACRO> m_macros;
+};
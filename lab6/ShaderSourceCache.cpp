@@ -0,0 +1,93 @@
+#include "framework.h"
+
+#include "ShaderSourceCache.h"
+
+#include <vector>
+
+ShaderSourceCache& ShaderSourceCache::GetDefault()
+{
+    static ShaderSourceCache cache;
+    return cache;
+}
+
+bool ShaderSourceCache::Open(const std::wstring& filepath, AssetView& view)
+{
+    std::shared_ptr<AssetPak> pPak = AssetPak::GetMounted();
+    if (pPak != nullptr && pPak->Find(filepath, view))
+    {
+        return true;
+    }
+
+    FileStamp stamp;
+    if (!MappedFile::GetStamp(filepath, stamp))
+    {
+        return false;
+    }
+
+    const std::string name = AssetPak::NormalizePath(filepath);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_entries.find(name);
+        if (it != m_entries.end() && it->second.stamp == stamp)
+        {
+            it->second.stats.hits++;
+            view = it->second.view;
+
+            return true;
+        }
+    }
+
+    // Read without the lock, other files are served meanwhile. A file changed again
+    // between the stamp and the read gets a newer stamp and is read once more later.
+    // Empty files cannot be mapped, their source is empty.
+    std::shared_ptr<std::vector<UINT8>> pContents = std::make_shared<std::vector<UINT8>>();
+    if (stamp.size != 0)
+    {
+        std::shared_ptr<MappedFile> pFile = MappedFile::Open(filepath);
+        if (pFile == nullptr)
+        {
+            return false;
+        }
+        pContents->assign(pFile->GetData(), pFile->GetData() + pFile->GetSize());
+    }
+
+    // A terminating zero past the end, so that even an empty source has a valid pointer
+    pContents->push_back(0);
+
+    AssetView contents;
+    contents.pData = pContents->data();
+    contents.size = pContents->size() - 1;
+    contents.pStorage = pContents;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Entry& entry = m_entries[name];
+    entry.view = contents;
+    entry.stamp = stamp;
+    entry.stats.misses++;
+
+    view = contents;
+
+    return true;
+}
+
+void ShaderSourceCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+}
+
+std::map<std::string, ShaderSourceStats> ShaderSourceCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::map<std::string, ShaderSourceStats> stats;
+    for (const auto& entry : m_entries)
+    {
+        stats[entry.first] = entry.second.stats;
+    }
+
+    return stats;
+}
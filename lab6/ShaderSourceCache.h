@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "AssetPak.h"
+#include "MappedFile.h"
+
+struct ShaderSourceStats
+{
+    UINT64 hits = 0;        ///< Opens served from memory
+    UINT64 misses = 0;      ///< Opens that read the file
+};
+
+/**
+ * Process wide cache of shader sources and includes, so a header included by many
+ * shaders is read once for all compiles and cache key walks. A cached file is checked
+ * against its write time and size on every open and read again once it changes.
+ * Loose files are copied out instead of kept mapped, an open mapping would keep
+ * editors from saving them. Files in the mounted archive do not change and are served
+ * from its mapping directly, they are not counted. Safe to use from several threads.
+ */
+class ShaderSourceCache
+{
+public:
+    static ShaderSourceCache& GetDefault();
+
+    /**
+     * Returns the contents of the file as OpenAsset would. The view is immutable and
+     * stays valid after the file changes or the cache is cleared.
+     */
+    bool Open(const std::wstring& filepath, AssetView& view);
+
+    /** Drops every cached file */
+    void Clear();
+
+    /** Counters of each file opened so far, keyed by the normalized name */
+    std::map<std::string, ShaderSourceStats> GetStats() const;
+
+private:
+    struct Entry
+    {
+        AssetView view;         ///< Contents as of stamp
+        FileStamp stamp;
+        ShaderSourceStats stats;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_entries;
+};
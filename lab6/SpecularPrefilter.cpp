@@ -0,0 +1,566 @@
+#include "framework.h"
+
+#include "SpecularPrefilter.h"
+#include "BCDecoder.h"
+#include "ContentHash.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SPECULAR_PREFILTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+    const float Pi = 3.14159265f;
+
+    /** Bumped whenever the baked output changes for the same input */
+    const UINT32 SpecularPrefilterVersion = 1;
+
+    /** Linear RGBA, one SSE register per color where available */
+#ifdef SPECULAR_PREFILTER_SSE
+    struct Color
+    {
+        __m128 value;
+    };
+
+    inline Color LoadColor(const float* pTexel) { return { _mm_loadu_ps(pTexel) }; }
+    inline void StoreColor(float* pTexel, Color color) { _mm_storeu_ps(pTexel, color.value); }
+    inline Color ZeroColor() { return { _mm_setzero_ps() }; }
+    inline Color operator+(Color a, Color b) { return { _mm_add_ps(a.value, b.value) }; }
+    inline Color operator*(Color a, float b) { return { _mm_mul_ps(a.value, _mm_set1_ps(b)) }; }
+#else
+    struct Color
+    {
+        float value[4];
+    };
+
+    inline Color LoadColor(const float* pTexel) { Color color; memcpy(color.value, pTexel, sizeof(color.value)); return color; }
+    inline void StoreColor(float* pTexel, Color color) { memcpy(pTexel, color.value, sizeof(color.value)); }
+    inline Color ZeroColor() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+    inline Color operator+(Color a, Color b)
+    {
+        return { { a.value[0] + b.value[0], a.value[1] + b.value[1], a.value[2] + b.value[2], a.value[3] + b.value[3] } };
+    }
+    inline Color operator*(Color a, float b)
+    {
+        return { { a.value[0] * b, a.value[1] * b, a.value[2] * b, a.value[3] * b } };
+    }
+#endif
+
+    /** Square face of linear RGBA floats */
+    struct FaceLevel
+    {
+        UINT32 size = 0;
+        std::vector<float> texels;
+
+        const float* GetTexel(UINT32 x, UINT32 y) const { return texels.data() + ((size_t)y * size + x) * 4; }
+    };
+
+    /** Box filtered levels of the six source faces, levels[mip][face] */
+    using CubePyramid = std::vector<std::vector<FaceLevel>>;
+
+    /** Direction of texel (s, t) in [-1, 1] of a face is s * sAxis + t * tAxis + normal */
+    struct FaceBasis
+    {
+        float sAxis[3];
+        float tAxis[3];
+        float normal[3];
+    };
+
+    // D3D cube face order, t grows down the face
+    const FaceBasis FaceBases[6] =
+    {
+        { {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f } },   // +X
+        { {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f }, { -1.0f,  0.0f,  0.0f } },   // -X
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } },   // +Y
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f }, {  0.0f, -1.0f,  0.0f } },   // -Y
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } },   // +Z
+        { { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } }    // -Z
+    };
+
+    /** Light direction around the normal (0, 0, 1) and the source level to fetch it from */
+    struct LobeSample
+    {
+        float direction[3];
+        float weight;           ///< Cosine of the light with the normal
+        float lod;
+    };
+
+    /** One face to read, index is the subresource of pDesc */
+    struct FaceSource
+    {
+        const TextureDesc* pDesc = nullptr;
+        UINT32 index = 0;
+    };
+
+    const float* GetSRGBToLinearTable()
+    {
+        static const std::vector<float> Table = []()
+        {
+            std::vector<float> table(256);
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                float value = (float)i / 255.0f;
+                table[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+
+        return Table.data();
+    }
+
+    inline UINT8 EncodeChannel(float value, bool isSRGB)
+    {
+        value = std::min(std::max(value, 0.0f), 1.0f);
+        if (isSRGB)
+        {
+            value = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+        }
+        return (UINT8)(value * 255.0f + 0.5f);
+    }
+
+    /**
+     * Converts the face to linear floats, averaging blocks of texels so the level is
+     * no larger than maxSize.
+     */
+    bool ReadFace(const FaceSource& face, UINT32 maxSize, FaceLevel& level, ThreadPool* pPool)
+    {
+        std::vector<UINT8> rgba;
+        if (!DecodeSubresource(*face.pDesc, face.index, rgba, pPool))
+        {
+            return false;
+        }
+
+        const UINT32 size = face.pDesc->subresources[face.index].width;
+        const UINT32 factor = std::max(1u, size / maxSize);
+        const bool isSRGB = IsSRGB(face.pDesc->fmt);
+        const float* pTable = GetSRGBToLinearTable();
+        const float scale = 1.0f / (float)(factor * factor);
+
+        level.size = size / factor;
+        level.texels.assign((size_t)level.size * level.size * 4, 0.0f);
+
+        for (UINT32 y = 0; y < level.size * factor; y++)
+        {
+            float* pDst = level.texels.data() + (size_t)(y / factor) * level.size * 4;
+            const UINT8* pSrc = rgba.data() + (size_t)y * size * 4;
+
+            for (UINT32 x = 0; x < level.size * factor; x++)
+            {
+                float* pTexel = pDst + (x / factor) * 4;
+                for (UINT32 c = 0; c < 3; c++)
+                {
+                    pTexel[c] += (isSRGB ? pTable[pSrc[x * 4 + c]] : pSrc[x * 4 + c] / 255.0f) * scale;
+                }
+                pTexel[3] += pSrc[x * 4 + 3] / 255.0f * scale;
+            }
+        }
+
+        return true;
+    }
+
+    void Downsample(const FaceLevel& source, FaceLevel& level)
+    {
+        level.size = std::max(1u, source.size / 2);
+        level.texels.resize((size_t)level.size * level.size * 4);
+
+        const UINT32 last = source.size - 1;
+        for (UINT32 y = 0; y < level.size; y++)
+        {
+            for (UINT32 x = 0; x < level.size; x++)
+            {
+                UINT32 x0 = std::min(x * 2, last);
+                UINT32 x1 = std::min(x * 2 + 1, last);
+                UINT32 y0 = std::min(y * 2, last);
+                UINT32 y1 = std::min(y * 2 + 1, last);
+
+                Color sum = LoadColor(source.GetTexel(x0, y0)) + LoadColor(source.GetTexel(x1, y0))
+                    + LoadColor(source.GetTexel(x0, y1)) + LoadColor(source.GetTexel(x1, y1));
+                StoreColor(level.texels.data() + ((size_t)y * level.size + x) * 4, sum * 0.25f);
+            }
+        }
+    }
+
+    /** Finds the face the direction points into and its texel coordinates there */
+    inline UINT32 ProjectToFace(float x, float y, float z, float& s, float& t)
+    {
+        float ax = fabsf(x);
+        float ay = fabsf(y);
+        float az = fabsf(z);
+
+        if (ax >= ay && ax >= az)
+        {
+            s = (x > 0.0f ? -z : z) / ax;
+            t = -y / ax;
+            return x > 0.0f ? 0 : 1;
+        }
+        if (ay >= az)
+        {
+            s = x / ay;
+            t = (y > 0.0f ? z : -z) / ay;
+            return y > 0.0f ? 2 : 3;
+        }
+        s = (z > 0.0f ? x : -x) / az;
+        t = -y / az;
+        return z > 0.0f ? 4 : 5;
+    }
+
+    /** Bilinear fetch clamped to the face, filtering does not cross cube edges */
+    inline Color SampleLevel(const FaceLevel& level, float s, float t)
+    {
+        float u = std::min(std::max((s + 1.0f) * 0.5f * level.size - 0.5f, 0.0f), (float)(level.size - 1));
+        float v = std::min(std::max((t + 1.0f) * 0.5f * level.size - 0.5f, 0.0f), (float)(level.size - 1));
+
+        UINT32 x0 = (UINT32)u;
+        UINT32 y0 = (UINT32)v;
+        UINT32 x1 = std::min(x0 + 1, level.size - 1);
+        UINT32 y1 = std::min(y0 + 1, level.size - 1);
+        float fx = u - (float)x0;
+        float fy = v - (float)y0;
+
+        Color top = LoadColor(level.GetTexel(x0, y0)) * (1.0f - fx) + LoadColor(level.GetTexel(x1, y0)) * fx;
+        Color bottom = LoadColor(level.GetTexel(x0, y1)) * (1.0f - fx) + LoadColor(level.GetTexel(x1, y1)) * fx;
+
+        return top * (1.0f - fy) + bottom * fy;
+    }
+
+    inline Color SampleCube(const CubePyramid& pyramid, float x, float y, float z, float lod)
+    {
+        float s = 0.0f;
+        float t = 0.0f;
+        UINT32 face = ProjectToFace(x, y, z, s, t);
+
+        UINT32 mip = std::min((UINT32)lod, (UINT32)pyramid.size() - 1);
+        UINT32 nextMip = std::min(mip + 1, (UINT32)pyramid.size() - 1);
+        float blend = std::min(lod - (float)mip, 1.0f);
+
+        Color color = SampleLevel(pyramid[mip][face], s, t);
+        if (blend > 0.0f && nextMip != mip)
+        {
+            color = color * (1.0f - blend) + SampleLevel(pyramid[nextMip][face], s, t) * blend;
+        }
+        return color;
+    }
+
+    float RadicalInverse(UINT32 bits)
+    {
+        bits = (bits << 16) | (bits >> 16);
+        bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+        bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+        bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+        bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+        return (float)bits * 2.3283064365386963e-10f;
+    }
+
+    /**
+     * GGX samples for the view along the normal, where the light direction does not
+     * depend on the normal and can be computed once per roughness. The source level
+     * matches the solid angle a sample stands for to the one of a source texel.
+     */
+    std::vector<LobeSample> BuildLobeSamples(float roughness, UINT32 sampleCount, UINT32 sourceSize, UINT32 sourceMips)
+    {
+        const float alpha = roughness * roughness;
+        const float alpha2 = alpha * alpha;
+        const float texelSolidAngle = 4.0f * Pi / (6.0f * (float)sourceSize * (float)sourceSize);
+
+        std::vector<LobeSample> samples;
+        samples.reserve(sampleCount);
+
+        for (UINT32 i = 0; i < sampleCount; i++)
+        {
+            float u = ((float)i + 0.5f) / (float)sampleCount;
+            float v = RadicalInverse(i);
+
+            float phi = 2.0f * Pi * u;
+            float cosTheta = sqrtf((1.0f - v) / (1.0f + (alpha2 - 1.0f) * v));
+            float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+
+            float hx = sinTheta * cosf(phi);
+            float hy = sinTheta * sinf(phi);
+            float hz = cosTheta;
+
+            // Reflection of the view (0, 0, 1) about the half vector
+            LobeSample sample;
+            sample.direction[0] = 2.0f * hz * hx;
+            sample.direction[1] = 2.0f * hz * hy;
+            sample.direction[2] = 2.0f * hz * hz - 1.0f;
+            sample.weight = sample.direction[2];
+
+            if (sample.weight <= 0.0f)
+            {
+                continue;
+            }
+
+            // With the view along the normal the pdf of the light is D / 4
+            float denominator = (alpha2 - 1.0f) * hz * hz + 1.0f;
+            float pdf = alpha2 / (Pi * denominator * denominator) * 0.25f;
+            float sampleSolidAngle = 1.0f / ((float)sampleCount * pdf + 1e-6f);
+
+            sample.lod = std::min(std::max(0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f, 0.0f),
+                (float)(sourceMips - 1));
+            samples.push_back(sample);
+        }
+
+        return samples;
+    }
+
+    void FilterRow(const CubePyramid& pyramid, const FaceBasis& face, UINT32 size, UINT32 y, float mirrorLod,
+        const std::vector<LobeSample>& samples, bool isSRGB, UINT8* pDst)
+    {
+        const float t = ((float)y + 0.5f) * 2.0f / (float)size - 1.0f;
+
+        for (UINT32 x = 0; x < size; x++)
+        {
+            const float s = ((float)x + 0.5f) * 2.0f / (float)size - 1.0f;
+
+            float n[3];
+            for (UINT32 i = 0; i < 3; i++)
+            {
+                n[i] = s * face.sAxis[i] + t * face.tAxis[i] + face.normal[i];
+            }
+            float invLength = 1.0f / sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            n[0] *= invLength;
+            n[1] *= invLength;
+            n[2] *= invLength;
+
+            Color color;
+            if (samples.empty())
+            {
+                color = SampleCube(pyramid, n[0], n[1], n[2], mirrorLod);
+            }
+            else
+            {
+                // Tangent frame around the normal
+                float up[3] = { 0.0f, 0.0f, 1.0f };
+                if (fabsf(n[2]) > 0.999f)
+                {
+                    up[0] = 1.0f;
+                    up[2] = 0.0f;
+                }
+
+                float tangent[3] = { up[1] * n[2] - up[2] * n[1], up[2] * n[0] - up[0] * n[2], up[0] * n[1] - up[1] * n[0] };
+                float tangentScale = 1.0f / sqrtf(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+                for (float& value : tangent)
+                {
+                    value *= tangentScale;
+                }
+                float bitangent[3] = { n[1] * tangent[2] - n[2] * tangent[1], n[2] * tangent[0] - n[0] * tangent[2],
+                    n[0] * tangent[1] - n[1] * tangent[0] };
+
+                Color sum = ZeroColor();
+                float weightSum = 0.0f;
+                for (const LobeSample& sample : samples)
+                {
+                    float lx = tangent[0] * sample.direction[0] + bitangent[0] * sample.direction[1] + n[0] * sample.direction[2];
+                    float ly = tangent[1] * sample.direction[0] + bitangent[1] * sample.direction[1] + n[1] * sample.direction[2];
+                    float lz = tangent[2] * sample.direction[0] + bitangent[2] * sample.direction[1] + n[2] * sample.direction[2];
+
+                    sum = sum + SampleCube(pyramid, lx, ly, lz, sample.lod) * sample.weight;
+                    weightSum += sample.weight;
+                }
+                color = sum * (1.0f / weightSum);
+            }
+
+            float channels[4];
+            StoreColor(channels, color);
+            for (UINT32 c = 0; c < 3; c++)
+            {
+                pDst[x * 4 + c] = EncodeChannel(channels[c], isSRGB);
+            }
+            pDst[x * 4 + 3] = EncodeChannel(channels[3], false);
+        }
+    }
+
+    bool GetFaceSources(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs, FaceSource faces[6])
+    {
+        for (UINT32 i = 0; i < 6; i++)
+        {
+            if (pFaceDescs == nullptr)
+            {
+                if (cubeDesc.arraySize != 6 || cubeDesc.subresources.size() != 6 * cubeDesc.mipmapsCount)
+                {
+                    return false;
+                }
+                faces[i].pDesc = &cubeDesc;
+                faces[i].index = i * cubeDesc.mipmapsCount;
+            }
+            else
+            {
+                if (pFaceDescs[i].subresources.empty())
+                {
+                    return false;
+                }
+                faces[i].pDesc = &pFaceDescs[i];
+                faces[i].index = 0;
+            }
+
+            const SubresourceLayout& top = faces[i].pDesc->subresources[faces[i].index];
+            const SubresourceLayout& first = faces[0].pDesc->subresources[faces[0].index];
+            if (top.width != top.height || top.width != first.width || faces[i].pDesc->fmt != faces[0].pDesc->fmt)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    UINT64 ComputeSourceKey(const FaceSource faces[6], const SpecularPrefilterSettings& settings)
+    {
+        const UINT32 Header[] = { SpecularPrefilterVersion, settings.faceSize, settings.mipCount, settings.sampleCount };
+
+        UINT64 key = ComputeContentHash(Header, sizeof(Header));
+        for (UINT32 i = 0; i < 6; i++)
+        {
+            const TextureDesc& desc = *faces[i].pDesc;
+            const SubresourceLayout& layout = desc.subresources[faces[i].index];
+
+            key = ComputeContentHash(&desc.fmt, sizeof(desc.fmt), key);
+            key = ComputeContentHash(desc.GetSubresourceData(faces[i].index), (size_t)layout.slicePitch * layout.depth, key);
+        }
+
+        // Zero means no key in the file
+        return key != 0 ? key : 1;
+    }
+
+}
+
+bool PrefilterSpecular(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs, TextureDesc& result,
+    const SpecularPrefilterSettings& settings, ThreadPool* pPool)
+{
+    FaceSource faces[6];
+    if (!GetFaceSources(cubeDesc, pFaceDescs, faces) || settings.faceSize == 0 || settings.mipCount == 0)
+    {
+        return false;
+    }
+
+    if (pPool == nullptr)
+    {
+        pPool = &ThreadPool::GetDefault();
+    }
+
+    // Twice the output size is enough for the mirror level, larger sources are box filtered down
+    CubePyramid pyramid(1, std::vector<FaceLevel>(6));
+    std::atomic<bool> isFailed(false);
+
+    pPool->ParallelFor(6, [&](uint32_t face)
+    {
+        if (!ReadFace(faces[face], settings.faceSize * 2, pyramid[0][face], pPool))
+        {
+            isFailed = true;
+        }
+    });
+
+    if (isFailed)
+    {
+        return false;
+    }
+
+    while (pyramid.back()[0].size > 1)
+    {
+        std::vector<FaceLevel> level(6);
+        for (UINT32 face = 0; face < 6; face++)
+        {
+            Downsample(pyramid.back()[face], level[face]);
+        }
+        pyramid.push_back(std::move(level));
+    }
+
+    const UINT32 sourceSize = pyramid[0][0].size;
+    const UINT32 faceSize = std::min(settings.faceSize, sourceSize);
+
+    UINT32 mipCount = 1;
+    while (mipCount < settings.mipCount && (faceSize >> mipCount) != 0)
+    {
+        mipCount++;
+    }
+
+    const bool isSRGB = IsSRGB(faces[0].pDesc->fmt);
+
+    result = TextureDesc();
+    result.fmt = isSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+    result.width = faceSize;
+    result.height = faceSize;
+    result.arraySize = 6;
+    result.isCubemap = true;
+    result.mipmapsCount = mipCount;
+    result.dataSize = ComputeSubresourceLayout(result.fmt, faceSize, faceSize, 1, 6, mipCount, mipCount,
+        result.subresources);
+    result.pitch = result.subresources[0].rowPitch;
+
+    std::shared_ptr<UINT8> pBuffer((UINT8*)malloc((size_t)result.dataSize), free);
+    if (pBuffer == nullptr)
+    {
+        return false;
+    }
+
+    for (UINT32 mip = 0; mip < mipCount; mip++)
+    {
+        const UINT32 size = std::max(1u, faceSize >> mip);
+        const float roughness = mipCount > 1 ? (float)mip / (float)(mipCount - 1) : 0.0f;
+
+        // The mirror level takes one filtered fetch per texel
+        const std::vector<LobeSample> samples = mip == 0 ? std::vector<LobeSample>()
+            : BuildLobeSamples(roughness, settings.sampleCount, sourceSize, (UINT32)pyramid.size());
+        const float mirrorLod = log2f((float)sourceSize / (float)size);
+
+        pPool->ParallelFor(6 * size, [&](uint32_t row)
+        {
+            const UINT32 face = row / size;
+            const UINT32 y = row % size;
+            const SubresourceLayout& layout = result.subresources[face * mipCount + mip];
+
+            FilterRow(pyramid, FaceBases[face], size, y, mirrorLod, samples, isSRGB,
+                pBuffer.get() + layout.offset + (size_t)y * layout.rowPitch);
+        });
+    }
+
+    result.pData = pBuffer.get();
+    result.pStorage = pBuffer;
+
+    return true;
+}
+
+bool BakeSpecularEnvironment(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs,
+    const std::wstring& outputPath, TextureDesc& result, const SpecularPrefilterSettings& settings, ThreadPool* pPool,
+    bool* pIsCached)
+{
+    FaceSource faces[6];
+    if (!GetFaceSources(cubeDesc, pFaceDescs, faces))
+    {
+        return false;
+    }
+
+    const UINT64 sourceKey = ComputeSourceKey(faces, settings);
+
+    bool isCached = false;
+    if (pIsCached == nullptr)
+    {
+        pIsCached = &isCached;
+    }
+
+    TextureDesc cached;
+    if (LoadDDS(outputPath, cached, false, DDSLoadMode::Mapped) && cached.sourceKey == sourceKey && cached.isCubemap)
+    {
+        result = std::move(cached);
+        *pIsCached = true;
+        return true;
+    }
+
+    if (!PrefilterSpecular(cubeDesc, pFaceDescs, result, settings, pPool))
+    {
+        return false;
+    }
+    result.sourceKey = sourceKey;
+    *pIsCached = false;
+
+    return SaveDDS(result, outputPath);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+
+#include "DDS.h"
+
+class ThreadPool;
+
+struct SpecularPrefilterSettings
+{
+    UINT32 faceSize = 128;      ///< Face size of the mirror-like top level
+    UINT32 mipCount = 6;        ///< Levels from roughness 0 to 1, limited by the face size
+    UINT32 sampleCount = 64;    ///< GGX samples per texel of the rough levels
+};
+
+/**
+ * Builds a cubemap whose mips hold the environment convolved with the GGX lobe of
+ * growing roughness, mip m = roughness m / (mipCount - 1) with the view along the
+ * normal. Samples are importance sampled and fetched from a box filtered pyramid of
+ * the source at a level matching their solid angle, which keeps few samples free of
+ * fireflies. Rows are filtered in parallel on the thread pool (the default one if
+ * pPool is nullptr). Faces come from cubeDesc (6 slices) if pFaceDescs is nullptr,
+ * from six 2D textures in +X, -X, +Y, -Y, +Z, -Z order otherwise. The result is
+ * RGBA8, sRGB if the source is.
+ */
+bool PrefilterSpecular(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs, TextureDesc& result,
+    const SpecularPrefilterSettings& settings = SpecularPrefilterSettings(), ThreadPool* pPool = nullptr);
+
+/**
+ * PrefilterSpecular with the result cached as a DDS at outputPath. The file carries a
+ * hash of the source faces and the settings as its sourceKey, a file with the same
+ * key is loaded instead of being baked again, pIsCached tells which one happened.
+ */
+bool BakeSpecularEnvironment(const TextureDesc& cubeDesc, const TextureDesc* pFaceDescs,
+    const std::wstring& outputPath, TextureDesc& result,
+    const SpecularPrefilterSettings& settings = SpecularPrefilterSettings(), ThreadPool* pPool = nullptr,
+    bool* pIsCached = nullptr);
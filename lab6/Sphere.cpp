@@ -8,6 +8,7 @@ void Sphere::GetSphereDataSize(size_t SphereSteps)
     indexCount = SphereSteps * SphereSteps * 6;
 
     sphereVertices.resize(vertexCount);
+    sphereVertexBatch.Resize(vertexCount);
     indices.resize(indexCount);
 
     m_sphereIndexCount = (UINT)indexCount;
@@ -16,7 +17,6 @@ void Sphere::GetSphereDataSize(size_t SphereSteps)
 void Sphere::CreateSphere()
 {
     UINT16* pIndices = indices.data();
-    XMFLOAT3* pPos   = sphereVertices.data();
     
     for (size_t lat = 0; lat < SphereSteps + 1; lat++)
     {
@@ -32,7 +32,7 @@ void Sphere::CreateSphere()
                 cosf(lonAngle) * cosf(latAngle)
             };
 
-            pPos[index] = r;
+            sphereVertexBatch.Set(index, r);
         }
     }
 
@@ -55,6 +55,8 @@ HRESULT Sphere::CreateVertexBuffer(ID3D11Device* m_pDevice)
 {
     HRESULT result{};
 
+    sphereVertexBatch.Store(sphereVertices.data());
+
     D3D11_BUFFER_DESC desc = {};
     desc.ByteWidth = (UINT)(sphereVertices.size() * sizeof(XMFLOAT3));
     desc.Usage = D3D11_USAGE_IMMUTABLE;
@@ -159,10 +161,7 @@ HRESULT Sphere::UpdateGeomtryBuffer(ID3D11DeviceContext* m_pDeviceContext, Spher
 
 HRESULT Sphere::Scale()
 {
-    for (auto& ver : sphereVertices)
-    {
-        ver *= 0.1f;
-    }
+    ScaleBatch(sphereVertexBatch, XMFLOAT3(0.1f, 0.1f, 0.1f));
 
     return S_OK;
 }
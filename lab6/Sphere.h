@@ -19,6 +19,7 @@
 
 #include "XMFLOAT3.h"
 #include "XMFLOAT4.h"
+#include "VectorBatch.h"
 
 
 struct SphereGeomBuffer
@@ -60,7 +61,8 @@ struct Sphere
 
     size_t SphereSteps;
 
-    std::vector<XMFLOAT3> sphereVertices{};
+    Float3Batch sphereVertexBatch{};        ///< Positions while they are built and scaled
+    std::vector<XMFLOAT3> sphereVertices{};  ///< Copied from sphereVertexBatch for the vertex buffer
     std::vector<UINT16> indices{};
 
     size_t indexCount;
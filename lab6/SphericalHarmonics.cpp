@@ -0,0 +1,404 @@
+#include "framework.h"
+
+#include "SphericalHarmonics.h"
+#include "BCDecoder.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <atomic>
+#include <vector>
+
+// Define SH_NO_SIMD to project with the scalar loop on x86 as well
+#if !defined(SH_NO_SIMD) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define SH_PROJECTION_SSE 1
+#include <immintrin.h>
+#endif
+
+// MSVC emits AVX2 intrinsics without extra switches, GCC and Clang need them enabled per function
+#if defined(SH_PROJECTION_SSE) && !defined(_MSC_VER)
+#define SH_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define SH_AVX2_TARGET
+#endif
+
+namespace
+{
+
+    const double Pi = 3.14159265358979323846;
+
+    /** Direction of texel (s, t) in [-1, 1] of a face is s * sAxis + t * tAxis + normal */
+    struct FaceBasis
+    {
+        float sAxis[3];
+        float tAxis[3];
+        float normal[3];
+    };
+
+    // D3D cube face order, t grows down the face
+    const FaceBasis FaceBases[6] =
+    {
+        { {  0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f } },   // +X
+        { {  0.0f, 0.0f,  1.0f }, { 0.0f, -1.0f,  0.0f }, { -1.0f,  0.0f,  0.0f } },   // -X
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } },   // +Y
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f,  0.0f, -1.0f }, {  0.0f, -1.0f,  0.0f } },   // -Y
+        { {  1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } },   // +Z
+        { { -1.0f, 0.0f,  0.0f }, { 0.0f, -1.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } }    // -Z
+    };
+
+    /** Squared normalization constants of the real SH basis times the cosine lobe band factor over pi */
+    const float CoefficientScales[SHCoefficientCount] =
+    {
+        0.282095f * 0.282095f,
+        0.488603f * 0.488603f * 2.0f / 3.0f,
+        0.488603f * 0.488603f * 2.0f / 3.0f,
+        0.488603f * 0.488603f * 2.0f / 3.0f,
+        1.092548f * 1.092548f * 0.25f,
+        1.092548f * 1.092548f * 0.25f,
+        0.315392f * 0.315392f * 0.25f,
+        1.092548f * 1.092548f * 0.25f,
+        0.546274f * 0.546274f * 0.25f
+    };
+
+    /** Weighted sums of color times the basis polynomials, coefficient major */
+    struct FaceSums
+    {
+        double color[SHCoefficientCount][3] = {};
+        double weight = 0.0;
+    };
+
+    /** One face to integrate, index is the subresource of pDesc */
+    struct FaceSource
+    {
+        const TextureDesc* pDesc = nullptr;
+        UINT32 index = 0;
+    };
+
+    /** Maps 8-bit values to linear floats, sRGB decoded by the second half */
+    const float* GetColorTable(bool isSRGB)
+    {
+        static const std::vector<float> Table = []()
+        {
+            std::vector<float> table(512);
+            for (UINT32 i = 0; i < 256; i++)
+            {
+                float value = (float)i / 255.0f;
+                table[i] = value;
+                table[256 + i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+
+        return Table.data() + (isSRGB ? 256 : 0);
+    }
+
+    /** Finest loaded mip of the slice not larger than maxFaceSize, the smallest loaded one otherwise */
+    UINT32 SelectMip(const TextureDesc& desc, UINT32 maxFaceSize)
+    {
+        UINT32 mip = 0;
+        while (maxFaceSize != 0 && mip + 1 < desc.mipmapsCount
+            && std::max(desc.subresources[mip].width, desc.subresources[mip].height) > maxFaceSize)
+        {
+            mip++;
+        }
+        return mip;
+    }
+
+    /** Basis polynomials without their constants, in the order of SHIrradiance */
+    inline void EvaluateBasis(float x, float y, float z, float basis[SHCoefficientCount])
+    {
+        basis[0] = 1.0f;
+        basis[1] = y;
+        basis[2] = z;
+        basis[3] = x;
+        basis[4] = x * y;
+        basis[5] = y * z;
+        basis[6] = 3.0f * z * z - 1.0f;
+        basis[7] = x * z;
+        basis[8] = x * x - y * y;
+    }
+
+    /** One row of a face as linear color planes, padded to RowAlignment columns */
+    struct RowPlanes
+    {
+        const float* pS;        ///< Texel center in [-1, 1] per column
+        const float* pValid;    ///< 1 for texels, 0 for the padding so it adds nothing
+        const float* pRed;
+        const float* pGreen;
+        const float* pBlue;
+    };
+
+    const UINT32 RowAlignment = 8;
+
+    /** Adds the row at height t of the face to the sums */
+    typedef void (*RowProjector)(const FaceBasis& face, float t, const RowPlanes& row, UINT32 count, FaceSums& sums);
+
+#ifndef SH_PROJECTION_SSE
+
+    void ProjectRowScalar(const FaceBasis& face, float t, const RowPlanes& row, UINT32 count, FaceSums& sums)
+    {
+        for (UINT32 x = 0; x < count; x++)
+        {
+            float s = row.pS[x];
+            float invLength = 1.0f / sqrtf(1.0f + s * s + t * t);
+            float weight = invLength * invLength * invLength * row.pValid[x];
+
+            float dx = (s * face.sAxis[0] + t * face.tAxis[0] + face.normal[0]) * invLength;
+            float dy = (s * face.sAxis[1] + t * face.tAxis[1] + face.normal[1]) * invLength;
+            float dz = (s * face.sAxis[2] + t * face.tAxis[2] + face.normal[2]) * invLength;
+
+            float basis[SHCoefficientCount];
+            EvaluateBasis(dx, dy, dz, basis);
+
+            for (UINT32 k = 0; k < SHCoefficientCount; k++)
+            {
+                sums.color[k][0] += row.pRed[x] * weight * basis[k];
+                sums.color[k][1] += row.pGreen[x] * weight * basis[k];
+                sums.color[k][2] += row.pBlue[x] * weight * basis[k];
+            }
+            sums.weight += weight;
+        }
+    }
+
+#else
+
+    /**
+     * Vector kernel shared by the SSE and AVX2 paths. Float lanes hold partial sums
+     * of one row at most, rows are added up in double.
+     */
+#define SH_PROJECT_ROW(Vec, Width, Set1, SetZero, Load, Store, Add, Sub, Mul, Div, Sqrt)                   \
+        const Vec one = Set1(1.0f);                                                                     \
+        const Vec three = Set1(3.0f);                                                                   \
+        const Vec rowLength2 = Set1(1.0f + t * t);                                                      \
+                                                                                                        \
+        const Vec rowX = Set1(face.tAxis[0] * t + face.normal[0]);                                      \
+        const Vec rowY = Set1(face.tAxis[1] * t + face.normal[1]);                                      \
+        const Vec rowZ = Set1(face.tAxis[2] * t + face.normal[2]);                                      \
+        const Vec sX = Set1(face.sAxis[0]);                                                             \
+        const Vec sY = Set1(face.sAxis[1]);                                                             \
+        const Vec sZ = Set1(face.sAxis[2]);                                                             \
+                                                                                                        \
+        Vec colorSums[SHCoefficientCount][3];                                                           \
+        for (UINT32 k = 0; k < SHCoefficientCount; k++)                                                 \
+        {                                                                                               \
+            colorSums[k][0] = colorSums[k][1] = colorSums[k][2] = SetZero();                            \
+        }                                                                                               \
+        Vec weightSum = SetZero();                                                                      \
+                                                                                                        \
+        for (UINT32 x = 0; x < count; x += Width)                                                       \
+        {                                                                                               \
+            Vec s = Load(row.pS + x);                                                                   \
+                                                                                                        \
+            /* Solid angle of a texel is proportional to (1 + s^2 + t^2)^(-3/2) */                      \
+            Vec invLength = Div(one, Sqrt(Add(rowLength2, Mul(s, s))));                                 \
+            Vec weight = Mul(Mul(invLength, Mul(invLength, invLength)), Load(row.pValid + x));          \
+                                                                                                        \
+            Vec dx = Mul(Add(Mul(s, sX), rowX), invLength);                                             \
+            Vec dy = Mul(Add(Mul(s, sY), rowY), invLength);                                             \
+            Vec dz = Mul(Add(Mul(s, sZ), rowZ), invLength);                                             \
+                                                                                                        \
+            const Vec basis[SHCoefficientCount] =                                                       \
+            {                                                                                           \
+                one, dy, dz, dx, Mul(dx, dy), Mul(dy, dz), Sub(Mul(three, Mul(dz, dz)), one),           \
+                Mul(dx, dz), Sub(Mul(dx, dx), Mul(dy, dy))                                              \
+            };                                                                                          \
+                                                                                                        \
+            Vec red = Mul(Load(row.pRed + x), weight);                                                  \
+            Vec green = Mul(Load(row.pGreen + x), weight);                                              \
+            Vec blue = Mul(Load(row.pBlue + x), weight);                                                \
+                                                                                                        \
+            for (UINT32 k = 0; k < SHCoefficientCount; k++)                                             \
+            {                                                                                           \
+                colorSums[k][0] = Add(colorSums[k][0], Mul(red, basis[k]));                             \
+                colorSums[k][1] = Add(colorSums[k][1], Mul(green, basis[k]));                           \
+                colorSums[k][2] = Add(colorSums[k][2], Mul(blue, basis[k]));                            \
+            }                                                                                           \
+            weightSum = Add(weightSum, weight);                                                         \
+        }                                                                                               \
+                                                                                                        \
+        alignas(32) float lanes[SHCoefficientCount * 3 + 1][Width];                                     \
+        for (UINT32 k = 0; k < SHCoefficientCount; k++)                                                 \
+        {                                                                                               \
+            for (UINT32 c = 0; c < 3; c++)                                                              \
+            {                                                                                           \
+                Store(lanes[k * 3 + c], colorSums[k][c]);                                               \
+            }                                                                                           \
+        }                                                                                               \
+        Store(lanes[SHCoefficientCount * 3], weightSum);                                                \
+                                                                                                        \
+        for (UINT32 i = 0; i < Width; i++)                                                              \
+        {                                                                                               \
+            for (UINT32 k = 0; k < SHCoefficientCount; k++)                                             \
+            {                                                                                           \
+                for (UINT32 c = 0; c < 3; c++)                                                          \
+                {                                                                                       \
+                    sums.color[k][c] += lanes[k * 3 + c][i];                                            \
+                }                                                                                       \
+            }                                                                                           \
+            sums.weight += lanes[SHCoefficientCount * 3][i];                                           \
+        }
+
+    void ProjectRowSSE(const FaceBasis& face, float t, const RowPlanes& row, UINT32 count, FaceSums& sums)
+    {
+        SH_PROJECT_ROW(__m128, 4, _mm_set1_ps, _mm_setzero_ps, _mm_loadu_ps, _mm_store_ps,
+            _mm_add_ps, _mm_sub_ps, _mm_mul_ps, _mm_div_ps, _mm_sqrt_ps)
+    }
+
+    SH_AVX2_TARGET void ProjectRowAVX2(const FaceBasis& face, float t, const RowPlanes& row, UINT32 count, FaceSums& sums)
+    {
+        SH_PROJECT_ROW(__m256, 8, _mm256_set1_ps, _mm256_setzero_ps, _mm256_loadu_ps, _mm256_store_ps,
+            _mm256_add_ps, _mm256_sub_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_sqrt_ps)
+    }
+
+#undef SH_PROJECT_ROW
+
+#endif
+
+    RowProjector GetRowProjector()
+    {
+#ifdef SH_PROJECTION_SSE
+        return GetCpuFeatures().avx2 ? ProjectRowAVX2 : ProjectRowSSE;
+#else
+        return ProjectRowScalar;
+#endif
+    }
+
+    bool ProjectFace(const FaceSource& face, const FaceBasis& basis, RowProjector projectRow, FaceSums& sums,
+        ThreadPool* pPool)
+    {
+        std::vector<UINT8> texels;
+        if (!DecodeSubresource(*face.pDesc, face.index, texels, pPool))
+        {
+            return false;
+        }
+
+        const TextureDesc& desc = *face.pDesc;
+        const UINT32 width = desc.subresources[face.index].width;
+        const UINT32 height = desc.subresources[face.index].height;
+        const UINT32 paddedWidth = DivUp(width, RowAlignment) * RowAlignment;
+
+        const float* pTable = GetColorTable(IsSRGB(desc.fmt));
+
+        std::vector<float> planes((size_t)paddedWidth * 5, 0.0f);
+        float* pS = planes.data();
+        float* pValid = pS + paddedWidth;
+        float* pRed = pValid + paddedWidth;
+        float* pGreen = pRed + paddedWidth;
+        float* pBlue = pGreen + paddedWidth;
+
+        for (UINT32 x = 0; x < width; x++)
+        {
+            pS[x] = ((float)x + 0.5f) * 2.0f / (float)width - 1.0f;
+            pValid[x] = 1.0f;
+        }
+
+        const RowPlanes row = { pS, pValid, pRed, pGreen, pBlue };
+
+        for (UINT32 y = 0; y < height; y++)
+        {
+            const UINT8* pRow = texels.data() + (size_t)y * width * 4;
+            for (UINT32 x = 0; x < width; x++)
+            {
+                pRed[x] = pTable[pRow[x * 4 + 0]];
+                pGreen[x] = pTable[pRow[x * 4 + 1]];
+                pBlue[x] = pTable[pRow[x * 4 + 2]];
+            }
+
+            float t = ((float)y + 0.5f) * 2.0f / (float)height - 1.0f;
+            projectRow(basis, t, row, paddedWidth, sums);
+        }
+
+        return true;
+    }
+
+    bool ProjectFaces(const FaceSource* pFaces, SHIrradiance& irradiance, ThreadPool* pPool)
+    {
+        if (pPool == nullptr)
+        {
+            pPool = &ThreadPool::GetDefault();
+        }
+
+        const RowProjector projectRow = GetRowProjector();
+
+        FaceSums faceSums[6];
+        std::atomic<bool> isFailed(false);
+
+        pPool->ParallelFor(6, [&](uint32_t face)
+        {
+            if (!ProjectFace(pFaces[face], FaceBases[face], projectRow, faceSums[face], pPool))
+            {
+                isFailed = true;
+            }
+        });
+
+        if (isFailed)
+        {
+            return false;
+        }
+
+        // Every face covers a sixth of the sphere whatever its resolution
+        double coefficients[SHCoefficientCount][3] = {};
+        for (const FaceSums& sums : faceSums)
+        {
+            double scale = sums.weight > 0.0 ? 4.0 * Pi / 6.0 / sums.weight : 0.0;
+            for (UINT32 k = 0; k < SHCoefficientCount; k++)
+            {
+                for (UINT32 c = 0; c < 3; c++)
+                {
+                    coefficients[k][c] += sums.color[k][c] * scale;
+                }
+            }
+        }
+
+        for (UINT32 k = 0; k < SHCoefficientCount; k++)
+        {
+            irradiance.coefficients[k] = XMFLOAT4(
+                (float)(coefficients[k][0] * CoefficientScales[k]),
+                (float)(coefficients[k][1] * CoefficientScales[k]),
+                (float)(coefficients[k][2] * CoefficientScales[k]),
+                0.0f);
+        }
+
+        return true;
+    }
+
+}
+
+bool ProjectCubemapToSH(const TextureDesc& cubeDesc, SHIrradiance& irradiance, UINT32 maxFaceSize, ThreadPool* pPool)
+{
+    if (cubeDesc.arraySize != 6 || cubeDesc.mipmapsCount == 0 || cubeDesc.subresources.size() != 6 * cubeDesc.mipmapsCount)
+    {
+        return false;
+    }
+
+    const UINT32 mip = SelectMip(cubeDesc, maxFaceSize);
+
+    FaceSource faces[6];
+    for (UINT32 i = 0; i < 6; i++)
+    {
+        faces[i].pDesc = &cubeDesc;
+        faces[i].index = i * cubeDesc.mipmapsCount + mip;
+    }
+
+    return ProjectFaces(faces, irradiance, pPool);
+}
+
+bool ProjectCubemapFacesToSH(const TextureDesc* pFaceDescs, SHIrradiance& irradiance, UINT32 maxFaceSize,
+    ThreadPool* pPool)
+{
+    FaceSource faces[6];
+    for (UINT32 i = 0; i < 6; i++)
+    {
+        if (pFaceDescs[i].mipmapsCount == 0 || pFaceDescs[i].subresources.empty())
+        {
+            return false;
+        }
+
+        faces[i].pDesc = &pFaceDescs[i];
+        faces[i].index = SelectMip(pFaceDescs[i], maxFaceSize);
+    }
+
+    return ProjectFaces(faces, irradiance, pPool);
+}
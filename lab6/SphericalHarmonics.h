@@ -0,0 +1,34 @@
+#pragma once
+
+#include "DDS.h"
+#include "XMFLOAT4.h"
+
+class ThreadPool;
+
+/** Number of coefficients of the first three SH bands */
+const UINT32 SHCoefficientCount = 9;
+
+/**
+ * Diffuse irradiance of an environment as 9 RGB coefficients, w is unused. The cosine
+ * lobe convolution and the basis constants are already folded in, so a surface of
+ * albedo c with normal n reflects
+ *   c * (k0 + k1 y + k2 z + k3 x + k4 xy + k5 yz + k6 (3z^2 - 1) + k7 xz + k8 (x^2 - y^2)).
+ */
+struct SHIrradiance
+{
+    XMFLOAT4 coefficients[SHCoefficientCount];
+};
+
+/**
+ * Projects a cubemap (6 slices in +X, -X, +Y, -Y, +Z, -Z order) to SH irradiance.
+ * Faces are decoded to linear color and integrated with solid angle weights in
+ * parallel on the thread pool (the default one if pPool is nullptr). The finest
+ * loaded mip not larger than maxFaceSize is used, 0 takes the top level; two SH
+ * bands can not tell a 64x64 face from a 1024x1024 one.
+ */
+bool ProjectCubemapToSH(const TextureDesc& cubeDesc, SHIrradiance& irradiance, UINT32 maxFaceSize = 0,
+    ThreadPool* pPool = nullptr);
+
+/** Same for a cubemap given as six separate 2D textures in face order */
+bool ProjectCubemapFacesToSH(const TextureDesc* pFaceDescs, SHIrradiance& irradiance, UINT32 maxFaceSize = 0,
+    ThreadPool* pPool = nullptr);
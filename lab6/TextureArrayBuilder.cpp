@@ -0,0 +1,262 @@
+#include "framework.h"
+
+#include "TextureArrayBuilder.h"
+#include "ContentHash.h"
+
+bool TextureSliceAllocator::Allocate(UINT32& slice)
+{
+    if (!m_freeSlices.empty())
+    {
+        slice = m_freeSlices.back();
+        m_freeSlices.pop_back();
+        return true;
+    }
+
+    if (m_sliceCount == m_capacity)
+    {
+        return false;
+    }
+
+    slice = m_sliceCount++;
+    return true;
+}
+
+void TextureSliceAllocator::Free(UINT32 slice)
+{
+    assert(slice < m_sliceCount);
+    assert(std::find(m_freeSlices.begin(), m_freeSlices.end(), slice) == m_freeSlices.end());
+
+    auto it = std::lower_bound(m_freeSlices.begin(), m_freeSlices.end(), slice, std::greater<UINT32>());
+    m_freeSlices.insert(it, slice);
+}
+
+bool TextureArrayBuilder::CanAdd(const TextureDesc& desc)
+{
+    return desc.dimension == TextureDimension::Texture2D && desc.arraySize == 1 && !desc.isCubemap
+        && desc.mipmapsCount != 0 && desc.subresources.size() == desc.mipmapsCount;
+}
+
+bool TextureArrayBuilder::Add(const TextureDesc& desc, TextureArraySlice& slice, UINT64 contentKey)
+{
+    if (!CanAdd(desc))
+    {
+        return false;
+    }
+
+    if (contentKey == 0)
+    {
+        contentKey = ComputeTextureKey(desc);
+    }
+
+    for (UINT32 i = 0; i < (UINT32)m_arrays.size(); i++)
+    {
+        Array& array = m_arrays[i];
+        if (array.fmt != desc.fmt || array.width != desc.width || array.height != desc.height)
+        {
+            continue;
+        }
+
+        UINT32 index = 0;
+        if (!array.allocator.Allocate(index))
+        {
+            continue;
+        }
+
+        if (index == array.slices.size())
+        {
+            array.slices.push_back(desc);
+            array.keys.push_back(contentKey);
+        }
+        else
+        {
+            array.slices[index] = desc;
+            array.keys[index] = contentKey;
+        }
+        array.isDirty = true;
+
+        slice.arrayIndex = i;
+        slice.slice = index;
+        return true;
+    }
+
+    // No array of this format and size has room left
+    Array array;
+    array.fmt = desc.fmt;
+    array.width = desc.width;
+    array.height = desc.height;
+
+    UINT32 index = 0;
+    array.allocator.Allocate(index);
+    array.slices.push_back(desc);
+    array.keys.push_back(contentKey);
+
+    m_arrays.push_back(std::move(array));
+
+    slice.arrayIndex = (UINT32)m_arrays.size() - 1;
+    slice.slice = index;
+    return true;
+}
+
+bool TextureArrayBuilder::AddFile(const std::wstring& filepath, TextureArraySlice& slice, DDSLoadMode mode)
+{
+    TextureDesc desc;
+    return LoadDDS(filepath, desc, false, mode) && Add(desc, slice);
+}
+
+void TextureArrayBuilder::Remove(const TextureArraySlice& slice)
+{
+    if (!slice.IsValid())
+    {
+        return;
+    }
+
+    Array& array = m_arrays[slice.arrayIndex];
+    array.allocator.Free(slice.slice);
+    array.slices[slice.slice] = TextureDesc();
+    array.keys[slice.slice] = 0;
+    array.isDirty = true;
+}
+
+UINT32 TextureArrayBuilder::AddMaterial(const TextureDesc& diffuse, const TextureDesc* pNormal)
+{
+    MaterialSlices material;
+    if (!Add(diffuse, material.diffuse))
+    {
+        return InvalidMaterial;
+    }
+
+    if (pNormal != nullptr && !Add(*pNormal, material.normal))
+    {
+        Remove(material.diffuse);
+        return InvalidMaterial;
+    }
+
+    if (!m_freeMaterials.empty())
+    {
+        UINT32 index = m_freeMaterials.back();
+        m_freeMaterials.pop_back();
+
+        m_materials[index] = material;
+        return index;
+    }
+
+    m_materials.push_back(material);
+    return (UINT32)m_materials.size() - 1;
+}
+
+void TextureArrayBuilder::RemoveMaterial(UINT32 material)
+{
+    MaterialSlices& slices = m_materials[material];
+    if (!slices.diffuse.IsValid())
+    {
+        return;
+    }
+
+    Remove(slices.diffuse);
+    Remove(slices.normal);
+
+    slices = MaterialSlices();
+    m_freeMaterials.push_back(material);
+}
+
+bool TextureArrayBuilder::ReplaceLayer(UINT32 material, bool isNormal, const TextureDesc& desc, UINT64 contentKey)
+{
+    MaterialSlices& slices = m_materials[material];
+    TextureArraySlice& slice = isNormal ? slices.normal : slices.diffuse;
+    if (!CanAdd(desc) || !slices.diffuse.IsValid())
+    {
+        return false;
+    }
+
+    // The freed slice is taken again when the texture keeps its format and size
+    Remove(slice);
+    slice = TextureArraySlice();
+    return Add(desc, slice, contentKey);
+}
+
+void TextureArrayBuilder::GetMaterialTable(std::vector<UINT32>& table) const
+{
+    table.resize(m_materials.size() * 4);
+
+    for (size_t i = 0; i < m_materials.size(); i++)
+    {
+        const MaterialSlices& material = m_materials[i];
+
+        table[i * 4 + 0] = material.diffuse.arrayIndex;
+        table[i * 4 + 1] = material.diffuse.slice;
+        table[i * 4 + 2] = material.normal.arrayIndex;
+        table[i * 4 + 3] = material.normal.slice;
+    }
+}
+
+bool TextureArrayBuilder::Build(UINT32 arrayIndex, TextureDesc& desc, std::vector<D3D11_SUBRESOURCE_DATA>& data,
+    bool isCubemap, UINT64* pContentKey)
+{
+    Array& array = m_arrays[arrayIndex];
+
+    const UINT32 sliceCount = array.allocator.GetSliceCount();
+    if (array.allocator.GetLiveCount() == 0 || (isCubemap && (sliceCount % 6 != 0 || array.width != array.height)))
+    {
+        return false;
+    }
+
+    UINT32 mipCount = UINT32_MAX;
+    for (const TextureDesc& slice : array.slices)
+    {
+        if (slice.mipmapsCount != 0)
+        {
+            mipCount = std::min(mipCount, slice.mipmapsCount);
+        }
+    }
+
+    desc = TextureDesc();
+    desc.fmt = array.fmt;
+    desc.width = array.width;
+    desc.height = array.height;
+    desc.arraySize = sliceCount;
+    desc.isCubemap = isCubemap;
+    desc.isArray = true;
+    desc.mipmapsCount = mipCount;
+    desc.dataSize = ComputeSubresourceLayout(array.fmt, array.width, array.height, 1, sliceCount, mipCount, mipCount,
+        desc.subresources);
+    desc.pitch = desc.subresources[0].rowPitch;
+
+    // Free slices read from a shared block of zeros as large as the top level
+    if (sliceCount != array.allocator.GetLiveCount() && m_zeros.size() < desc.subresources[0].slicePitch)
+    {
+        m_zeros.assign(desc.subresources[0].slicePitch, 0);
+    }
+
+    data.resize((size_t)sliceCount * mipCount);
+    for (UINT32 slice = 0; slice < sliceCount; slice++)
+    {
+        const TextureDesc& source = array.slices[slice];
+
+        for (UINT32 mip = 0; mip < mipCount; mip++)
+        {
+            D3D11_SUBRESOURCE_DATA& subresourceData = data[slice * mipCount + mip];
+            if (source.mipmapsCount != 0)
+            {
+                subresourceData.pSysMem = source.GetSubresourceData(mip);
+                subresourceData.SysMemPitch = source.subresources[mip].rowPitch;
+            }
+            else
+            {
+                subresourceData.pSysMem = m_zeros.data();
+                subresourceData.SysMemPitch = desc.subresources[mip].rowPitch;
+            }
+            subresourceData.SysMemSlicePitch = 0;
+        }
+    }
+
+    if (pContentKey != nullptr)
+    {
+        // Slices were hashed when they were added, the texels are not read again
+        *pContentKey = ComputeContentHash(array.keys.data(), array.keys.size() * sizeof(UINT64),
+            ComputeTextureDescKey(desc));
+    }
+
+    array.isDirty = false;
+
+    return true;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <d3d11.h>
+
+#include "DDS.h"
+
+/** Hands out slice indices of one array, freed slices are reused lowest first */
+class TextureSliceAllocator
+{
+public:
+    explicit TextureSliceAllocator(UINT32 capacity) : m_capacity(capacity) {}
+
+    /** Returns false when all slices are taken */
+    bool Allocate(UINT32& slice);
+    void Free(UINT32 slice);
+
+    /** One past the highest slice ever allocated, the array has to be this long */
+    UINT32 GetSliceCount() const { return m_sliceCount; }
+    UINT32 GetLiveCount() const { return m_sliceCount - (UINT32)m_freeSlices.size(); }
+
+private:
+    UINT32 m_capacity;
+    UINT32 m_sliceCount = 0;
+    std::vector<UINT32> m_freeSlices;       ///< Kept sorted in descending order
+};
+
+/** Place of one texture inside the arrays of a TextureArrayBuilder */
+struct TextureArraySlice
+{
+    UINT32 arrayIndex = UINT32_MAX;
+    UINT32 slice = 0;
+
+    bool IsValid() const { return arrayIndex != UINT32_MAX; }
+};
+
+/** Layers of one material, the normal one is invalid if the material has none */
+struct MaterialSlices
+{
+    TextureArraySlice diffuse;
+    TextureArraySlice normal;
+};
+
+/**
+ * Packs 2D textures of the same format and size into texture arrays, so draws of
+ * many materials share one view per array instead of binding a view per texture.
+ * Textures are kept by reference to their loaded data and copied only by the
+ * driver when an array is created. The shortest mip chain among the slices of an
+ * array limits the whole array, free slices are filled with zeros.
+ */
+class TextureArrayBuilder
+{
+public:
+    static const UINT32 MaxArraySize = D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION;
+    static const UINT32 InvalidMaterial = UINT32_MAX;
+
+    /**
+     * Adds a single 2D texture, fails for arrays, cubemaps and volume textures.
+     * contentKey is ComputeTextureKey of the texture if the caller has it, 0 hashes here.
+     */
+    bool Add(const TextureDesc& desc, TextureArraySlice& slice, UINT64 contentKey = 0);
+    static bool CanAdd(const TextureDesc& desc);
+    bool AddFile(const std::wstring& filepath, TextureArraySlice& slice, DDSLoadMode mode = DDSLoadMode::Mapped);
+
+    /** Releases the slice for reuse, the array keeps its length */
+    void Remove(const TextureArraySlice& slice);
+
+    /** Adds the layers of a material and returns its index in the material table */
+    UINT32 AddMaterial(const TextureDesc& diffuse, const TextureDesc* pNormal);
+    void RemoveMaterial(UINT32 material);
+
+    /**
+     * Moves one layer of a material to another texture, as when a streamed texture
+     * changes its resident mips. A texture of another size or format moves the layer
+     * to another array, the material table has to be read again afterwards.
+     */
+    bool ReplaceLayer(UINT32 material, bool isNormal, const TextureDesc& desc, UINT64 contentKey = 0);
+
+    const MaterialSlices& GetMaterial(UINT32 material) const { return m_materials[material]; }
+
+    /**
+     * Material table as four UINT32 per material: diffuse array and slice, then normal
+     * array and slice. Meant for a constant or structured buffer indexed by material.
+     */
+    void GetMaterialTable(std::vector<UINT32>& table) const;
+
+    UINT32 GetArrayCount() const { return (UINT32)m_arrays.size(); }
+    DXGI_FORMAT GetFormat(UINT32 arrayIndex) const { return m_arrays[arrayIndex].fmt; }
+
+    /** Slices in use, an array without any cannot be built and its texture may go */
+    UINT32 GetLiveSliceCount(UINT32 arrayIndex) const { return m_arrays[arrayIndex].allocator.GetLiveCount(); }
+
+    /** True if slices were added or removed since the array was last built */
+    bool IsDirty(UINT32 arrayIndex) const { return m_arrays[arrayIndex].isDirty; }
+
+    /**
+     * Describes the array and fills initial data of all its subresources for
+     * CreateTexture2D. The desc has the layout only, texels are reached through data,
+     * which points into the added textures and stays valid until they change.
+     * isCubemap needs square slices, a multiple of six of them. pContentKey receives
+     * the TextureCache key of the array, made of the keys of its slices.
+     */
+    bool Build(UINT32 arrayIndex, TextureDesc& desc, std::vector<D3D11_SUBRESOURCE_DATA>& data,
+        bool isCubemap = false, UINT64* pContentKey = nullptr);
+
+private:
+    struct Array
+    {
+        Array() : allocator(MaxArraySize) {}
+
+        DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
+        UINT32 width = 0;
+        UINT32 height = 0;
+
+        TextureSliceAllocator allocator;
+        std::vector<TextureDesc> slices;    ///< Indexed by slice, empty descs are free slices
+        std::vector<UINT64> keys;           ///< ComputeTextureKey of each slice, 0 for free ones
+        bool isDirty = true;
+    };
+
+    std::vector<Array> m_arrays;
+    std::vector<MaterialSlices> m_materials;
+    std::vector<UINT32> m_freeMaterials;
+    std::vector<UINT8> m_zeros;
+};
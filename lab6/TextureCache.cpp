@@ -0,0 +1,181 @@
+#include "framework.h"
+
+#include "TextureCache.h"
+
+TextureCache& TextureCache::GetDefault()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+HRESULT TextureCache::Acquire(ID3D11Device* pDevice, const TextureDesc& textureDesc, const D3D11_SUBRESOURCE_DATA* pData,
+    const std::string& name, ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView, UINT64 contentKey)
+{
+    if (contentKey == 0)
+    {
+        // Row and slice padding of the source data is not part of the key
+        contentKey = ComputeTextureKey(textureDesc, [pData](UINT32 index, UINT32& pitch, UINT32& slicePitch)
+        {
+            pitch = pData[index].SysMemPitch;
+            slicePitch = pData[index].SysMemSlicePitch;
+            return pData[index].pSysMem;
+        });
+    }
+
+    UINT64 bytes = 0;
+    for (UINT32 i = 0; i < textureDesc.arraySize * textureDesc.mipmapsCount; i++)
+    {
+        bytes += textureDesc.subresources[i % textureDesc.mipmapsCount].slicePitch;
+    }
+
+    Key key(pDevice, contentKey);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end())
+    {
+        it->second.refCount++;
+        m_stats.hits++;
+        m_stats.bytesSaved += bytes;
+
+        *ppTexture = it->second.pTexture;
+        *ppView = it->second.pView;
+
+        return S_OK;
+    }
+
+    Entry entry;
+    HRESULT result = CreateTexture(pDevice, textureDesc, pData, name, &entry.pTexture, &entry.pView);
+
+    if (FAILED(result))
+    {
+        if (entry.pView != nullptr)
+        {
+            entry.pView->Release();
+        }
+        if (entry.pTexture != nullptr)
+        {
+            entry.pTexture->Release();
+        }
+        return result;
+    }
+
+    entry.refCount = 1;
+    entry.bytes = bytes;
+
+    m_entries[key] = entry;
+    m_keys[entry.pView] = key;
+
+    m_stats.misses++;
+    m_stats.residentBytes += bytes;
+    m_stats.textureCount++;
+
+    *ppTexture = entry.pTexture;
+    *ppView = entry.pView;
+
+    return S_OK;
+}
+
+void TextureCache::Release(ID3D11ShaderResourceView* pView)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto keyIt = m_keys.find(pView);
+    assert(keyIt != m_keys.end());
+    if (keyIt == m_keys.end())
+    {
+        return;
+    }
+
+    auto it = m_entries.find(keyIt->second);
+    Entry& entry = it->second;
+    if (--entry.refCount != 0)
+    {
+        return;
+    }
+
+    entry.pView->Release();
+    entry.pTexture->Release();
+
+    m_stats.residentBytes -= entry.bytes;
+    m_stats.textureCount--;
+
+    m_entries.erase(it);
+    m_keys.erase(keyIt);
+}
+
+TextureCacheStats TextureCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+HRESULT TextureCache::CreateTexture(ID3D11Device* pDevice, const TextureDesc& textureDesc,
+    const D3D11_SUBRESOURCE_DATA* pData, const std::string& name,
+    ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView)
+{
+    HRESULT result;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Format = textureDesc.fmt;
+    desc.ArraySize = textureDesc.arraySize;
+    desc.MipLevels = textureDesc.mipmapsCount;
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    desc.CPUAccessFlags = 0;
+    desc.MiscFlags = textureDesc.isCubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+    desc.SampleDesc.Count = 1;
+    desc.SampleDesc.Quality = 0;
+    desc.Height = textureDesc.height;
+    desc.Width = textureDesc.width;
+
+    result = pDevice->CreateTexture2D(&desc, pData, ppTexture);
+    assert(SUCCEEDED(result));
+
+    if (SUCCEEDED(result))
+    {
+        result = (*ppTexture)->SetPrivateData(WKPDID_D3DDebugObjectName,
+            (UINT)name.length(), name.c_str());
+    }
+
+    if (SUCCEEDED(result))
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+        viewDesc.Format = textureDesc.fmt;
+
+        if (textureDesc.isCubemap)
+        {
+            viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+            viewDesc.TextureCube.MipLevels = textureDesc.mipmapsCount;
+            viewDesc.TextureCube.MostDetailedMip = 0;
+        }
+        else if (textureDesc.arraySize > 1 || textureDesc.isArray)
+        {
+            viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+            viewDesc.Texture2DArray.MipLevels = textureDesc.mipmapsCount;
+            viewDesc.Texture2DArray.MostDetailedMip = 0;
+            viewDesc.Texture2DArray.FirstArraySlice = 0;
+            viewDesc.Texture2DArray.ArraySize = textureDesc.arraySize;
+        }
+        else
+        {
+            viewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            viewDesc.Texture2D.MipLevels = textureDesc.mipmapsCount;
+            viewDesc.Texture2D.MostDetailedMip = 0;
+        }
+
+        result = pDevice->CreateShaderResourceView(*ppTexture, &viewDesc, ppView);
+        assert(SUCCEEDED(result));
+    }
+
+    if (SUCCEEDED(result))
+    {
+        std::string viewName = name + "View";
+
+        result = (*ppView)->SetPrivateData(WKPDID_D3DDebugObjectName,
+            (UINT)viewName.length(), viewName.c_str());
+    }
+
+    return result;
+}
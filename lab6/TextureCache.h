@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <d3d11.h>
+
+#include "DDS.h"
+
+struct TextureCacheStats
+{
+    UINT64 hits = 0;                ///< Requests served by an already created texture
+    UINT64 misses = 0;              ///< Requests that created a texture
+    UINT64 bytesSaved = 0;          ///< Texel bytes hits did not upload again
+    UINT64 residentBytes = 0;       ///< Texel bytes of all live textures
+    UINT32 textureCount = 0;
+};
+
+/**
+ * Process wide cache of immutable textures keyed by a content hash of their texels
+ * and description, so identical payloads are uploaded once per device whichever
+ * file or renderer they come from. Views are reference counted: every Acquire is
+ * paired with a Release of the view, the texture is destroyed with the last one.
+ */
+class TextureCache
+{
+public:
+    static TextureCache& GetDefault();
+
+    /**
+     * Returns the texture holding the given subresources, creating it on the device
+     * if no live one matches. The pointers are owned by the cache and stay valid
+     * until the view is released, name is only applied to a new texture. contentKey
+     * is ComputeTextureKey of the texture if the caller already has it, 0 hashes here.
+     */
+    HRESULT Acquire(ID3D11Device* pDevice, const TextureDesc& textureDesc, const D3D11_SUBRESOURCE_DATA* pData,
+        const std::string& name, ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView,
+        UINT64 contentKey = 0);
+
+    /** Drops one reference taken by Acquire */
+    void Release(ID3D11ShaderResourceView* pView);
+
+    TextureCacheStats GetStats() const;
+
+private:
+    using Key = std::pair<ID3D11Device*, UINT64>;
+
+    struct Entry
+    {
+        ID3D11Texture2D* pTexture = nullptr;
+        ID3D11ShaderResourceView* pView = nullptr;
+        UINT32 refCount = 0;
+        UINT64 bytes = 0;
+    };
+
+    static HRESULT CreateTexture(ID3D11Device* pDevice, const TextureDesc& textureDesc,
+        const D3D11_SUBRESOURCE_DATA* pData, const std::string& name,
+        ID3D11Texture2D** ppTexture, ID3D11ShaderResourceView** ppView);
+
+    mutable std::mutex m_mutex;
+    std::map<Key, Entry> m_entries;
+    std::unordered_map<ID3D11ShaderResourceView*, Key> m_keys;
+    TextureCacheStats m_stats;
+};
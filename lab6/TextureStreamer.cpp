@@ -0,0 +1,295 @@
+#include "framework.h"
+
+#include "TextureStreamer.h"
+
+#include <float.h>
+
+TextureStreamer::TextureStreamer(const TextureStreamerSettings& settings, const Loader& loader)
+    : m_settings(settings)
+    , m_loader(loader)
+{
+    if (m_loader == nullptr)
+    {
+        m_loader = [](const std::wstring& filepath, UINT32 firstMip, DDSLoadMode mode, TextureDesc& desc)
+        {
+            return LoadDDSMips(filepath, desc, firstMip, 0, mode);
+        };
+    }
+
+    m_thread = std::thread(&TextureStreamer::WorkerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+        m_jobs.clear();
+    }
+    m_condition.notify_all();
+
+    m_thread.join();
+}
+
+bool TextureStreamer::Register(const std::wstring& filepath, UINT32& id, TextureDesc& tailDesc)
+{
+    // Mapping the whole chain only touches the header pages
+    TextureDesc chainDesc;
+    if (!m_loader(filepath, 0, DDSLoadMode::Mapped, chainDesc) || chainDesc.mipmapsCount == 0)
+    {
+        return false;
+    }
+
+    Texture texture;
+    texture.filepath = filepath;
+    texture.size = std::max(chainDesc.width, chainDesc.height);
+    texture.mipBytes.assign(chainDesc.mipmapsCount, 0);
+
+    for (UINT32 i = 0; i < (UINT32)chainDesc.subresources.size(); i++)
+    {
+        const SubresourceLayout& subresource = chainDesc.subresources[i];
+        texture.mipBytes[i % chainDesc.mipmapsCount] += (UINT64)subresource.slicePitch * subresource.depth;
+    }
+
+    texture.tailMip = chainDesc.mipmapsCount - 1;
+    for (UINT32 mip = 0; mip < chainDesc.mipmapsCount; mip++)
+    {
+        const SubresourceLayout& subresource = chainDesc.subresources[mip];
+        if (std::max(subresource.width, subresource.height) <= m_settings.tailSize)
+        {
+            texture.tailMip = mip;
+            break;
+        }
+    }
+
+    if (!m_loader(filepath, texture.tailMip, DDSLoadMode::Copy, tailDesc))
+    {
+        return false;
+    }
+
+    texture.residentMip = texture.tailMip;
+    texture.wantedMip = texture.tailMip;
+    m_residentBytes += GetBytes(texture, texture.tailMip);
+
+    id = (UINT32)m_textures.size();
+    m_textures.push_back(std::move(texture));
+
+    return true;
+}
+
+void TextureStreamer::RequestScreenSize(UINT32 id, float screenSize)
+{
+    Texture& texture = m_textures[id];
+
+    if (texture.lastUsedFrame != m_frame)
+    {
+        texture.lastUsedFrame = m_frame;
+        texture.screenSize = 0.0f;
+    }
+    texture.screenSize = std::max(texture.screenSize, screenSize);
+}
+
+void TextureStreamer::Update(std::vector<TextureStreamerUpdate>& updates)
+{
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+
+    for (Result& result : results)
+    {
+        Texture& texture = m_textures[result.id];
+        texture.pendingMip = NoMip;
+
+        if (!result.success)
+        {
+            // Only a load reserves its bytes up front
+            if (result.firstMip < texture.residentMip)
+            {
+                m_residentBytes -= GetBytes(texture, result.firstMip) - GetBytes(texture, texture.residentMip);
+            }
+            continue;
+        }
+
+        if (result.firstMip > texture.residentMip)
+        {
+            m_residentBytes -= GetBytes(texture, texture.residentMip) - GetBytes(texture, result.firstMip);
+        }
+        texture.residentMip = result.firstMip;
+
+        TextureStreamerUpdate update;
+        update.id = result.id;
+        update.residentMip = result.firstMip;
+        update.desc = std::move(result.desc);
+        update.contentKey = result.contentKey;
+        updates.push_back(std::move(update));
+    }
+
+    // Wanted mip is the finest one not smaller than the texture is on screen
+    std::vector<UINT32> candidates;
+    for (UINT32 id = 0; id < (UINT32)m_textures.size(); id++)
+    {
+        Texture& texture = m_textures[id];
+
+        texture.wantedMip = texture.tailMip;
+        texture.priority = 0.0f;
+        if (texture.lastUsedFrame == m_frame && texture.screenSize > 0.0f)
+        {
+            UINT32 mip = 0;
+            while (mip < texture.tailMip && (float)(texture.size >> (mip + 1)) >= texture.screenSize)
+            {
+                mip++;
+            }
+            texture.wantedMip = mip;
+
+            // The more screen pixels per resident texel, the blurrier the texture looks
+            texture.priority = texture.screenSize / (float)std::max(1u, texture.size >> texture.residentMip);
+        }
+
+        if (texture.pendingMip == NoMip && texture.wantedMip < texture.residentMip)
+        {
+            candidates.push_back(id);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [this](UINT32 a, UINT32 b)
+    {
+        return m_textures[a].priority > m_textures[b].priority;
+    });
+
+    std::vector<Job> jobs;
+    for (UINT32 id : candidates)
+    {
+        Texture& texture = m_textures[id];
+
+        UINT32 mip = texture.residentMip - 1;
+        if (m_residentBytes + texture.mipBytes[mip] > m_settings.budget)
+        {
+            // Loads are strictly ordered, the rest waits until the evicted mips are released
+            EvictFor(texture.mipBytes[mip], jobs);
+            break;
+        }
+
+        m_residentBytes += texture.mipBytes[mip];
+        texture.pendingMip = mip;
+        jobs.push_back({ id, mip, texture.priority, texture.filepath });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Demand of loads still waiting in the queue may have changed since they were added
+        for (Job& job : m_jobs)
+        {
+            if (job.priority != FLT_MAX)
+            {
+                job.priority = m_textures[job.id].priority;
+            }
+        }
+        m_jobs.insert(m_jobs.end(), jobs.begin(), jobs.end());
+
+        std::stable_sort(m_jobs.begin(), m_jobs.end(), [](const Job& a, const Job& b)
+        {
+            return a.priority < b.priority;
+        });
+    }
+    if (!jobs.empty())
+    {
+        m_condition.notify_one();
+    }
+
+    m_frame++;
+}
+
+void TextureStreamer::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCondition.wait(lock, [this]() { return m_jobs.empty() && !m_isBusy; });
+}
+
+UINT64 TextureStreamer::GetBytes(const Texture& texture, UINT32 firstMip) const
+{
+    UINT64 bytes = 0;
+    for (UINT32 mip = firstMip; mip < (UINT32)texture.mipBytes.size(); mip++)
+    {
+        bytes += texture.mipBytes[mip];
+    }
+    return bytes;
+}
+
+void TextureStreamer::EvictFor(UINT64 bytes, std::vector<Job>& jobs)
+{
+    INT64 excess = (INT64)(m_residentBytes + bytes) - (INT64)m_settings.budget;
+
+    std::vector<UINT32> victims;
+    for (UINT32 id = 0; id < (UINT32)m_textures.size(); id++)
+    {
+        const Texture& texture = m_textures[id];
+
+        // Evictions already on their way count as freed
+        if (texture.pendingMip != NoMip && texture.pendingMip > texture.residentMip)
+        {
+            excess -= (INT64)(GetBytes(texture, texture.residentMip) - GetBytes(texture, texture.pendingMip));
+        }
+        else if (texture.pendingMip == NoMip && texture.residentMip < texture.wantedMip)
+        {
+            victims.push_back(id);
+        }
+    }
+
+    std::sort(victims.begin(), victims.end(), [this](UINT32 a, UINT32 b)
+    {
+        return m_textures[a].lastUsedFrame < m_textures[b].lastUsedFrame;
+    });
+
+    for (UINT32 id : victims)
+    {
+        if (excess <= 0)
+        {
+            break;
+        }
+
+        // Mips the texture does not need right now go all at once
+        Texture& texture = m_textures[id];
+        excess -= (INT64)(GetBytes(texture, texture.residentMip) - GetBytes(texture, texture.wantedMip));
+        texture.pendingMip = texture.wantedMip;
+        jobs.push_back({ id, texture.wantedMip, FLT_MAX, texture.filepath });
+    }
+}
+
+void TextureStreamer::WorkerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+
+            if (m_isStopping)
+            {
+                return;
+            }
+
+            job = std::move(m_jobs.back());
+            m_jobs.pop_back();
+            m_isBusy = true;
+        }
+
+        Result result;
+        result.id = job.id;
+        result.firstMip = job.firstMip;
+        result.success = m_loader(job.filepath, job.firstMip, DDSLoadMode::Copy, result.desc);
+
+        // The owner passes the key on to TextureCache, which would hash the texels otherwise
+        result.contentKey = result.success ? ComputeTextureKey(result.desc) : 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_results.push_back(std::move(result));
+            m_isBusy = false;
+        }
+        m_idleCondition.notify_all();
+    }
+}
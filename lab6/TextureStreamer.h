@@ -0,0 +1,129 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DDS.h"
+
+struct TextureStreamerSettings
+{
+    UINT64 budget = 64ull << 20;    ///< Bytes resident mips of all streamed textures may take
+    UINT32 tailSize = 64;           ///< Mips not larger than this are loaded on registration and never evicted
+};
+
+/** Resident range of a streamed texture changed, the GPU copy has to be recreated */
+struct TextureStreamerUpdate
+{
+    UINT32 id = 0;
+    UINT32 residentMip = 0;         ///< Finest mip of the file now resident
+    TextureDesc desc;               ///< Mips residentMip..last of every slice
+    UINT64 contentKey = 0;          ///< ComputeTextureKey of desc, hashed on the background thread
+};
+
+/**
+ * Residency manager of mip-streamed textures. Only the small mip tail is loaded on
+ * registration; finer mips are requested from the screen size each texture covers
+ * and are read one level at a time on a background thread, most demanded first.
+ * Resident mips are kept under the byte budget by dropping mips of the least recently
+ * used textures that hold more than they need. Knows nothing about D3D, the owner
+ * recreates its textures from the updates.
+ */
+class TextureStreamer
+{
+public:
+    /**
+     * Reads mips firstMip..last of the file, LoadDDSMips unless replaced. Mapped mode
+     * is only used to learn the layout of the whole chain on registration.
+     */
+    using Loader = std::function<bool(const std::wstring& filepath, UINT32 firstMip, DDSLoadMode mode,
+        TextureDesc& desc)>;
+
+    explicit TextureStreamer(const TextureStreamerSettings& settings = TextureStreamerSettings(),
+        const Loader& loader = nullptr);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /** Loads the mip tail synchronously, tailDesc receives it for the initial texture */
+    bool Register(const std::wstring& filepath, UINT32& id, TextureDesc& tailDesc);
+
+    /**
+     * Reports this frame's demand, the size in pixels the texture spans on screen
+     * along its larger axis. Textures not reported during a frame fall back to the tail.
+     */
+    void RequestScreenSize(UINT32 id, float screenSize);
+
+    /**
+     * Called once per frame: hands out finished loads and evictions, then schedules
+     * new ones for the demand reported since the previous call.
+     */
+    void Update(std::vector<TextureStreamerUpdate>& updates);
+
+    /** Blocks until the background thread has nothing left to read */
+    void WaitIdle();
+
+    UINT64 GetResidentBytes() const { return m_residentBytes; }
+    UINT32 GetResidentMip(UINT32 id) const { return m_textures[id].residentMip; }
+    UINT32 GetWantedMip(UINT32 id) const { return m_textures[id].wantedMip; }
+
+private:
+    static const UINT32 NoMip = ~0u;
+
+    struct Texture
+    {
+        std::wstring filepath;
+        UINT32 size = 0;                ///< Larger dimension of mip 0
+        UINT32 tailMip = 0;
+        std::vector<UINT64> mipBytes;   ///< Bytes of each mip summed over slices
+
+        UINT32 residentMip = 0;
+        UINT32 wantedMip = 0;
+        UINT32 pendingMip = NoMip;      ///< Target of the queued or running job
+        float screenSize = 0.0f;
+        float priority = 0.0f;
+        UINT64 lastUsedFrame = 0;
+    };
+
+    struct Job
+    {
+        UINT32 id;
+        UINT32 firstMip;
+        float priority;
+        std::wstring filepath;      ///< Copied so the loader thread never reads the texture list
+    };
+
+    struct Result
+    {
+        UINT32 id;
+        UINT32 firstMip;
+        bool success;
+        TextureDesc desc;
+        UINT64 contentKey;
+    };
+
+    UINT64 GetBytes(const Texture& texture, UINT32 firstMip) const;
+    void EvictFor(UINT64 bytes, std::vector<Job>& jobs);
+
+    void WorkerLoop();
+
+    TextureStreamerSettings m_settings;
+    Loader m_loader;
+
+    std::vector<Texture> m_textures;
+    UINT64 m_frame = 1;
+    UINT64 m_residentBytes = 0;     ///< Bytes of resident mips and of those being loaded
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_idleCondition;
+    std::vector<Job> m_jobs;        ///< Sorted by priority, the last one is taken first
+    std::vector<Result> m_results;
+    bool m_isBusy = false;
+    bool m_isStopping = false;
+};
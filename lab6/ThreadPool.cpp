@@ -0,0 +1,147 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        m_threads.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::GetDefault()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::Enqueue(std::function<void()>&& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+
+            // Queue is drained before exit so that no future is left without a result
+            if (m_jobs.empty())
+            {
+                return;
+            }
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    if (count == 1)
+    {
+        func(0);
+        return;
+    }
+
+    struct SharedState
+    {
+        std::atomic<uint32_t> next{ 0 };
+        std::atomic<uint32_t> done{ 0 };
+        std::atomic<bool> isFailed{ false };
+        std::exception_ptr pException;      ///< First exception thrown by func, guarded by mutex
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    auto pState = std::make_shared<SharedState>();
+
+    // Indices are grabbed one by one, so uneven items balance across threads.
+    // Items are counted as done even when func throws or is skipped after a
+    // failure, otherwise the caller would wait forever.
+    auto worker = [pState, count, &func]()
+    {
+        uint32_t finished = 0;
+        for (uint32_t i = pState->next++; i < count; i = pState->next++)
+        {
+            if (!pState->isFailed)
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(pState->mutex);
+                    if (!pState->isFailed)
+                    {
+                        pState->pException = std::current_exception();
+                        pState->isFailed = true;
+                    }
+                }
+            }
+            finished++;
+        }
+
+        if (finished != 0 && (pState->done += finished) == count)
+        {
+            std::lock_guard<std::mutex> lock(pState->mutex);
+            pState->condition.notify_all();
+        }
+    };
+
+    uint32_t helpers = std::min(count - 1, GetThreadCount());
+    for (uint32_t i = 0; i < helpers; i++)
+    {
+        Enqueue(worker);
+    }
+
+    worker();
+
+    std::unique_lock<std::mutex> lock(pState->mutex);
+    pState->condition.wait(lock, [&]() { return pState->done == count; });
+
+    if (pState->pException != nullptr)
+    {
+        std::rethrow_exception(pState->pException);
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Fixed set of worker threads executing queued jobs in FIFO order */
+class ThreadPool
+{
+public:
+    /** threadCount == 0 picks one thread per hardware thread */
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** Pool shared by loaders and other CPU heavy subsystems, created on first use */
+    static ThreadPool& GetDefault();
+
+    uint32_t GetThreadCount() const { return (uint32_t)m_threads.size(); }
+
+    /** Queues the job, the returned future gets its result or exception */
+    template <typename F>
+    auto Submit(F&& func) -> std::future<decltype(func())>
+    {
+        using ResultType = decltype(func());
+
+        auto pTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(func));
+        std::future<ResultType> future = pTask->get_future();
+
+        Enqueue([pTask]() { (*pTask)(); });
+
+        return future;
+    }
+
+    /**
+     * Runs func(i) for every i in [0, count) and returns when all are done.
+     * The calling thread takes part in the work, so nested calls from a
+     * worker can not deadlock the pool. If func throws, items not started yet
+     * are skipped and the first exception is rethrown here once the running
+     * ones have finished, as Submit hands it over through its future.
+     */
+    void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& func);
+
+private:
+    void Enqueue(std::function<void()>&& job);
+    void WorkerLoop();
+
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_isStopping = false;
+};
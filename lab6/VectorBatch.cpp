@@ -0,0 +1,502 @@
+#include "framework.h"
+
+#include "VectorBatch.h"
+#include "CpuFeatures.h"
+
+#include <float.h>
+#include <math.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VECTOR_BATCH_SSE 1
+#include <immintrin.h>
+#endif
+
+// MSVC emits AVX2 and AVX-512 intrinsics without extra switches, GCC and Clang need them enabled per function.
+// AVX-512 implies FMA for GCC, which would fuse the multiplies and adds of the kernels.
+#if defined(VECTOR_BATCH_SSE) && !defined(_MSC_VER)
+#define VB_AVX2_TARGET __attribute__((target("avx2")))
+#define VB_AVX512_TARGET __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define VB_AVX2_TARGET
+#define VB_AVX512_TARGET
+#endif
+
+namespace
+{
+
+    /** Kernels over the component arrays of a batch, count is the padded count */
+    struct BatchKernels
+    {
+        void (*pScale)(float* const* ppValues, const float* pScale, size_t count);
+        void (*pTranslate)(float* const* ppValues, const float* pOffset, size_t count);
+        void (*pNormalize)(float* const* ppValues, size_t count);
+        void (*pDot)(const float* const* ppA, const float* const* ppB, float* pResults, size_t count);
+        void (*pTransform)(float* const* ppValues, const float (*pMatrix)[4], size_t count);
+    };
+
+    using CrossKernel = void (*)(const float* const* ppA, const float* const* ppB, float* const* ppResult, size_t count);
+
+    /**
+     * Kernels of one instruction set for vectors of Components components. Every path
+     * adds and multiplies in the same order and none of them fuses, so they all give
+     * the same results. Width lanes of each component are processed at once.
+     */
+#define VECTOR_BATCH_KERNELS(Suffix, Target, Components, Vec, Width, Set1, Load, Store, Add, Mul, Div, Sqrt, Max) \
+    Target void Scale##Suffix(float* const* ppValues, const float* pScale, size_t count)                          \
+    {                                                                                                           \
+        for (size_t c = 0; c < Components; c++)                                                                 \
+        {                                                                                                       \
+            const Vec scale = Set1(pScale[c]);                                                                  \
+            float* pValues = ppValues[c];                                                                       \
+            for (size_t i = 0; i < count; i += Width)                                                           \
+            {                                                                                                   \
+                Store(pValues + i, Mul(Load(pValues + i), scale));                                              \
+            }                                                                                                   \
+        }                                                                                                       \
+    }                                                                                                           \
+                                                                                                                \
+    Target void Translate##Suffix(float* const* ppValues, const float* pOffset, size_t count)                    \
+    {                                                                                                           \
+        for (size_t c = 0; c < Components; c++)                                                                 \
+        {                                                                                                       \
+            const Vec offset = Set1(pOffset[c]);                                                                \
+            float* pValues = ppValues[c];                                                                       \
+            for (size_t i = 0; i < count; i += Width)                                                           \
+            {                                                                                                   \
+                Store(pValues + i, Add(Load(pValues + i), offset));                                             \
+            }                                                                                                   \
+        }                                                                                                       \
+    }                                                                                                           \
+                                                                                                                \
+    Target void Normalize##Suffix(float* const* ppValues, size_t count)                                         \
+    {                                                                                                           \
+        const Vec one = Set1(1.0f);                                                                             \
+        /* Zero vectors get a finite reciprocal and stay zero */                                                \
+        const Vec minLengthSquared = Set1(FLT_MIN);                                                             \
+                                                                                                                \
+        for (size_t i = 0; i < count; i += Width)                                                               \
+        {                                                                                                       \
+            Vec v[Components];                                                                                  \
+            for (size_t c = 0; c < Components; c++)                                                             \
+            {                                                                                                   \
+                v[c] = Load(ppValues[c] + i);                                                                   \
+            }                                                                                                   \
+                                                                                                                \
+            Vec lengthSquared = Mul(v[0], v[0]);                                                                \
+            for (size_t c = 1; c < Components; c++)                                                             \
+            {                                                                                                   \
+                lengthSquared = Add(lengthSquared, Mul(v[c], v[c]));                                            \
+            }                                                                                                   \
+                                                                                                                \
+            Vec invLength = Div(one, Sqrt(Max(lengthSquared, minLengthSquared)));                               \
+            for (size_t c = 0; c < Components; c++)                                                             \
+            {                                                                                                   \
+                Store(ppValues[c] + i, Mul(v[c], invLength));                                                   \
+            }                                                                                                   \
+        }                                                                                                       \
+    }                                                                                                           \
+                                                                                                                \
+    Target void Dot##Suffix(const float* const* ppA, const float* const* ppB, float* pResults, size_t count)    \
+    {                                                                                                           \
+        for (size_t i = 0; i < count; i += Width)                                                               \
+        {                                                                                                       \
+            Vec sum = Mul(Load(ppA[0] + i), Load(ppB[0] + i));                                                  \
+            for (size_t c = 1; c < Components; c++)                                                             \
+            {                                                                                                   \
+                sum = Add(sum, Mul(Load(ppA[c] + i), Load(ppB[c] + i)));                                        \
+            }                                                                                                   \
+            Store(pResults + i, sum);                                                                           \
+        }                                                                                                       \
+    }                                                                                                           \
+                                                                                                                \
+    Target void Transform##Suffix(float* const* ppValues, const float (*pMatrix)[4], size_t count)              \
+    {                                                                                                           \
+        Vec matrix[4][Components];                                                                              \
+        for (size_t r = 0; r < 4; r++)                                                                          \
+        {                                                                                                       \
+            for (size_t c = 0; c < Components; c++)                                                             \
+            {                                                                                                   \
+                matrix[r][c] = Set1(pMatrix[r][c]);                                                             \
+            }                                                                                                   \
+        }                                                                                                       \
+                                                                                                                \
+        for (size_t i = 0; i < count; i += Width)                                                               \
+        {                                                                                                       \
+            Vec v[Components];                                                                                  \
+            for (size_t c = 0; c < Components; c++)                                                             \
+            {                                                                                                   \
+                v[c] = Load(ppValues[c] + i);                                                                   \
+            }                                                                                                   \
+                                                                                                                \
+            for (size_t c = 0; c < Components; c++)                                                             \
+            {                                                                                                   \
+                Vec sum = Mul(v[0], matrix[0][c]);                                                              \
+                for (size_t r = 1; r < Components; r++)                                                         \
+                {                                                                                               \
+                    sum = Add(sum, Mul(v[r], matrix[r][c]));                                                    \
+                }                                                                                               \
+                /* Points have an implicit w of 1 */                                                            \
+                if (Components == 3)                                                                            \
+                {                                                                                               \
+                    sum = Add(sum, matrix[3][c]);                                                               \
+                }                                                                                               \
+                Store(ppValues[c] + i, sum);                                                                    \
+            }                                                                                                   \
+        }                                                                                                       \
+    }
+
+#define VECTOR_BATCH_CROSS(Suffix, Target, Vec, Width, Load, Store, Sub, Mul)                                   \
+    Target void Cross##Suffix(const float* const* ppA, const float* const* ppB, float* const* ppResult,          \
+        size_t count)                                                                                           \
+    {                                                                                                           \
+        for (size_t i = 0; i < count; i += Width)                                                               \
+        {                                                                                                       \
+            Vec ax = Load(ppA[0] + i), ay = Load(ppA[1] + i), az = Load(ppA[2] + i);                            \
+            Vec bx = Load(ppB[0] + i), by = Load(ppB[1] + i), bz = Load(ppB[2] + i);                            \
+                                                                                                                \
+            Store(ppResult[0] + i, Sub(Mul(ay, bz), Mul(az, by)));                                              \
+            Store(ppResult[1] + i, Sub(Mul(az, bx), Mul(ax, bz)));                                              \
+            Store(ppResult[2] + i, Sub(Mul(ax, by), Mul(ay, bx)));                                              \
+        }                                                                                                       \
+    }
+
+#define VECTOR_BATCH_TABLE(Suffix) { Scale##Suffix, Translate##Suffix, Normalize##Suffix, Dot##Suffix, Transform##Suffix }
+
+#ifdef VECTOR_BATCH_SSE
+
+    VECTOR_BATCH_KERNELS(3SSE, , 3, __m128, 4, _mm_set1_ps, _mm_loadu_ps, _mm_storeu_ps,
+        _mm_add_ps, _mm_mul_ps, _mm_div_ps, _mm_sqrt_ps, _mm_max_ps)
+    VECTOR_BATCH_KERNELS(4SSE, , 4, __m128, 4, _mm_set1_ps, _mm_loadu_ps, _mm_storeu_ps,
+        _mm_add_ps, _mm_mul_ps, _mm_div_ps, _mm_sqrt_ps, _mm_max_ps)
+    VECTOR_BATCH_CROSS(SSE, , __m128, 4, _mm_loadu_ps, _mm_storeu_ps, _mm_sub_ps, _mm_mul_ps)
+
+    VECTOR_BATCH_KERNELS(3AVX2, VB_AVX2_TARGET, 3, __m256, 8, _mm256_set1_ps, _mm256_loadu_ps, _mm256_storeu_ps,
+        _mm256_add_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_sqrt_ps, _mm256_max_ps)
+    VECTOR_BATCH_KERNELS(4AVX2, VB_AVX2_TARGET, 4, __m256, 8, _mm256_set1_ps, _mm256_loadu_ps, _mm256_storeu_ps,
+        _mm256_add_ps, _mm256_mul_ps, _mm256_div_ps, _mm256_sqrt_ps, _mm256_max_ps)
+    VECTOR_BATCH_CROSS(AVX2, VB_AVX2_TARGET, __m256, 8, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps, _mm256_mul_ps)
+
+    VECTOR_BATCH_KERNELS(3AVX512, VB_AVX512_TARGET, 3, __m512, 16, _mm512_set1_ps, _mm512_loadu_ps, _mm512_storeu_ps,
+        _mm512_add_ps, _mm512_mul_ps, _mm512_div_ps, _mm512_sqrt_ps, _mm512_max_ps)
+    VECTOR_BATCH_KERNELS(4AVX512, VB_AVX512_TARGET, 4, __m512, 16, _mm512_set1_ps, _mm512_loadu_ps, _mm512_storeu_ps,
+        _mm512_add_ps, _mm512_mul_ps, _mm512_div_ps, _mm512_sqrt_ps, _mm512_max_ps)
+    VECTOR_BATCH_CROSS(AVX512, VB_AVX512_TARGET, __m512, 16, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_sub_ps, _mm512_mul_ps)
+
+#else
+
+    inline float ScalarSet1(float value) { return value; }
+    inline float ScalarLoad(const float* p) { return *p; }
+    inline void ScalarStore(float* p, float value) { *p = value; }
+    inline float ScalarAdd(float a, float b) { return a + b; }
+    inline float ScalarSub(float a, float b) { return a - b; }
+    inline float ScalarMul(float a, float b) { return a * b; }
+    inline float ScalarDiv(float a, float b) { return a / b; }
+    inline float ScalarSqrt(float value) { return sqrtf(value); }
+    // As maxps, the second operand wins if either is NaN
+    inline float ScalarMax(float a, float b) { return a > b ? a : b; }
+
+    VECTOR_BATCH_KERNELS(3Scalar, , 3, float, 1, ScalarSet1, ScalarLoad, ScalarStore,
+        ScalarAdd, ScalarMul, ScalarDiv, ScalarSqrt, ScalarMax)
+    VECTOR_BATCH_KERNELS(4Scalar, , 4, float, 1, ScalarSet1, ScalarLoad, ScalarStore,
+        ScalarAdd, ScalarMul, ScalarDiv, ScalarSqrt, ScalarMax)
+    VECTOR_BATCH_CROSS(Scalar, , float, 1, ScalarLoad, ScalarStore, ScalarSub, ScalarMul)
+
+#endif
+
+    const BatchKernels& GetKernels(size_t components)
+    {
+#ifdef VECTOR_BATCH_SSE
+        static const BatchKernels Kernels3SSE = VECTOR_BATCH_TABLE(3SSE);
+        static const BatchKernels Kernels4SSE = VECTOR_BATCH_TABLE(4SSE);
+        static const BatchKernels Kernels3AVX2 = VECTOR_BATCH_TABLE(3AVX2);
+        static const BatchKernels Kernels4AVX2 = VECTOR_BATCH_TABLE(4AVX2);
+        static const BatchKernels Kernels3AVX512 = VECTOR_BATCH_TABLE(3AVX512);
+        static const BatchKernels Kernels4AVX512 = VECTOR_BATCH_TABLE(4AVX512);
+
+        const CpuFeatures& features = GetCpuFeatures();
+        if (features.avx512f)
+        {
+            return components == 3 ? Kernels3AVX512 : Kernels4AVX512;
+        }
+        if (features.avx2)
+        {
+            return components == 3 ? Kernels3AVX2 : Kernels4AVX2;
+        }
+        return components == 3 ? Kernels3SSE : Kernels4SSE;
+#else
+        static const BatchKernels Kernels3Scalar = VECTOR_BATCH_TABLE(3Scalar);
+        static const BatchKernels Kernels4Scalar = VECTOR_BATCH_TABLE(4Scalar);
+
+        return components == 3 ? Kernels3Scalar : Kernels4Scalar;
+#endif
+    }
+
+    CrossKernel GetCrossKernel()
+    {
+#ifdef VECTOR_BATCH_SSE
+        const CpuFeatures& features = GetCpuFeatures();
+        if (features.avx512f)
+        {
+            return CrossAVX512;
+        }
+        return features.avx2 ? CrossAVX2 : CrossSSE;
+#else
+        return CrossScalar;
+#endif
+    }
+
+#undef VECTOR_BATCH_TABLE
+#undef VECTOR_BATCH_CROSS
+#undef VECTOR_BATCH_KERNELS
+
+    template <size_t Components>
+    void GetComponents(VectorBatch<Components>& batch, float* (&ppComponents)[Components])
+    {
+        for (size_t c = 0; c < Components; c++)
+        {
+            ppComponents[c] = batch.GetComponent(c);
+        }
+    }
+
+    template <size_t Components>
+    void GetComponents(const VectorBatch<Components>& batch, const float* (&ppComponents)[Components])
+    {
+        for (size_t c = 0; c < Components; c++)
+        {
+            ppComponents[c] = batch.GetComponent(c);
+        }
+    }
+
+}
+
+void Float3Batch::Load(const XMFLOAT3* pVectors, size_t count)
+{
+    Resize(count);
+
+    float* pX = GetX();
+    float* pY = GetY();
+    float* pZ = GetZ();
+    size_t i = 0;
+
+#ifdef VECTOR_BATCH_SSE
+    // Four vectors are three registers: x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    for (; i + 4 <= count; i += 4)
+    {
+        const float* pSource = &pVectors[i].x;
+        __m128 a = _mm_loadu_ps(pSource);
+        __m128 b = _mm_loadu_ps(pSource + 4);
+        __m128 c = _mm_loadu_ps(pSource + 8);
+
+        __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+
+        _mm_storeu_ps(pX + i, x);
+        _mm_storeu_ps(pY + i, y);
+        _mm_storeu_ps(pZ + i, z);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        pX[i] = pVectors[i].x;
+        pY[i] = pVectors[i].y;
+        pZ[i] = pVectors[i].z;
+    }
+}
+
+void Float3Batch::Store(XMFLOAT3* pVectors) const
+{
+    const float* pX = GetX();
+    const float* pY = GetY();
+    const float* pZ = GetZ();
+    size_t i = 0;
+
+#ifdef VECTOR_BATCH_SSE
+    for (; i + 4 <= m_count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(pX + i);
+        __m128 y = _mm_loadu_ps(pY + i);
+        __m128 z = _mm_loadu_ps(pZ + i);
+
+        __m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+            _MM_SHUFFLE(2, 0, 2, 0));
+
+        float* pTarget = &pVectors[i].x;
+        _mm_storeu_ps(pTarget, a);
+        _mm_storeu_ps(pTarget + 4, b);
+        _mm_storeu_ps(pTarget + 8, c);
+    }
+#endif
+
+    for (; i < m_count; i++)
+    {
+        pVectors[i] = XMFLOAT3(pX[i], pY[i], pZ[i]);
+    }
+}
+
+void Float4Batch::Load(const XMFLOAT4* pVectors, size_t count)
+{
+    Resize(count);
+
+    float* pX = GetX();
+    float* pY = GetY();
+    float* pZ = GetZ();
+    float* pW = GetW();
+    size_t i = 0;
+
+#ifdef VECTOR_BATCH_SSE
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&pVectors[i].x);
+        __m128 y = _mm_loadu_ps(&pVectors[i + 1].x);
+        __m128 z = _mm_loadu_ps(&pVectors[i + 2].x);
+        __m128 w = _mm_loadu_ps(&pVectors[i + 3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+
+        _mm_storeu_ps(pX + i, x);
+        _mm_storeu_ps(pY + i, y);
+        _mm_storeu_ps(pZ + i, z);
+        _mm_storeu_ps(pW + i, w);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        pX[i] = pVectors[i].x;
+        pY[i] = pVectors[i].y;
+        pZ[i] = pVectors[i].z;
+        pW[i] = pVectors[i].w;
+    }
+}
+
+void Float4Batch::Store(XMFLOAT4* pVectors) const
+{
+    const float* pX = GetX();
+    const float* pY = GetY();
+    const float* pZ = GetZ();
+    const float* pW = GetW();
+    size_t i = 0;
+
+#ifdef VECTOR_BATCH_SSE
+    for (; i + 4 <= m_count; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(pX + i);
+        __m128 b = _mm_loadu_ps(pY + i);
+        __m128 c = _mm_loadu_ps(pZ + i);
+        __m128 d = _mm_loadu_ps(pW + i);
+        _MM_TRANSPOSE4_PS(a, b, c, d);
+
+        _mm_storeu_ps(&pVectors[i].x, a);
+        _mm_storeu_ps(&pVectors[i + 1].x, b);
+        _mm_storeu_ps(&pVectors[i + 2].x, c);
+        _mm_storeu_ps(&pVectors[i + 3].x, d);
+    }
+#endif
+
+    for (; i < m_count; i++)
+    {
+        pVectors[i] = XMFLOAT4(pX[i], pY[i], pZ[i], pW[i]);
+    }
+}
+
+void ScaleBatch(Float3Batch& batch, const XMFLOAT3& scale)
+{
+    float* ppComponents[3];
+    GetComponents(batch, ppComponents);
+    GetKernels(3).pScale(ppComponents, &scale.x, batch.GetPaddedCount());
+}
+
+void ScaleBatch(Float4Batch& batch, const XMFLOAT4& scale)
+{
+    float* ppComponents[4];
+    GetComponents(batch, ppComponents);
+    GetKernels(4).pScale(ppComponents, &scale.x, batch.GetPaddedCount());
+}
+
+void TranslateBatch(Float3Batch& batch, const XMFLOAT3& offset)
+{
+    float* ppComponents[3];
+    GetComponents(batch, ppComponents);
+    GetKernels(3).pTranslate(ppComponents, &offset.x, batch.GetPaddedCount());
+}
+
+void TranslateBatch(Float4Batch& batch, const XMFLOAT4& offset)
+{
+    float* ppComponents[4];
+    GetComponents(batch, ppComponents);
+    GetKernels(4).pTranslate(ppComponents, &offset.x, batch.GetPaddedCount());
+}
+
+void NormalizeBatch(Float3Batch& batch)
+{
+    float* ppComponents[3];
+    GetComponents(batch, ppComponents);
+    GetKernels(3).pNormalize(ppComponents, batch.GetPaddedCount());
+}
+
+void NormalizeBatch(Float4Batch& batch)
+{
+    float* ppComponents[4];
+    GetComponents(batch, ppComponents);
+    GetKernels(4).pNormalize(ppComponents, batch.GetPaddedCount());
+}
+
+void DotBatch(const Float3Batch& a, const Float3Batch& b, float* pResults)
+{
+    assert(a.GetCount() == b.GetCount());
+
+    const float* ppA[3];
+    const float* ppB[3];
+    GetComponents(a, ppA);
+    GetComponents(b, ppB);
+    GetKernels(3).pDot(ppA, ppB, pResults, a.GetPaddedCount());
+}
+
+void DotBatch(const Float4Batch& a, const Float4Batch& b, float* pResults)
+{
+    assert(a.GetCount() == b.GetCount());
+
+    const float* ppA[4];
+    const float* ppB[4];
+    GetComponents(a, ppA);
+    GetComponents(b, ppB);
+    GetKernels(4).pDot(ppA, ppB, pResults, a.GetPaddedCount());
+}
+
+void CrossBatch(const Float3Batch& a, const Float3Batch& b, Float3Batch& result)
+{
+    assert(a.GetCount() == b.GetCount());
+
+    // A no-op when result is a or b
+    result.Resize(a.GetCount());
+
+    const float* ppA[3];
+    const float* ppB[3];
+    float* ppResult[3];
+    GetComponents(a, ppA);
+    GetComponents(b, ppB);
+    GetComponents(result, ppResult);
+    GetCrossKernel()(ppA, ppB, ppResult, a.GetPaddedCount());
+}
+
+void TransformBatch(Float3Batch& batch, const DirectX::XMFLOAT4X4& matrix)
+{
+    float* ppComponents[3];
+    GetComponents(batch, ppComponents);
+    GetKernels(3).pTransform(ppComponents, matrix.m, batch.GetPaddedCount());
+}
+
+void TransformBatch(Float4Batch& batch, const DirectX::XMFLOAT4X4& matrix)
+{
+    float* ppComponents[4];
+    GetComponents(batch, ppComponents);
+    GetKernels(4).pTransform(ppComponents, matrix.m, batch.GetPaddedCount());
+}
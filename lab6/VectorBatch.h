@@ -0,0 +1,147 @@
+#pragma once
+
+#include "XMFLOAT4.h"
+
+#include "PortableMath.h"
+
+#include <algorithm>
+#include <vector>
+
+/** Lanes of the widest kernel (AVX-512), batches are padded to a multiple of it */
+const size_t VectorBatchWidth = 16;
+
+/**
+ * Structure of arrays storage: Components arrays of floats, one per vector component,
+ * each padded with zeros to a multiple of VectorBatchWidth. The kernels below run over
+ * the padding too, so it holds unspecified values afterwards; it is never read back.
+ */
+template <size_t Components>
+class VectorBatch
+{
+public:
+    /** Keeps the first vectors, new ones are zero */
+    void Resize(size_t count)
+    {
+        const size_t paddedCount = (count + VectorBatchWidth - 1) / VectorBatchWidth * VectorBatchWidth;
+        if (paddedCount != GetPaddedCount())
+        {
+            std::vector<float> data(paddedCount * Components, 0.0f);
+            const size_t kept = std::min(count, m_count);
+            for (size_t c = 0; c < Components; c++)
+            {
+                std::copy(GetComponent(c), GetComponent(c) + kept, data.data() + c * paddedCount);
+            }
+            m_data.swap(data);
+        }
+        else if (count > m_count)
+        {
+            for (size_t c = 0; c < Components; c++)
+            {
+                std::fill(GetComponent(c) + m_count, GetComponent(c) + count, 0.0f);
+            }
+        }
+        m_count = count;
+    }
+
+    size_t GetCount() const { return m_count; }
+
+    /** Count rounded up to VectorBatchWidth */
+    size_t GetPaddedCount() const { return m_data.size() / Components; }
+
+    float* GetComponent(size_t index) { return m_data.data() + index * GetPaddedCount(); }
+    const float* GetComponent(size_t index) const { return m_data.data() + index * GetPaddedCount(); }
+
+protected:
+    size_t m_count = 0;
+    std::vector<float> m_data;
+};
+
+class Float3Batch : public VectorBatch<3>
+{
+public:
+    Float3Batch() = default;
+    explicit Float3Batch(size_t count) { Resize(count); }
+
+    float* GetX() { return GetComponent(0); }
+    float* GetY() { return GetComponent(1); }
+    float* GetZ() { return GetComponent(2); }
+    const float* GetX() const { return GetComponent(0); }
+    const float* GetY() const { return GetComponent(1); }
+    const float* GetZ() const { return GetComponent(2); }
+
+    XMFLOAT3 Get(size_t index) const { return XMFLOAT3(GetX()[index], GetY()[index], GetZ()[index]); }
+
+    void Set(size_t index, const XMFLOAT3& vector)
+    {
+        GetX()[index] = vector.x;
+        GetY()[index] = vector.y;
+        GetZ()[index] = vector.z;
+    }
+
+    /** Resizes to count and transposes the vectors in */
+    void Load(const XMFLOAT3* pVectors, size_t count);
+
+    /** Transposes GetCount() vectors out */
+    void Store(XMFLOAT3* pVectors) const;
+};
+
+class Float4Batch : public VectorBatch<4>
+{
+public:
+    Float4Batch() = default;
+    explicit Float4Batch(size_t count) { Resize(count); }
+
+    float* GetX() { return GetComponent(0); }
+    float* GetY() { return GetComponent(1); }
+    float* GetZ() { return GetComponent(2); }
+    float* GetW() { return GetComponent(3); }
+    const float* GetX() const { return GetComponent(0); }
+    const float* GetY() const { return GetComponent(1); }
+    const float* GetZ() const { return GetComponent(2); }
+    const float* GetW() const { return GetComponent(3); }
+
+    XMFLOAT4 Get(size_t index) const { return XMFLOAT4(GetX()[index], GetY()[index], GetZ()[index], GetW()[index]); }
+
+    void Set(size_t index, const XMFLOAT4& vector)
+    {
+        GetX()[index] = vector.x;
+        GetY()[index] = vector.y;
+        GetZ()[index] = vector.z;
+        GetW()[index] = vector.w;
+    }
+
+    void Load(const XMFLOAT4* pVectors, size_t count);
+    void Store(XMFLOAT4* pVectors) const;
+};
+
+// Kernels over whole batches. They take the AVX-512, AVX2 or SSE path the CPU supports
+// and compute in the same order on each, so the results do not depend on the path.
+// Batches given together must have the same count.
+
+/** Component-wise multiplication, ScaleBatch(batch, XMFLOAT3(s, s, s)) scales uniformly */
+void ScaleBatch(Float3Batch& batch, const XMFLOAT3& scale);
+void ScaleBatch(Float4Batch& batch, const XMFLOAT4& scale);
+
+void TranslateBatch(Float3Batch& batch, const XMFLOAT3& offset);
+void TranslateBatch(Float4Batch& batch, const XMFLOAT4& offset);
+
+/**
+ * Multiplies by the reciprocal of the length, within an ulp of XMFLOAT3::Normalized.
+ * Zero stays zero.
+ */
+void NormalizeBatch(Float3Batch& batch);
+void NormalizeBatch(Float4Batch& batch);
+
+/** pResults receives GetPaddedCount() values */
+void DotBatch(const Float3Batch& a, const Float3Batch& b, float* pResults);
+void DotBatch(const Float4Batch& a, const Float4Batch& b, float* pResults);
+
+/** result may be a or b */
+void CrossBatch(const Float3Batch& a, const Float3Batch& b, Float3Batch& result);
+
+/**
+ * Row vectors times the matrix as in DirectXMath. XMFLOAT3 are points (w = 1), the w of
+ * the result is dropped without dividing by it, as XMVector3Transform does.
+ */
+void TransformBatch(Float3Batch& batch, const DirectX::XMFLOAT4X4& matrix);
+void TransformBatch(Float4Batch& batch, const DirectX::XMFLOAT4X4& matrix);
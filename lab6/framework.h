@@ -4,24 +4,29 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
 // Windows Header Files
 #define NOMINMAX
 #include <windows.h>
+#include <tchar.h>
+
+#include <dxgiformat.h>
+#else
+// Types and CRT calls of the Windows SDK the CPU-side code uses
+#include "PortablePlatform.h"
+#endif
 // C RunTime Header Files
 #include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
-#include <tchar.h>
 #include <assert.h>
 #include <memory>
 #include <algorithm>
 
-#include <dxgiformat.h>
-
 
-#include <DirectXMath.h>
+#include "PortableMath.h"
 
 inline UINT32 GetBytesPerBlock(const DXGI_FORMAT& fmt)
 {
@@ -53,6 +58,9 @@ inline UINT32 GetBytesPerBlock(const DXGI_FORMAT& fmt)
     case DXGI_FORMAT_BC7_UNORM_SRGB:
         return 16;
         break;
+
+    default:
+        break;
     }
     assert(0);
     return 0;
@@ -2,6 +2,7 @@
 #include "framework.h"
 #include "lab6.h"
 #include "Renderer.h"
+#include "AssetPak.h"
 
 constexpr auto MAX_LOADSTRING = 100;
 
@@ -128,6 +129,9 @@ HRESULT InitWindow(HINSTANCE hInstance, int nCmdShow)
 
 HRESULT InitDevice(HWND hWnd)
 {
+    // A deployed archive replaces loose textures and shaders, without one files are read from disk
+    AssetPak::Mount(AssetPak::Open(L"../assets.pak"));
+
     pRenderer = new Renderer();
     if (!pRenderer->InitDevice(hWnd))
     {
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <math.h>
+#include <stdio.h>
+
+// Checks shared by the tests. A failed check prints its location and what it compared and
+// the test goes on, main returns Test::Finish() so the exit code tells whether all passed.
+
+namespace Test
+{
+
+    inline int& GetFailureCount()
+    {
+        static int failureCount = 0;
+        return failureCount;
+    }
+
+    inline void Check(bool condition, const char* file, int line, const char* expression)
+    {
+        if (!condition)
+        {
+            printf("%s(%d): check failed: %s\n", file, line, expression);
+            GetFailureCount()++;
+        }
+    }
+
+    /** NaN never matches */
+    inline void CheckNear(double actual, double expected, double tolerance, const char* file, int line, const char* expression)
+    {
+        if (!(fabs(actual - expected) <= tolerance))
+        {
+            printf("%s(%d): %s is %.9g, expected %.9g within %g\n", file, line, expression, actual, expected, tolerance);
+            GetFailureCount()++;
+        }
+    }
+
+    /** Prints the summary, returns the exit code of the test */
+    inline int Finish(const char* name)
+    {
+        if (GetFailureCount() != 0)
+        {
+            printf("%s: %d checks failed\n", name, GetFailureCount());
+            return 1;
+        }
+
+        printf("%s: all checks passed\n", name);
+        return 0;
+    }
+
+}
+
+#define CHECK(condition) Test::Check((condition), __FILE__, __LINE__, #condition)
+#define CHECK_NEAR(actual, expected, tolerance) Test::CheckNear((double)(actual), (double)(expected), (double)(tolerance), __FILE__, __LINE__, #actual)
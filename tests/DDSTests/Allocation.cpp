@@ -0,0 +1,56 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+// Allocations of at least g_failSize bytes fail while a test lowers it, so that loads fail
+// the way they do when memory runs out. Kept apart from the tests, so that the compiler
+// never pairs these with the standard operators. Every form is replaced, the sanitizers
+// check that memory goes back through the same family it came from.
+std::atomic<size_t> g_failSize(SIZE_MAX);
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return size < g_failSize.load(std::memory_order_relaxed) ? malloc(size != 0 ? size : 1) : nullptr;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void* operator new(size_t size)
+{
+    void* p = operator new(size, std::nothrow);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
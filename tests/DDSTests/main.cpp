@@ -0,0 +1,1154 @@
+#include "framework.h"
+
+#include "DDS.h"
+#include "BCDecoder.h"
+#include "BCEncoder.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+
+#include "../Check.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Allocations of at least this many bytes throw while a test lowers it, see Allocation.cpp
+extern std::atomic<size_t> g_failSize;
+
+namespace
+{
+
+    const UINT32 TestSizes[][2] =
+    {
+        { 1, 1 }, { 2, 3 }, { 4, 4 }, { 5, 3 }, { 7, 9 }, { 13, 17 }, { 64, 33 }
+    };
+
+    const BCQuality Qualities[] = { BCQuality::Fast, BCQuality::Normal, BCQuality::High };
+
+    /** Deterministic xorshift generator, the tests must not depend on rand() */
+    class Random
+    {
+    public:
+        explicit Random(UINT32 seed) : m_state(seed) {}
+
+        UINT32 Next()
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        void Fill(std::vector<UINT8>& data)
+        {
+            for (UINT8& value : data)
+            {
+                value = (UINT8)(Next() >> 24);
+            }
+        }
+
+    private:
+        UINT32 m_state;
+    };
+
+    /** Smooth gradients with some noise, what a texture looks like to the encoder */
+    std::vector<UINT8> MakeImage(UINT32 width, UINT32 height, UINT32 seed)
+    {
+        Random random(seed);
+        std::vector<UINT8> rgba((size_t)width * height * 4);
+
+        for (UINT32 y = 0; y < height; y++)
+        {
+            for (UINT32 x = 0; x < width; x++)
+            {
+                UINT8* pPixel = &rgba[((size_t)y * width + x) * 4];
+                int noise = (int)(random.Next() % 5) - 2;
+
+                pPixel[0] = (UINT8)std::min(255, std::max(0, (int)(40 + x * 5 + y * 2) + noise));
+                pPixel[1] = (UINT8)std::min(255, std::max(0, (int)(200 - y * 4 + x) - noise));
+                pPixel[2] = (UINT8)(128 + 60 * sinf(x * 0.1f + y * 0.15f));
+                pPixel[3] = (UINT8)(230 - (x + y) % 16 * 4);
+            }
+        }
+
+        return rgba;
+    }
+
+    /** Peak signal to noise ratio in dB over the first channelCount channels */
+    double ComputePSNR(const std::vector<UINT8>& a, const std::vector<UINT8>& b, UINT32 channelCount)
+    {
+        double sum = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < a.size(); i += 4)
+        {
+            for (UINT32 c = 0; c < channelCount; c++)
+            {
+                double delta = (double)a[i + c] - b[i + c];
+                sum += delta * delta;
+                count++;
+            }
+        }
+
+        if (sum == 0.0)
+        {
+            return 100.0;
+        }
+        return 10.0 * log10(255.0 * 255.0 * count / sum);
+    }
+
+    struct BCImage
+    {
+        std::vector<UINT8> blocks;
+        UINT32 rowPitch = 0;
+    };
+
+    BCImage Encode(DXGI_FORMAT fmt, const std::vector<UINT8>& rgba, UINT32 width, UINT32 height, BCQuality quality)
+    {
+        BCImage image;
+        image.rowPitch = DivUp(width, 4u) * GetBytesPerBlock(fmt);
+        image.blocks.resize((size_t)image.rowPitch * DivUp(height, 4u));
+
+        CHECK(EncodeBC(fmt, rgba.data(), width, height, width * 4, image.blocks.data(), image.rowPitch, quality));
+        return image;
+    }
+
+    /** Decodes into rows 3 pixels wider than the image, the extra bytes must stay untouched */
+    std::vector<UINT8> Decode(DXGI_FORMAT fmt, const BCImage& image, UINT32 width, UINT32 height)
+    {
+        const UINT32 dstRowPitch = (width + 3) * 4;
+        const UINT8 guard = 0xCD;
+
+        std::vector<UINT8> padded((size_t)dstRowPitch * height, guard);
+        CHECK(DecodeBC(fmt, image.blocks.data(), image.rowPitch, width, height, padded.data(), dstRowPitch));
+
+        std::vector<UINT8> rgba((size_t)width * height * 4);
+        bool guardIntact = true;
+        for (UINT32 y = 0; y < height; y++)
+        {
+            const UINT8* pRow = &padded[(size_t)y * dstRowPitch];
+            memcpy(&rgba[(size_t)y * width * 4], pRow, (size_t)width * 4);
+            for (UINT32 i = width * 4; i < dstRowPitch; i++)
+            {
+                guardIntact = guardIntact && pRow[i] == guard;
+            }
+        }
+        CHECK(guardIntact);
+
+        return rgba;
+    }
+
+    /** The image grown to whole blocks by repeating the last column and row */
+    std::vector<UINT8> PadToBlocks(const std::vector<UINT8>& rgba, UINT32 width, UINT32 height)
+    {
+        const UINT32 paddedWidth = DivUp(width, 4u) * 4;
+        const UINT32 paddedHeight = DivUp(height, 4u) * 4;
+
+        std::vector<UINT8> padded((size_t)paddedWidth * paddedHeight * 4);
+        for (UINT32 y = 0; y < paddedHeight; y++)
+        {
+            for (UINT32 x = 0; x < paddedWidth; x++)
+            {
+                memcpy(&padded[((size_t)y * paddedWidth + x) * 4],
+                    &rgba[((size_t)std::min(y, height - 1) * width + std::min(x, width - 1)) * 4], 4);
+            }
+        }
+        return padded;
+    }
+
+    // Reference decoders written from the format description, one block at a time
+
+    void ReferenceDecodeBC1Color(const UINT8* pBlock, bool allowPunchThrough, UINT8 pixels[16][4])
+    {
+        UINT32 c[2] = { (UINT32)(pBlock[0] | pBlock[1] << 8), (UINT32)(pBlock[2] | pBlock[3] << 8) };
+
+        UINT8 palette[4][4];
+        for (UINT32 e = 0; e < 2; e++)
+        {
+            UINT32 r = (c[e] >> 11) & 31, g = (c[e] >> 5) & 63, b = c[e] & 31;
+            palette[e][0] = (UINT8)(r << 3 | r >> 2);
+            palette[e][1] = (UINT8)(g << 2 | g >> 4);
+            palette[e][2] = (UINT8)(b << 3 | b >> 2);
+            palette[e][3] = 255;
+        }
+
+        const bool fourColors = !allowPunchThrough || c[0] > c[1];
+        for (UINT32 ch = 0; ch < 4; ch++)
+        {
+            if (fourColors)
+            {
+                palette[2][ch] = (UINT8)((2 * palette[0][ch] + palette[1][ch]) / 3);
+                palette[3][ch] = (UINT8)((palette[0][ch] + 2 * palette[1][ch]) / 3);
+            }
+            else
+            {
+                palette[2][ch] = (UINT8)((palette[0][ch] + palette[1][ch]) / 2);
+                palette[3][ch] = 0;
+            }
+        }
+
+        UINT32 indices = pBlock[4] | pBlock[5] << 8 | pBlock[6] << 16 | (UINT32)pBlock[7] << 24;
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            memcpy(pixels[i], palette[(indices >> (2 * i)) & 3], 4);
+        }
+    }
+
+    void ReferenceDecodeChannel(const UINT8* pBlock, UINT8 values[16])
+    {
+        UINT32 a0 = pBlock[0], a1 = pBlock[1];
+
+        UINT8 palette[8] = { (UINT8)a0, (UINT8)a1 };
+        for (UINT32 i = 2; i < 8; i++)
+        {
+            if (a0 > a1)
+            {
+                palette[i] = (UINT8)(((8 - i) * a0 + (i - 1) * a1) / 7);
+            }
+            else
+            {
+                palette[i] = i < 6 ? (UINT8)(((6 - i) * a0 + (i - 1) * a1) / 5) : (i == 6 ? 0 : 255);
+            }
+        }
+
+        UINT64 indices = 0;
+        for (UINT32 i = 0; i < 6; i++)
+        {
+            indices |= (UINT64)pBlock[2 + i] << (8 * i);
+        }
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            values[i] = palette[(indices >> (3 * i)) & 7];
+        }
+    }
+
+    void ReferenceDecodeBlock(DXGI_FORMAT fmt, const UINT8* pBlock, UINT8 pixels[16][4])
+    {
+        UINT8 values[16];
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+            ReferenceDecodeBC1Color(pBlock, true, pixels);
+            break;
+
+        case DXGI_FORMAT_BC3_UNORM:
+            ReferenceDecodeBC1Color(pBlock + 8, false, pixels);
+            ReferenceDecodeChannel(pBlock, values);
+            for (UINT32 i = 0; i < 16; i++)
+            {
+                pixels[i][3] = values[i];
+            }
+            break;
+
+        case DXGI_FORMAT_BC5_UNORM:
+            for (UINT32 ch = 0; ch < 2; ch++)
+            {
+                ReferenceDecodeChannel(pBlock + 8 * ch, values);
+                for (UINT32 i = 0; i < 16; i++)
+                {
+                    pixels[i][ch] = values[i];
+                    pixels[i][2] = 0;
+                    pixels[i][3] = 255;
+                }
+            }
+            break;
+
+        default:
+            assert(0);
+            break;
+        }
+    }
+
+    /** Writes little-endian bit fields into a 128-bit block */
+    class BlockBitWriter
+    {
+    public:
+        explicit BlockBitWriter(UINT8* pBlock) : m_pBlock(pBlock)
+        {
+            memset(m_pBlock, 0, 16);
+        }
+
+        void Write(UINT32 value, UINT32 bits)
+        {
+            for (UINT32 i = 0; i < bits; i++, m_position++)
+            {
+                m_pBlock[m_position / 8] |= (UINT8)(((value >> i) & 1) << (m_position % 8));
+            }
+        }
+
+    private:
+        UINT8* m_pBlock;
+        UINT32 m_position = 0;
+    };
+
+    /**
+     * Builds a random BC7 mode 6 block (one subset, 7-bit RGBA endpoints with a p-bit each,
+     * 4-bit indices) and the pixels it stands for
+     */
+    void MakeBC7Mode6Block(Random& random, UINT8* pBlock, UINT8 pixels[16][4])
+    {
+        static const UINT32 weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        UINT32 endpoints[2][4];
+        for (UINT32 ch = 0; ch < 4; ch++)
+        {
+            endpoints[0][ch] = random.Next() & 127;
+            endpoints[1][ch] = random.Next() & 127;
+        }
+        UINT32 pBits[2] = { random.Next() & 1, random.Next() & 1 };
+
+        BlockBitWriter writer(pBlock);
+        writer.Write(1 << 6, 7);
+        for (UINT32 ch = 0; ch < 4; ch++)
+        {
+            writer.Write(endpoints[0][ch], 7);
+            writer.Write(endpoints[1][ch], 7);
+        }
+        writer.Write(pBits[0], 1);
+        writer.Write(pBits[1], 1);
+
+        for (UINT32 i = 0; i < 16; i++)
+        {
+            // The anchor index drops its top bit, which is always 0
+            UINT32 index = random.Next() & (i == 0 ? 7 : 15);
+            writer.Write(index, i == 0 ? 3 : 4);
+
+            for (UINT32 ch = 0; ch < 4; ch++)
+            {
+                UINT32 e0 = endpoints[0][ch] << 1 | pBits[0];
+                UINT32 e1 = endpoints[1][ch] << 1 | pBits[1];
+                pixels[i][ch] = (UINT8)(((64 - weights[index]) * e0 + weights[index] * e1 + 32) >> 6);
+            }
+        }
+    }
+
+    /** Compares a decoded image with per-block reference pixels */
+    template <typename ReferenceBlock>
+    bool MatchesReference(const std::vector<UINT8>& rgba, UINT32 width, UINT32 height, ReferenceBlock reference)
+    {
+        for (UINT32 by = 0; by < DivUp(height, 4u); by++)
+        {
+            for (UINT32 bx = 0; bx < DivUp(width, 4u); bx++)
+            {
+                UINT8 pixels[16][4];
+                reference(bx, by, pixels);
+
+                for (UINT32 i = 0; i < 16; i++)
+                {
+                    UINT32 x = bx * 4 + i % 4;
+                    UINT32 y = by * 4 + i / 4;
+                    if (x < width && y < height && memcmp(&rgba[((size_t)y * width + x) * 4], pixels[i], 4) != 0)
+                    {
+                        printf("  pixel (%u, %u) differs from the reference\n", x, y);
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    void TestDecodeRandomBlocks()
+    {
+        const DXGI_FORMAT formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC5_UNORM };
+
+        Random random(17);
+        for (DXGI_FORMAT fmt : formats)
+        {
+            for (const UINT32* pSize : TestSizes)
+            {
+                BCImage image;
+                image.rowPitch = DivUp(pSize[0], 4u) * GetBytesPerBlock(fmt);
+                image.blocks.resize((size_t)image.rowPitch * DivUp(pSize[1], 4u));
+                random.Fill(image.blocks);
+
+                std::vector<UINT8> rgba = Decode(fmt, image, pSize[0], pSize[1]);
+                CHECK(MatchesReference(rgba, pSize[0], pSize[1], [&](UINT32 bx, UINT32 by, UINT8 pixels[16][4])
+                {
+                    ReferenceDecodeBlock(fmt, &image.blocks[(size_t)by * image.rowPitch + bx * GetBytesPerBlock(fmt)], pixels);
+                }));
+            }
+        }
+    }
+
+    void TestDecodeBC7()
+    {
+        Random random(29);
+        for (const UINT32* pSize : TestSizes)
+        {
+            const UINT32 blocksWide = DivUp(pSize[0], 4u);
+            const UINT32 blocksHigh = DivUp(pSize[1], 4u);
+
+            BCImage image;
+            image.rowPitch = blocksWide * 16;
+            image.blocks.resize((size_t)image.rowPitch * blocksHigh);
+
+            std::vector<UINT8> expected((size_t)blocksWide * blocksHigh * 64);
+            for (UINT32 block = 0; block < blocksWide * blocksHigh; block++)
+            {
+                MakeBC7Mode6Block(random, &image.blocks[block * 16], reinterpret_cast<UINT8(*)[4]>(&expected[block * 64]));
+            }
+
+            std::vector<UINT8> rgba = Decode(DXGI_FORMAT_BC7_UNORM, image, pSize[0], pSize[1]);
+            CHECK(MatchesReference(rgba, pSize[0], pSize[1], [&](UINT32 bx, UINT32 by, UINT8 pixels[16][4])
+            {
+                memcpy(pixels, &expected[(by * blocksWide + bx) * 64], 64);
+            }));
+        }
+
+        // Mode bits all zero are reserved and decode to transparent black
+        BCImage reserved;
+        reserved.rowPitch = 16;
+        reserved.blocks.assign(16, 0);
+        reserved.blocks[15] = 0xFF;
+        std::vector<UINT8> rgba = Decode(DXGI_FORMAT_BC7_UNORM, reserved, 3, 2);
+        CHECK(std::all_of(rgba.begin(), rgba.end(), [](UINT8 value) { return value == 0; }));
+    }
+
+    /** Encoded images decode to the reference of their own blocks and stay close to the source */
+    void TestEncodeQuality()
+    {
+        struct FormatLimits
+        {
+            DXGI_FORMAT fmt;
+            UINT32 channelCount;    ///< Channels the format keeps
+            double minPSNR[3];      ///< Per quality, in dB
+        };
+        const FormatLimits formats[] =
+        {
+            { DXGI_FORMAT_BC1_UNORM, 3, { 31.0, 35.5, 35.5 } },
+            { DXGI_FORMAT_BC3_UNORM, 4, { 32.5, 36.5, 36.5 } },
+            { DXGI_FORMAT_BC5_UNORM, 2, { 48.5, 49.5, 49.5 } },
+        };
+
+        for (const FormatLimits& limits : formats)
+        {
+            for (UINT32 q = 0; q < 3; q++)
+            {
+                for (const UINT32* pSize : TestSizes)
+                {
+                    const UINT32 width = pSize[0];
+                    const UINT32 height = pSize[1];
+
+                    std::vector<UINT8> source = MakeImage(width, height, width * 31 + height);
+                    if (limits.fmt == DXGI_FORMAT_BC1_UNORM)
+                    {
+                        // Alpha below 128 would switch BC1 blocks to punch-through
+                        for (size_t i = 3; i < source.size(); i += 4)
+                        {
+                            source[i] = 255;
+                        }
+                    }
+
+                    BCImage image = Encode(limits.fmt, source, width, height, Qualities[q]);
+                    std::vector<UINT8> rgba = Decode(limits.fmt, image, width, height);
+
+                    CHECK(MatchesReference(rgba, width, height, [&](UINT32 bx, UINT32 by, UINT8 pixels[16][4])
+                    {
+                        ReferenceDecodeBlock(limits.fmt, &image.blocks[(size_t)by * image.rowPitch + bx * GetBytesPerBlock(limits.fmt)], pixels);
+                    }));
+                    CHECK(ComputePSNR(source, rgba, limits.channelCount) >= limits.minPSNR[q]);
+
+                    // Partial blocks are encoded as if the edge pixels were repeated
+                    if (width % 4 != 0 || height % 4 != 0)
+                    {
+                        BCImage padded = Encode(limits.fmt, PadToBlocks(source, width, height),
+                            DivUp(width, 4u) * 4, DivUp(height, 4u) * 4, Qualities[q]);
+                        CHECK(padded.blocks == image.blocks);
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Colors the formats store exactly come back bit exact. Fast quality insets the color
+     * endpoints of opaque blocks, so there only the BC3 alpha is exact; BC1 blocks with
+     * transparent pixels fit their endpoints to the opaque ones at every quality.
+     */
+    void TestEncodeExact()
+    {
+        // 565 colors expanded to 8 bits, two per block so that they are the endpoints
+        const UINT8 colors[2][4] = { { 255, 0, 66, 255 }, { 16, 178, 255, 255 } };
+
+        for (BCQuality quality : Qualities)
+        {
+            for (const UINT32* pSize : TestSizes)
+            {
+                const UINT32 width = pSize[0];
+                const UINT32 height = pSize[1];
+
+                std::vector<UINT8> source((size_t)width * height * 4);
+                for (UINT32 y = 0; y < height; y++)
+                {
+                    for (UINT32 x = 0; x < width; x++)
+                    {
+                        UINT8* pPixel = &source[((size_t)y * width + x) * 4];
+                        memcpy(pPixel, colors[(x + y) & 1], 4);
+
+                        // Channel formats keep 8-bit endpoints, any two values per block are exact
+                        pPixel[3] = (x + 2 * y) % 3 == 0 ? 7 : 250;
+                    }
+                }
+
+                std::vector<UINT8> bc1 = Decode(DXGI_FORMAT_BC1_UNORM, Encode(DXGI_FORMAT_BC1_UNORM, source, width, height, quality), width, height);
+                std::vector<UINT8> bc3 = Decode(DXGI_FORMAT_BC3_UNORM, Encode(DXGI_FORMAT_BC3_UNORM, source, width, height, quality), width, height);
+                std::vector<UINT8> bc5 = Decode(DXGI_FORMAT_BC5_UNORM, Encode(DXGI_FORMAT_BC5_UNORM, source, width, height, quality), width, height);
+
+                bool bc1Exact = true, bc3Exact = true, bc5Exact = true;
+                for (size_t i = 0; i < source.size(); i += 4)
+                {
+                    // BC1 turns alpha below 128 into transparent black
+                    const bool opaque = source[i + 3] >= 128;
+                    bc1Exact = bc1Exact && (opaque ? memcmp(&bc1[i], &source[i], 3) == 0 && bc1[i + 3] == 255
+                        : bc1[i] == 0 && bc1[i + 1] == 0 && bc1[i + 2] == 0 && bc1[i + 3] == 0);
+                    bc3Exact = bc3Exact && (quality == BCQuality::Fast || memcmp(&bc3[i], &source[i], 3) == 0)
+                        && bc3[i + 3] == source[i + 3];
+                    bc5Exact = bc5Exact && bc5[i] == source[i] && bc5[i + 1] == source[i + 1];
+                }
+                CHECK(bc1Exact);
+                CHECK(bc3Exact);
+                CHECK(bc5Exact);
+            }
+        }
+    }
+
+    std::vector<UINT8> ReadFile(const std::wstring& path)
+    {
+        std::vector<UINT8> contents;
+        FILE* pFile = nullptr;
+        if (_wfopen_s(&pFile, path.c_str(), L"rb") == 0)
+        {
+            _fseeki64(pFile, 0, SEEK_END);
+            contents.resize((size_t)_ftelli64(pFile));
+            _fseeki64(pFile, 0, SEEK_SET);
+            contents.resize(fread(contents.data(), 1, contents.size(), pFile));
+            fclose(pFile);
+        }
+        return contents;
+    }
+
+    void WriteFile(const std::wstring& path, const std::vector<UINT8>& contents)
+    {
+        FILE* pFile = nullptr;
+        if (_wfopen_s(&pFile, path.c_str(), L"wb") == 0)
+        {
+            if (!contents.empty())
+            {
+                fwrite(contents.data(), 1, contents.size(), pFile);
+            }
+            fclose(pFile);
+        }
+    }
+
+    /** A texture with random texels in every subresource, laid out the way LoadDDS lays them out */
+    struct TestTexture
+    {
+        TextureDesc desc;
+        std::vector<UINT8> data;
+    };
+
+    TestTexture MakeTexture(DXGI_FORMAT fmt, TextureDimension dimension, UINT32 width, UINT32 height, UINT32 depth,
+        UINT32 arraySize, UINT32 mipCount, bool isCubemap, UINT32 seed)
+    {
+        TestTexture texture;
+        TextureDesc& desc = texture.desc;
+        desc.fmt = fmt;
+        desc.dimension = dimension;
+        desc.width = width;
+        desc.height = height;
+        desc.depth = depth;
+        desc.arraySize = arraySize;
+        desc.mipmapsCount = mipCount;
+        desc.isCubemap = isCubemap;
+        desc.dataSize = ComputeSubresourceLayout(fmt, width, height, depth, arraySize, mipCount, mipCount, desc.subresources);
+        desc.pitch = desc.subresources[0].rowPitch;
+
+        texture.data.resize((size_t)desc.dataSize);
+        Random(seed).Fill(texture.data);
+        desc.pData = texture.data.data();
+
+        return texture;
+    }
+
+    /** The loaded desc matches what was saved, texel for texel */
+    bool SameTexture(const TextureDesc& saved, const TextureDesc& loaded)
+    {
+        if (loaded.fmt != saved.fmt || loaded.dimension != saved.dimension || loaded.width != saved.width
+            || loaded.height != saved.height || loaded.depth != saved.depth || loaded.arraySize != saved.arraySize
+            || loaded.mipmapsCount != saved.mipmapsCount || loaded.isCubemap != saved.isCubemap
+            || loaded.sourceKey != saved.sourceKey || loaded.dataSize != saved.dataSize
+            || loaded.subresources.size() != saved.subresources.size())
+        {
+            printf("  loaded desc differs from the saved one\n");
+            return false;
+        }
+
+        for (size_t i = 0; i < saved.subresources.size(); i++)
+        {
+            const SubresourceLayout& a = saved.subresources[i];
+            const SubresourceLayout& b = loaded.subresources[i];
+            if (a.offset != b.offset || a.rowPitch != b.rowPitch || a.slicePitch != b.slicePitch
+                || a.blockRows != b.blockRows || a.width != b.width || a.height != b.height || a.depth != b.depth)
+            {
+                printf("  layout of subresource %zu differs\n", i);
+                return false;
+            }
+        }
+
+        return memcmp(loaded.pData, saved.pData, (size_t)saved.dataSize) == 0;
+    }
+
+    void TestSaveLoadRoundTrip()
+    {
+        std::vector<TestTexture> textures;
+        // Legacy header: BC1 and RGBA8 with partial blocks and full chains, a BC3 cube
+        textures.push_back(MakeTexture(DXGI_FORMAT_BC1_UNORM, TextureDimension::Texture2D, 13, 7, 1, 1, 4, false, 1));
+        textures.push_back(MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 5, 3, 1, 1, 3, false, 2));
+        textures.push_back(MakeTexture(DXGI_FORMAT_BC3_UNORM, TextureDimension::Texture2D, 8, 8, 1, 6, 4, true, 3));
+        textures.push_back(MakeTexture(DXGI_FORMAT_B8G8R8A8_UNORM, TextureDimension::Texture3D, 6, 5, 3, 1, 2, false, 4));
+        // DX10 header: formats without a legacy description, arrays and 1D textures
+        textures.push_back(MakeTexture(DXGI_FORMAT_BC7_UNORM_SRGB, TextureDimension::Texture2D, 9, 6, 1, 3, 2, false, 5));
+        textures.push_back(MakeTexture(DXGI_FORMAT_BC5_UNORM, TextureDimension::Texture2D, 4, 4, 1, 12, 3, true, 6));
+        textures.push_back(MakeTexture(DXGI_FORMAT_R16G16B16A16_FLOAT, TextureDimension::Texture1D, 17, 1, 1, 2, 5, false, 7));
+        textures[0].desc.sourceKey = 0x0123456789ABCDEFull;
+
+        const std::wstring path = L"DDSTests.tmp.dds";
+        for (const TestTexture& texture : textures)
+        {
+            for (bool supercompress : { false, true })
+            {
+                CHECK(SaveDDS(texture.desc, path, supercompress));
+
+                TextureDesc copied;
+                CHECK(LoadDDS(path, copied, false, DDSLoadMode::Copy) && SameTexture(texture.desc, copied));
+
+                // Supercompressed payloads are always decoded into a heap buffer
+                TextureDesc mapped;
+                CHECK(LoadDDS(path, mapped, false, DDSLoadMode::Mapped) && SameTexture(texture.desc, mapped));
+
+                // Saving what was loaded gives the same file again
+                std::vector<UINT8> firstFile = ReadFile(path);
+                CHECK(SaveDDS(copied, path, supercompress));
+                std::vector<UINT8> secondFile = ReadFile(path);
+                CHECK(!firstFile.empty() && firstFile == secondFile);
+            }
+        }
+
+        // A single mip load keeps the top level of every slice
+        const TextureDesc& cube = textures[2].desc;
+        CHECK(SaveDDS(cube, path));
+
+        TextureDesc top;
+        CHECK(LoadDDS(path, top, true));
+        CHECK(top.mipmapsCount == 1 && top.arraySize == 6 && top.subresources.size() == 6);
+        bool topMatches = top.subresources.size() == 6;
+        for (UINT32 face = 0; face < 6 && topMatches; face++)
+        {
+            topMatches = memcmp(top.GetSubresourceData(face), cube.GetSubresourceData(face * cube.mipmapsCount),
+                cube.subresources[0].slicePitch) == 0;
+        }
+        CHECK(topMatches);
+
+        _wremove(path.c_str());
+    }
+
+    /** Field offsets in a file image, after the signature */
+    const size_t HeaderHeightOffset = 12;
+    const size_t HeaderWidthOffset = 16;
+    const size_t HeaderMipCountOffset = 28;
+    const size_t Header10ArraySizeOffset = 140;
+    const size_t ChunkTableOffset = 164;      ///< After the DX10 header and the chunk header of a DDSZ file
+
+    void PatchUInt32(std::vector<UINT8>& file, size_t offset, UINT32 value)
+    {
+        memcpy(&file[offset], &value, sizeof(UINT32));
+    }
+
+    /** Both load modes reject the file image */
+    bool IsRejected(const std::vector<UINT8>& file)
+    {
+        const std::wstring path = L"DDSTests.malformed.dds";
+        WriteFile(path, file);
+
+        TextureDesc copied;
+        TextureDesc mapped;
+        bool isRejected = !LoadDDS(path, copied, false, DDSLoadMode::Copy)
+            && !LoadDDS(path, mapped, false, DDSLoadMode::Mapped);
+
+        _wremove(path.c_str());
+        return isRejected;
+    }
+
+    void TestRejectMalformed()
+    {
+        std::vector<SubresourceLayout> layout;
+
+        // Pitches are computed in 64 bits, 32K x 32K RGBA8 is one byte too large for a slice pitch
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 32768, 32768, 1, 1, 1, 1, layout) == 0 && layout.empty());
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 65536, 65536, 1, 1, 1, 1, layout) == 0);
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_BC1_UNORM, 0xFFFFFFFF, 4, 1, 1, 1, 1, layout) == 0);
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_R8G8B8A8_UNORM, 32768, 32767, 1, 1, 1, 1, layout) == 32768ull * 4 * 32767
+            && layout.size() == 1 && layout[0].slicePitch == 32768u * 4 * 32767);
+
+        // The payload has to fit in maxSize, 8x8 BC1 with 4 mips takes 32 + 3 * 8 bytes
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_BC1_UNORM, 8, 8, 1, 1, 4, 4, layout, 0, 55) == 0 && layout.empty());
+        CHECK(ComputeSubresourceLayout(DXGI_FORMAT_BC1_UNORM, 8, 8, 1, 1, 4, 4, layout, 0, 56) == 56 && layout.size() == 4);
+
+        const std::wstring path = L"DDSTests.tmp.dds";
+        TestTexture rgba = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 4, 4, 1, 1, 1, false, 8);
+        CHECK(SaveDDS(rgba.desc, path));
+        const std::vector<UINT8> file = ReadFile(path);
+        _wremove(path.c_str());
+        CHECK(!file.empty() && !IsRejected(file));
+
+        // 64K x 64K RGBA8 used to wrap its slice pitch to 0 and pass the size check
+        std::vector<UINT8> huge = file;
+        PatchUInt32(huge, HeaderWidthOffset, 65536);
+        PatchUInt32(huge, HeaderHeightOffset, 65536);
+        CHECK(IsRejected(huge));
+
+        // Every subresource has to be in the file
+        std::vector<UINT8> truncated(file.begin(), file.end() - 1);
+        CHECK(IsRejected(truncated));
+
+        // A mip count past the full chain is clamped to it
+        TestTexture chain = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 4, 4, 1, 1, 3, false, 9);
+        CHECK(SaveDDS(chain.desc, path));
+        std::vector<UINT8> longChain = ReadFile(path);
+        PatchUInt32(longChain, HeaderMipCountOffset, 0xFFFFFFFF);
+        WriteFile(path, longChain);
+        TextureDesc clamped;
+        CHECK(LoadDDS(path, clamped) && SameTexture(chain.desc, clamped));
+        _wremove(path.c_str());
+
+        // Array sizes are checked before anything is allocated for them
+        TestTexture array = MakeTexture(DXGI_FORMAT_BC7_UNORM, TextureDimension::Texture2D, 4, 4, 1, 2, 1, false, 10);
+        CHECK(SaveDDS(array.desc, path));
+        const std::vector<UINT8> arrayFile = ReadFile(path);
+        _wremove(path.c_str());
+        CHECK(!arrayFile.empty() && !IsRejected(arrayFile));
+
+        for (UINT32 arraySize : { 0u, 3u, 2049u, 0xFFFFFFFFu })
+        {
+            std::vector<UINT8> patched = arrayFile;
+            PatchUInt32(patched, Header10ArraySizeOffset, arraySize);
+            CHECK(IsRejected(patched));
+        }
+
+        // 0x2AAAAAAB cubes wrapped to 2 faces when multiplied by 6 in 32 bits
+        TestTexture cube = MakeTexture(DXGI_FORMAT_BC7_UNORM, TextureDimension::Texture2D, 4, 4, 1, 6, 1, true, 11);
+        CHECK(SaveDDS(cube.desc, path));
+        const std::vector<UINT8> cubeFile = ReadFile(path);
+        _wremove(path.c_str());
+        CHECK(!cubeFile.empty() && !IsRejected(cubeFile));
+
+        for (UINT32 cubeCount : { 0u, 342u, 0x2AAAAAABu })
+        {
+            std::vector<UINT8> patched = cubeFile;
+            PatchUInt32(patched, Header10ArraySizeOffset, cubeCount);
+            CHECK(IsRejected(patched));
+        }
+
+        // Supercompressed files are checked before their chunks are decoded. Cut anywhere, a
+        // DX10 one used to underflow the size left after its headers and read past the end.
+        TestTexture chunked = MakeTexture(DXGI_FORMAT_BC7_UNORM, TextureDimension::Texture2D, 256, 160, 1, 2, 1, false, 12);
+        memset(chunked.data.data(), 0x5A, chunked.data.size() / 2);
+        CHECK(SaveDDS(chunked.desc, path, true));
+        const std::vector<UINT8> chunkedFile = ReadFile(path);
+        _wremove(path.c_str());
+        CHECK(!chunkedFile.empty() && !IsRejected(chunkedFile));
+
+        bool isTruncationRejected = true;
+        for (size_t size = 0; size < chunkedFile.size(); size += size < 256 ? 1 : 97)
+        {
+            isTruncationRejected = isTruncationRejected
+                && IsRejected(std::vector<UINT8>(chunkedFile.begin(), chunkedFile.begin() + size));
+        }
+        CHECK(isTruncationRejected);
+
+        // Stored chunk sizes have to be in (0, raw size] and in the file
+        for (UINT32 storedSize : { 0u, 64u * 1024 + 1, 0xFFFFFFFFu })
+        {
+            std::vector<UINT8> patched = chunkedFile;
+            PatchUInt32(patched, ChunkTableOffset, storedSize);
+            CHECK(IsRejected(patched));
+        }
+    }
+
+    void TestTextureKey()
+    {
+        TestTexture chain = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 256, 128, 1, 2, 9, false, 13);
+        const TextureDesc& desc = chain.desc;
+        const UINT64 key = ComputeTextureKey(desc);
+        CHECK(key != 0 && ComputeTextureKey(desc) == key);
+
+        // Rows handed over with padding, as D3D11_SUBRESOURCE_DATA may have them, give the same key
+        const UINT32 Padding = 12;
+        std::vector<std::vector<UINT8>> padded(desc.subresources.size());
+        for (size_t i = 0; i < padded.size(); i++)
+        {
+            const SubresourceLayout& subresource = desc.subresources[i];
+            const UINT32 pitch = subresource.rowPitch + Padding;
+            padded[i].assign((size_t)pitch * subresource.blockRows, 0xCD);
+            for (UINT32 row = 0; row < subresource.blockRows; row++)
+            {
+                memcpy(padded[i].data() + (size_t)row * pitch,
+                    static_cast<const UINT8*>(desc.GetSubresourceData((UINT32)i)) + (size_t)row * subresource.rowPitch,
+                    subresource.rowPitch);
+            }
+        }
+        CHECK(ComputeTextureKey(desc, [&](UINT32 index, UINT32& pitch, UINT32&)
+        {
+            pitch = desc.subresources[index].rowPitch + Padding;
+            return static_cast<const void*>(padded[index].data());
+        }) == key);
+
+        // Any texel of any subresource and any part of the description changes it
+        chain.data[chain.data.size() - 1] ^= 1;
+        CHECK(ComputeTextureKey(desc) != key);
+        chain.data[chain.data.size() - 1] ^= 1;
+
+        TextureDesc other = desc;
+        other.fmt = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        CHECK(ComputeTextureKey(other) != key);
+
+        // Every depth slice of a 3D texture counts, padded slices give the same key
+        TestTexture volume = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture3D, 8, 4, 5, 1, 3, false, 16);
+        const TextureDesc& volumeDesc = volume.desc;
+        const UINT64 volumeKey = ComputeTextureKey(volumeDesc);
+
+        const UINT32 SlicePadding = 20;
+        std::vector<std::vector<UINT8>> paddedSlices(volumeDesc.subresources.size());
+        for (size_t i = 0; i < paddedSlices.size(); i++)
+        {
+            const SubresourceLayout& subresource = volumeDesc.subresources[i];
+            const UINT32 slicePitch = subresource.slicePitch + SlicePadding;
+            paddedSlices[i].assign((size_t)slicePitch * subresource.depth, 0xCD);
+            for (UINT32 slice = 0; slice < subresource.depth; slice++)
+            {
+                memcpy(paddedSlices[i].data() + (size_t)slice * slicePitch,
+                    static_cast<const UINT8*>(volumeDesc.GetSubresourceData((UINT32)i)) + (size_t)slice * subresource.slicePitch,
+                    subresource.slicePitch);
+            }
+        }
+        CHECK(ComputeTextureKey(volumeDesc, [&](UINT32 index, UINT32& pitch, UINT32& slicePitch)
+        {
+            pitch = volumeDesc.subresources[index].rowPitch;
+            slicePitch = volumeDesc.subresources[index].slicePitch + SlicePadding;
+            return static_cast<const void*>(paddedSlices[index].data());
+        }) == volumeKey);
+
+        const SubresourceLayout& top = volumeDesc.subresources[0];
+        volume.data[(size_t)top.slicePitch * (top.depth - 1)] ^= 1;
+        CHECK(ComputeTextureKey(volumeDesc) != volumeKey);
+        volume.data[(size_t)top.slicePitch * (top.depth - 1)] ^= 1;
+
+        // As do the depth and the dimension
+        TextureDesc shallower = volumeDesc;
+        shallower.depth = 4;
+        CHECK(ComputeTextureKey(shallower) != volumeKey);
+
+        TestTexture flat = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 8, 4, 1, 1, 3, false, 17);
+        TestTexture thin = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture3D, 8, 4, 1, 1, 3, false, 17);
+        CHECK(ComputeTextureKey(flat.desc) != ComputeTextureKey(thin.desc));
+
+        // Streamed mips arrive keyed the same way
+        const std::wstring path = L"DDSTests.Streamed.dds";
+        CHECK(SaveDDS(desc, path));
+
+        TextureStreamerSettings settings;
+        settings.tailSize = 32;
+        TextureStreamer streamer(settings);
+
+        UINT32 id = 0;
+        TextureDesc tailDesc;
+        CHECK(streamer.Register(path, id, tailDesc));
+        CHECK(tailDesc.width == 32 && tailDesc.arraySize == 2);
+
+        std::vector<TextureStreamerUpdate> updates;
+        for (UINT32 frame = 0; frame < 16 && streamer.GetResidentMip(id) != 0; frame++)
+        {
+            streamer.RequestScreenSize(id, 256.0f);
+            streamer.Update(updates);
+            streamer.WaitIdle();
+        }
+        CHECK(streamer.GetResidentMip(id) == 0 && !updates.empty());
+
+        bool isEachKeyed = true;
+        for (const TextureStreamerUpdate& update : updates)
+        {
+            isEachKeyed = isEachKeyed && update.contentKey != 0 && update.contentKey == ComputeTextureKey(update.desc);
+        }
+        CHECK(isEachKeyed);
+        CHECK(updates.back().residentMip == 0 && updates.back().contentKey == key);
+
+        _wremove(path.c_str());
+    }
+
+    void TestBatchThrowingItem()
+    {
+        // The layout of this one takes far more memory than the others
+        TestTexture small = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 4, 4, 1, 1, 3, false, 14);
+        TestTexture large = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 1, 1, 1, 2048, 1, false, 15);
+
+        const std::wstring smallPath = L"DDSTests.Small.dds";
+        const std::wstring largePath = L"DDSTests.Large.dds";
+        CHECK(SaveDDS(small.desc, smallPath));
+        CHECK(SaveDDS(large.desc, largePath));
+
+        const std::vector<DDSBatchItem> items =
+        {
+            { smallPath, false, false }, { largePath, false, false }, { L"DDSTests.Missing.dds", false, false },
+            { smallPath, true, false }
+        };
+
+        ThreadPool pool(2);
+        for (DDSLoadMode mode : { DDSLoadMode::Copy, DDSLoadMode::Mapped })
+        {
+            std::vector<int> reported(items.size(), -1);
+
+            g_failSize = 64 * 1024;
+            size_t loadedCount = LoadDDSBatch(items, [&](size_t index, bool success, TextureDesc&)
+            {
+                reported[index] = success ? 1 : 0;
+            }, mode, &pool);
+            g_failSize = SIZE_MAX;
+
+            // The batch returns with every item reported, the one that threw as failed
+            std::vector<int> expected = { 1, 0, 0, 1 };
+            CHECK(loadedCount == 2);
+            CHECK(reported == expected);
+        }
+
+        // Loaded normally, the large one is fine
+        TextureDesc desc;
+        CHECK(LoadDDS(largePath, desc) && desc.arraySize == 2048);
+
+        _wremove(smallPath.c_str());
+        _wremove(largePath.c_str());
+    }
+
+    /** LoadDDSMips that logs the mips streamed in or out and can hold the loader thread */
+    class LoggingLoader
+    {
+    public:
+        using Read = std::pair<std::wstring, UINT32>;
+
+        bool Load(const std::wstring& filepath, UINT32 firstMip, DDSLoadMode mode, TextureDesc& desc)
+        {
+            if (mode == DDSLoadMode::Copy)
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_isHeld; });
+                m_reads.push_back({ filepath, firstMip });
+            }
+            return LoadDDSMips(filepath, desc, firstMip, 0, mode);
+        }
+
+        void Hold()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isHeld = true;
+        }
+
+        void Release()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_isHeld = false;
+            }
+            m_condition.notify_all();
+        }
+
+        /** Reads since the previous call, in the order the loader thread made them */
+        std::vector<Read> TakeReads()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<Read> reads;
+            reads.swap(m_reads);
+            return reads;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        std::vector<Read> m_reads;
+        bool m_isHeld = false;
+    };
+
+    /** Three 256x256 RGBA8 chains, the tail is mips 3..8 under a tail size of 32 */
+    const wchar_t* const StreamedPaths[] = { L"DDSTests.StreamA.dds", L"DDSTests.StreamB.dds", L"DDSTests.StreamC.dds" };
+    const UINT64 StreamedTailBytes = 4096 + 1024 + 256 + 64 + 16 + 4;
+    const UINT64 StreamedMip2Bytes = 64 * 64 * 4;
+
+    void SaveStreamedTextures()
+    {
+        for (UINT32 i = 0; i < 3; i++)
+        {
+            TestTexture chain = MakeTexture(DXGI_FORMAT_R8G8B8A8_UNORM, TextureDimension::Texture2D, 256, 256, 1, 1, 9, false, 20 + i);
+            CHECK(SaveDDS(chain.desc, StreamedPaths[i]));
+        }
+    }
+
+    void RemoveStreamedTextures()
+    {
+        for (const wchar_t* pPath : StreamedPaths)
+        {
+            _wremove(pPath);
+        }
+    }
+
+    void TestStreamerPriority()
+    {
+        SaveStreamedTextures();
+
+        LoggingLoader loader;
+        TextureStreamerSettings settings;
+        settings.tailSize = 32;
+        TextureStreamer streamer(settings, [&](const std::wstring& filepath, UINT32 firstMip, DDSLoadMode mode, TextureDesc& desc)
+        {
+            return loader.Load(filepath, firstMip, mode, desc);
+        });
+
+        UINT32 ids[3] = {};
+        for (UINT32 i = 0; i < 3; i++)
+        {
+            TextureDesc tailDesc;
+            CHECK(streamer.Register(StreamedPaths[i], ids[i], tailDesc));
+            CHECK(streamer.GetResidentMip(ids[i]) == 3);
+        }
+        CHECK(streamer.GetResidentBytes() == 3 * StreamedTailBytes);
+        loader.TakeReads();
+
+        // The three loads are queued together, the blurriest texture goes first
+        std::vector<TextureStreamerUpdate> updates;
+        streamer.RequestScreenSize(ids[0], 64.0f);
+        streamer.RequestScreenSize(ids[1], 256.0f);
+        streamer.RequestScreenSize(ids[2], 128.0f);
+        streamer.Update(updates);
+        streamer.WaitIdle();
+
+        CHECK(streamer.GetWantedMip(ids[0]) == 2 && streamer.GetWantedMip(ids[1]) == 0 && streamer.GetWantedMip(ids[2]) == 1);
+
+        const std::vector<LoggingLoader::Read> expected =
+        {
+            { StreamedPaths[1], 2 }, { StreamedPaths[2], 2 }, { StreamedPaths[0], 2 }
+        };
+        CHECK(loader.TakeReads() == expected);
+
+        // One level per frame until every texture holds what it is wanted at
+        for (UINT32 frame = 0; frame < 8; frame++)
+        {
+            streamer.RequestScreenSize(ids[0], 64.0f);
+            streamer.RequestScreenSize(ids[1], 256.0f);
+            streamer.RequestScreenSize(ids[2], 128.0f);
+            streamer.Update(updates);
+            streamer.WaitIdle();
+        }
+        CHECK(streamer.GetResidentMip(ids[0]) == 2 && streamer.GetResidentMip(ids[1]) == 0 && streamer.GetResidentMip(ids[2]) == 1);
+        CHECK(streamer.GetResidentBytes() == 3 * StreamedTailBytes + 3 * StreamedMip2Bytes + 2 * 4 * StreamedMip2Bytes
+            + 16 * StreamedMip2Bytes);
+
+        RemoveStreamedTextures();
+    }
+
+    void TestStreamerEviction()
+    {
+        SaveStreamedTextures();
+
+        // Room for the tails and mip 2 of two of the textures
+        LoggingLoader loader;
+        TextureStreamerSettings settings;
+        settings.tailSize = 32;
+        settings.budget = 3 * StreamedTailBytes + 2 * StreamedMip2Bytes;
+        TextureStreamer streamer(settings, [&](const std::wstring& filepath, UINT32 firstMip, DDSLoadMode mode, TextureDesc& desc)
+        {
+            return loader.Load(filepath, firstMip, mode, desc);
+        });
+
+        UINT32 ids[3] = {};
+        for (UINT32 i = 0; i < 3; i++)
+        {
+            TextureDesc tailDesc;
+            CHECK(streamer.Register(StreamedPaths[i], ids[i], tailDesc));
+        }
+        loader.TakeReads();
+
+        std::vector<TextureStreamerUpdate> updates;
+        auto frame = [&](std::initializer_list<UINT32> visible, bool wait)
+        {
+            for (UINT32 i : visible)
+            {
+                streamer.RequestScreenSize(ids[i], 64.0f);
+            }
+            streamer.Update(updates);
+            if (wait)
+            {
+                streamer.WaitIdle();
+            }
+            CHECK(streamer.GetResidentBytes() <= settings.budget);
+        };
+
+        // B is used before A is again, so B is the least recently used once C shows up
+        frame({ 0 }, true);
+        frame({ 1 }, true);
+        frame({ 0 }, true);
+        CHECK(streamer.GetResidentMip(ids[0]) == 2 && streamer.GetResidentMip(ids[1]) == 2);
+        CHECK(streamer.GetResidentBytes() == settings.budget);
+
+        const std::vector<LoggingLoader::Read> loads = { { StreamedPaths[0], 2 }, { StreamedPaths[1], 2 } };
+        CHECK(loader.TakeReads() == loads);
+
+        // C does not fit: B is evicted, not A, and C waits for the eviction to finish
+        loader.Hold();
+        frame({ 2 }, false);
+
+        // The eviction of B is still running; it covers C, so A is not evicted as well
+        frame({ 2 }, false);
+        loader.Release();
+        streamer.WaitIdle();
+
+        const std::vector<LoggingLoader::Read> eviction = { { StreamedPaths[1], 3 } };
+        CHECK(loader.TakeReads() == eviction);
+
+        frame({ 2 }, true);
+        frame({ 2 }, true);
+
+        const std::vector<LoggingLoader::Read> load = { { StreamedPaths[2], 2 } };
+        CHECK(loader.TakeReads() == load);
+        CHECK(streamer.GetResidentMip(ids[0]) == 2 && streamer.GetResidentMip(ids[1]) == 3 && streamer.GetResidentMip(ids[2]) == 2);
+        CHECK(streamer.GetResidentBytes() == settings.budget);
+
+        // B the eviction finished with, the update hands out its tail
+        bool isBEvicted = false;
+        for (const TextureStreamerUpdate& update : updates)
+        {
+            isBEvicted = isBEvicted || (update.id == ids[1] && update.residentMip == 3 && update.desc.width == 32);
+        }
+        CHECK(isBEvicted);
+
+        RemoveStreamedTextures();
+    }
+
+}
+
+int main()
+{
+    TestDecodeRandomBlocks();
+    TestDecodeBC7();
+    TestEncodeQuality();
+    TestEncodeExact();
+    TestSaveLoadRoundTrip();
+    TestRejectMalformed();
+    TestTextureKey();
+    TestBatchThrowingItem();
+    TestStreamerPriority();
+    TestStreamerEviction();
+
+    return Test::Finish("DDSTests");
+}
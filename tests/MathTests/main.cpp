@@ -0,0 +1,444 @@
+#include "framework.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "SceneMath.h"
+#include "VectorBatch.h"
+
+#include "../Check.h"
+
+// Reference values for the DirectXMath subset the renderer uses. Windows builds check
+// DirectXMath itself, Linux builds PortableMath (SSE, NEON or plain floats), so both are
+// held to the same numbers. Where every operation is exact in float the result is
+// compared exactly, elsewhere against values worked out in double precision. The vector
+// batch kernels are held to the XMFLOAT3 operations they replace.
+
+namespace
+{
+
+    using namespace DirectX;
+
+    /** Rows of a matrix as floats */
+    struct Matrix
+    {
+        float m[4][4];
+    };
+
+    Matrix ToMatrix(const XMMATRIX& matrix)
+    {
+        XMFLOAT4X4 stored;
+        XMStoreFloat4x4(&stored, matrix);
+
+        Matrix result;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                result.m[i][j] = stored.m[i][j];
+            }
+        }
+        return result;
+    }
+
+    XMMATRIX FromRows(const float rows[4][4])
+    {
+        return XMMATRIX(
+            XMVectorSet(rows[0][0], rows[0][1], rows[0][2], rows[0][3]),
+            XMVectorSet(rows[1][0], rows[1][1], rows[1][2], rows[1][3]),
+            XMVectorSet(rows[2][0], rows[2][1], rows[2][2], rows[2][3]),
+            XMVectorSet(rows[3][0], rows[3][1], rows[3][2], rows[3][3]));
+    }
+
+    /** Every element within tolerance, 0 asks for equality */
+    bool MatrixNear(const XMMATRIX& actual, const float expected[4][4], float tolerance)
+    {
+        Matrix values = ToMatrix(actual);
+
+        bool near = true;
+        for (int i = 0; i < 4; i++)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                if (!(fabsf(values.m[i][j] - expected[i][j]) <= tolerance))
+                {
+                    printf("  [%d][%d] is %.9g, expected %.9g\n", i, j, values.m[i][j], expected[i][j]);
+                    near = false;
+                }
+            }
+        }
+        return near;
+    }
+
+    /** Row vector times matrix, as the shaders apply them */
+    void TransformPoint(const XMMATRIX& matrix, const float point[4], float result[4])
+    {
+        Matrix values = ToMatrix(matrix);
+        for (int j = 0; j < 4; j++)
+        {
+            result[j] = point[0] * values.m[0][j] + point[1] * values.m[1][j] + point[2] * values.m[2][j] + point[3] * values.m[3][j];
+        }
+    }
+
+    void TestVectors()
+    {
+        XMVECTOR a = XMVectorSet(1.0f, 2.0f, 3.0f, 4.0f);
+        XMVECTOR b = XMVectorSet(-2.0f, 5.0f, 0.5f, 8.0f);
+
+        CHECK(XMVectorGetX(a) == 1.0f && XMVectorGetY(a) == 2.0f && XMVectorGetZ(a) == 3.0f && XMVectorGetW(a) == 4.0f);
+
+        CHECK(XMVectorGetX(XMVector3Dot(a, b)) == 9.5f);
+        CHECK(XMVectorGetW(XMVector3Dot(a, b)) == 9.5f);
+        CHECK(XMVectorGetX(XMVector4Dot(a, b)) == 41.5f);
+
+        XMVECTOR cross = XMVector3Cross(a, b);
+        CHECK(XMVectorGetX(cross) == -14.0f && XMVectorGetY(cross) == -6.5f && XMVectorGetZ(cross) == 9.0f);
+
+        XMVECTOR unit = XMVector3Normalize(XMVectorSet(3.0f, 4.0f, 0.0f, 10.0f));
+        CHECK(XMVectorGetX(unit) == 0.6f && XMVectorGetY(unit) == 0.8f && XMVectorGetZ(unit) == 0.0f);
+        // w is divided by the length of x, y, z too
+        CHECK(XMVectorGetW(unit) == 2.0f);
+
+        XMVECTOR zero = XMVector3Normalize(XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f));
+        CHECK(XMVectorGetX(zero) == 0.0f && XMVectorGetY(zero) == 0.0f && XMVectorGetZ(zero) == 0.0f);
+
+        XMVECTOR infinite = XMVector3Normalize(XMVectorSet(INFINITY, 1.0f, 0.0f, 0.0f));
+        CHECK(isnan(XMVectorGetX(infinite)) && isnan(XMVectorGetY(infinite)) && isnan(XMVectorGetZ(infinite)));
+
+        XMVECTOR negated = XMVectorNegate(a);
+        CHECK(XMVectorGetX(negated) == -1.0f && XMVectorGetW(negated) == -4.0f);
+    }
+
+    void TestSinCos()
+    {
+        const float angles[] = { 0.0f, 0.5f, -1.0f, XM_PIDIV2, 3.0f, -4.0f, 10.0f };
+        for (float angle : angles)
+        {
+            float sine, cosine;
+            XMScalarSinCos(&sine, &cosine, angle);
+            CHECK_NEAR(sine, sin((double)angle), 2e-6);
+            CHECK_NEAR(cosine, cos((double)angle), 2e-6);
+        }
+    }
+
+    void TestConstruction()
+    {
+        const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        CHECK(MatrixNear(XMMatrixIdentity(), identity, 0.0f));
+
+        const float translation[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 2, -3, 0.5f, 1 } };
+        CHECK(MatrixNear(XMMatrixTranslation(2.0f, -3.0f, 0.5f), translation, 0.0f));
+
+        const float rows[4][4] = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 }, { 9, 10, 11, 12 }, { 13, 14, 15, 16 } };
+        const float transposed[4][4] = { { 1, 5, 9, 13 }, { 2, 6, 10, 14 }, { 3, 7, 11, 15 }, { 4, 8, 12, 16 } };
+        CHECK(MatrixNear(XMMatrixTranspose(FromRows(rows)), transposed, 0.0f));
+    }
+
+    void TestMultiply()
+    {
+        const float a[4][4] = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 }, { 9, 10, 11, 12 }, { 13, 14, 15, 16 } };
+        const float b[4][4] = { { 2, 0, -1, 1 }, { 0.5f, 3, 0, -2 }, { 1, 1, 1, 1 }, { -1, 0, 2, 0.25f } };
+        const float product[4][4] = {
+            { 2, 9, 10, 1 },
+            { 12, 25, 18, 2 },
+            { 22, 41, 26, 3 },
+            { 32, 57, 34, 4 },
+        };
+        CHECK(MatrixNear(XMMatrixMultiply(FromRows(a), FromRows(b)), product, 0.0f));
+
+        // Translation then translation adds the offsets
+        const float translations[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 3, 1, -2, 1 } };
+        CHECK(MatrixNear(XMMatrixMultiply(XMMatrixTranslation(1.0f, 2.0f, 3.0f), XMMatrixTranslation(2.0f, -1.0f, -5.0f)), translations, 0.0f));
+    }
+
+    void TestInverse()
+    {
+        // Scale by (2, 4, 0.5) then move by (3, -1, 2): the inverse and determinant are exact
+        const float scaleMove[4][4] = { { 2, 0, 0, 0 }, { 0, 4, 0, 0 }, { 0, 0, 0.5f, 0 }, { 3, -1, 2, 1 } };
+        const float scaleMoveInverse[4][4] = { { 0.5f, 0, 0, 0 }, { 0, 0.25f, 0, 0 }, { 0, 0, 2, 0 }, { -1.5f, 0.25f, -4, 1 } };
+
+        XMVECTOR determinant;
+        CHECK(MatrixNear(XMMatrixInverse(&determinant, FromRows(scaleMove)), scaleMoveInverse, 0.0f));
+        CHECK(XMVectorGetX(determinant) == 4.0f && XMVectorGetW(determinant) == 4.0f);
+
+        // The normal matrix of a translation is the identity with the offsets in the last column
+        const float normalMatrix[4][4] = { { 1, 0, 0, -2 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        CHECK(MatrixNear(ComputeNormalMatrix(XMMatrixTranslation(2.0f, 0.0f, 0.0f)), normalMatrix, 0.0f));
+
+        // A general matrix, the inverse worked out in double precision
+        const float general[4][4] = { { 2, 1, 0, 0 }, { 1, 3, 1, 0 }, { 0, 1, 4, 0 }, { 1, 2, 3, 1 } };
+        const float generalInverse[4][4] = {
+            { 11.0f / 18, -4.0f / 18, 1.0f / 18, 0 },
+            { -4.0f / 18, 8.0f / 18, -2.0f / 18, 0 },
+            { 1.0f / 18, -2.0f / 18, 5.0f / 18, 0 },
+            { -6.0f / 18, -6.0f / 18, -12.0f / 18, 1 },
+        };
+        CHECK(MatrixNear(XMMatrixInverse(&determinant, FromRows(general)), generalInverse, 1e-6f));
+        CHECK_NEAR(XMVectorGetX(determinant), 18.0, 1e-5);
+
+        const float identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+        CHECK(MatrixNear(XMMatrixMultiply(XMMatrixInverse(nullptr, FromRows(general)), FromRows(general)), identity, 1e-6f));
+    }
+
+    void TestRotation()
+    {
+        // About +Y as the renderer spins the cube (its axis has w = 1, which is ignored)
+        const float angles[] = { 0.0f, XM_PIDIV2, 1.0f, -2.5f };
+        for (float angle : angles)
+        {
+            float c = (float)cos((double)angle);
+            float s = (float)sin((double)angle);
+            const float rotationY[4][4] = { { c, 0, -s, 0 }, { 0, 1, 0, 0 }, { s, 0, c, 0 }, { 0, 0, 0, 1 } };
+            CHECK(MatrixNear(ComputeModelMatrix(angle), rotationY, 2e-6f));
+        }
+
+        // An axis that is not unit length, against Rodrigues' formula
+        double axis[3] = { 1.0, -2.0, 2.0 };
+        double length = 3.0;
+        double x = axis[0] / length, y = axis[1] / length, z = axis[2] / length;
+        double angle = 0.75;
+        double c = cos(angle), s = sin(angle), t = 1.0 - c;
+        const float rotation[4][4] = {
+            { (float)(t * x * x + c), (float)(t * x * y + s * z), (float)(t * x * z - s * y), 0 },
+            { (float)(t * x * y - s * z), (float)(t * y * y + c), (float)(t * y * z + s * x), 0 },
+            { (float)(t * x * z + s * y), (float)(t * y * z - s * x), (float)(t * z * z + c), 0 },
+            { 0, 0, 0, 1 },
+        };
+        XMMATRIX m = XMMatrixRotationAxis(XMVectorSet((float)axis[0], (float)axis[1], (float)axis[2], 0.0f), (float)angle);
+        CHECK(MatrixNear(m, rotation, 2e-6f));
+
+        // Rotations are orthonormal, their normal matrix is themselves
+        CHECK(MatrixNear(ComputeNormalMatrix(m), rotation, 4e-6f));
+    }
+
+    void TestLookAt()
+    {
+        // From -Z towards the origin: the view only moves the world back by 5
+        const float fromFront[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 5, 1 } };
+        CHECK(MatrixNear(XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -5.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f),
+            XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), fromFront, 0.0f));
+
+        // From +X: world -X is the view direction and world Z points right
+        const float fromSide[4][4] = { { 0, 0, -1, 0 }, { 0, 1, 0, 0 }, { 1, 0, 0, 0 }, { 0, 0, 5, 1 } };
+        CHECK(MatrixNear(XMMatrixLookAtLH(XMVectorSet(5.0f, 0.0f, 0.0f, 0.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f),
+            XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), fromSide, 0.0f));
+
+        // The renderer's start camera: the eye goes to the origin, the point of interest r ahead
+        Camera camera = { XMFLOAT3(0.5f, -1.0f, 2.0f), 5.0f, -XM_PIDIV4, XM_PIDIV4 };
+        CameraMatrices matrices = ComputeCameraMatrices(camera, 1280, 720);
+
+        const float eye[4] = { matrices.position.x, matrices.position.y, matrices.position.z, 1.0f };
+        float eyeView[4];
+        TransformPoint(matrices.view, eye, eyeView);
+        CHECK_NEAR(eyeView[0], 0.0, 1e-5);
+        CHECK_NEAR(eyeView[1], 0.0, 1e-5);
+        CHECK_NEAR(eyeView[2], 0.0, 1e-5);
+        CHECK_NEAR(eyeView[3], 1.0, 0.0);
+
+        const float poi[4] = { camera.poi.x, camera.poi.y, camera.poi.z, 1.0f };
+        float poiView[4];
+        TransformPoint(matrices.view, poi, poiView);
+        CHECK_NEAR(poiView[0], 0.0, 1e-5);
+        CHECK_NEAR(poiView[1], 0.0, 1e-5);
+        CHECK_NEAR(poiView[2], camera.r, 1e-5);
+
+        CHECK_NEAR(matrices.position.x, 0.5 + cos((double)XM_PIDIV4) * cos(-(double)XM_PIDIV4) * 5.0, 1e-5);
+        CHECK_NEAR(matrices.position.y, -1.0 + sin((double)XM_PIDIV4) * 5.0, 1e-5);
+        CHECK_NEAR(matrices.position.z, 2.0 + cos((double)XM_PIDIV4) * sin(-(double)XM_PIDIV4) * 5.0, 1e-5);
+    }
+
+    void TestPerspective()
+    {
+        // Width 2 and height 1 at the near plane 1, far plane 101
+        const float range = 101.0f / 100.0f;
+        const float perspective[4][4] = { { 1, 0, 0, 0 }, { 0, 2, 0, 0 }, { 0, 0, range, 1 }, { 0, 0, -range, 0 } };
+        CHECK(MatrixNear(XMMatrixPerspectiveLH(2.0f, 1.0f, 1.0f, 101.0f), perspective, 0.0f));
+
+        // The renderer's projection takes the near plane to depth 0 and the far plane to 1
+        Camera camera = { XMFLOAT3(0.0f, 0.0f, 0.0f), 5.0f, 0.0f, 0.0f };
+        CameraMatrices matrices = ComputeCameraMatrices(camera, 800, 600);
+
+        const float nearPoint[4] = { 0.0f, 0.0f, CameraNearZ, 1.0f };
+        const float farPoint[4] = { 0.0f, 0.0f, CameraFarZ, 1.0f };
+        float nearClip[4], farClip[4];
+        TransformPoint(matrices.projection, nearPoint, nearClip);
+        TransformPoint(matrices.projection, farPoint, farClip);
+        CHECK_NEAR(nearClip[2] / nearClip[3], 0.0, 1e-6);
+        CHECK_NEAR(farClip[2] / farClip[3], 1.0, 1e-6);
+
+        // 60 degrees vertical field of view, the aspect ratio applied to x
+        Matrix projection = ToMatrix(matrices.projection);
+        CHECK_NEAR(matrices.projectionScale, 1.0 / tan((double)CameraFov / 2), 1e-5);
+        CHECK_NEAR(projection.m[0][0], 1.0 / tan((double)CameraFov / 2), 1e-5);
+        CHECK_NEAR(projection.m[1][1], 1.0 / tan((double)CameraFov / 2) * 800.0 / 600.0, 1e-5);
+    }
+
+    /** Not multiples of the 4, 8 and 16 lanes, so every path has a partial last group */
+    const size_t BatchCounts[] = { 1, 3, 5, 7, 13, 19, 37, 67 };
+
+    /** Deterministic vectors with components in [-4, 4), the first one zero */
+    std::vector<XMFLOAT3> MakeVectors(size_t count, UINT32 seed)
+    {
+        std::vector<XMFLOAT3> vectors(count);
+        UINT32 state = seed;
+        for (size_t i = 1; i < count; i++)
+        {
+            float components[3];
+            for (float& component : components)
+            {
+                state = state * 1664525u + 1013904223u;
+                component = (float)(state >> 8) / (float)(1u << 24) * 8.0f - 4.0f;
+            }
+            vectors[i] = XMFLOAT3(components[0], components[1], components[2]);
+        }
+        return vectors;
+    }
+
+    /** Representable floats between a and b, 0 for equal values, zeros of both signs included */
+    INT64 UlpDistance(float a, float b)
+    {
+        if (a == b)
+        {
+            return 0;
+        }
+
+        INT32 bitsA, bitsB;
+        memcpy(&bitsA, &a, sizeof(float));
+        memcpy(&bitsB, &b, sizeof(float));
+
+        // Sign and magnitude to an ordered integer line
+        INT64 orderA = bitsA < 0 ? (INT64)INT32_MIN - bitsA : bitsA;
+        INT64 orderB = bitsB < 0 ? (INT64)INT32_MIN - bitsB : bitsB;
+        return orderA > orderB ? orderA - orderB : orderB - orderA;
+    }
+
+    /** Every vector of the batch within maxUlp of the expected one in each component, 0 asks for equality */
+    bool BatchMatches(const char* operation, const Float3Batch& batch, const std::vector<XMFLOAT3>& expected, INT64 maxUlp)
+    {
+        bool matches = batch.GetCount() == expected.size();
+        for (size_t i = 0; matches && i < expected.size(); i++)
+        {
+            XMFLOAT3 actual = batch.Get(i);
+            if (UlpDistance(actual.x, expected[i].x) > maxUlp || UlpDistance(actual.y, expected[i].y) > maxUlp
+                || UlpDistance(actual.z, expected[i].z) > maxUlp)
+            {
+                printf("  %s of %zu vectors: [%zu] is (%.9g, %.9g, %.9g), expected (%.9g, %.9g, %.9g)\n", operation,
+                    expected.size(), i, actual.x, actual.y, actual.z, expected[i].x, expected[i].y, expected[i].z);
+                matches = false;
+            }
+        }
+        return matches;
+    }
+
+    /** The kernels of the path this CPU takes against the XMFLOAT3 operations */
+    void TestVectorBatches()
+    {
+        const XMFLOAT3 scale(0.5f, -1.25f, 3.1f);
+        const XMFLOAT3 offset(-2.5f, 0.75f, 10.3f);
+        const float Transform[4][4] =
+        {
+            { 0.9f, 0.1f, -0.3f, 0.0f },
+            { -0.1f, 0.95f, 0.2f, 0.0f },
+            { 0.3f, -0.2f, 0.9f, 0.0f },
+            { 1.5f, -2.0f, 0.25f, 1.0f }
+        };
+        XMFLOAT4X4 matrix;
+        memcpy(matrix.m, Transform, sizeof(Transform));
+
+        for (size_t count : BatchCounts)
+        {
+            const std::vector<XMFLOAT3> a = MakeVectors(count, 1 + (UINT32)count);
+            const std::vector<XMFLOAT3> b = MakeVectors(count, 1000 + (UINT32)count);
+
+            Float3Batch batchA;
+            batchA.Load(a.data(), count);
+            Float3Batch batchB;
+            batchB.Load(b.data(), count);
+            CHECK(BatchMatches("Load", batchA, a, 0));
+
+            std::vector<XMFLOAT3> stored(count, XMFLOAT3(NAN, NAN, NAN));
+            batchA.Store(stored.data());
+            bool isStoredExact = true;
+            for (size_t i = 0; i < count; i++)
+            {
+                isStoredExact = isStoredExact && stored[i] == a[i];
+            }
+            CHECK(isStoredExact);
+
+            std::vector<XMFLOAT3> expected(count);
+
+            Float3Batch batch = batchA;
+            ScaleBatch(batch, scale);
+            for (size_t i = 0; i < count; i++)
+            {
+                expected[i] = a[i] * scale;
+            }
+            CHECK(BatchMatches("Scale", batch, expected, 0));
+
+            batch = batchA;
+            TranslateBatch(batch, offset);
+            for (size_t i = 0; i < count; i++)
+            {
+                expected[i] = a[i] + offset;
+            }
+            CHECK(BatchMatches("Translate", batch, expected, 0));
+
+            Float3Batch cross;
+            CrossBatch(batchA, batchB, cross);
+            for (size_t i = 0; i < count; i++)
+            {
+                expected[i] = a[i].Cross(b[i]);
+            }
+            CHECK(BatchMatches("Cross", cross, expected, 0));
+
+            std::vector<float> dots(batchA.GetPaddedCount());
+            DotBatch(batchA, batchB, dots.data());
+            bool isDotExact = true;
+            for (size_t i = 0; i < count; i++)
+            {
+                isDotExact = isDotExact && dots[i] == a[i].Dot(b[i]);
+            }
+            CHECK(isDotExact);
+
+            batch = batchA;
+            TransformBatch(batch, matrix);
+            for (size_t i = 0; i < count; i++)
+            {
+                const XMFLOAT3& v = a[i];
+                expected[i] = XMFLOAT3(
+                    v.x * Transform[0][0] + v.y * Transform[1][0] + v.z * Transform[2][0] + Transform[3][0],
+                    v.x * Transform[0][1] + v.y * Transform[1][1] + v.z * Transform[2][1] + Transform[3][1],
+                    v.x * Transform[0][2] + v.y * Transform[1][2] + v.z * Transform[2][2] + Transform[3][2]);
+            }
+            CHECK(BatchMatches("Transform", batch, expected, 0));
+
+            // Multiplied by the reciprocal of the length instead of divided by it, the zero vector stays zero
+            batch = batchA;
+            NormalizeBatch(batch);
+            for (size_t i = 0; i < count; i++)
+            {
+                expected[i] = a[i].Normalized();
+            }
+            CHECK(BatchMatches("Normalize", batch, expected, 1));
+        }
+    }
+
+}
+
+int main()
+{
+    TestVectors();
+    TestSinCos();
+    TestConstruction();
+    TestMultiply();
+    TestInverse();
+    TestRotation();
+    TestLookAt();
+    TestPerspective();
+    TestVectorBatches();
+
+    return Test::Finish("MathTests");
+}
@@ -0,0 +1,302 @@
+#include "framework.h"
+
+#include "ShaderCache.h"
+#include "ShaderSourceCache.h"
+
+#include "../Check.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+// ShaderCache in front of a stub compiler that counts its calls: what goes into the key,
+// and that a hit never reaches the compiler. Sources are written to the working directory,
+// includes are resolved from there as the compiler would.
+
+namespace
+{
+
+    const wchar_t* SourcePath = L"ShaderCacheTests.hlsl";
+    const wchar_t* IncludePath = L"ShaderCacheTests.hlsli";
+    const wchar_t* NestedIncludePath = L"ShaderCacheTests.Nested.hlsli";
+    const wchar_t* CacheDirectory = L"ShaderCacheTests.cache";
+
+    /** Returns the source text as bytecode, with the entry point in front so that entries differ */
+    class StubCompiler : public IShaderCompiler
+    {
+    public:
+        HRESULT Compile(const void* pSource, size_t size, const ShaderCompileArgs& args,
+            std::vector<UINT8>& bytecode, std::string& messages) override
+        {
+            m_compileCount++;
+            if (m_fail)
+            {
+                messages = "stub error";
+                return E_FAIL;
+            }
+
+            bytecode.assign(args.entryPoint.begin(), args.entryPoint.end());
+            bytecode.insert(bytecode.end(), static_cast<const UINT8*>(pSource), static_cast<const UINT8*>(pSource) + size);
+            return S_OK;
+        }
+
+        UINT64 GetVersion() const override
+        {
+            return m_version;
+        }
+
+        UINT32 m_compileCount = 0;
+        UINT64 m_version = 1;
+        bool m_fail = false;
+    };
+
+    void WriteFile(const wchar_t* path, const std::string& text)
+    {
+        FILE* pFile = nullptr;
+        _wfopen_s(&pFile, path, L"wb");
+        CHECK(pFile != nullptr);
+        if (pFile != nullptr)
+        {
+            fwrite(text.data(), 1, text.size(), pFile);
+            fclose(pFile);
+        }
+    }
+
+    void WriteSources()
+    {
+        WriteFile(SourcePath,
+            "#include \"ShaderCacheTests.hlsli\"\n"
+            "float4 PS() : SV_Target { return Shade(); }\n");
+        WriteFile(IncludePath,
+            "  #  include <ShaderCacheTests.Nested.hlsli>\n"
+            "float4 Shade() { return Base(); }\n");
+        WriteFile(NestedIncludePath,
+            "float4 Base() { return 1; }\n");
+    }
+
+    ShaderCompileArgs MakeArgs()
+    {
+        ShaderCompileArgs args;
+        args.path = SourcePath;
+        args.entryPoint = "PS";
+        args.profile = "ps_5_0";
+        return args;
+    }
+
+    /** Removes the entries a test wrote, the cache starts empty for each one */
+    void RemoveEntries(const std::vector<UINT64>& keys)
+    {
+        for (UINT64 key : keys)
+        {
+            wchar_t name[64];
+            swprintf(name, sizeof(name) / sizeof(name[0]), L"%ls/%016llx.cso", CacheDirectory, (unsigned long long)key);
+            _wremove(name);
+        }
+    }
+
+    void TestKey()
+    {
+        WriteSources();
+
+        StubCompiler compiler;
+        ShaderCache cache(&compiler, CacheDirectory);
+
+        const ShaderCompileArgs args = MakeArgs();
+        const UINT64 key = cache.ComputeKey(args);
+        CHECK(key != 0);
+        CHECK(cache.ComputeKey(args) == key);
+
+        // Every part of the compile goes into the key
+        ShaderCompileArgs other = args;
+        other.entryPoint = "VS";
+        CHECK(cache.ComputeKey(other) != key);
+
+        other = args;
+        other.profile = "ps_4_0";
+        CHECK(cache.ComputeKey(other) != key);
+
+        other = args;
+        other.flags = 1;
+        CHECK(cache.ComputeKey(other) != key);
+
+        const D3D_SHADER_MACRO defines[] = { { "USE_NORMAL_MAP", "1" }, { nullptr, nullptr } };
+        const D3D_SHADER_MACRO otherDefines[] = { { "USE_NORMAL_MAP", "0" }, { nullptr, nullptr } };
+        other = args;
+        other.pDefines = defines;
+        const UINT64 definesKey = cache.ComputeKey(other);
+        CHECK(definesKey != key);
+        other.pDefines = otherDefines;
+        CHECK(cache.ComputeKey(other) != key && cache.ComputeKey(other) != definesKey);
+
+        compiler.m_version = 2;
+        CHECK(cache.ComputeKey(args) != key);
+        compiler.m_version = 1;
+
+        // So do the includes, also the ones included by includes
+        WriteFile(IncludePath,
+            "  #  include <ShaderCacheTests.Nested.hlsli>\n"
+            "float4 Shade() { return Base() * 0.5; }\n");
+        const UINT64 includeKey = cache.ComputeKey(args);
+        CHECK(includeKey != key);
+
+        WriteFile(NestedIncludePath,
+            "float4 Base() { return 0.25; }\n");
+        CHECK(cache.ComputeKey(args) != includeKey && cache.ComputeKey(args) != key);
+
+        // Restoring the files restores the key
+        WriteSources();
+        CHECK(cache.ComputeKey(args) == key);
+
+        CHECK(cache.ComputeKey(ShaderCompileArgs()) == 0);
+        CHECK(compiler.m_compileCount == 0);
+    }
+
+    void TestHitSkipsCompile()
+    {
+        WriteSources();
+
+        StubCompiler compiler;
+        ShaderCache cache(&compiler, CacheDirectory);
+
+        const ShaderCompileArgs args = MakeArgs();
+        std::vector<UINT64> keys = { cache.ComputeKey(args) };
+        RemoveEntries(keys);
+
+        std::string messages;
+        std::vector<std::wstring> dependencies;
+        AssetView first;
+        CHECK(SUCCEEDED(cache.GetBytecode(args, first, messages, &dependencies)));
+        CHECK(compiler.m_compileCount == 1);
+        CHECK(first.size > 2 && memcmp(first.pData, "PS", 2) == 0);
+
+        std::vector<std::wstring> expected = { SourcePath, NestedIncludePath, IncludePath };
+        CHECK(dependencies == expected);
+
+        AssetView second;
+        CHECK(SUCCEEDED(cache.GetBytecode(args, second, messages)));
+        CHECK(compiler.m_compileCount == 1);
+        CHECK(second.size == first.size && memcmp(second.pData, first.pData, first.size) == 0);
+
+        // The next start finds the entry on disk
+        StubCompiler nextCompiler;
+        ShaderCache nextCache(&nextCompiler, CacheDirectory);
+        AssetView third;
+        CHECK(SUCCEEDED(nextCache.GetBytecode(args, third, messages)));
+        CHECK(nextCompiler.m_compileCount == 0);
+        CHECK(third.size == first.size && memcmp(third.pData, first.pData, first.size) == 0);
+
+        ShaderCacheStats stats = cache.GetStats();
+        CHECK(stats.hits == 1 && stats.misses == 1);
+        stats = nextCache.GetStats();
+        CHECK(stats.hits == 1 && stats.misses == 0);
+
+        // An edited include is a miss, then a hit again
+        WriteFile(NestedIncludePath,
+            "float4 Base() { return 2.0; }\n");
+        keys.push_back(cache.ComputeKey(args));
+
+        AssetView edited;
+        CHECK(SUCCEEDED(cache.GetBytecode(args, edited, messages)));
+        CHECK(compiler.m_compileCount == 2);
+        CHECK(SUCCEEDED(cache.GetBytecode(args, edited, messages)));
+        CHECK(compiler.m_compileCount == 2);
+
+        // A failed compile is not cached
+        ShaderCompileArgs failing = args;
+        failing.entryPoint = "Missing";
+        keys.push_back(cache.ComputeKey(failing));
+
+        compiler.m_fail = true;
+        AssetView failed;
+        CHECK(FAILED(cache.GetBytecode(failing, failed, messages)));
+        CHECK(messages == "stub error");
+        compiler.m_fail = false;
+        CHECK(SUCCEEDED(cache.GetBytecode(failing, failed, messages)));
+        CHECK(compiler.m_compileCount == 4);
+
+        // A damaged entry is compiled again
+        wchar_t name[64];
+        swprintf(name, sizeof(name) / sizeof(name[0]), L"%ls/%016llx.cso", CacheDirectory, (unsigned long long)keys[0]);
+        WriteSources();
+        WriteFile(name, "SHDC");
+        CHECK(SUCCEEDED(cache.GetBytecode(args, failed, messages)));
+        CHECK(compiler.m_compileCount == 5);
+
+        RemoveEntries(keys);
+    }
+
+    void TestSourceCache()
+    {
+        ShaderSourceCache cache;
+
+        // A missing file is not counted, it has never been opened
+        const wchar_t* missingPath = L"ShaderCacheTests.Missing.hlsli";
+        AssetView view;
+        CHECK(!cache.Open(missingPath, view));
+        CHECK(cache.GetStats().empty());
+
+        // An empty file is an empty source, read once
+        const wchar_t* emptyPath = L"ShaderCacheTests.Empty.hlsli";
+        WriteFile(emptyPath, "");
+        AssetView empty;
+        CHECK(cache.Open(emptyPath, empty) && empty.size == 0 && empty.pData != nullptr);
+        CHECK(cache.Open(emptyPath, empty) && empty.size == 0);
+
+        std::map<std::string, ShaderSourceStats> stats = cache.GetStats();
+        CHECK(stats.size() == 1);
+        CHECK(stats.begin()->second.hits == 1 && stats.begin()->second.misses == 1);
+
+        _wremove(emptyPath);
+    }
+
+    std::string ReadText(const wchar_t* path)
+    {
+        AssetView view;
+        return OpenAsset(path, view) ? std::string(reinterpret_cast<const char*>(view.pData), view.size) : std::string();
+    }
+
+    void TestEntryReplacedWhole()
+    {
+        const wchar_t* path = L"ShaderCacheTests.Replaced.bin";
+        WriteFile(path, "old entry");
+
+        // A failed write leaves the old file as it was
+        CHECK(!WriteFileReplacing(path, [](FILE* pFile)
+        {
+            fwrite("partial", 1, 7, pFile);
+            return false;
+        }));
+        CHECK(ReadText(path) == "old entry");
+
+        CHECK(WriteFileReplacing(path, [](FILE* pFile)
+        {
+            return fwrite("new entry", 1, 9, pFile) == 9;
+        }));
+        CHECK(ReadText(path) == "new entry");
+
+        // Nor is a file created when the first write fails
+        const wchar_t* missingPath = L"ShaderCacheTests.Missing.bin";
+        CHECK(!WriteFileReplacing(missingPath, [](FILE*) { return false; }));
+        CHECK(ReadText(missingPath).empty());
+
+        _wremove(path);
+    }
+
+}
+
+int main()
+{
+    TestKey();
+    TestHitSkipsCompile();
+    TestSourceCache();
+    TestEntryReplacedWhole();
+
+    _wremove(SourcePath);
+    _wremove(IncludePath);
+    _wremove(NestedIncludePath);
+
+    return Test::Finish("ShaderCacheTests");
+}
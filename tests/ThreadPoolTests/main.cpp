@@ -0,0 +1,152 @@
+#include "ThreadPool.h"
+
+#include "../Check.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ParallelFor runs every item once, also nested, and hands exceptions of items over to
+// the caller instead of hanging it; Submit does the same through its future.
+
+namespace
+{
+
+    const uint32_t ItemCount = 1000;
+
+    void TestParallelFor(ThreadPool& pool)
+    {
+        std::vector<std::atomic<uint32_t>> runs(ItemCount);
+        for (std::atomic<uint32_t>& run : runs)
+        {
+            run = 0;
+        }
+
+        pool.ParallelFor(ItemCount, [&](uint32_t i) { runs[i]++; });
+
+        bool isEachRunOnce = true;
+        for (const std::atomic<uint32_t>& run : runs)
+        {
+            isEachRunOnce = isEachRunOnce && run == 1;
+        }
+        CHECK(isEachRunOnce);
+
+        // Workers waiting for nested loops help with them instead of blocking the pool
+        std::atomic<uint32_t> nestedRuns(0);
+        pool.ParallelFor(pool.GetThreadCount() * 2, [&](uint32_t)
+        {
+            pool.ParallelFor(50, [&](uint32_t) { nestedRuns++; });
+        });
+        CHECK(nestedRuns == pool.GetThreadCount() * 2 * 50);
+    }
+
+    void TestParallelForException(ThreadPool& pool)
+    {
+        // Thrown from every kind of item: the first one, which the caller runs, one in the
+        // middle, which a worker likely runs, and all of them
+        const uint32_t throwingItems[] = { 0, ItemCount / 2, ItemCount - 1 };
+        for (uint32_t throwing : throwingItems)
+        {
+            std::atomic<uint32_t> runs(0);
+            bool isCaught = false;
+            try
+            {
+                pool.ParallelFor(ItemCount, [&](uint32_t i)
+                {
+                    runs++;
+                    if (i == throwing)
+                    {
+                        throw std::runtime_error("item failed");
+                    }
+                });
+            }
+            catch (const std::runtime_error& error)
+            {
+                isCaught = std::string(error.what()) == "item failed";
+            }
+            CHECK(isCaught);
+            CHECK(runs >= 1 && runs <= ItemCount);
+        }
+
+        bool isCaught = false;
+        try
+        {
+            pool.ParallelFor(ItemCount, [&](uint32_t i) { throw (int)i; });
+        }
+        catch (int)
+        {
+            isCaught = true;
+        }
+        CHECK(isCaught);
+
+        // Single items run on the caller directly
+        isCaught = false;
+        try
+        {
+            pool.ParallelFor(1, [&](uint32_t) { throw std::logic_error("single"); });
+        }
+        catch (const std::logic_error&)
+        {
+            isCaught = true;
+        }
+        CHECK(isCaught);
+
+        // A nested failure surfaces in the outer loop
+        isCaught = false;
+        try
+        {
+            pool.ParallelFor(8, [&](uint32_t outer)
+            {
+                pool.ParallelFor(8, [&](uint32_t inner)
+                {
+                    if (outer == 5 && inner == 3)
+                    {
+                        throw std::runtime_error("nested");
+                    }
+                });
+            });
+        }
+        catch (const std::runtime_error&)
+        {
+            isCaught = true;
+        }
+        CHECK(isCaught);
+
+        // The pool is still fine afterwards
+        TestParallelFor(pool);
+    }
+
+    void TestSubmit(ThreadPool& pool)
+    {
+        std::future<int> value = pool.Submit([]() { return 42; });
+        CHECK(value.get() == 42);
+
+        std::future<void> failed = pool.Submit([]() { throw std::runtime_error("job failed"); });
+        bool isCaught = false;
+        try
+        {
+            failed.get();
+        }
+        catch (const std::runtime_error&)
+        {
+            isCaught = true;
+        }
+        CHECK(isCaught);
+    }
+
+}
+
+int main()
+{
+    ThreadPool pool(4);
+    TestParallelFor(pool);
+    TestParallelForException(pool);
+    TestSubmit(pool);
+
+    // With a single worker most items run on the caller
+    ThreadPool singlePool(1);
+    TestParallelForException(singlePool);
+
+    return Test::Finish("ThreadPoolTests");
+}
@@ -0,0 +1,206 @@
+#include "framework.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "AssetPak.h"
+
+namespace
+{
+
+    void PrintUsage()
+    {
+        wprintf(L"Usage:\n"
+            L"  AssetPacker <output.pak> <directory>[=<prefix>]... [options]\n"
+            L"\n"
+            L"Every file under each directory is stored as <prefix>/<path relative to the directory>.\n"
+            L"Names are looked up case-insensitively and with \".\" and \"..\" segments dropped, so\n"
+            L"..\\textures=textures serves \"../textures/bricks.dds\" and . serves \"VertexShader.hlsl\".\n"
+            L"\n"
+            L"Options:\n"
+            L"  --ext <.a,.b,...>   Pack only files with these extensions, all files by default\n"
+            L"  --verify            Read the archive back and compare every entry with its file\n");
+    }
+
+    bool HasExtension(const std::wstring& name, const std::vector<std::wstring>& extensions)
+    {
+        if (extensions.empty())
+        {
+            return true;
+        }
+
+        size_t dot = name.find_last_of(L'.');
+        if (dot == std::wstring::npos)
+        {
+            return false;
+        }
+
+        std::wstring extension = name.substr(dot);
+        for (const std::wstring& allowed : extensions)
+        {
+            if (_wcsicmp(extension.c_str(), allowed.c_str()) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /** Adds all matching files under directory, names get prefix and the relative path */
+    void CollectFiles(const std::wstring& directory, const std::wstring& prefix,
+        const std::vector<std::wstring>& extensions, std::vector<AssetPakSource>& sources)
+    {
+        WIN32_FIND_DATAW findData;
+        HANDLE hFind = FindFirstFileW((directory + L"\\*").c_str(), &findData);
+        if (hFind == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        do
+        {
+            std::wstring name = findData.cFileName;
+            if (name == L"." || name == L"..")
+            {
+                continue;
+            }
+
+            std::wstring path = directory + L"\\" + name;
+            std::wstring entryName = prefix.empty() ? name : prefix + L"/" + name;
+
+            if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+            {
+                CollectFiles(path, entryName, extensions, sources);
+            }
+            else if (HasExtension(name, extensions))
+            {
+                AssetPakSource source;
+                source.filepath = path;
+                source.name = entryName;
+                sources.push_back(std::move(source));
+            }
+        } while (FindNextFileW(hFind, &findData));
+
+        FindClose(hFind);
+    }
+
+    bool Verify(const std::wstring& pakPath, const std::vector<AssetPakSource>& sources)
+    {
+        std::shared_ptr<AssetPak> pPak = AssetPak::Open(pakPath);
+        if (pPak == nullptr || pPak->GetEntryCount() != sources.size())
+        {
+            return false;
+        }
+
+        // Checked against the loose files, so the archive must not be mounted here
+        for (const AssetPakSource& source : sources)
+        {
+            AssetView packed;
+            AssetView file;
+            if (!pPak->Find(source.name, packed) || (!OpenAsset(source.filepath, file) && packed.size != 0))
+            {
+                fwprintf(stderr, L"Verification failed: %ls\n", source.name.c_str());
+                return false;
+            }
+
+            if (packed.size != file.size || (packed.size != 0 && memcmp(packed.pData, file.pData, packed.size) != 0))
+            {
+                fwprintf(stderr, L"Verification failed: %ls\n", source.name.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::vector<std::wstring> positional;
+    std::vector<std::wstring> extensions;
+    bool verify = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring arg = argv[i];
+
+        if (arg == L"--verify")
+        {
+            verify = true;
+        }
+        else if (arg == L"--ext" && i + 1 < argc)
+        {
+            std::wstring list = argv[++i];
+            size_t start = 0;
+            while (start < list.size())
+            {
+                size_t end = list.find(L',', start);
+                if (end == std::wstring::npos)
+                {
+                    end = list.size();
+                }
+                if (end > start)
+                {
+                    extensions.push_back(list.substr(start, end - start));
+                }
+                start = end + 1;
+            }
+        }
+        else if (arg.compare(0, 2, L"--") == 0)
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<AssetPakSource> sources;
+    for (size_t i = 1; i < positional.size(); i++)
+    {
+        std::wstring directory = positional[i];
+        std::wstring prefix;
+
+        size_t separator = directory.find(L'=');
+        if (separator != std::wstring::npos)
+        {
+            prefix = directory.substr(separator + 1);
+            directory.resize(separator);
+        }
+
+        CollectFiles(directory, prefix, extensions, sources);
+    }
+
+    if (sources.empty())
+    {
+        fwprintf(stderr, L"No files to pack\n");
+        return 1;
+    }
+
+    if (!WriteAssetPak(positional[0], sources))
+    {
+        fwprintf(stderr, L"Can not write %ls\n", positional[0].c_str());
+        return 1;
+    }
+
+    if (verify && !Verify(positional[0], sources))
+    {
+        return 1;
+    }
+
+    wprintf(L"Packed %u files into %ls\n", (UINT32)sources.size(), positional[0].c_str());
+
+    return 0;
+}
@@ -0,0 +1,338 @@
+#include "framework.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "SceneMath.h"
+#include "VectorBatch.h"
+#include "XMFLOAT4.h"
+
+namespace
+{
+
+    void PrintUsage()
+    {
+        wprintf(L"Usage:\n"
+            L"  MathBench [options]\n"
+            L"\n"
+            L"Times the batch kernels against loops over XMFLOAT3 arrays, then the matrices\n"
+            L"the renderer builds each frame. The vectors stay in the cache, with millions of\n"
+            L"them every variant waits on memory and they all time the same.\n"
+            L"\n"
+            L"Options:\n"
+            L"  --count <n>    Vectors, 4096 by default\n"
+            L"  --passes <n>   Passes over the vectors per run, 250 by default\n"
+            L"  --runs <n>     Runs per operation, the fastest one is reported, 10 by default\n");
+    }
+
+    template <typename Vector>
+    Vector MakePoint(float x, float y, float z)
+    {
+        return Vector(x, y, z);
+    }
+
+    template <typename Vector>
+    std::vector<Vector> MakePoints(size_t count)
+    {
+        std::vector<Vector> points(count);
+
+        // Points on a sphere as CreateSphere lays them out, a fixed pattern keeps runs comparable
+        for (size_t i = 0; i < count; i++)
+        {
+            float lon = (float)i * 0.0173f;
+            float lat = (float)(i % 997) * 0.00315f - 1.57f;
+            points[i] = MakePoint<Vector>(sinf(lon) * cosf(lat), sinf(lat), cosf(lon) * cosf(lat));
+        }
+
+        return points;
+    }
+
+    /** Sphere::Scale */
+    template <typename Vector>
+    float Scale(std::vector<Vector>& points)
+    {
+        for (Vector& point : points)
+        {
+            point *= 0.999f;
+        }
+        return points[points.size() / 2].x;
+    }
+
+    const XMFLOAT3 Axis(0.267f, 0.535f, 0.802f);
+
+    /** Row vector times matrix, the translation row applied */
+    const float Transform[4][4] =
+    {
+        { 0.9f, 0.1f, -0.3f, 0.0f },
+        { -0.1f, 0.95f, 0.2f, 0.0f },
+        { 0.3f, -0.2f, 0.9f, 0.0f },
+        { 1.5f, -2.0f, 0.25f, 1.0f }
+    };
+
+    template <typename Vector>
+    float NormalizeOnly(std::vector<Vector>& points)
+    {
+        for (Vector& point : points)
+        {
+            point = point.Normalized();
+        }
+        return points[points.size() / 2].x;
+    }
+
+    template <typename Vector>
+    float CrossAxis(std::vector<Vector>& points)
+    {
+        const Vector axis(Axis.x, Axis.y, Axis.z);
+        for (Vector& point : points)
+        {
+            point = point.Cross(axis);
+        }
+        return points[points.size() / 2].x;
+    }
+
+    template <typename Vector>
+    float TransformPoints(std::vector<Vector>& points)
+    {
+        for (Vector& point : points)
+        {
+            point = Vector(
+                point.x * Transform[0][0] + point.y * Transform[1][0] + point.z * Transform[2][0] + Transform[3][0],
+                point.x * Transform[0][1] + point.y * Transform[1][1] + point.z * Transform[2][1] + Transform[3][1],
+                point.x * Transform[0][2] + point.y * Transform[1][2] + point.z * Transform[2][2] + Transform[3][2]);
+        }
+        return points[points.size() / 2].x;
+    }
+
+    float ScaleBatchOnly(Float3Batch& batch, std::vector<XMFLOAT3>&)
+    {
+        ScaleBatch(batch, XMFLOAT3(0.999f, 0.999f, 0.999f));
+        return batch.GetX()[batch.GetCount() / 2];
+    }
+
+    /** Sphere::Scale as it is now, the conversions included */
+    float ScaleBatchConverted(Float3Batch& batch, std::vector<XMFLOAT3>& points)
+    {
+        batch.Load(points.data(), points.size());
+        ScaleBatch(batch, XMFLOAT3(0.999f, 0.999f, 0.999f));
+        batch.Store(points.data());
+        return points[points.size() / 2].x;
+    }
+
+    float NormalizeBatchOnly(Float3Batch& batch, std::vector<XMFLOAT3>&)
+    {
+        NormalizeBatch(batch);
+        return batch.GetX()[batch.GetCount() / 2];
+    }
+
+    float CrossBatchOnly(Float3Batch& batch, std::vector<XMFLOAT3>&)
+    {
+        static Float3Batch axis;
+        if (axis.GetCount() != batch.GetCount())
+        {
+            axis.Resize(batch.GetCount());
+            for (size_t i = 0; i < batch.GetCount(); i++)
+            {
+                axis.Set(i, Axis);
+            }
+        }
+
+        CrossBatch(batch, axis, batch);
+        return batch.GetX()[batch.GetCount() / 2];
+    }
+
+    float TransformBatchOnly(Float3Batch& batch, std::vector<XMFLOAT3>&)
+    {
+        DirectX::XMFLOAT4X4 matrix;
+        memcpy(matrix.m, Transform, sizeof(Transform));
+
+        TransformBatch(batch, matrix);
+        return batch.GetX()[batch.GetCount() / 2];
+    }
+
+    volatile float g_sink;
+
+    struct Options
+    {
+        size_t count = 4096;
+        int passes = 250;
+        int runs = 10;
+    };
+
+    /** Fastest of the runs in milliseconds, the points are rebuilt before each one */
+    template <typename Vector>
+    double Time(float (*pOperation)(std::vector<Vector>&), const Options& options)
+    {
+        double best = 1e30;
+
+        for (int run = 0; run < options.runs; run++)
+        {
+            std::vector<Vector> points = MakePoints<Vector>(options.count);
+
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < options.passes; pass++)
+            {
+                g_sink = pOperation(points);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            best = std::min(best, ms);
+        }
+
+        return best;
+    }
+
+    double TimeBatch(float (*pOperation)(Float3Batch&, std::vector<XMFLOAT3>&), const Options& options)
+    {
+        double best = 1e30;
+
+        for (int run = 0; run < options.runs; run++)
+        {
+            std::vector<XMFLOAT3> points = MakePoints<XMFLOAT3>(options.count);
+            Float3Batch batch;
+            batch.Load(points.data(), points.size());
+
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < options.passes; pass++)
+            {
+                g_sink = pOperation(batch, points);
+            }
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            best = std::min(best, ms);
+        }
+
+        return best;
+    }
+
+    void CompareBatch(const wchar_t* name, float (*pScalar)(std::vector<XMFLOAT3>&),
+        float (*pBatch)(Float3Batch&, std::vector<XMFLOAT3>&), const Options& options)
+    {
+        double scalarMs = Time<XMFLOAT3>(pScalar, options);
+        double batchMs = TimeBatch(pBatch, options);
+
+        wprintf(L"%-24ls %9.3f ms %9.3f ms %6.2fx\n", name, scalarMs, batchMs, scalarMs / batchMs);
+    }
+
+    /** The matrices Renderer::Update builds in a frame, through the same calls, for count frames */
+    float FrameMatrices(size_t count)
+    {
+        Camera camera = { XMFLOAT3(0.0f, 0.0f, 0.0f), 5.0f, -3.14159265f / 4, 3.14159265f / 4 };
+
+        DirectX::XMFLOAT4X4 sum = {};
+        for (size_t i = 0; i < count; i++)
+        {
+            float angle = 0.001f * (float)i;
+            camera.phi = angle;
+
+            DirectX::XMMATRIX model = ComputeModelMatrix(-angle);
+            DirectX::XMMATRIX normalMatrix = ComputeNormalMatrix(model);
+            CameraMatrices matrices = ComputeCameraMatrices(camera, 1280, 720);
+            DirectX::XMMATRIX vp = DirectX::XMMatrixMultiply(matrices.view, matrices.projection);
+
+            DirectX::XMFLOAT4X4 result;
+            DirectX::XMStoreFloat4x4(&result, DirectX::XMMatrixMultiply(normalMatrix, vp));
+            sum.m[i % 4][(i / 4) % 4] += result.m[i % 4][(i / 4) % 4];
+        }
+        return sum.m[0][0] + sum.m[3][3];
+    }
+
+    /** Nanoseconds per frame of FrameMatrices, the fastest of the runs */
+    double TimeFrameMatrices(const Options& options)
+    {
+        double best = 1e30;
+
+        for (int run = 0; run < options.runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < options.passes; pass++)
+            {
+                g_sink = FrameMatrices(options.count);
+            }
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            best = std::min(best, ns / ((double)options.count * options.passes));
+        }
+
+        return best;
+    }
+
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    Options options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring arg = argv[i];
+
+        if (arg == L"--count" && i + 1 < argc)
+        {
+            options.count = (size_t)std::max(_wtoi(argv[++i]), 3);
+        }
+        else if (arg == L"--passes" && i + 1 < argc)
+        {
+            options.passes = std::max(_wtoi(argv[++i]), 1);
+        }
+        else if (arg == L"--runs" && i + 1 < argc)
+        {
+            options.runs = std::max(_wtoi(argv[++i]), 1);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    const CpuFeatures& features = GetCpuFeatures();
+    const wchar_t* batchPath = features.avx512f ? L"AVX-512" : features.avx2 ? L"AVX2" : L"SSE";
+
+    wprintf(L"%u vectors, %d passes, best of %d runs, batch kernels use %ls\n\n",
+        (UINT32)options.count, options.passes, options.runs, batchPath);
+    wprintf(L"%-24ls %12ls %12ls %7ls\n", L"", L"XMFLOAT3[]", L"Float3Batch", L"speedup");
+
+    CompareBatch(L"Scale", Scale<XMFLOAT3>, ScaleBatchOnly, options);
+    CompareBatch(L"Scale with conversions", Scale<XMFLOAT3>, ScaleBatchConverted, options);
+    CompareBatch(L"Normalize", NormalizeOnly<XMFLOAT3>, NormalizeBatchOnly, options);
+    CompareBatch(L"Cross", CrossAxis<XMFLOAT3>, CrossBatchOnly, options);
+    CompareBatch(L"Transform", TransformPoints<XMFLOAT3>, TransformBatchOnly, options);
+
+#if !defined(USE_PORTABLE_MATH) && defined(_WIN32)
+    const wchar_t* mathLibrary = L"DirectXMath";
+#elif defined(PORTABLE_MATH_SSE)
+    const wchar_t* mathLibrary = L"PortableMath, SSE";
+#elif defined(PORTABLE_MATH_NEON)
+    const wchar_t* mathLibrary = L"PortableMath, NEON";
+#else
+    const wchar_t* mathLibrary = L"PortableMath, scalar";
+#endif
+
+    wprintf(L"\nFrame matrices (%ls): %.1f ns per frame\n", mathLibrary, TimeFrameMatrices(options));
+
+    return 0;
+}
+
+#ifndef _WIN32
+/** Linux entry point, the arguments are taken as UTF-8 */
+int main(int argc, char* argv[])
+{
+    std::vector<std::wstring> args(argc);
+    std::vector<wchar_t*> pointers(argc);
+    for (int i = 0; i < argc; i++)
+    {
+        args[i].resize(mbstowcs(nullptr, argv[i], 0) + 1);
+        args[i].resize(mbstowcs(&args[i][0], argv[i], args[i].size()));
+        pointers[i] = &args[i][0];
+    }
+
+    return wmain(argc, pointers.data());
+}
+#endif
@@ -0,0 +1,290 @@
+#include "framework.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <d3dcompiler.h>
+
+#include "D3DShaderCompiler.h"
+#include "ShaderCache.h"
+#include "ShaderCompileQueue.h"
+#include "ShaderPermutation.h"
+
+namespace
+{
+
+    void PrintUsage()
+    {
+        wprintf(L"Usage:\n"
+            L"  ShaderEmbedder <output.h> [options]\n"
+            L"\n"
+            L"Compiles every lab6 shader and lit shader variant from the current directory and\n"
+            L"writes a header with their bytecode for EmbeddedShaders.cpp. The header is only\n"
+            L"rewritten when its contents change.\n"
+            L"\n"
+            L"Options:\n"
+            L"  --debug         Compile with the flags of the Debug build of lab6\n"
+            L"  --cache <dir>   Shader cache directory, ShaderCache by default\n");
+    }
+
+    /** Shaders the renderer creates without defines */
+    struct PlainShader
+    {
+        const wchar_t* path;
+        const char* entryPoint;
+        const char* profile;
+    };
+
+    const PlainShader PlainShaders[] =
+    {
+        { L"VertexShader.hlsl",             "VS", "vs_5_0" },
+        { L"VertexSphereShader.hlsl",       "VS", "vs_5_0" },
+        { L"PixelSphereShader.hlsl",        "PS", "ps_5_0" },
+        { L"VertexLightShader.hlsl",        "VS", "vs_5_0" },
+        { L"PixelLightShader.hlsl",         "PS", "ps_5_0" },
+        { L"VertexRectangleShader.hlsl",    "VS", "vs_5_0" },
+    };
+
+    /** Normal map layouts Renderer::InitScene can pick for the cubes */
+    const UINT32 NormalMapFeatures[] =
+    {
+        ShaderFeatureNormalMap,
+        ShaderFeatureNormalMap | ShaderFeatureNormalMapBC5,
+        ShaderFeatureNormalMap | ShaderFeatureNormalMapBC5 | ShaderFeatureNormalMapSnorm,
+    };
+
+    struct Variant
+    {
+        ShaderCompileArgs args;
+        std::unique_ptr<ShaderPermutationDefines> pDefines;
+        std::shared_future<ShaderCompileResult> job;
+    };
+
+    /** Every variant of the lit shader for each light count with a permutation of its own */
+    void AddLitVariants(const wchar_t* path, UINT32 features, UINT flags, std::vector<Variant>& variants)
+    {
+        for (UINT32 lightCount = 0; lightCount <= ShaderPermutation::MaxSpecializedLights; lightCount++)
+        {
+            Variant variant;
+            variant.pDefines.reset(new ShaderPermutationDefines(ShaderPermutation::Make(features, lightCount)));
+            variant.args.path = path;
+            variant.args.pDefines = variant.pDefines->Get();
+            variant.args.entryPoint = "PS";
+            variant.args.profile = "ps_5_0";
+            variant.args.flags = flags;
+
+            variants.push_back(std::move(variant));
+        }
+    }
+
+    /** C++ literal of text, L"..." if isWide */
+    std::string Quote(const std::string& text, bool isWide)
+    {
+        std::string literal = isWide ? "L\"" : "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                literal += '\\';
+            }
+            literal += c;
+        }
+        return literal + '"';
+    }
+
+    std::string Narrow(const std::wstring& text)
+    {
+        // Shader names are plain ASCII
+        std::string narrow;
+        for (wchar_t c : text)
+        {
+            narrow += (char)c;
+        }
+        return narrow;
+    }
+
+    std::string GenerateHeader(const std::vector<Variant>& variants)
+    {
+        std::string header = "// Generated by ShaderEmbedder, do not edit\n\nnamespace\n{\n";
+        std::string table = "constexpr EmbeddedShader EmbeddedShaderTable[] =\n{\n";
+
+        char text[256];
+
+        for (size_t i = 0; i < variants.size(); i++)
+        {
+            const ShaderCompileArgs& args = variants[i].args;
+            const ShaderCompileResult& compiled = variants[i].job.get();
+
+            sprintf_s(text, "\n    constexpr UINT8 Bytecode%u[] =\n    {", (UINT32)i);
+            header += text;
+
+            for (size_t offset = 0; offset < compiled.bytecode.size; offset++)
+            {
+                sprintf_s(text, offset % 16 == 0 ? "\n        0x%02x," : " 0x%02x,", compiled.bytecode.pData[offset]);
+                header += text;
+            }
+            header += "\n    };\n";
+
+            sprintf_s(text, "    constexpr const char* Defines%u[] = { ", (UINT32)i);
+            header += text;
+            for (const D3D_SHADER_MACRO* pDefine = args.pDefines; pDefine != nullptr && pDefine->Name != nullptr; pDefine++)
+            {
+                header += Quote(pDefine->Name, false) + ", " + Quote(pDefine->Definition != nullptr ? pDefine->Definition : "", false) + ", ";
+            }
+            header += "nullptr };\n";
+
+            sprintf_s(text, "    constexpr const wchar_t* Dependencies%u[] = { ", (UINT32)i);
+            header += text;
+            for (const std::wstring& dependency : compiled.dependencies)
+            {
+                header += Quote(Narrow(dependency), true) + ", ";
+            }
+            header += "nullptr };\n";
+
+            sprintf_s(text, ", 0x%x, Defines%u, Bytecode%u, sizeof(Bytecode%u), Dependencies%u },\n",
+                args.flags, (UINT32)i, (UINT32)i, (UINT32)i, (UINT32)i);
+            table += "    { " + Quote(Narrow(args.path), true) + ", " + Quote(args.entryPoint, false) + ", "
+                + Quote(args.profile, false) + text;
+        }
+
+        return header + "\n}\n\n" + table + "};\n";
+    }
+
+    bool IsFileEqual(const std::wstring& path, const std::string& contents)
+    {
+        FILE* pFile = nullptr;
+        _wfopen_s(&pFile, path.c_str(), L"rb");
+        if (pFile == nullptr)
+        {
+            return false;
+        }
+
+        std::string existing;
+        char buffer[64 * 1024];
+        size_t size = 0;
+        while ((size = fread(buffer, 1, sizeof(buffer), pFile)) != 0)
+        {
+            existing.append(buffer, size);
+        }
+        fclose(pFile);
+
+        return existing == contents;
+    }
+
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::vector<std::wstring> positional;
+    std::wstring cacheDirectory = L"ShaderCache";
+    UINT flags = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring arg = argv[i];
+
+        if (arg == L"--debug")
+        {
+            // Must match Renderer::MakeShaderArgs, other flags miss the table
+            flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+        }
+        else if (arg == L"--cache" && i + 1 < argc)
+        {
+            cacheDirectory = argv[++i];
+        }
+        else if (arg.compare(0, 2, L"--") == 0)
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 1)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<Variant> variants;
+
+    for (const PlainShader& shader : PlainShaders)
+    {
+        Variant variant;
+        variant.args.path = shader.path;
+        variant.args.entryPoint = shader.entryPoint;
+        variant.args.profile = shader.profile;
+        variant.args.flags = flags;
+
+        variants.push_back(std::move(variant));
+    }
+
+    for (UINT32 normalMap : NormalMapFeatures)
+    {
+        AddLitVariants(L"PixelShader.hlsl", normalMap, flags, variants);
+        AddLitVariants(L"PixelShader.hlsl", normalMap | ShaderFeatureSpecular, flags, variants);
+    }
+    AddLitVariants(L"PixelRectangleShader.hlsl", ShaderFeatureTranslucent, flags, variants);
+
+    // Unchanged shaders come from the same cache the renderer uses
+    D3DShaderCompiler compiler;
+    ShaderCache cache(&compiler, cacheDirectory);
+    ShaderCompileQueue queue(&cache);
+
+    for (Variant& variant : variants)
+    {
+        variant.job = queue.Enqueue(variant.args);
+    }
+
+    bool isCompiled = true;
+    for (const Variant& variant : variants)
+    {
+        const ShaderCompileResult& compiled = variant.job.get();
+        if (FAILED(compiled.result))
+        {
+            fwprintf(stderr, L"Can not compile %ls\n", variant.args.path.c_str());
+            fprintf(stderr, "%s", compiled.messages.c_str());
+            isCompiled = false;
+        }
+    }
+
+    if (!isCompiled)
+    {
+        return 1;
+    }
+
+    std::string header = GenerateHeader(variants);
+
+    // An untouched header keeps the dependent sources from being rebuilt
+    if (IsFileEqual(positional[0], header))
+    {
+        wprintf(L"%ls is up to date\n", positional[0].c_str());
+        return 0;
+    }
+
+    FILE* pFile = nullptr;
+    _wfopen_s(&pFile, positional[0].c_str(), L"wb");
+    if (pFile == nullptr)
+    {
+        fwprintf(stderr, L"Can not write %ls\n", positional[0].c_str());
+        return 1;
+    }
+
+    bool isWritten = fwrite(header.data(), 1, header.size(), pFile) == header.size();
+    if (fclose(pFile) != 0 || !isWritten)
+    {
+        fwprintf(stderr, L"Can not write %ls\n", positional[0].c_str());
+        return 1;
+    }
+
+    wprintf(L"Embedded %u shaders into %ls\n", (UINT32)variants.size(), positional[0].c_str());
+
+    return 0;
+}
@@ -0,0 +1,571 @@
+#include "framework.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "DDS.h"
+#include "BCDecoder.h"
+#include "BCEncoder.h"
+#include "MipGenerator.h"
+#include "SpecularPrefilter.h"
+#include "ThreadPool.h"
+
+namespace
+{
+
+    /** RGBA8 image with tightly packed rows */
+    struct Image
+    {
+        UINT32 width = 0;
+        UINT32 height = 0;
+        std::vector<UINT8> pixels;
+    };
+
+    struct CookOptions
+    {
+        DXGI_FORMAT fmt = DXGI_FORMAT_BC1_UNORM;
+        BCQuality quality = BCQuality::Normal;
+        bool generateMips = true;
+        MipFilter mipFilter = MipFilter::Kaiser;
+        bool verify = false;
+        bool supercompress = false;
+        bool isNormalMap = false;
+        SpecularPrefilterSettings specular;
+        ThreadPool* pPool = nullptr;
+    };
+
+    void PrintUsage()
+    {
+        wprintf(L"Usage:\n"
+            L"  TextureCooker <input> <output.dds> [options]\n"
+            L"  TextureCooker --benchmark [input] [options]\n"
+            L"  TextureCooker --prefilter-specular <cube.dds | px,nx,py,ny,pz,nz> <output.dds> [options]\n"
+            L"\n"
+            L"Input is a .dds file (mip 0 is decoded) or raw RGBA8 given as file.rgba:<width>x<height>.\n"
+            L"Specular prefiltering takes a cubemap .dds or six face .dds files separated by commas and\n"
+            L"skips baking if the output was made from the same faces with the same settings.\n"
+            L"\n"
+            L"Options:\n"
+            L"  --format bc1|bc1srgb|bc3|bc3srgb|bc5   Output format, bc1 by default\n"
+            L"  --quality fast|normal|high             Endpoint search effort, normal by default\n"
+            L"  --no-mips                              Write the top level only\n"
+            L"  --mip-filter box|kaiser                Mip downsampling filter, kaiser by default\n"
+            L"  --threads <count>                      Worker threads, all hardware threads by default\n"
+            L"  --normal-map                           Renormalize every level as a tangent space normal map, bc5 by default\n"
+            L"  --supercompress                        Store the payload as LZ compressed chunks (DDSZ, read by LoadDDS only)\n"
+            L"  --verify                               Read the output back and compare it with the cooked data\n"
+            L"  --face-size <size>                     Top level face size of the prefiltered cubemap, 128 by default\n"
+            L"  --samples <count>                      GGX samples per prefiltered texel, 64 by default\n");
+    }
+
+    bool ParseFormat(const std::wstring& name, DXGI_FORMAT& fmt)
+    {
+        if (name == L"bc1")          fmt = DXGI_FORMAT_BC1_UNORM;
+        else if (name == L"bc1srgb") fmt = DXGI_FORMAT_BC1_UNORM_SRGB;
+        else if (name == L"bc3")     fmt = DXGI_FORMAT_BC3_UNORM;
+        else if (name == L"bc3srgb") fmt = DXGI_FORMAT_BC3_UNORM_SRGB;
+        else if (name == L"bc5")     fmt = DXGI_FORMAT_BC5_UNORM;
+        else return false;
+
+        return true;
+    }
+
+    bool ParseMipFilter(const std::wstring& name, MipFilter& filter)
+    {
+        if (name == L"box")         filter = MipFilter::Box;
+        else if (name == L"kaiser") filter = MipFilter::Kaiser;
+        else return false;
+
+        return true;
+    }
+
+    bool ParseQuality(const std::wstring& name, BCQuality& quality)
+    {
+        if (name == L"fast")        quality = BCQuality::Fast;
+        else if (name == L"normal") quality = BCQuality::Normal;
+        else if (name == L"high")   quality = BCQuality::High;
+        else return false;
+
+        return true;
+    }
+
+    const wchar_t* GetFormatName(DXGI_FORMAT fmt)
+    {
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM:      return L"BC1";
+        case DXGI_FORMAT_BC1_UNORM_SRGB: return L"BC1 sRGB";
+        case DXGI_FORMAT_BC3_UNORM:      return L"BC3";
+        case DXGI_FORMAT_BC3_UNORM_SRGB: return L"BC3 sRGB";
+        case DXGI_FORMAT_BC5_UNORM:      return L"BC5";
+        }
+        return L"?";
+    }
+
+    const wchar_t* GetQualityName(BCQuality quality)
+    {
+        switch (quality)
+        {
+        case BCQuality::Fast:   return L"fast";
+        case BCQuality::Normal: return L"normal";
+        case BCQuality::High:   return L"high";
+        }
+        return L"?";
+    }
+
+    bool HasExtension(const std::wstring& path, const std::wstring& extension)
+    {
+        return path.size() >= extension.size()
+            && _wcsicmp(path.c_str() + path.size() - extension.size(), extension.c_str()) == 0;
+    }
+
+    /** Reads "file.rgba:<width>x<height>" or decodes the top level of a DDS file */
+    bool LoadImage(const std::wstring& spec, Image& image)
+    {
+        if (HasExtension(spec, L".dds"))
+        {
+            TextureDesc desc;
+            if (!LoadDDS(spec, desc, true, DDSLoadMode::Mapped))
+            {
+                return false;
+            }
+
+            image.width = desc.width;
+            image.height = desc.height;
+            return DecodeSubresource(desc, 0, image.pixels);
+        }
+
+        size_t separator = spec.rfind(L':');
+        if (separator == std::wstring::npos
+            || swscanf_s(spec.c_str() + separator + 1, L"%ux%u", &image.width, &image.height) != 2
+            || image.width == 0 || image.height == 0)
+        {
+            return false;
+        }
+
+        FILE* pFile = nullptr;
+        _wfopen_s(&pFile, spec.substr(0, separator).c_str(), L"rb");
+        if (pFile == nullptr)
+        {
+            return false;
+        }
+
+        image.pixels.resize((size_t)image.width * image.height * 4);
+        size_t readSize = fread(image.pixels.data(), 1, image.pixels.size(), pFile);
+        fclose(pFile);
+
+        return readSize == image.pixels.size();
+    }
+
+    /**
+     * Unpacks every texel to a vector, normalizes it and packs it back. The result
+     * survives dropping the blue channel, Z is rebuilt from X and Y on sampling.
+     */
+    void NormalizeNormals(Image& image)
+    {
+        for (size_t i = 0; i < image.pixels.size(); i += 4)
+        {
+            UINT8* pPixel = &image.pixels[i];
+
+            float x = pPixel[0] / 127.5f - 1.0f;
+            float y = pPixel[1] / 127.5f - 1.0f;
+            float z = pPixel[2] / 127.5f - 1.0f;
+
+            float length = sqrtf(x * x + y * y + z * z);
+            if (length < 1e-6f)
+            {
+                x = 0.0f;
+                y = 0.0f;
+                z = 1.0f;
+                length = 1.0f;
+            }
+
+            pPixel[0] = (UINT8)(std::min(std::max((x / length + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+            pPixel[1] = (UINT8)(std::min(std::max((y / length + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+            pPixel[2] = (UINT8)(std::min(std::max((z / length + 1.0f) * 127.5f + 0.5f, 0.0f), 255.0f));
+            pPixel[3] = 255;
+        }
+    }
+
+    UINT32 GetBlockPitch(DXGI_FORMAT fmt, UINT32 width)
+    {
+        return DivUp(width, 4u) * GetBytesPerBlock(fmt);
+    }
+
+    std::vector<UINT8> Compress(const Image& image, const CookOptions& options)
+    {
+        UINT32 pitch = GetBlockPitch(options.fmt, image.width);
+        std::vector<UINT8> blocks((size_t)pitch * DivUp(image.height, 4u));
+
+        EncodeBC(options.fmt, image.pixels.data(), image.width, image.height, image.width * 4,
+            blocks.data(), pitch, options.quality, options.pPool);
+
+        return blocks;
+    }
+
+    /** Packs the compressed levels into one payload in the layout SaveDDS expects */
+    TextureDesc MakeTextureDesc(DXGI_FORMAT fmt, UINT32 width, UINT32 height, const std::vector<std::vector<UINT8>>& mips)
+    {
+        TextureDesc desc;
+        desc.fmt = fmt;
+        desc.width = width;
+        desc.height = height;
+        desc.mipmapsCount = (UINT32)mips.size();
+        desc.dataSize = ComputeSubresourceLayout(fmt, width, height, 1, 1, desc.mipmapsCount, desc.mipmapsCount,
+            desc.subresources);
+
+        std::shared_ptr<UINT8> pBuffer((UINT8*)malloc((size_t)desc.dataSize), free);
+        for (size_t i = 0; i < mips.size(); i++)
+        {
+            memcpy(pBuffer.get() + desc.subresources[i].offset, mips[i].data(), mips[i].size());
+        }
+
+        desc.pData = pBuffer.get();
+        desc.pStorage = pBuffer;
+
+        return desc;
+    }
+
+    /** Reads the written file back and compares the payload */
+    bool VerifyOutput(const std::wstring& output, const TextureDesc& desc)
+    {
+        TextureDesc written;
+        return LoadDDS(output, written, false, DDSLoadMode::Mapped)
+            && written.fmt == desc.fmt && written.width == desc.width && written.height == desc.height
+            && written.mipmapsCount == desc.mipmapsCount && written.dataSize == desc.dataSize
+            && memcmp(written.pData, desc.pData, (size_t)desc.dataSize) == 0;
+    }
+
+    int Cook(const std::wstring& input, const std::wstring& output, const CookOptions& options)
+    {
+        Image image;
+        if (!LoadImage(input, image))
+        {
+            fwprintf(stderr, L"Can not read %ls\n", input.c_str());
+            return 1;
+        }
+
+        const UINT32 width = image.width;
+        const UINT32 height = image.height;
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (options.isNormalMap)
+        {
+            NormalizeNormals(image);
+        }
+
+        std::vector<std::vector<UINT8>> mips;
+        mips.push_back(Compress(image, options));
+
+        if (options.generateMips)
+        {
+            const bool isSRGB = options.fmt == DXGI_FORMAT_BC1_UNORM_SRGB || options.fmt == DXGI_FORMAT_BC3_UNORM_SRGB;
+
+            std::vector<std::vector<UINT8>> levels;
+            GenerateMipChain(image.pixels.data(), width, height, width * 4, isSRGB, options.mipFilter, levels,
+                options.pPool);
+
+            for (size_t i = 0; i < levels.size(); i++)
+            {
+                image.width = std::max(1u, width >> (i + 1));
+                image.height = std::max(1u, height >> (i + 1));
+                image.pixels.swap(levels[i]);
+
+                // Filtering shortens the vectors, every level is brought back to unit length
+                if (options.isNormalMap)
+                {
+                    NormalizeNormals(image);
+                }
+                mips.push_back(Compress(image, options));
+            }
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        TextureDesc desc = MakeTextureDesc(options.fmt, width, height, mips);
+        if (!SaveDDS(desc, output, options.supercompress))
+        {
+            fwprintf(stderr, L"Can not write %ls\n", output.c_str());
+            return 1;
+        }
+
+        if (options.verify && !VerifyOutput(output, desc))
+        {
+            fwprintf(stderr, L"%ls does not read back as written\n", output.c_str());
+            return 1;
+        }
+
+        wprintf(L"%ls: %ux%u %ls, %u mips, %.1f ms\n", output.c_str(), width, height,
+            GetFormatName(options.fmt), (UINT32)mips.size(), seconds * 1000.0);
+
+        return 0;
+    }
+
+    /** Gradient with noise, close to the mix of smooth and busy blocks of real textures */
+    Image MakeBenchmarkImage()
+    {
+        Image image;
+        image.width = 2048;
+        image.height = 2048;
+        image.pixels.resize((size_t)image.width * image.height * 4);
+
+        UINT32 seed = 12345;
+        for (UINT32 y = 0; y < image.height; y++)
+        {
+            for (UINT32 x = 0; x < image.width; x++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                UINT32 noise = (seed >> 24) & 0x1F;
+
+                UINT8* pPixel = &image.pixels[((size_t)y * image.width + x) * 4];
+                pPixel[0] = (UINT8)std::min(255u, x * 255 / image.width + noise);
+                pPixel[1] = (UINT8)std::min(255u, y * 255 / image.height + noise);
+                pPixel[2] = (UINT8)(((x / 64) ^ (y / 64)) & 1 ? 200 : 40);
+                pPixel[3] = (UINT8)((x + y) * 255 / (image.width + image.height));
+            }
+        }
+
+        return image;
+    }
+
+    double ComputePSNR(const Image& image, const std::vector<UINT8>& decoded, UINT32 channels)
+    {
+        double error = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < image.pixels.size(); i += 4)
+        {
+            // Color of BC1 punch-through texels is black by definition, they do not count
+            if (channels == 3 && image.pixels[i + 3] < 128)
+            {
+                continue;
+            }
+
+            count++;
+            for (UINT32 c = 0; c < channels; c++)
+            {
+                double delta = (double)image.pixels[i + c] - decoded[i + c];
+                error += delta * delta;
+            }
+        }
+
+        error /= (double)std::max<size_t>(count * channels, 1);
+        return error == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / error);
+    }
+
+    /** Bakes the GGX prefiltered cubemap of a skybox, reusing the output if it is up to date */
+    int PrefilterEnvironment(const std::wstring& input, const std::wstring& output, const CookOptions& options)
+    {
+        std::vector<std::wstring> paths;
+        for (size_t start = 0; start <= input.size();)
+        {
+            size_t end = std::min(input.find(L',', start), input.size());
+            paths.push_back(input.substr(start, end - start));
+            start = end + 1;
+        }
+
+        if (paths.size() != 1 && paths.size() != 6)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        TextureDesc cubeDesc;
+        TextureDesc faceDescs[6];
+        for (size_t i = 0; i < paths.size(); i++)
+        {
+            TextureDesc& desc = paths.size() == 1 ? cubeDesc : faceDescs[i];
+            if (!LoadDDS(paths[i], desc, false, DDSLoadMode::Mapped))
+            {
+                fwprintf(stderr, L"Can not read %ls\n", paths[i].c_str());
+                return 1;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        TextureDesc result;
+        bool isCached = false;
+        if (!BakeSpecularEnvironment(cubeDesc, paths.size() == 1 ? nullptr : faceDescs, output, result,
+            options.specular, options.pPool, &isCached))
+        {
+            fwprintf(stderr, L"Can not prefilter %ls to %ls\n", input.c_str(), output.c_str());
+            return 1;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        wprintf(L"%ls: %ux%u cube, %u mips, %ls, %.1f ms\n", output.c_str(), result.width, result.height,
+            result.mipmapsCount, isCached ? L"up to date" : L"baked", seconds * 1000.0);
+
+        return 0;
+    }
+
+    /** Encodes the image with every format and quality, reports input throughput and quality */
+    int Benchmark(const std::wstring& input, const CookOptions& options, bool isFormatForced)
+    {
+        Image image;
+        if (input.empty())
+        {
+            image = MakeBenchmarkImage();
+        }
+        else if (!LoadImage(input, image))
+        {
+            fwprintf(stderr, L"Can not read %ls\n", input.c_str());
+            return 1;
+        }
+
+        const double megabytes = (double)image.pixels.size() / (1024.0 * 1024.0);
+
+        wprintf(L"%ux%u RGBA8 (%.1f MB), %u threads\n", image.width, image.height, megabytes,
+            options.pPool->GetThreadCount());
+        wprintf(L"%-9ls %-7ls %10ls %10ls %8ls\n", L"format", L"quality", L"ms", L"MB/s", L"PSNR");
+
+        const DXGI_FORMAT Formats[] = { DXGI_FORMAT_BC1_UNORM, DXGI_FORMAT_BC3_UNORM, DXGI_FORMAT_BC5_UNORM };
+        const BCQuality Qualities[] = { BCQuality::Fast, BCQuality::Normal, BCQuality::High };
+
+        for (DXGI_FORMAT fmt : Formats)
+        {
+            if (isFormatForced && fmt != options.fmt)
+            {
+                continue;
+            }
+
+            for (BCQuality quality : Qualities)
+            {
+                CookOptions runOptions = options;
+                runOptions.fmt = fmt;
+                runOptions.quality = quality;
+
+                // Best of several runs hides warm-up and scheduling noise
+                double bestSeconds = 1e30;
+                std::vector<UINT8> blocks;
+                for (int run = 0; run < 3; run++)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    blocks = Compress(image, runOptions);
+                    bestSeconds = std::min(bestSeconds,
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                }
+
+                std::vector<UINT8> decoded(image.pixels.size());
+                DecodeBC(fmt, blocks.data(), GetBlockPitch(fmt, image.width), image.width, image.height,
+                    decoded.data(), image.width * 4);
+
+                // BC1 is scored on color of opaque texels, BC5 stores red and green
+                UINT32 channels = fmt == DXGI_FORMAT_BC5_UNORM ? 2 : fmt == DXGI_FORMAT_BC1_UNORM ? 3 : 4;
+
+                wprintf(L"%-9ls %-7ls %10.1f %10.1f %8.2f\n", GetFormatName(fmt), GetQualityName(quality),
+                    bestSeconds * 1000.0, megabytes / bestSeconds, ComputePSNR(image, decoded, channels));
+            }
+        }
+
+        return 0;
+    }
+
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    std::vector<std::wstring> positional;
+    CookOptions options;
+    bool isBenchmark = false;
+    bool isPrefilter = false;
+    bool isFormatForced = false;
+    UINT32 threadCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::wstring arg = argv[i];
+
+        if (arg == L"--benchmark")
+        {
+            isBenchmark = true;
+        }
+        else if (arg == L"--prefilter-specular")
+        {
+            isPrefilter = true;
+        }
+        else if (arg == L"--verify")
+        {
+            options.verify = true;
+        }
+        else if (arg == L"--supercompress")
+        {
+            options.supercompress = true;
+        }
+        else if (arg == L"--normal-map")
+        {
+            options.isNormalMap = true;
+        }
+        else if (arg == L"--no-mips")
+        {
+            options.generateMips = false;
+        }
+        else if (arg == L"--format" && i + 1 < argc && ParseFormat(argv[i + 1], options.fmt))
+        {
+            isFormatForced = true;
+            i++;
+        }
+        else if (arg == L"--quality" && i + 1 < argc && ParseQuality(argv[i + 1], options.quality))
+        {
+            i++;
+        }
+        else if (arg == L"--mip-filter" && i + 1 < argc && ParseMipFilter(argv[i + 1], options.mipFilter))
+        {
+            i++;
+        }
+        else if (arg == L"--face-size" && i + 1 < argc)
+        {
+            options.specular.faceSize = (UINT32)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--samples" && i + 1 < argc)
+        {
+            options.specular.sampleCount = (UINT32)_wtoi(argv[++i]);
+        }
+        else if (arg == L"--threads" && i + 1 < argc)
+        {
+            threadCount = (UINT32)_wtoi(argv[++i]);
+        }
+        else if (arg.compare(0, 2, L"--") == 0)
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (options.isNormalMap && !isFormatForced)
+    {
+        options.fmt = DXGI_FORMAT_BC5_UNORM;
+    }
+
+    ThreadPool pool(threadCount);
+    options.pPool = &pool;
+
+    if (isBenchmark)
+    {
+        return Benchmark(positional.empty() ? std::wstring() : positional[0], options, isFormatForced);
+    }
+
+    if (positional.size() != 2)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (isPrefilter)
+    {
+        return PrefilterEnvironment(positional[0], positional[1], options);
+    }
+
+    return Cook(positional[0], positional[1], options);
+}